@@ -16,6 +16,10 @@ if USE_POSTGRES
 AM_CPPFLAGS += -DUSE_POSTGRES=1 $(libpq_CFLAGS)
 endif # USE_POSTGRES
 
+if USE_ZSTD
+AM_CPPFLAGS += -DUSE_ZSTD=1 $(libzstd_CFLAGS)
+endif # USE_ZSTD
+
 # USE_TRACY and tracy_CFLAGS here represent the case of enabling
 # tracy at configure-time; but even when it is disabled we want
 # its includes in the CPPFLAGS above, so its (disabled) headers
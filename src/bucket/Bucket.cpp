@@ -8,8 +8,10 @@
 #include "util/asio.h"
 #include "bucket/Bucket.h"
 #include "bucket/BucketApplicator.h"
+#include "bucket/BucketIndex.h"
 #include "bucket/BucketList.h"
 #include "bucket/BucketManager.h"
+#include "bucket/BucketMergeCheckpoint.h"
 #include "bucket/BucketOutputIterator.h"
 #include "bucket/LedgerCmp.h"
 #include "bucket/MergeKey.h"
@@ -40,7 +42,10 @@ Bucket::Bucket(std::string const& filename, Hash const& hash)
     {
         CLOG_TRACE(Bucket, "Bucket::Bucket() created, file exists : {}",
                    mFilename);
-        mSize = fs::size(filename);
+        XDRInputFileStream in;
+        in.open(filename);
+        mSize = in.size();
+        mCompressed = in.isCompressed();
     }
 }
 
@@ -66,6 +71,12 @@ Bucket::getSize() const
     return mSize;
 }
 
+bool
+Bucket::isCompressed() const
+{
+    return mCompressed;
+}
+
 bool
 Bucket::containsBucketIdentity(BucketEntry const& id) const
 {
@@ -82,6 +93,86 @@ Bucket::containsBucketIdentity(BucketEntry const& id) const
     return false;
 }
 
+void
+Bucket::setIndex(std::unique_ptr<BucketIndex const> index) const
+{
+    std::lock_guard<std::mutex> lock(mIndexMutex);
+    if (!mIndex)
+    {
+        mIndex = std::move(index);
+    }
+}
+
+bool
+Bucket::isIndexed() const
+{
+    std::lock_guard<std::mutex> lock(mIndexMutex);
+    return static_cast<bool>(mIndex);
+}
+
+std::shared_ptr<BucketIndex const>
+Bucket::getIndex() const
+{
+    {
+        std::lock_guard<std::mutex> lock(mIndexMutex);
+        if (mIndex)
+        {
+            return mIndex;
+        }
+    }
+
+    // Reading the whole bucket file can take a while; build without the lock
+    // so other lookups of an indexed bucket aren't stuck behind it. If two
+    // threads race here the first index set wins and the other is dropped.
+    CLOG_DEBUG(Bucket, "Indexing bucket {}", mFilename);
+    std::shared_ptr<BucketIndex const> index = BucketIndex::build(mFilename);
+    std::lock_guard<std::mutex> lock(mIndexMutex);
+    if (!mIndex)
+    {
+        mIndex = std::move(index);
+    }
+    return mIndex;
+}
+
+std::optional<BucketEntry>
+Bucket::getBucketEntry(LedgerKey const& key) const
+{
+    ZoneScoped;
+    if (mFilename.empty())
+    {
+        return std::nullopt;
+    }
+
+    auto page = getIndex()->lookup(key);
+    if (!page)
+    {
+        return std::nullopt;
+    }
+
+    XDRInputFileStream in;
+    in.open(mFilename);
+    in.seek(page->first);
+    LedgerEntryIdCmp cmp;
+    BucketEntry be;
+    while (in.pos() < page->second && in.readOne(be))
+    {
+        if (be.type() == METAENTRY)
+        {
+            continue;
+        }
+        auto k = getBucketLedgerKey(be);
+        if (cmp(key, k))
+        {
+            break;
+        }
+        if (!cmp(k, key))
+        {
+            return std::make_optional(std::move(be));
+        }
+    }
+    return std::nullopt;
+}
+
 #ifdef BUILD_TESTS
 void
 Bucket::apply(Application& app) const
@@ -164,7 +255,7 @@ Bucket::fresh(BucketManager& bucketManager, uint32_t protocolVersion,
 
     MergeCounters mc;
     BucketOutputIterator out(bucketManager.getTmpDir(), true, meta, mc, ctx,
-                             doFsync);
+                             doFsync, bucketManager.getCompressionLevel());
     for (auto const& e : entries)
     {
         out.put(e);
@@ -427,6 +518,25 @@ calculateMergeProtocolVersion(
     }
 }
 
+// Compare the identities of the current entries of two iterators: negative if
+// `a` sorts first, positive if `b` does, zero if they are the same key. Most
+// pairs are told apart by their key prefixes alone.
+static int
+compareCurrentKeys(BucketEntryIdCmp const& cmp, BucketInputIterator& a,
+                   BucketInputIterator& b)
+{
+    int c = a.keyPrefix().compare(b.keyPrefix());
+    if (c != 0)
+    {
+        return c;
+    }
+    if (cmp(*a, *b))
+    {
+        return -1;
+    }
+    return cmp(*b, *a) ? 1 : 0;
+}
+
 // There are 4 "easy" cases for merging: exhausted iterators on either
 // side, or entries that compare non-equal. In all these cases we just
 // take the lesser (or existing) entry and advance only one iterator,
@@ -438,7 +548,8 @@ mergeCasesWithDefaultAcceptance(
     std::vector<BucketInputIterator>& shadowIterators, uint32_t protocolVersion,
     bool keepShadowedLifecycleEntries)
 {
-    if (!ni || (oi && ni && cmp(*oi, *ni)))
+    int c = (oi && ni) ? compareCurrentKeys(cmp, oi, ni) : 0;
+    if (!ni || (oi && c < 0))
     {
         // Either of:
         //
@@ -453,7 +564,7 @@ mergeCasesWithDefaultAcceptance(
         ++oi;
         return true;
     }
-    else if (!oi || (oi && ni && cmp(*ni, *oi)))
+    else if (!oi || c > 0)
     {
         // Either of:
         //
@@ -632,8 +743,64 @@ Bucket::merge(BucketManager& bucketManager, uint32_t maxProtocolVersion,
     auto timer = bucketManager.getMergeTimer().TimeScope();
     BucketMetadata meta;
     meta.ledgerVersion = protocolVersion;
-    BucketOutputIterator out(bucketManager.getTmpDir(), keepDeadEntries, meta,
-                             mc, ctx, doFsync);
+    MergeKey mk{keepDeadEntries, oldBucket, newBucket, shadows};
+
+    // With merge checkpointing on, write the output where it survives a
+    // restart, and pick up from the last checkpoint of an earlier run of the
+    // same merge if there is one.
+    size_t expectedBytes = oldBucket->getSize() + newBucket->getSize();
+    BucketMergeStateDir const* stateDir = bucketManager.getMergeStateDir();
+    std::unique_ptr<BucketOutputIterator> outPtr;
+    if (stateDir)
+    {
+        auto resumeFrom = stateDir->loadCheckpoint(mk);
+        if (resumeFrom &&
+            (resumeFrom->mProtocolVersion != protocolVersion ||
+             resumeFrom->mShadowPos.size() != shadowIterators.size()))
+        {
+            CLOG_WARNING(Bucket, "Ignoring mismatched checkpoint of merge {}",
+                         mk);
+            resumeFrom.reset();
+        }
+        outPtr = std::make_unique<BucketOutputIterator>(
+            stateDir->getOutputFilename(mk), resumeFrom, keepDeadEntries, meta,
+            mc, ctx, doFsync, expectedBytes);
+        if (resumeFrom)
+        {
+            CLOG_INFO(Bucket, "Resuming merge {} from checkpoint", mk);
+            oi.seekToEntry(resumeFrom->mOldPos);
+            ni.seekToEntry(resumeFrom->mNewPos);
+            for (size_t i = 0; i < shadowIterators.size(); ++i)
+            {
+                shadowIterators[i].seekToEntry(resumeFrom->mShadowPos[i]);
+            }
+        }
+    }
+    else
+    {
+        outPtr = std::make_unique<BucketOutputIterator>(
+            bucketManager.getTmpDir(), keepDeadEntries, meta, mc, ctx, doFsync,
+            bucketManager.getCompressionLevel(), expectedBytes);
+    }
+    BucketOutputIterator& out = *outPtr;
+
+    // Every merge step leaves the iterators between entries, so the state
+    // between two steps is a consistent place to pick up from.
+    size_t nextCheckpoint =
+        stateDir ? out.getBytesPut() + stateDir->getCheckpointBytes() : 0;
+    auto saveCheckpoint = [&]() {
+        BucketMergeCheckpoint ckpt;
+        ckpt.mProtocolVersion = protocolVersion;
+        ckpt.mOldPos = oi.entryPos();
+        ckpt.mNewPos = ni.entryPos();
+        for (auto& si : shadowIterators)
+        {
+            ckpt.mShadowPos.emplace_back(si.entryPos());
+        }
+        out.checkpoint(ckpt);
+        stateDir->saveCheckpoint(mk, ckpt);
+        nextCheckpoint = out.getBytesPut() + stateDir->getCheckpointBytes();
+    };
 
     BucketEntryIdCmp cmp;
     size_t iter = 0;
@@ -648,10 +815,19 @@ Bucket::merge(BucketManager& bucketManager, uint32_t maxProtocolVersion,
             {
                 // Stop merging, as BucketManager is now shutdown
                 // This is safe as temp file has not been adopted yet,
-                // so it will be removed with the tmp dir
+                // so it will be removed with the tmp dir (or, with
+                // checkpointing on, picked up from here after restart)
+                if (stateDir)
+                {
+                    saveCheckpoint();
+                }
                 throw std::runtime_error(
                     "Incomplete bucket merge due to BucketManager shutdown");
             }
+            if (stateDir && out.getBytesPut() >= nextCheckpoint)
+            {
+                saveCheckpoint();
+            }
         }
 
         if (!mergeCasesWithDefaultAcceptance(cmp, mc, oi, ni, out,
@@ -667,8 +843,12 @@ Bucket::merge(BucketManager& bucketManager, uint32_t maxProtocolVersion,
     {
         bucketManager.incrMergeCounters(mc);
     }
-    MergeKey mk{keepDeadEntries, oldBucket, newBucket, shadows};
-    return out.getBucket(bucketManager, &mk);
+    auto res = out.getBucket(bucketManager, &mk);
+    if (stateDir)
+    {
+        stateDir->removeCheckpoint(mk);
+    }
+    return res;
 }
 
 uint32_t
@@ -10,6 +10,9 @@
 #include "util/NonCopyable.h"
 #include "util/ProtocolVersion.h"
 #include "util/XDRStream.h"
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 
 namespace stellar
@@ -27,6 +30,7 @@ namespace stellar
  */
 
 class Application;
+class BucketIndex;
 class BucketManager;
 class BucketList;
 class Database;
@@ -37,7 +41,17 @@ class Bucket : public std::enable_shared_from_this<Bucket>,
 
     std::string const mFilename;
     Hash const mHash;
+    // Size of the bucket's XDR, which is less than that of its file if the
+    // file is compressed.
     size_t mSize{0};
+    bool mCompressed{false};
+
+    // Set by BucketManager::indexBucket when the bucket is adopted or loaded,
+    // or built on first lookup otherwise; immutable once set.
+    mutable std::mutex mIndexMutex;
+    mutable std::shared_ptr<BucketIndex const> mIndex;
+
+    std::shared_ptr<BucketIndex const> getIndex() const;
 
   public:
     // Create an empty bucket. The empty bucket has hash '000000...' and its
@@ -53,10 +67,25 @@ class Bucket : public std::enable_shared_from_this<Bucket>,
     std::string const& getFilename() const;
     size_t getSize() const;
 
+    // Whether the bucket file is zstd-compressed (see BUCKET_COMPRESSION_LEVEL)
+    // rather than raw XDR; buckets downloaded by catchup are always raw.
+    bool isCompressed() const;
+
     // Returns true if a BucketEntry that is key-wise identical to the given
     // BucketEntry exists in the bucket. For testing.
     bool containsBucketIdentity(BucketEntry const& id) const;
 
+    // Returns the LIVEENTRY, INITENTRY or DEADENTRY for `key` in this bucket,
+    // if any, reading at most one index page of the bucket file.
+    std::optional<BucketEntry> getBucketEntry(LedgerKey const& key) const;
+
+    // Attach `index`, built while the bucket file was written, unless the
+    // bucket already has one.
+    void setIndex(std::unique_ptr<BucketIndex const> index) const;
+
+    // Whether the bucket has an index yet.
+    bool isIndexed() const;
+
     // At version 11, we added support for INITENTRY and METAENTRY. Before this
     // we were only supporting LIVEENTRY and DEADENTRY.
     static constexpr ProtocolVersion
@@ -182,6 +182,92 @@ BucketApplicator::advance(BucketApplicator::Counters& counters)
     return count;
 }
 
+BucketPartitionApplicator::BucketPartitionApplicator(
+    AbstractLedgerTxnParent& root, uint32_t maxProtocolVersion,
+    std::vector<std::shared_ptr<Bucket const>> const& newestFirst,
+    std::function<bool(LedgerEntryType)> filter)
+    : mRoot(root)
+    , mMaxProtocolVersion(maxProtocolVersion)
+    , mBuckets(newestFirst)
+    , mEntryTypeFilter(filter)
+{
+    openNextBucket();
+}
+
+BucketPartitionApplicator::operator bool() const
+{
+    return (bool)mBucketIter;
+}
+
+void
+BucketPartitionApplicator::openNextBucket()
+{
+    mBucketIter.reset();
+    while (mNextBucket < mBuckets.size())
+    {
+        auto iter =
+            std::make_unique<BucketInputIterator>(mBuckets[mNextBucket++]);
+        auto protocolVersion = iter->getMetadata().ledgerVersion;
+        if (protocolVersion > mMaxProtocolVersion)
+        {
+            throw std::runtime_error(fmt::format(
+                FMT_STRING("bucket protocol version {:d} exceeds "
+                           "maxProtocolVersion {:d}"),
+                protocolVersion, mMaxProtocolVersion));
+        }
+        if (*iter)
+        {
+            mBucketIter = std::move(iter);
+            return;
+        }
+    }
+}
+
+size_t
+BucketPartitionApplicator::advance()
+{
+    size_t count = 0;
+
+    LedgerTxn ltx(mRoot, false);
+    ltx.prepareNewObjects(LEDGER_ENTRY_BATCH_COMMIT_SIZE);
+
+    while (mBucketIter && count <= LEDGER_ENTRY_BATCH_COMMIT_SIZE)
+    {
+        BucketEntry const& e = **mBucketIter;
+        Bucket::checkProtocolLegality(e, mMaxProtocolVersion);
+
+        if (shouldApplyEntry(mEntryTypeFilter, e))
+        {
+            if (e.type() == LIVEENTRY || e.type() == INITENTRY)
+            {
+                if (mAppliedKeys.emplace(LedgerEntryKey(e.liveEntry())).second)
+                {
+                    // The entry may or may not be in the database already,
+                    // depending on the levels that did not need applying, so
+                    // write it as an update: both commit as an upsert.
+                    ltx.updateWithoutLoading(e.liveEntry());
+                    ++count;
+                }
+            }
+            else if (mAppliedKeys.emplace(e.deadEntry()).second)
+            {
+                // Erasing without loading tolerates the entry not existing.
+                ltx.eraseWithoutLoading(e.deadEntry());
+                ++count;
+            }
+        }
+
+        ++(*mBucketIter);
+        if (!*mBucketIter)
+        {
+            openNextBucket();
+        }
+    }
+    ltx.commit();
+
+    return count;
+}
+
 BucketApplicator::Counters::Counters(VirtualClock::time_point now)
 {
     reset(now);
@@ -7,12 +7,15 @@
 #include "bucket/Bucket.h"
 #include "bucket/BucketInputIterator.h"
 #include "util/Timer.h"
+#include "util/UnorderedSet.h"
 #include "util/XDRStream.h"
 #include <memory>
+#include <vector>
 
 namespace stellar
 {
 
+class AbstractLedgerTxnParent;
 class Application;
 
 // Class that represents a single apply-bucket-to-database operation in
@@ -76,4 +79,36 @@ class BucketApplicator
     size_t pos();
     size_t size() const;
 };
+
+// Applies, into a LedgerTxnRoot of the caller's choosing, the newest state of
+// every key that passes `filter` in a list of buckets given newest first. The
+// first entry seen for a key wins and older ones are skipped, which leaves
+// the same state as applying the buckets oldest first with BucketApplicator,
+// whatever the protocol version. LIVE and INIT entries are upserted and DEAD
+// entries erased if present. ApplyBucketsWork runs one of these per entry
+// type, concurrently, each on its own database connection.
+
+class BucketPartitionApplicator
+{
+    AbstractLedgerTxnParent& mRoot;
+    uint32_t mMaxProtocolVersion;
+    std::vector<std::shared_ptr<Bucket const>> mBuckets;
+    size_t mNextBucket{0};
+    std::unique_ptr<BucketInputIterator> mBucketIter;
+    std::function<bool(LedgerEntryType)> mEntryTypeFilter;
+    UnorderedSet<LedgerKey> mAppliedKeys;
+
+    void openNextBucket();
+
+  public:
+    BucketPartitionApplicator(
+        AbstractLedgerTxnParent& root, uint32_t maxProtocolVersion,
+        std::vector<std::shared_ptr<Bucket const>> const& newestFirst,
+        std::function<bool(LedgerEntryType)> filter);
+    operator bool() const;
+
+    // Apply and commit up to LEDGER_ENTRY_BATCH_COMMIT_SIZE entries, returning
+    // how many were written.
+    size_t advance();
+};
 }
@@ -0,0 +1,374 @@
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "bucket/BucketIndex.h"
+#include "bucket/LedgerCmp.h"
+#include "crypto/Hex.h"
+#include "crypto/Random.h"
+#include "crypto/XDRHasher.h"
+#include "util/Fs.h"
+#include "util/GlobalChecks.h"
+#include "util/Logging.h"
+#include "util/XDRStream.h"
+#include "util/siphash.h"
+#include "util/types.h"
+#include <Tracy.hpp>
+#include <fmt/format.h>
+#include <xdrpp/marshal.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+
+namespace stellar
+{
+
+size_t const BucketIndex::PAGE_SIZE = 16384;
+// 10 bits and 7 hashes per key give a false positive rate just under 1%.
+size_t const BucketIndex::BLOOM_BITS_PER_KEY = 10;
+size_t const BucketIndex::BLOOM_HASHES = 7;
+
+namespace
+{
+// Bump when the sidecar format changes; sidecars of other versions are
+// ignored, and their buckets indexed again.
+uint32_t const kSidecarVersion = 1;
+char const kSidecarMagic[4] = {'B', 'I', 'D', 'X'};
+
+struct KeyedXDRHasher : XDRHasher<KeyedXDRHasher>
+{
+    SipHash24 mState;
+    explicit KeyedXDRHasher(uint8_t const key[16]) : mState(key)
+    {
+    }
+    void
+    hashBytes(unsigned char const* bytes, size_t len)
+    {
+        mState.update(bytes, len);
+    }
+};
+
+// Sidecar integers are little-endian whatever the host.
+void
+putU64(std::ostream& out, uint64_t v)
+{
+    unsigned char b[8];
+    for (size_t i = 0; i < 8; ++i)
+    {
+        b[i] = static_cast<unsigned char>(v >> (8 * i));
+    }
+    out.write(reinterpret_cast<char const*>(b), sizeof(b));
+}
+
+uint64_t
+getU64(std::istream& in)
+{
+    unsigned char b[8];
+    if (!in.read(reinterpret_cast<char*>(b), sizeof(b)))
+    {
+        throw std::runtime_error("truncated");
+    }
+    uint64_t v = 0;
+    for (size_t i = 0; i < 8; ++i)
+    {
+        v |= static_cast<uint64_t>(b[i]) << (8 * i);
+    }
+    return v;
+}
+
+void
+putBytes(std::ostream& out, std::vector<uint8_t> const& bytes)
+{
+    putU64(out, bytes.size());
+    out.write(reinterpret_cast<char const*>(bytes.data()), bytes.size());
+}
+
+std::vector<uint8_t>
+getBytes(std::istream& in, size_t maxSize)
+{
+    auto size = getU64(in);
+    if (size > maxSize)
+    {
+        throw std::runtime_error("malformed");
+    }
+    std::vector<uint8_t> bytes(size);
+    if (!in.read(reinterpret_cast<char*>(bytes.data()), size))
+    {
+        throw std::runtime_error("truncated");
+    }
+    return bytes;
+}
+
+// Number of 64-bit words in the bloom filter of an index of `numKeys` keys.
+size_t
+bloomWords(size_t numKeys)
+{
+    size_t nBits =
+        std::max<size_t>(64, numKeys * BucketIndex::BLOOM_BITS_PER_KEY);
+    return (nBits + 63) / 64;
+}
+
+// Second, independent-enough hash for double hashing in the bloom filter
+// (the splitmix64 finalizer). Forced odd so that it is never 0.
+uint64_t
+secondHash(uint64_t h)
+{
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h | 1;
+}
+}
+
+LedgerKey
+getBucketLedgerKey(BucketEntry const& be)
+{
+    switch (be.type())
+    {
+    case LIVEENTRY:
+    case INITENTRY:
+        return LedgerEntryKey(be.liveEntry());
+    case DEADENTRY:
+        return be.deadEntry();
+    default:
+        throw std::runtime_error("Malformed bucket: unexpected "
+                                 "non-INIT/LIVE/DEAD entry.");
+    }
+}
+
+BucketIndex::BucketIndex()
+{
+    auto key = randomBytes(mBloomKey.size());
+    std::copy(key.begin(), key.end(), mBloomKey.begin());
+}
+
+std::unique_ptr<BucketIndex const>
+BucketIndex::build(std::string const& filename)
+{
+    ZoneScoped;
+    auto index = std::make_unique<BucketIndex>();
+    XDRInputFileStream in;
+    in.open(filename);
+    BucketEntry be;
+    size_t offset = in.pos();
+    while (in.readOne(be))
+    {
+        if (be.type() != METAENTRY)
+        {
+            index->add(getBucketLedgerKey(be), offset);
+        }
+        offset = in.pos();
+    }
+    index->finish();
+    return index;
+}
+
+std::unique_ptr<BucketIndex const>
+BucketIndex::load(std::string const& filename, Hash const& bucketHash)
+{
+    ZoneScoped;
+    if (!fs::exists(filename))
+    {
+        return nullptr;
+    }
+
+    auto index = std::make_unique<BucketIndex>();
+    try
+    {
+        std::ifstream in(filename, std::ios::binary);
+        char magic[sizeof(kSidecarMagic)];
+        if (!in.read(magic, sizeof(magic)) ||
+            !std::equal(magic, magic + sizeof(magic), kSidecarMagic))
+        {
+            throw std::runtime_error("not a bucket index");
+        }
+        auto version = getU64(in);
+        if (version != kSidecarVersion)
+        {
+            throw std::runtime_error(
+                fmt::format(FMT_STRING("unexpected version {}"), version));
+        }
+        auto hash = getBytes(in, bucketHash.size());
+        if (!std::equal(hash.begin(), hash.end(), bucketHash.begin(),
+                        bucketHash.end()))
+        {
+            throw std::runtime_error("index of another bucket");
+        }
+        auto key = getBytes(in, index->mBloomKey.size());
+        if (key.size() != index->mBloomKey.size())
+        {
+            throw std::runtime_error("malformed");
+        }
+        std::copy(key.begin(), key.end(), index->mBloomKey.begin());
+
+        index->mNumKeys = getU64(in);
+        auto nPages = getU64(in);
+        if (nPages > index->mNumKeys)
+        {
+            throw std::runtime_error("malformed");
+        }
+        index->mPages.reserve(nPages);
+        for (uint64_t i = 0; i < nPages; ++i)
+        {
+            auto offset = getU64(in);
+            LedgerKey k;
+            xdr::xdr_from_opaque(getBytes(in, PAGE_SIZE), k);
+            index->mPages.emplace_back(std::move(k), offset);
+        }
+        auto nWords = getU64(in);
+        if (nWords != bloomWords(index->mNumKeys))
+        {
+            throw std::runtime_error("malformed");
+        }
+        index->mBloomBits.resize(nWords);
+        for (auto& w : index->mBloomBits)
+        {
+            w = getU64(in);
+        }
+    }
+    catch (std::exception const& e)
+    {
+        CLOG_WARNING(Bucket, "Ignoring unusable bucket index {}: {}",
+                     filename, e.what());
+        return nullptr;
+    }
+    index->mFinished = true;
+    return index;
+}
+
+void
+BucketIndex::save(std::string const& filename, Hash const& bucketHash) const
+{
+    ZoneScoped;
+    releaseAssert(mFinished);
+    // Merges producing the same bucket may race to save its index.
+    std::string tmp = fmt::format(FMT_STRING("{}.{}.tmp"), filename,
+                                  binToHex(randomBytes(8)));
+    try
+    {
+        std::ofstream out;
+        out.exceptions(std::ios::failbit | std::ios::badbit);
+        out.open(tmp, std::ios::binary | std::ios::trunc);
+        out.write(kSidecarMagic, sizeof(kSidecarMagic));
+        putU64(out, kSidecarVersion);
+        putBytes(out, std::vector<uint8_t>(bucketHash.begin(),
+                                           bucketHash.end()));
+        putBytes(out,
+                 std::vector<uint8_t>(mBloomKey.begin(), mBloomKey.end()));
+        putU64(out, mNumKeys);
+        putU64(out, mPages.size());
+        for (auto const& page : mPages)
+        {
+            putU64(out, page.second);
+            putBytes(out, xdr::xdr_to_opaque(page.first));
+        }
+        putU64(out, mBloomBits.size());
+        for (auto w : mBloomBits)
+        {
+            putU64(out, w);
+        }
+    }
+    catch (...)
+    {
+        std::remove(tmp.c_str());
+        throw;
+    }
+    auto dir = std::filesystem::path(filename).parent_path().string();
+    if (!fs::durableRename(tmp, filename, dir))
+    {
+        std::remove(tmp.c_str());
+        throw std::runtime_error(
+            fmt::format(FMT_STRING("Failed to rename {} to {}"), tmp, filename));
+    }
+}
+
+uint64_t
+BucketIndex::hashKey(LedgerKey const& key) const
+{
+    KeyedXDRHasher hasher(mBloomKey.data());
+    xdr::archive(hasher, key);
+    hasher.flush();
+    return hasher.mState.digest();
+}
+
+void
+BucketIndex::add(LedgerKey const& key, size_t offset)
+{
+    releaseAssert(!mFinished);
+    if (mPages.empty() || offset - mPages.back().second >= PAGE_SIZE)
+    {
+        releaseAssert(mPages.empty() ||
+                      LedgerEntryIdCmp{}(mPages.back().first, key));
+        mPages.emplace_back(key, offset);
+    }
+    mKeyHashes.emplace_back(hashKey(key));
+    ++mNumKeys;
+}
+
+void
+BucketIndex::finish()
+{
+    ZoneScoped;
+    releaseAssert(!mFinished);
+    mBloomBits.assign(bloomWords(mNumKeys), 0);
+    size_t nBits = mBloomBits.size() * 64;
+    for (auto h : mKeyHashes)
+    {
+        auto h2 = secondHash(h);
+        for (size_t i = 0; i < BLOOM_HASHES; ++i)
+        {
+            auto bit = (h + i * h2) % nBits;
+            mBloomBits[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+    }
+    mKeyHashes.clear();
+    mKeyHashes.shrink_to_fit();
+    mPages.shrink_to_fit();
+    mFinished = true;
+}
+
+bool
+BucketIndex::bloomMayContain(uint64_t h) const
+{
+    size_t nBits = mBloomBits.size() * 64;
+    auto h2 = secondHash(h);
+    for (size_t i = 0; i < BLOOM_HASHES; ++i)
+    {
+        auto bit = (h + i * h2) % nBits;
+        if ((mBloomBits[bit / 64] & (uint64_t(1) << (bit % 64))) == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::optional<BucketIndex::PageRange>
+BucketIndex::lookup(LedgerKey const& key) const
+{
+    releaseAssert(mFinished);
+    if (mNumKeys == 0 || !bloomMayContain(hashKey(key)))
+    {
+        return std::nullopt;
+    }
+
+    // First page whose first key is greater than `key`; the key can only be
+    // on the page before it.
+    auto next = std::upper_bound(
+        mPages.begin(), mPages.end(), key,
+        [](LedgerKey const& k, std::pair<LedgerKey, size_t> const& page) {
+            return LedgerEntryIdCmp{}(k, page.first);
+        });
+    if (next == mPages.begin())
+    {
+        return std::nullopt;
+    }
+    size_t end = next == mPages.end() ? std::numeric_limits<size_t>::max()
+                                      : next->second;
+    return std::make_optional<PageRange>(std::prev(next)->second, end);
+}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+#include "xdr/Stellar-ledger.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace stellar
+{
+
+// The key of a LIVEENTRY, INITENTRY or DEADENTRY.
+LedgerKey getBucketLedgerKey(BucketEntry const& be);
+
+/**
+ * BucketIndex is a sparse index over the (sorted) entries of a bucket file,
+ * for point lookups: it records the first key of every page of roughly
+ * PAGE_SIZE bytes along with the file offset the page starts at, and keeps a
+ * bloom filter over every key in the bucket, so that most lookups of a key
+ * that isn't in the bucket don't touch the file at all.
+ *
+ * Keys are added in bucket order while the bucket is written (see
+ * BucketOutputIterator) or read back (see BucketIndex::build), and the index
+ * is immutable once finish() has been called.
+ *
+ * An index can be saved to a sidecar file next to its bucket and loaded back
+ * at startup instead of reading the whole bucket again. The bloom filter
+ * hashes keys with a random key of its own, saved along with it, rather than
+ * with the per-process shortHash key.
+ */
+class BucketIndex : public NonMovableOrCopyable
+{
+  public:
+    static size_t const PAGE_SIZE;
+    static size_t const BLOOM_BITS_PER_KEY;
+    static size_t const BLOOM_HASHES;
+
+    // Offsets [first, second) of the file to scan for a key; second is
+    // SIZE_MAX for the last page.
+    typedef std::pair<size_t, size_t> PageRange;
+
+    BucketIndex();
+
+    // Index the bucket file `filename` by reading it through.
+    static std::unique_ptr<BucketIndex const>
+    build(std::string const& filename);
+
+    // Load the index of the bucket with hash `bucketHash` saved to
+    // `filename`; nullptr if there is none, or it can't be used (written by
+    // another version, or for another bucket).
+    static std::unique_ptr<BucketIndex const>
+    load(std::string const& filename, Hash const& bucketHash);
+
+    // Atomically write the (finished) index of the bucket with hash
+    // `bucketHash` to `filename`.
+    void save(std::string const& filename, Hash const& bucketHash) const;
+
+    // Record the entry with key `key` that starts at `offset` in the file.
+    // Keys must be added in increasing order.
+    void add(LedgerKey const& key, size_t offset);
+    void finish();
+
+    // The page that contains `key`, if the bucket might contain it.
+    std::optional<PageRange> lookup(LedgerKey const& key) const;
+
+    size_t
+    numKeys() const
+    {
+        return mNumKeys;
+    }
+
+    size_t
+    numPages() const
+    {
+        return mPages.size();
+    }
+
+  private:
+    std::vector<std::pair<LedgerKey, size_t>> mPages;
+    size_t mNumKeys{0};
+    bool mFinished{false};
+    std::array<uint8_t, 16> mBloomKey;
+
+    // Hashes of the keys added so far; the bloom filter can only be sized,
+    // and populated, in finish().
+    std::vector<uint64_t> mKeyHashes;
+    std::vector<uint64_t> mBloomBits;
+
+    uint64_t hashKey(LedgerKey const& key) const;
+    bool bloomMayContain(uint64_t hash) const;
+};
+}
@@ -16,6 +16,7 @@ void
 BucketInputIterator::loadEntry()
 {
     ZoneScoped;
+    mKeyPrefixValid = false;
     if (mIn.readOne(mEntry))
     {
         mEntryPtr = &mEntry;
@@ -64,6 +65,34 @@ BucketInputIterator::size() const
     return mIn.size();
 }
 
+size_t
+BucketInputIterator::entryPos()
+{
+    if (!mEntryPtr)
+    {
+        return size();
+    }
+    // The stream is just past the current entry, which is a 4-byte size
+    // followed by its XDR.
+    return mIn.pos() - xdr::xdr_size(*mEntryPtr) - 4;
+}
+
+void
+BucketInputIterator::seekToEntry(size_t offset)
+{
+    ZoneScoped;
+    if (offset > size())
+    {
+        throw std::runtime_error("Seeking past end of bucket");
+    }
+    if (mBucket->getFilename().empty())
+    {
+        return;
+    }
+    mIn.seek(offset);
+    loadEntry();
+}
+
 BucketInputIterator::operator bool() const
 {
     return mEntryPtr != nullptr;
@@ -75,6 +104,17 @@ BucketInputIterator::operator*()
     return *mEntryPtr;
 }
 
+BucketEntryKeyPrefix const&
+BucketInputIterator::keyPrefix()
+{
+    if (!mKeyPrefixValid)
+    {
+        mKeyPrefix = BucketEntryKeyPrefix(*mEntryPtr);
+        mKeyPrefixValid = true;
+    }
+    return mKeyPrefix;
+}
+
 bool
 BucketInputIterator::seenMetadata() const
 {
@@ -101,7 +141,8 @@ BucketInputIterator::BucketInputIterator(std::shared_ptr<Bucket const> bucket)
     {
         CLOG_TRACE(Bucket, "BucketInputIterator opening file to read: {}",
                    mBucket->getFilename());
-        mIn.open(mBucket->getFilename());
+        // Buckets are immutable and (mostly) read front to back.
+        mIn.openMapped(mBucket->getFilename());
         loadEntry();
     }
 }
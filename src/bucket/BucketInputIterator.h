@@ -29,6 +29,8 @@ class BucketInputIterator
     bool mSeenMetadata{false};
     bool mSeenOtherEntries{false};
     BucketMetadata mMetadata;
+    BucketEntryKeyPrefix mKeyPrefix;
+    bool mKeyPrefixValid{false};
     void loadEntry();
 
   public:
@@ -46,6 +48,9 @@ class BucketInputIterator
 
     BucketEntry const& operator*();
 
+    // Key prefix of the current entry, computed on first use.
+    BucketEntryKeyPrefix const& keyPrefix();
+
     BucketInputIterator(std::shared_ptr<Bucket const> bucket);
 
     ~BucketInputIterator();
@@ -54,5 +59,12 @@ class BucketInputIterator
 
     size_t pos();
     size_t size() const;
+
+    // Offset of the current entry in the file, or size() once the iterator
+    // is exhausted; and the inverse, moving to the entry at an offset that
+    // entryPos() returned for the same bucket. Used to checkpoint and resume
+    // merges.
+    size_t entryPos();
+    void seekToEntry(size_t offset);
 };
 }
@@ -15,6 +15,9 @@
 #include "util/ProtocolVersion.h"
 #include "util/XDRStream.h"
 #include "util/types.h"
+
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
 #include <Tracy.hpp>
 #include <fmt/format.h>
 
@@ -371,6 +374,29 @@ BucketList::getHash() const
     return hsh.finish();
 }
 
+std::shared_ptr<LedgerEntry const>
+BucketList::getLedgerEntry(LedgerKey const& k) const
+{
+    ZoneScoped;
+    for (auto const& lev : mLevels)
+    {
+        for (auto const& b : {lev.getCurr(), lev.getSnap()})
+        {
+            auto be = b->getBucketEntry(k);
+            if (!be)
+            {
+                continue;
+            }
+            if (be->type() == DEADENTRY)
+            {
+                return nullptr;
+            }
+            return std::make_shared<LedgerEntry const>(be->liveEntry());
+        }
+    }
+    return nullptr;
+}
+
 // levelShouldSpill is the set of boundaries at which each level should spill,
 // it's not-entirely obvious which numbers these are by inspection, so we list
 // the first 3 values it's true on each level here for reference:
@@ -550,6 +576,18 @@ BucketList::addBatch(Application& app, uint32_t currLedger,
              * else spilled/added to it.
              */
 
+            // The merge into this level was due now; if it's still running,
+            // commit() blocks on it.
+            auto& next = mLevels[i].getNext();
+            if (next.isMerging() && !next.mergeComplete())
+            {
+                app.getMetrics()
+                    .NewMeter({"bucket", "merge-deadline-miss",
+                               "level-" + std::to_string(i)},
+                              "merge")
+                    .Mark();
+            }
+
             auto snap = mLevels[i - 1].snap();
             mLevels[i].commit();
             mLevels[i].prepare(app, currLedger, currLedgerProtocol, snap,
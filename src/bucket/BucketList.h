@@ -402,6 +402,13 @@ class BucketList
     // of the concatenation of the hashes of the `curr` and `snap` buckets.
     Hash getHash() const;
 
+    // Look up the entry with key `k` in the buckets, newest first: level 0
+    // to the last level, `curr` before `snap`. The first bucket holding `k`
+    // has its current state; returns null if that is a DEADENTRY, or if no
+    // bucket holds `k`. Merges in progress don't need to be consulted, since
+    // their inputs are still the `curr` and `snap` of some level.
+    std::shared_ptr<LedgerEntry const> getLedgerEntry(LedgerKey const& k) const;
+
     // Restart any merges that might be running on background worker threads,
     // merging buckets between levels. This needs to be called after forcing a
     // BucketList to adopt a new state, either at application restart or when
@@ -0,0 +1,114 @@
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "bucket/BucketListSnapshot.h"
+#include "bucket/Bucket.h"
+#include "bucket/BucketList.h"
+#include "crypto/SHA.h"
+#include "util/GlobalChecks.h"
+
+#include <Tracy.hpp>
+
+namespace stellar
+{
+
+namespace
+{
+std::vector<BucketListSnapshot::Level>
+levelsOf(BucketList const& bl)
+{
+    std::vector<BucketListSnapshot::Level> levels;
+    levels.reserve(BucketList::kNumLevels);
+    for (uint32_t i = 0; i < BucketList::kNumLevels; ++i)
+    {
+        auto const& lev = bl.getLevel(i);
+        levels.emplace_back(
+            BucketListSnapshot::Level{lev.getCurr(), lev.getSnap()});
+    }
+    return levels;
+}
+}
+
+BucketListSnapshot::BucketListSnapshot(BucketList const& bl,
+                                       uint32_t ledgerSeq)
+    : BucketListSnapshot(levelsOf(bl), ledgerSeq)
+{
+}
+
+BucketListSnapshot::BucketListSnapshot(std::vector<Level> levels,
+                                       uint32_t ledgerSeq)
+    : mLevels(std::move(levels)), mLedgerSeq(ledgerSeq)
+{
+    for (auto const& lev : mLevels)
+    {
+        releaseAssert(lev.mCurr && lev.mSnap);
+    }
+}
+
+uint32_t
+BucketListSnapshot::getLedgerSeq() const
+{
+    return mLedgerSeq;
+}
+
+size_t
+BucketListSnapshot::getNumLevels() const
+{
+    return mLevels.size();
+}
+
+BucketListSnapshot::Level const&
+BucketListSnapshot::getLevel(size_t i) const
+{
+    return mLevels.at(i);
+}
+
+Hash
+BucketListSnapshot::getHash() const
+{
+    ZoneScoped;
+    SHA256 hsh;
+    for (auto const& lev : mLevels)
+    {
+        SHA256 levHsh;
+        levHsh.add(lev.mCurr->getHash());
+        levHsh.add(lev.mSnap->getHash());
+        hsh.add(levHsh.finish());
+    }
+    return hsh.finish();
+}
+
+std::shared_ptr<LedgerEntry const>
+BucketListSnapshot::getLedgerEntry(LedgerKey const& k) const
+{
+    ZoneScoped;
+    std::shared_ptr<LedgerEntry const> result;
+    loopAllBuckets([&](std::shared_ptr<Bucket const> const& b) {
+        auto be = b->getBucketEntry(k);
+        if (!be)
+        {
+            return true;
+        }
+        if (be->type() != DEADENTRY)
+        {
+            result = std::make_shared<LedgerEntry const>(be->liveEntry());
+        }
+        return false;
+    });
+    return result;
+}
+
+void
+BucketListSnapshot::loopAllBuckets(
+    std::function<bool(std::shared_ptr<Bucket const> const&)> f) const
+{
+    for (auto const& lev : mLevels)
+    {
+        if (!f(lev.mCurr) || !f(lev.mSnap))
+        {
+            return;
+        }
+    }
+}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+#include "xdr/Stellar-ledger-entries.h"
+#include "xdr/Stellar-types.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace stellar
+{
+
+class Bucket;
+class BucketList;
+
+// An immutable view of the `curr` and `snap` buckets of every level of a
+// BucketList, as of the end of some ledger. A BucketList can only be touched
+// from the thread that owns it (the ledger-close thread while a ledger is
+// applied there), since `addBatch` mutates its levels in place; a snapshot
+// only holds shared_ptrs to buckets, which never change once written, so it
+// can be iterated or searched from any thread.
+//
+// Holding a snapshot pins its buckets: BucketManager::forgetUnreferencedBuckets
+// only drops a bucket once nothing but the BucketManager refers to it, so the
+// files stay on disk until the last snapshot referring to them is released.
+class BucketListSnapshot : public NonMovableOrCopyable
+{
+  public:
+    struct Level
+    {
+        std::shared_ptr<Bucket const> mCurr;
+        std::shared_ptr<Bucket const> mSnap;
+    };
+
+  private:
+    std::vector<Level> const mLevels;
+    uint32_t const mLedgerSeq;
+
+  public:
+    // Must be called on the thread that owns `bl`, while no addBatch is
+    // running on it.
+    BucketListSnapshot(BucketList const& bl, uint32_t ledgerSeq);
+    BucketListSnapshot(std::vector<Level> levels, uint32_t ledgerSeq);
+
+    uint32_t getLedgerSeq() const;
+    size_t getNumLevels() const;
+    Level const& getLevel(size_t i) const;
+
+    // Same value as BucketList::getHash() had when the snapshot was taken.
+    Hash getHash() const;
+
+    // Newest-first lookup of `k`, returning nullptr if the key is absent or
+    // was most recently deleted.
+    std::shared_ptr<LedgerEntry const> getLedgerEntry(LedgerKey const& k) const;
+
+    // Call `f` on every bucket, newest first (level 0 curr, level 0 snap,
+    // level 1 curr, ...). Stops early if `f` returns false.
+    void loopAllBuckets(
+        std::function<bool(std::shared_ptr<Bucket const> const&)> f) const;
+};
+}
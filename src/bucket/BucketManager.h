@@ -7,6 +7,7 @@
 #include "bucket/Bucket.h"
 #include "overlay/StellarXDR.h"
 #include "util/NonCopyable.h"
+#include <functional>
 #include <future>
 #include <map>
 #include <memory>
@@ -18,7 +19,10 @@ namespace stellar
 {
 
 class Application;
+class BucketIndex;
 class BucketList;
+class BucketListSnapshot;
+class BucketMergeStateDir;
 class TmpDirManager;
 struct LedgerHeader;
 struct MergeKey;
@@ -106,8 +110,20 @@ class BucketManager : NonMovableOrCopyable
     virtual std::string const& getBucketDir() const = 0;
     virtual BucketList& getBucketList() = 0;
 
+    // zstd level to compress new bucket files at, or 0 to write raw XDR.
+    virtual int getCompressionLevel() const = 0;
+
+    // Where merges save checkpoints (see BucketMergeStateDir), or nullptr if
+    // they don't: BUCKET_MERGE_CHECKPOINT_BYTES is unset, or buckets are
+    // compressed.
+    virtual BucketMergeStateDir const* getMergeStateDir() const = 0;
+
     virtual medida::Timer& getMergeTimer() = 0;
 
+    // Run `f`, a merge into BucketList level `level`, on the merge threads
+    // (see BucketMergeExecutor).
+    virtual void postMerge(uint32_t level, std::function<void()>&& f) = 0;
+
     // Reading and writing the merge counters is done in bulk, and takes a lock
     // briefly; this can be done from any thread.
     virtual MergeCounters readMergeCounters() = 0;
@@ -129,6 +145,15 @@ class BucketManager : NonMovableOrCopyable
                       size_t nObjects, size_t nBytes,
                       MergeKey* mergeKey = nullptr) = 0;
 
+    // Give the adopted bucket `b` its index: `index`, if it was built while
+    // the bucket was written, or else (with EXPERIMENTAL_BUCKET_POINT_LOADS)
+    // the one saved next to the bucket, or a new one read off the bucket.
+    // With EXPERIMENTAL_BUCKET_POINT_LOADS the index is saved next to the
+    // bucket too; without it, buckets not given an index are indexed on
+    // their first lookup. Can be called from any thread.
+    virtual void indexBucket(std::shared_ptr<Bucket> const& b,
+                             std::unique_ptr<BucketIndex const> index) = 0;
+
     // Companion method to `adoptFileAsBucket` also called from the
     // `BucketOutputIterator::getBucket` merge-completion path. This method
     // however should be called when the output bucket is _empty_ and thereby
@@ -137,6 +162,20 @@ class BucketManager : NonMovableOrCopyable
     // inputs to be GC'ed.
     virtual void noteEmptyMergeOutput(MergeKey const& mergeKey) = 0;
 
+    // Buckets written with fsync while a sync group is open -- as it is for
+    // the duration of `addBatch` -- don't sync their files or the bucket
+    // directory one by one. Instead, their writers hand the files to the
+    // group (see `deferBucketSync`), and closing the group syncs them all,
+    // and the bucket directory once. Groups don't nest.
+    virtual void openBucketSyncGroup() = 0;
+    virtual void closeBucketSyncGroup() = 0;
+    virtual bool hasBucketSyncGroup() const = 0;
+
+    // Add the bucket file `filename` to the open sync group and return true,
+    // or return false if there isn't one, in which case the caller must sync
+    // the file itself. Can be called from any thread.
+    virtual bool deferBucketSync(std::string const& filename) = 0;
+
     // Return a bucket by hash if we have it, else return nullptr.
     virtual std::shared_ptr<Bucket> getBucketByHash(uint256 const& hash) = 0;
 
@@ -162,10 +201,11 @@ class BucketManager : NonMovableOrCopyable
     virtual void clearMergeFuturesForTesting() = 0;
 #endif
 
-    // Forget any buckets not referenced by the current BucketList. This will
-    // not immediately cause the buckets to delete themselves, if someone else
-    // is using them via a shared_ptr<>, but the BucketManager will no longer
-    // independently keep them alive.
+    // Forget any buckets that are no longer referenced by anything: neither
+    // held via a shared_ptr<> (by the BucketList, a merge, a snapshot, ...)
+    // nor named by the LCL HAS or the publish queue. The BucketManager's own
+    // reference does not count, so only buckets released since the last call
+    // need to be looked at.
     virtual void forgetUnreferencedBuckets() = 0;
 
     // Feed a new batch of entries to the bucket list. This interface expects to
@@ -182,6 +222,13 @@ class BucketManager : NonMovableOrCopyable
     // state of the bucket list.
     virtual void snapshotLedger(LedgerHeader& currentHeader) = 0;
 
+    // Return an immutable snapshot of the BucketList as of the most recent
+    // `addBatch` or `assumeState`. The snapshot can be read from any thread,
+    // and keeps its buckets from being garbage-collected while it is held.
+    // Returns nullptr if the BucketList is disabled.
+    virtual std::shared_ptr<BucketListSnapshot const>
+    getBucketListSnapshot() const = 0;
+
 #ifdef BUILD_TESTS
     // Install a fake/assumed ledger version and bucket list hash to use in next
     // call to addBatch and snapshotLedger. This interface exists only for
@@ -199,6 +246,11 @@ class BucketManager : NonMovableOrCopyable
     // and publish queue.
     virtual std::set<Hash> getReferencedBuckets() const = 0;
 
+    // Tell the BucketManager that `has` was just stored as the LCL HAS, so it
+    // can keep its buckets without reading the HAS back from the database
+    // every time it collects garbage.
+    virtual void noteLastClosedLedgerHAS(HistoryArchiveState const& has) = 0;
+
     // Check for missing bucket files that would prevent `assumeState` from
     // succeeding
     virtual std::vector<std::string>
@@ -226,7 +278,8 @@ class BucketManager : NonMovableOrCopyable
     loadCompleteLedgerState(HistoryArchiveState const& has) = 0;
 
     // Merge the bucket list of the provided HAS into a single "super bucket"
-    // consisting of only live entries, and return it.
+    // consisting of only live entries, and return it. The bucket file is
+    // always raw XDR, whatever BUCKET_COMPRESSION_LEVEL is.
     virtual std::shared_ptr<Bucket>
     mergeBuckets(HistoryArchiveState const& has) = 0;
 
@@ -4,8 +4,12 @@
 
 #include "bucket/BucketManagerImpl.h"
 #include "bucket/Bucket.h"
+#include "bucket/BucketIndex.h"
 #include "bucket/BucketInputIterator.h"
 #include "bucket/BucketList.h"
+#include "bucket/BucketListSnapshot.h"
+#include "bucket/BucketMergeCheckpoint.h"
+#include "bucket/BucketMergeExecutor.h"
 #include "bucket/BucketOutputIterator.h"
 #include "crypto/Hex.h"
 #include "history/HistoryManager.h"
@@ -85,13 +89,49 @@ BucketManagerImpl::initialize()
     if (mApp.getConfig().MODE_ENABLES_BUCKETLIST)
     {
         mBucketList = std::make_unique<BucketList>();
+        refreshBucketListSnapshot(0);
+        initializeMergeState();
     }
 }
 
+void
+BucketManagerImpl::initializeMergeState()
+{
+    ZoneScoped;
+    mMergeStateDir.reset();
+    auto const& cfg = mApp.getConfig();
+    if (cfg.BUCKET_MERGE_CHECKPOINT_BYTES == 0 ||
+        cfg.BUCKET_COMPRESSION_LEVEL != 0)
+    {
+        return;
+    }
+#ifdef _WIN32
+    // Resuming a merge needs to reopen its output without truncating it.
+    CLOG_WARNING(Bucket,
+                 "BUCKET_MERGE_CHECKPOINT_BYTES is not supported on Windows");
+#else
+    mMergeStateDir = std::make_unique<BucketMergeStateDir>(
+        getBucketDir() + "/merges", cfg.BUCKET_MERGE_CHECKPOINT_BYTES);
+
+    // Merges that finished before the last shutdown can be reattached to, as
+    // long as their output is still on disk; cleanupStaleFiles drops the
+    // records of the ones that aren't wanted.
+    std::lock_guard<std::recursive_mutex> lock(mBucketMutex);
+    for (auto const& merge : mMergeStateDir->loadFinishedMerges())
+    {
+        mFinishedMerges.recordMerge(merge.first, merge.second);
+    }
+#endif
+}
+
 void
 BucketManagerImpl::dropAll()
 {
     ZoneScoped;
+    {
+        std::lock_guard<std::recursive_mutex> lock(mBucketMutex);
+        mLastClosedLedgerBuckets.reset();
+    }
     deleteEntireBucketDir();
     initialize();
 }
@@ -107,17 +147,26 @@ BucketManagerImpl::BucketManagerImpl(Application& app)
     , mBucketList(nullptr)
     , mTmpDirManager(nullptr)
     , mWorkDir(nullptr)
+    , mReleasedBuckets(std::make_shared<ReleasedBuckets>())
     , mLockedBucketDir(nullptr)
     , mBucketObjectInsertBatch(app.getMetrics().NewMeter(
           {"bucket", "batch", "objectsadded"}, "object"))
     , mBucketAddBatch(app.getMetrics().NewTimer({"bucket", "batch", "addtime"}))
     , mBucketSnapMerge(app.getMetrics().NewTimer({"bucket", "snap", "merge"}))
+    , mBucketGroupSync(
+          app.getMetrics().NewTimer({"bucket", "batch", "synctime"}))
     , mSharedBucketsSize(
           app.getMetrics().NewCounter({"bucket", "memory", "shared"}))
+    , mSharedBucketsBytes(
+          app.getMetrics().NewCounter({"bucket", "memory", "shared-bytes"}))
+    , mBucketGC(app.getMetrics().NewTimer({"bucket", "gc", "time"}))
     // Minimal DB is stored in the buckets dir, so delete it only when
     // mode does not use minimal DB
     , mDeleteEntireBucketDirInDtor(
           app.getConfig().isInMemoryModeWithoutMinimalDB())
+    , mMergeExecutor(std::make_unique<BucketMergeExecutor>(
+          app, app.getConfig().BUCKET_MERGE_THREADS,
+          app.getConfig().BUCKET_MERGE_MAX_LONG_MERGES))
 {
 }
 
@@ -134,7 +183,7 @@ bucketBasename(std::string const& bucketHexHash)
 bool
 isBucketFile(std::string const& name)
 {
-    static std::regex re("^bucket-[a-z0-9]{64}\\.xdr(\\.gz)?$");
+    static std::regex re("^bucket-[a-z0-9]{64}\\.xdr(\\.gz|\\.index)?$");
     return std::regex_match(name, re);
 };
 
@@ -242,12 +291,30 @@ BucketManagerImpl::getBucketList()
     return *mBucketList;
 }
 
+int
+BucketManagerImpl::getCompressionLevel() const
+{
+    return mApp.getConfig().BUCKET_COMPRESSION_LEVEL;
+}
+
+BucketMergeStateDir const*
+BucketManagerImpl::getMergeStateDir() const
+{
+    return mMergeStateDir.get();
+}
+
 medida::Timer&
 BucketManagerImpl::getMergeTimer()
 {
     return mBucketSnapMerge;
 }
 
+void
+BucketManagerImpl::postMerge(uint32_t level, std::function<void()>&& f)
+{
+    mMergeExecutor->post(level, std::move(f));
+}
+
 MergeCounters
 BucketManagerImpl::readMergeCounters()
 {
@@ -353,6 +420,17 @@ BucketManagerImpl::renameBucket(std::string const& src, std::string const& dst)
     {
         return rename(src.c_str(), dst.c_str()) == 0;
     }
+    std::lock_guard<std::recursive_mutex> lock(mBucketMutex);
+    if (mSyncGroupOpen)
+    {
+        // Leave the directory for the sync group to sync when it closes.
+        if (rename(src.c_str(), dst.c_str()) != 0)
+        {
+            return false;
+        }
+        mSyncGroupDirChanged = true;
+        return true;
+    }
     else
     {
         return fs::durableRename(src, dst, getBucketDir());
@@ -416,11 +494,8 @@ BucketManagerImpl::adoptFileAsBucket(std::string const& filename,
             }
         }
 
-        b = std::make_shared<Bucket>(canonicalName, hash);
-        {
-            mSharedBuckets.emplace(hash, b);
-            mSharedBucketsSize.set_count(mSharedBuckets.size());
-        }
+        addSharedBucket(hash, std::make_shared<Bucket>(canonicalName, hash));
+        b = getHandle(hash, mSharedBuckets.at(hash));
     }
     releaseAssert(b);
     if (mergeKey)
@@ -428,10 +503,57 @@ BucketManagerImpl::adoptFileAsBucket(std::string const& filename,
         // Second half of the mergeKey record-keeping, above: if we successfully
         // adopted (no throw), then (weakly) record the preimage of the hash.
         mFinishedMerges.recordMerge(*mergeKey, hash);
+        if (mMergeStateDir)
+        {
+            mMergeStateDir->saveFinishedMerge(*mergeKey, hash);
+        }
     }
     return b;
 }
 
+void
+BucketManagerImpl::indexBucket(std::shared_ptr<Bucket> const& b,
+                               std::unique_ptr<BucketIndex const> index)
+{
+    ZoneScoped;
+    if (!b || b->getFilename().empty())
+    {
+        return;
+    }
+    bool persist = mApp.getConfig().EXPERIMENTAL_BUCKET_POINT_LOADS;
+    if ((!index && !persist) || b->isIndexed())
+    {
+        return;
+    }
+
+    auto indexFilename = b->getFilename() + ".index";
+    if (!index)
+    {
+        index = BucketIndex::load(indexFilename, b->getHash());
+        if (index)
+        {
+            b->setIndex(std::move(index));
+            return;
+        }
+        CLOG_DEBUG(Bucket, "Indexing bucket {}", b->getFilename());
+        index = BucketIndex::build(b->getFilename());
+    }
+    if (persist)
+    {
+        try
+        {
+            index->save(indexFilename, b->getHash());
+        }
+        catch (std::exception const& e)
+        {
+            // The bucket is still usable; it'll be indexed again on restart.
+            CLOG_WARNING(Bucket, "Failed to save bucket index {}: {}",
+                         indexFilename, e.what());
+        }
+    }
+    b->setIndex(std::move(index));
+}
+
 void
 BucketManagerImpl::noteEmptyMergeOutput(MergeKey const& mergeKey)
 {
@@ -451,6 +573,67 @@ BucketManagerImpl::noteEmptyMergeOutput(MergeKey const& mergeKey)
     mLiveFutures.erase(mergeKey);
 }
 
+void
+BucketManagerImpl::openBucketSyncGroup()
+{
+#ifndef _WIN32
+    // Win32 has no directory fsync to defer: renames write through.
+    std::lock_guard<std::recursive_mutex> lock(mBucketMutex);
+    releaseAssert(!mSyncGroupOpen);
+    mSyncGroupOpen = true;
+#endif
+}
+
+void
+BucketManagerImpl::closeBucketSyncGroup()
+{
+    ZoneScoped;
+    std::vector<std::string> files;
+    bool dirChanged;
+    {
+        std::lock_guard<std::recursive_mutex> lock(mBucketMutex);
+        if (!mSyncGroupOpen)
+        {
+            return;
+        }
+        mSyncGroupOpen = false;
+        files.swap(mSyncGroupFiles);
+        dirChanged = mSyncGroupDirChanged;
+        mSyncGroupDirChanged = false;
+    }
+
+    // Nothing here can be garbage-collected before the group closes, so the
+    // files all still exist.
+    auto timer = mBucketGroupSync.TimeScope();
+    for (auto const& f : files)
+    {
+        fs::flushPathChanges(f);
+    }
+    if (dirChanged)
+    {
+        fs::flushPathChanges(getBucketDir());
+    }
+}
+
+bool
+BucketManagerImpl::hasBucketSyncGroup() const
+{
+    std::lock_guard<std::recursive_mutex> lock(mBucketMutex);
+    return mSyncGroupOpen;
+}
+
+bool
+BucketManagerImpl::deferBucketSync(std::string const& filename)
+{
+    std::lock_guard<std::recursive_mutex> lock(mBucketMutex);
+    if (!mSyncGroupOpen)
+    {
+        return false;
+    }
+    mSyncGroupFiles.emplace_back(filename);
+    return true;
+}
+
 std::shared_ptr<Bucket>
 BucketManagerImpl::getBucketByHash(uint256 const& hash)
 {
@@ -464,8 +647,8 @@ BucketManagerImpl::getBucketByHash(uint256 const& hash)
     if (i != mSharedBuckets.end())
     {
         CLOG_TRACE(Bucket, "BucketManager::getBucketByHash({}) found bucket {}",
-                   binToHex(hash), i->second->getFilename());
-        return i->second;
+                   binToHex(hash), i->second.mBucket->getFilename());
+        return getHandle(hash, i->second);
     }
     std::string canonicalName = bucketFilename(hash);
     if (fs::exists(canonicalName))
@@ -474,14 +657,47 @@ BucketManagerImpl::getBucketByHash(uint256 const& hash)
                    "BucketManager::getBucketByHash({}) found no bucket, making "
                    "new one",
                    binToHex(hash));
-        auto p = std::make_shared<Bucket>(canonicalName, hash);
-        mSharedBuckets.emplace(hash, p);
-        mSharedBucketsSize.set_count(mSharedBuckets.size());
-        return p;
+        addSharedBucket(hash, std::make_shared<Bucket>(canonicalName, hash));
+        return getHandle(hash, mSharedBuckets.at(hash));
     }
     return std::shared_ptr<Bucket>();
 }
 
+void
+BucketManagerImpl::addSharedBucket(Hash const& hash,
+                                   std::shared_ptr<Bucket> const& b)
+{
+    std::lock_guard<std::recursive_mutex> lock(mBucketMutex);
+    auto res = mSharedBuckets.emplace(hash, SharedBucket{b, {}});
+    releaseAssert(res.second);
+    mSharedBucketsSize.set_count(mSharedBuckets.size());
+    mSharedBucketsBytes.inc(b->getSize());
+}
+
+std::shared_ptr<Bucket>
+BucketManagerImpl::getHandle(Hash const& hash, SharedBucket& sb)
+{
+    std::lock_guard<std::recursive_mutex> lock(mBucketMutex);
+    auto handle = sb.mHandle.lock();
+    if (!handle)
+    {
+        // The deleter keeps the bucket alive (in case the BucketManager lets
+        // go of it first, at shutdown) and queues it for GC once the last
+        // handle dies, possibly on another thread.
+        std::weak_ptr<ReleasedBuckets> released = mReleasedBuckets;
+        handle = std::shared_ptr<Bucket>(
+            sb.mBucket.get(), [owner = sb.mBucket, released, hash](Bucket*) {
+                if (auto r = released.lock())
+                {
+                    std::lock_guard<std::mutex> guard(r->mMutex);
+                    r->mHashes.emplace_back(hash);
+                }
+            });
+        sb.mHandle = handle;
+    }
+    return handle;
+}
+
 std::shared_future<std::shared_ptr<Bucket>>
 BucketManagerImpl::getMergeFuture(MergeKey const& key)
 {
@@ -633,10 +849,30 @@ BucketManagerImpl::cleanupStaleFiles()
     auto referenced = getReferencedBuckets();
     std::transform(std::begin(mSharedBuckets), std::end(mSharedBuckets),
                    std::inserter(referenced, std::end(referenced)),
-                   [](std::pair<Hash, std::shared_ptr<Bucket>> const& p) {
+                   [](std::pair<Hash const, SharedBucket> const& p) {
                        return p.first;
                    });
 
+    if (mMergeStateDir)
+    {
+        // Keep the records of finished merges whose output we're keeping, and
+        // the checkpoints of merges that are running.
+        for (auto const& merge : mMergeStateDir->loadFinishedMerges())
+        {
+            if (referenced.find(merge.second) == referenced.end())
+            {
+                mMergeStateDir->forgetFinishedMerge(merge.first);
+                mFinishedMerges.forgetAllMergesProducing(merge.second);
+            }
+        }
+        UnorderedSet<MergeKey> running;
+        for (auto const& f : mLiveFutures)
+        {
+            running.emplace(f.first);
+        }
+        mMergeStateDir->removeCheckpointsExcept(running);
+    }
+
     for (auto f : fs::findfiles(getBucketDir(), isBucketFile))
     {
         auto hash = extractFromFilename(f);
@@ -651,74 +887,176 @@ BucketManagerImpl::cleanupStaleFiles()
     }
 }
 
+std::set<Hash> const&
+BucketManagerImpl::getLastClosedLedgerBuckets()
+{
+    std::lock_guard<std::recursive_mutex> lock(mBucketMutex);
+    if (!mLastClosedLedgerBuckets)
+    {
+        noteLastClosedLedgerHAS(
+            mApp.getLedgerManager().getLastClosedLedgerHAS());
+    }
+    return *mLastClosedLedgerBuckets;
+}
+
+void
+BucketManagerImpl::noteLastClosedLedgerHAS(HistoryArchiveState const& has)
+{
+    ZoneScoped;
+    std::set<Hash> buckets;
+    for (auto const& h : has.allBuckets())
+    {
+        buckets.emplace(hexToBin256(h));
+    }
+    std::lock_guard<std::recursive_mutex> lock(mBucketMutex);
+    mLastClosedLedgerBuckets = std::move(buckets);
+}
+
+bool
+BucketManagerImpl::isReferencedByHash(Hash const& hash)
+{
+    ZoneScoped;
+    if (!mApp.getConfig().MODE_ENABLES_BUCKETLIST)
+    {
+        return false;
+    }
+
+    // A FutureBucket that hasn't been made live again since a restart names
+    // its inputs (or output) without holding them.
+    auto hex = binToHex(hash);
+    for (uint32_t i = 0; i < BucketList::kNumLevels; ++i)
+    {
+        for (auto const& h : mBucketList->getLevel(i).getNext().getHashes())
+        {
+            if (h == hex)
+            {
+                CLOG_TRACE(Bucket, "{} referenced by bucket list", hex);
+                return true;
+            }
+        }
+    }
+
+    // Retain any bucket referenced by the last closed ledger as recorded in
+    // the database (as merges complete, the bucket list drifts from that
+    // state).
+    if (getLastClosedLedgerBuckets().count(hash) != 0)
+    {
+        CLOG_TRACE(Bucket, "{} referenced by LCL", hex);
+        return true;
+    }
+
+    // Retain buckets that are referenced by a state in the publish queue, and
+    // the outputs of any merges of theirs we know of -- which we'll want in
+    // order to resynthesize the merge in the future, rather than re-run it.
+    auto& hm = mApp.getHistoryManager();
+    if (hm.isBucketReferencedByPublishQueue(hex))
+    {
+        CLOG_TRACE(Bucket, "{} referenced by publish queue", hex);
+        return true;
+    }
+    std::set<Hash> inputs;
+    mFinishedMerges.getInputsProducing(hash, inputs);
+    for (auto const& in : inputs)
+    {
+        if (hm.isBucketReferencedByPublishQueue(binToHex(in)))
+        {
+            CLOG_TRACE(Bucket, "{} referenced as output of merge of {}", hex,
+                       hexAbbrev(in));
+            return true;
+        }
+    }
+    return false;
+}
+
 void
 BucketManagerImpl::forgetUnreferencedBuckets()
 {
     ZoneScoped;
     std::lock_guard<std::recursive_mutex> lock(mBucketMutex);
-    auto referenced = getReferencedBuckets();
+    auto timer = mBucketGC.TimeScope();
 
-    for (auto i = mSharedBuckets.begin(); i != mSharedBuckets.end();)
+    // Only buckets whose last handle has died since we last looked, and those
+    // we kept last time for being referenced by hash, can be unreferenced
+    // now.
     {
-        // Standard says map iterators other than the one you're erasing remain
-        // valid.
-        auto j = i;
-        ++i;
+        std::lock_guard<std::mutex> guard(mReleasedBuckets->mMutex);
+        mGCCandidates.insert(mReleasedBuckets->mHashes.begin(),
+                             mReleasedBuckets->mHashes.end());
+        mReleasedBuckets->mHashes.clear();
+    }
+
+    for (auto c = mGCCandidates.begin(); c != mGCCandidates.end();)
+    {
+        auto j = mSharedBuckets.find(*c);
 
         // Only drop buckets if the bucketlist has forgotten them _and_
-        // no other in-progress structures (worker threads, shadow lists)
-        // have references to them, just us. It's ok to retain a few too
-        // many buckets, a little longer than necessary.
+        // no other in-progress structures (worker threads, shadow lists,
+        // BucketListSnapshots) have handles to them, just us. A bucket that
+        // was handed out again since it was released is no longer a
+        // candidate; it'll come back when its new handles are gone.
         //
         // This conservatism is important because we want to enforce that only
         // one bucket ever exists in memory with a given filename, and that
         // we're the first and last to know about it. Otherwise buckets might
         // race on deleting the underlying file from one another.
+        if (j == mSharedBuckets.end() || !j->second.mHandle.expired())
+        {
+            c = mGCCandidates.erase(c);
+            continue;
+        }
+        if (isReferencedByHash(j->first))
+        {
+            ++c;
+            continue;
+        }
+
+        auto filename = j->second.mBucket->getFilename();
+        CLOG_TRACE(Bucket,
+                   "BucketManager::forgetUnreferencedBuckets dropping {}",
+                   filename);
+        if (!filename.empty() && !mApp.getConfig().DISABLE_BUCKET_GC)
+        {
+            CLOG_TRACE(Bucket, "removing bucket file: {}", filename);
+            std::remove(filename.c_str());
+            auto gzfilename = filename + ".gz";
+            std::remove(gzfilename.c_str());
+            auto indexfilename = filename + ".index";
+            std::remove(indexfilename.c_str());
+        }
 
-        if (referenced.find(j->first) == referenced.end() &&
-            j->second.use_count() == 1)
+        // Dropping this bucket means we'll no longer be able to
+        // resynthesize a std::shared_future pointing directly to it as a
+        // short-cut to performing a merge we've already seen. Therefore we
+        // should forget it from the weak map we use for that resynthesis.
+        for (auto const& forgottenMergeKey :
+             mFinishedMerges.forgetAllMergesProducing(j->first))
         {
-            auto filename = j->second->getFilename();
-            CLOG_TRACE(Bucket,
-                       "BucketManager::forgetUnreferencedBuckets dropping {}",
-                       filename);
-            if (!filename.empty() && !mApp.getConfig().DISABLE_BUCKET_GC)
+            if (mMergeStateDir)
             {
-                CLOG_TRACE(Bucket, "removing bucket file: {}", filename);
-                std::remove(filename.c_str());
-                auto gzfilename = filename + ".gz";
-                std::remove(gzfilename.c_str());
+                mMergeStateDir->forgetFinishedMerge(forgottenMergeKey);
             }
-
-            // Dropping this bucket means we'll no longer be able to
-            // resynthesize a std::shared_future pointing directly to it as a
-            // short-cut to performing a merge we've already seen. Therefore we
-            // should forget it from the weak map we use for that resynthesis.
-            for (auto const& forgottenMergeKey :
-                 mFinishedMerges.forgetAllMergesProducing(j->first))
+            // There should be no futures alive with this output: we
+            // switched to storing only weak input/output mappings when any
+            // merge producing the bucket completed (in adoptFileAsBucket),
+            // and nobody holds a handle to the bucket. But there might be a
+            // race we missed, so double check & mop up here. Worst case
+            // we prevent a slow memory leak at the cost of redoing merges
+            // we might have been able to reattach to.
+            auto f = mLiveFutures.find(forgottenMergeKey);
+            if (f != mLiveFutures.end())
             {
-                // There should be no futures alive with this output: we
-                // switched to storing only weak input/output mappings when any
-                // merge producing the bucket completed (in adoptFileAsBucket),
-                // and we believe there's only one reference to the bucket
-                // anyways -- our own in mSharedBuckets. But there might be a
-                // race we missed, so double check & mop up here. Worst case
-                // we prevent a slow memory leak at the cost of redoing merges
-                // we might have been able to reattach to.
-                auto f = mLiveFutures.find(forgottenMergeKey);
-                if (f != mLiveFutures.end())
-                {
-                    CLOG_WARNING(
-                        Bucket,
-                        "Unexpected live future for unreferenced bucket: {}",
-                        binToHex(i->first));
-                    mLiveFutures.erase(f);
-                }
+                CLOG_WARNING(
+                    Bucket,
+                    "Unexpected live future for unreferenced bucket: {}",
+                    binToHex(j->first));
+                mLiveFutures.erase(f);
             }
-
-            // All done, delete the bucket from the shared map.
-            mSharedBuckets.erase(j);
         }
+
+        // All done, delete the bucket from the shared map.
+        mSharedBucketsBytes.dec(j->second.mBucket->getSize());
+        mSharedBuckets.erase(j);
+        c = mGCCandidates.erase(c);
     }
     mSharedBucketsSize.set_count(mSharedBuckets.size());
 }
@@ -741,8 +1079,37 @@ BucketManagerImpl::addBatch(Application& app, uint32_t currLedger,
     auto timer = mBucketAddBatch.TimeScope();
     mBucketObjectInsertBatch.Mark(initEntries.size() + liveEntries.size() +
                                   deadEntries.size());
-    mBucketList->addBatch(app, currLedger, currLedgerProtocol, initEntries,
-                          liveEntries, deadEntries);
+    // Sync the buckets this batch writes together, once it's done.
+    openBucketSyncGroup();
+    try
+    {
+        mBucketList->addBatch(app, currLedger, currLedgerProtocol, initEntries,
+                              liveEntries, deadEntries);
+    }
+    catch (...)
+    {
+        closeBucketSyncGroup();
+        throw;
+    }
+    closeBucketSyncGroup();
+    refreshBucketListSnapshot(currLedger);
+}
+
+void
+BucketManagerImpl::refreshBucketListSnapshot(uint32_t ledgerSeq)
+{
+    ZoneScoped;
+    auto snapshot =
+        std::make_shared<BucketListSnapshot const>(*mBucketList, ledgerSeq);
+    std::lock_guard<std::recursive_mutex> lock(mBucketMutex);
+    mBucketListSnapshot = std::move(snapshot);
+}
+
+std::shared_ptr<BucketListSnapshot const>
+BucketManagerImpl::getBucketListSnapshot() const
+{
+    std::lock_guard<std::recursive_mutex> lock(mBucketMutex);
+    return mBucketListSnapshot;
 }
 
 #ifdef BUILD_TESTS
@@ -847,12 +1214,15 @@ BucketManagerImpl::assumeState(HistoryArchiveState const& has,
             throw std::runtime_error(
                 "Missing bucket files while assuming saved BucketList state");
         }
+        indexBucket(curr, nullptr);
+        indexBucket(snap, nullptr);
         mBucketList->getLevel(i).setCurr(curr);
         mBucketList->getLevel(i).setSnap(snap);
         mBucketList->getLevel(i).setNext(has.currentBuckets.at(i).next);
     }
 
     mBucketList->restartMerges(mApp, maxProtocolVersion, has.currentLedger);
+    refreshBucketListSnapshot(has.currentLedger);
     cleanupStaleFiles();
 }
 
@@ -860,6 +1230,8 @@ void
 BucketManagerImpl::shutdown()
 {
     mIsShutdown = true;
+    // Running merges notice the shutdown and stop early.
+    mMergeExecutor->shutdown();
 }
 
 bool
@@ -8,8 +8,10 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <set>
 #include <string>
+#include <vector>
 
 // Copyright 2015 Stellar Development Foundation and contributors. Licensed
 // under the Apache License, Version 2.0. See the COPYING file at the root
@@ -29,6 +31,9 @@ class TmpDir;
 class Application;
 class Bucket;
 class BucketList;
+class BucketListSnapshot;
+class BucketMergeStateDir;
+class BucketMergeExecutor;
 struct HistoryArchiveState;
 
 class BucketManagerImpl : public BucketManager
@@ -37,19 +42,69 @@ class BucketManagerImpl : public BucketManager
 
     Application& mApp;
     std::unique_ptr<BucketList> mBucketList;
+    // Replaced after every change to mBucketList's curr/snap buckets, guarded
+    // by mBucketMutex.
+    std::shared_ptr<BucketListSnapshot const> mBucketListSnapshot;
     std::unique_ptr<TmpDirManager> mTmpDirManager;
     std::unique_ptr<TmpDir> mWorkDir;
-    std::map<Hash, std::shared_ptr<Bucket>> mSharedBuckets;
+    // Set when merges persist their progress across restarts.
+    std::unique_ptr<BucketMergeStateDir> mMergeStateDir;
+
+    // Every bucket with a file in the bucket dir that's in memory. The
+    // BucketManager owns `mBucket`, but hands out `mHandle` instead: a
+    // shared_ptr to the same Bucket with its own reference count, whose
+    // deleter reports the bucket to mReleasedBuckets. So the BucketManager's
+    // reference doesn't keep `mHandle` alive, and a bucket needs looking at
+    // by GC only once it has been released by everyone else.
+    //
+    // Bucket::shared_from_this() yields `mBucket`, not a handle, so it only
+    // suits a Bucket method working on behalf of a caller holding one.
+    struct SharedBucket
+    {
+        std::shared_ptr<Bucket> mBucket;
+        std::weak_ptr<Bucket> mHandle;
+    };
+    std::map<Hash, SharedBucket> mSharedBuckets;
     mutable std::recursive_mutex mBucketMutex;
+
+    // Hashes of buckets whose last handle has died, appended to by handle
+    // deleters on whatever thread drops them. Shared with the deleters, which
+    // can outlive the BucketManager.
+    struct ReleasedBuckets
+    {
+        std::mutex mMutex;
+        std::vector<Hash> mHashes;
+    };
+    std::shared_ptr<ReleasedBuckets> mReleasedBuckets;
+
+    // Buckets that had no handle at some forgetUnreferencedBuckets but were
+    // kept because the LCL HAS, the publish queue or a FutureBucket named
+    // them, along with those released since. Guarded by mBucketMutex.
+    UnorderedSet<Hash> mGCCandidates;
+
+    // The buckets of the LCL HAS, as of the last noteLastClosedLedgerHAS (or
+    // as read from the database, if there hasn't been one). Guarded by
+    // mBucketMutex.
+    std::optional<std::set<Hash>> mLastClosedLedgerBuckets;
     std::unique_ptr<std::string> mLockedBucketDir;
     medida::Meter& mBucketObjectInsertBatch;
     medida::Timer& mBucketAddBatch;
     medida::Timer& mBucketSnapMerge;
+    medida::Timer& mBucketGroupSync;
     medida::Counter& mSharedBucketsSize;
+    medida::Counter& mSharedBucketsBytes;
+    medida::Timer& mBucketGC;
     MergeCounters mMergeCounters;
 
     bool const mDeleteEntireBucketDirInDtor;
 
+    // The open bucket sync group, if any: the files to sync when it closes,
+    // and whether anything was renamed into the bucket dir meanwhile. Guarded
+    // by mBucketMutex.
+    bool mSyncGroupOpen{false};
+    std::vector<std::string> mSyncGroupFiles;
+    bool mSyncGroupDirChanged{false};
+
     // Records bucket-merges that are currently _live_ in some FutureBucket, in
     // the sense of either running, or finished (with or without the
     // FutureBucket being resolved). Entries in this map will be cleared when
@@ -67,7 +122,17 @@ class BucketManagerImpl : public BucketManager
 
     std::atomic<bool> mIsShutdown{false};
 
+    // Declared after the state merges use, so that it's destroyed (and
+    // merges are done) first.
+    std::unique_ptr<BucketMergeExecutor> mMergeExecutor;
+
     void cleanupStaleFiles();
+    std::shared_ptr<Bucket> getHandle(Hash const& hash, SharedBucket& sb);
+    void addSharedBucket(Hash const& hash, std::shared_ptr<Bucket> const& b);
+    bool isReferencedByHash(Hash const& hash);
+    std::set<Hash> const& getLastClosedLedgerBuckets();
+    void refreshBucketListSnapshot(uint32_t ledgerSeq);
+    void initializeMergeState();
     void deleteTmpDirAndUnlockBucketDir();
     void deleteEntireBucketDir();
     bool renameBucket(std::string const& src, std::string const& dst);
@@ -91,7 +156,10 @@ class BucketManagerImpl : public BucketManager
     std::string const& getTmpDir() override;
     std::string const& getBucketDir() const override;
     BucketList& getBucketList() override;
+    int getCompressionLevel() const override;
+    BucketMergeStateDir const* getMergeStateDir() const override;
     medida::Timer& getMergeTimer() override;
+    void postMerge(uint32_t level, std::function<void()>&& f) override;
     MergeCounters readMergeCounters() override;
     void incrMergeCounters(MergeCounters const&) override;
     TmpDirManager& getTmpDirManager() override;
@@ -99,7 +167,13 @@ class BucketManagerImpl : public BucketManager
     adoptFileAsBucket(std::string const& filename, uint256 const& hash,
                       size_t nObjects, size_t nBytes,
                       MergeKey* mergeKey = nullptr) override;
+    void indexBucket(std::shared_ptr<Bucket> const& b,
+                     std::unique_ptr<BucketIndex const> index) override;
     void noteEmptyMergeOutput(MergeKey const& mergeKey) override;
+    void openBucketSyncGroup() override;
+    void closeBucketSyncGroup() override;
+    bool hasBucketSyncGroup() const override;
+    bool deferBucketSync(std::string const& filename) override;
     std::shared_ptr<Bucket> getBucketByHash(uint256 const& hash) override;
 
     std::shared_future<std::shared_ptr<Bucket>>
@@ -117,6 +191,8 @@ class BucketManagerImpl : public BucketManager
                   std::vector<LedgerEntry> const& liveEntries,
                   std::vector<LedgerKey> const& deadEntries) override;
     void snapshotLedger(LedgerHeader& currentHeader) override;
+    std::shared_ptr<BucketListSnapshot const>
+    getBucketListSnapshot() const override;
 
 #ifdef BUILD_TESTS
     // Install a fake/assumed ledger version and bucket list hash to use in next
@@ -129,6 +205,7 @@ class BucketManagerImpl : public BucketManager
 #endif
 
     std::set<Hash> getReferencedBuckets() const override;
+    void noteLastClosedLedgerHAS(HistoryArchiveState const& has) override;
     std::vector<std::string>
     checkForMissingBucketsFiles(HistoryArchiveState const& has) override;
     void assumeState(HistoryArchiveState const& has,
@@ -0,0 +1,292 @@
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "bucket/BucketMergeCheckpoint.h"
+#include "crypto/Hex.h"
+#include "crypto/SHA.h"
+#include "util/Fs.h"
+#include "util/Logging.h"
+#include <Tracy.hpp>
+#include <fmt/format.h>
+
+#include <cereal/archives/json.hpp>
+#include <cereal/cereal.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
+#include <cstdio>
+#include <fstream>
+
+namespace stellar
+{
+
+namespace
+{
+// Bump when the checkpoint format changes; checkpoints of other versions are
+// ignored, which just means their merges start over.
+uint32_t const kCheckpointVersion = 2;
+
+char const* const kPartialSuffix = ".partial";
+char const* const kCheckpointSuffix = ".checkpoint";
+char const* const kFinishedSuffix = ".merge";
+
+// Length of the hex MergeKey hash every file in the dir is named after.
+size_t const kNameLength = 64;
+
+std::string
+stateName(MergeKey const& mk)
+{
+    SHA256 hsh;
+    uint8_t keep = mk.mKeepDeadEntries ? 1 : 0;
+    hsh.add(ByteSlice(&keep, 1));
+    hsh.add(mk.mInputCurrBucket);
+    hsh.add(mk.mInputSnapBucket);
+    for (auto const& s : mk.mInputShadowBuckets)
+    {
+        hsh.add(s);
+    }
+    return binToHex(hsh.finish());
+}
+
+bool
+hasSuffix(std::string const& name, char const* suffix)
+{
+    std::string s(suffix);
+    return name.size() == kNameLength + s.size() &&
+           name.compare(kNameLength, s.size(), s) == 0;
+}
+
+// Write `save` to `path` through a temporary file, so that readers see either
+// the old contents or the new ones.
+template <typename F>
+void
+writeJsonFile(std::string const& dir, std::string const& path, F save)
+{
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out;
+        out.exceptions(std::ios::failbit | std::ios::badbit);
+        out.open(tmp, std::ios::out | std::ios::trunc);
+        cereal::JSONOutputArchive ar(out);
+        save(ar);
+    }
+    if (!fs::durableRename(tmp, path, dir))
+    {
+        throw std::runtime_error(
+            fmt::format(FMT_STRING("Failed to rename {} to {}"), tmp, path));
+    }
+}
+}
+
+BucketMergeStateDir::BucketMergeStateDir(std::string const& dir,
+                                         size_t checkpointBytes)
+    : mDir(dir), mCheckpointBytes(checkpointBytes)
+{
+    if (!fs::exists(mDir) && !fs::mkpath(mDir))
+    {
+        throw std::runtime_error("Unable to create merge state directory: " +
+                                 mDir);
+    }
+}
+
+std::string
+BucketMergeStateDir::pathFor(MergeKey const& mk, char const* suffix) const
+{
+    return mDir + "/" + stateName(mk) + suffix;
+}
+
+size_t
+BucketMergeStateDir::getCheckpointBytes() const
+{
+    return mCheckpointBytes;
+}
+
+std::string
+BucketMergeStateDir::getOutputFilename(MergeKey const& mk) const
+{
+    return pathFor(mk, kPartialSuffix);
+}
+
+std::optional<BucketMergeCheckpoint>
+BucketMergeStateDir::loadCheckpoint(MergeKey const& mk) const
+{
+    ZoneScoped;
+    std::string path = pathFor(mk, kCheckpointSuffix);
+    if (!fs::exists(path))
+    {
+        return std::nullopt;
+    }
+
+    BucketMergeCheckpoint ckpt;
+    try
+    {
+        std::ifstream in(path);
+        in.exceptions(std::ios::badbit);
+        cereal::JSONInputArchive ar(in);
+        uint32_t version;
+        std::string buffered;
+        ar(cereal::make_nvp("version", version));
+        if (version != kCheckpointVersion)
+        {
+            throw std::runtime_error(
+                fmt::format(FMT_STRING("unexpected version {}"), version));
+        }
+        ar(cereal::make_nvp("protocolVersion", ckpt.mProtocolVersion));
+        ar(cereal::make_nvp("oldPos", ckpt.mOldPos));
+        ar(cereal::make_nvp("newPos", ckpt.mNewPos));
+        ar(cereal::make_nvp("shadowPos", ckpt.mShadowPos));
+        ar(cereal::make_nvp("bytesPut", ckpt.mBytesPut));
+        ar(cereal::make_nvp("objectsPut", ckpt.mObjectsPut));
+        ar(cereal::make_nvp("putMeta", ckpt.mPutMeta));
+        ar(cereal::make_nvp("buffered", buffered));
+        if (!buffered.empty())
+        {
+            ckpt.mBuffered = std::make_optional<BucketEntry>();
+            xdr::xdr_from_opaque(hexToBin(buffered), *ckpt.mBuffered);
+        }
+    }
+    catch (std::exception const& e)
+    {
+        CLOG_WARNING(Bucket, "Ignoring unreadable merge checkpoint {}: {}",
+                     path, e.what());
+        return std::nullopt;
+    }
+
+    std::string output = getOutputFilename(mk);
+    if (!fs::exists(output) || fs::size(output) < ckpt.mBytesPut)
+    {
+        CLOG_WARNING(Bucket,
+                     "Ignoring merge checkpoint {}: output {} is missing or "
+                     "truncated",
+                     path, output);
+        return std::nullopt;
+    }
+    return std::make_optional(std::move(ckpt));
+}
+
+void
+BucketMergeStateDir::saveCheckpoint(MergeKey const& mk,
+                                    BucketMergeCheckpoint const& ckpt) const
+{
+    ZoneScoped;
+    std::string buffered =
+        ckpt.mBuffered ? binToHex(xdr::xdr_to_opaque(*ckpt.mBuffered)) : "";
+    writeJsonFile(
+        mDir, pathFor(mk, kCheckpointSuffix),
+        [&](cereal::JSONOutputArchive& ar) {
+            ar(cereal::make_nvp("version", kCheckpointVersion));
+            ar(cereal::make_nvp("protocolVersion", ckpt.mProtocolVersion));
+            ar(cereal::make_nvp("oldPos", ckpt.mOldPos));
+            ar(cereal::make_nvp("newPos", ckpt.mNewPos));
+            ar(cereal::make_nvp("shadowPos", ckpt.mShadowPos));
+            ar(cereal::make_nvp("bytesPut", ckpt.mBytesPut));
+            ar(cereal::make_nvp("objectsPut", ckpt.mObjectsPut));
+            ar(cereal::make_nvp("putMeta", ckpt.mPutMeta));
+            ar(cereal::make_nvp("buffered", buffered));
+        });
+}
+
+void
+BucketMergeStateDir::removeCheckpoint(MergeKey const& mk) const
+{
+    std::remove(pathFor(mk, kCheckpointSuffix).c_str());
+    std::remove(getOutputFilename(mk).c_str());
+}
+
+void
+BucketMergeStateDir::removeCheckpointsExcept(
+    UnorderedSet<MergeKey> const& keep) const
+{
+    ZoneScoped;
+    UnorderedSet<std::string> keepNames;
+    for (auto const& mk : keep)
+    {
+        keepNames.emplace(stateName(mk));
+    }
+    auto isCheckpointFile = [](std::string const& name) {
+        return hasSuffix(name, kCheckpointSuffix) ||
+               hasSuffix(name, ".checkpoint.tmp") ||
+               hasSuffix(name, kPartialSuffix);
+    };
+    for (auto const& f : fs::findfiles(mDir, isCheckpointFile))
+    {
+        if (keepNames.find(f.substr(0, kNameLength)) == keepNames.end())
+        {
+            CLOG_DEBUG(Bucket, "Removing stale merge state {}", f);
+            std::remove((mDir + "/" + f).c_str());
+        }
+    }
+}
+
+void
+BucketMergeStateDir::saveFinishedMerge(MergeKey const& mk,
+                                       Hash const& output) const
+{
+    ZoneScoped;
+    std::vector<std::string> shadows;
+    for (auto const& s : mk.mInputShadowBuckets)
+    {
+        shadows.emplace_back(binToHex(s));
+    }
+    std::string curr = binToHex(mk.mInputCurrBucket);
+    std::string snap = binToHex(mk.mInputSnapBucket);
+    std::string out = binToHex(output);
+    writeJsonFile(mDir, pathFor(mk, kFinishedSuffix),
+                  [&](cereal::JSONOutputArchive& ar) {
+                      ar(cereal::make_nvp("keep", mk.mKeepDeadEntries));
+                      ar(cereal::make_nvp("curr", curr));
+                      ar(cereal::make_nvp("snap", snap));
+                      ar(cereal::make_nvp("shadow", shadows));
+                      ar(cereal::make_nvp("output", out));
+                  });
+}
+
+void
+BucketMergeStateDir::forgetFinishedMerge(MergeKey const& mk) const
+{
+    std::remove(pathFor(mk, kFinishedSuffix).c_str());
+}
+
+std::vector<std::pair<MergeKey, Hash>>
+BucketMergeStateDir::loadFinishedMerges() const
+{
+    ZoneScoped;
+    std::vector<std::pair<MergeKey, Hash>> merges;
+    auto isFinishedFile = [](std::string const& name) {
+        return hasSuffix(name, kFinishedSuffix);
+    };
+    for (auto const& f : fs::findfiles(mDir, isFinishedFile))
+    {
+        std::string path = mDir + "/" + f;
+        try
+        {
+            std::ifstream in(path);
+            in.exceptions(std::ios::badbit);
+            cereal::JSONInputArchive ar(in);
+            bool keep;
+            std::string curr, snap, output;
+            std::vector<std::string> shadowHex;
+            ar(cereal::make_nvp("keep", keep));
+            ar(cereal::make_nvp("curr", curr));
+            ar(cereal::make_nvp("snap", snap));
+            ar(cereal::make_nvp("shadow", shadowHex));
+            ar(cereal::make_nvp("output", output));
+            std::vector<Hash> shadows;
+            for (auto const& s : shadowHex)
+            {
+                shadows.emplace_back(hexToBin256(s));
+            }
+            merges.emplace_back(MergeKey(keep, hexToBin256(curr),
+                                         hexToBin256(snap), shadows),
+                                hexToBin256(output));
+        }
+        catch (std::exception const& e)
+        {
+            CLOG_WARNING(Bucket, "Removing unreadable merge record {}: {}",
+                         path, e.what());
+            std::remove(path.c_str());
+        }
+    }
+    return merges;
+}
+}
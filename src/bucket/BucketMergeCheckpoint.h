@@ -0,0 +1,85 @@
+#pragma once
+
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "bucket/MergeKey.h"
+#include "util/UnorderedSet.h"
+#include "xdr/Stellar-ledger.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace stellar
+{
+
+// The progress of a Bucket::merge, saved every so often so that a merge cut
+// short by a restart can carry on from where it got to. The output file of a
+// checkpointed merge is named after its MergeKey and lives in the
+// BucketMergeStateDir rather than the tmp dir (which is wiped at startup);
+// the checkpoint says how much of that file is good, and holds the rest of
+// what the merge needs to carry on writing it: the entry BucketOutputIterator
+// is holding back, and the offset of the current entry of each input. The
+// hash of the output so far is recomputed from the file on resume. The offsets are into raw XDR, so only uncompressed output
+// can be checkpointed.
+struct BucketMergeCheckpoint
+{
+    uint32_t mProtocolVersion{0};
+    uint64_t mOldPos{0};
+    uint64_t mNewPos{0};
+    std::vector<uint64_t> mShadowPos;
+    uint64_t mBytesPut{0};
+    uint64_t mObjectsPut{0};
+    bool mPutMeta{false};
+    std::optional<BucketEntry> mBuffered;
+};
+
+// The directory, under the bucket dir, holding what BucketManager keeps of
+// merges across restarts when BUCKET_MERGE_CHECKPOINT_BYTES is set: the
+// partial output and latest checkpoint of each unfinished merge, and a record
+// of the inputs and output of each finished merge whose output is still
+// around, which BucketManager loads back into its BucketMergeMap at startup.
+//
+// Everything is keyed by a hash of the MergeKey. The methods only touch the
+// files of the merge they're given, so merges on different threads can use
+// them concurrently.
+class BucketMergeStateDir
+{
+    std::string const mDir;
+    size_t const mCheckpointBytes;
+
+    std::string pathFor(MergeKey const& mk, char const* suffix) const;
+
+  public:
+    BucketMergeStateDir(std::string const& dir, size_t checkpointBytes);
+
+    // How many bytes of output a merge writes between checkpoints.
+    size_t getCheckpointBytes() const;
+
+    std::string getOutputFilename(MergeKey const& mk) const;
+
+    // Returns the saved checkpoint of `mk`, if there is one and its output
+    // file holds (at least) the bytes it covers.
+    std::optional<BucketMergeCheckpoint>
+    loadCheckpoint(MergeKey const& mk) const;
+
+    // Atomically replace the checkpoint of `mk`. The output file must already
+    // hold everything the checkpoint covers.
+    void saveCheckpoint(MergeKey const& mk,
+                        BucketMergeCheckpoint const& ckpt) const;
+
+    // Drop the checkpoint and any partial output of `mk`.
+    void removeCheckpoint(MergeKey const& mk) const;
+
+    // Drop the checkpoints and partial outputs of all merges but `keep`.
+    void removeCheckpointsExcept(UnorderedSet<MergeKey> const& keep) const;
+
+    void saveFinishedMerge(MergeKey const& mk, Hash const& output) const;
+    void forgetFinishedMerge(MergeKey const& mk) const;
+    std::vector<std::pair<MergeKey, Hash>> loadFinishedMerges() const;
+};
+}
@@ -0,0 +1,165 @@
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "bucket/BucketMergeExecutor.h"
+#include "bucket/BucketList.h"
+#include "main/Application.h"
+#include "main/Config.h"
+#include "util/GlobalChecks.h"
+#include "util/Logging.h"
+#include "util/Thread.h"
+
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+#include <Tracy.hpp>
+
+namespace stellar
+{
+
+// Merges into level 4 and deeper have at least 32 ledgers to run.
+uint32_t const BucketMergeExecutor::LONG_MERGE_LEVEL = 4;
+
+BucketMergeExecutor::BucketMergeExecutor(Application& app, size_t threads,
+                                         size_t maxLongMerges)
+    : mApp(app), mMaxLongMerges(maxLongMerges)
+{
+    releaseAssert(threads > 0);
+    releaseAssert(maxLongMerges > 0);
+    for (uint32_t level = 0; level < BucketList::kNumLevels; ++level)
+    {
+        auto name = "level-" + std::to_string(level);
+        mQueueTime.emplace_back(
+            &app.getMetrics().NewTimer({"bucket", "merge-queue-time", name}));
+        mLatency.emplace_back(
+            &app.getMetrics().NewTimer({"bucket", "merge-latency", name}));
+    }
+    for (size_t i = 0; i < threads; ++i)
+    {
+        mThreads.emplace_back([this]() {
+            runCurrentThreadWithLowPriority();
+            run();
+        });
+    }
+}
+
+BucketMergeExecutor::~BucketMergeExecutor()
+{
+    shutdown();
+}
+
+uint32_t
+BucketMergeExecutor::ledgersUntilNeeded(uint32_t level)
+{
+    return level == 0 ? 0 : BucketList::levelHalf(level - 1);
+}
+
+void
+BucketMergeExecutor::post(uint32_t level, std::function<void()>&& f)
+{
+    releaseAssert(level < BucketList::kNumLevels);
+    auto now = std::chrono::steady_clock::now();
+    auto deadline = now + mApp.getConfig().getExpectedLedgerCloseTime() *
+                              ledgersUntilNeeded(level);
+    {
+        std::lock_guard<std::mutex> guard(mMutex);
+        if (!mShutdown)
+        {
+            mQueue.emplace(std::make_pair(deadline, mNextSeq++),
+                           Task{level, now, deadline, std::move(f)});
+            mCV.notify_all();
+            return;
+        }
+    }
+    f();
+}
+
+decltype(BucketMergeExecutor::mQueue)::iterator
+BucketMergeExecutor::nextRunnable()
+{
+    for (auto it = mQueue.begin(); it != mQueue.end(); ++it)
+    {
+        if (it->second.mLevel < LONG_MERGE_LEVEL ||
+            mRunningLongMerges < mMaxLongMerges)
+        {
+            return it;
+        }
+    }
+    return mQueue.end();
+}
+
+void
+BucketMergeExecutor::run()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true)
+    {
+        auto it = nextRunnable();
+        if (it == mQueue.end())
+        {
+            if (mShutdown && mQueue.empty())
+            {
+                return;
+            }
+            mCV.wait(lock);
+            continue;
+        }
+
+        Task task = std::move(it->second);
+        mQueue.erase(it);
+        bool isLong = task.mLevel >= LONG_MERGE_LEVEL;
+        if (isLong)
+        {
+            ++mRunningLongMerges;
+        }
+        lock.unlock();
+
+        mQueueTime[task.mLevel]->Update(std::chrono::steady_clock::now() -
+                                        task.mPosted);
+        {
+            ZoneNamedN(mergeZone, "BucketMergeExecutor task", true);
+            // Merge tasks are packaged_tasks, which hand any exception to
+            // whoever resolves the FutureBucket.
+            task.mFunc();
+        }
+        auto finished = std::chrono::steady_clock::now();
+        mLatency[task.mLevel]->Update(finished - task.mPosted);
+        if (finished > task.mDeadline && task.mLevel != 0)
+        {
+            CLOG_DEBUG(Bucket,
+                       "Merge into level {} finished {} ms after its deadline",
+                       task.mLevel,
+                       std::chrono::duration_cast<std::chrono::milliseconds>(
+                           finished - task.mDeadline)
+                           .count());
+        }
+
+        lock.lock();
+        if (isLong)
+        {
+            --mRunningLongMerges;
+            // A long merge may have been waiting for this one.
+            mCV.notify_all();
+        }
+    }
+}
+
+void
+BucketMergeExecutor::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> guard(mMutex);
+        if (mShutdown)
+        {
+            return;
+        }
+        mShutdown = true;
+        mCV.notify_all();
+    }
+    for (auto& t : mThreads)
+    {
+        t.join();
+    }
+    mThreads.clear();
+}
+}
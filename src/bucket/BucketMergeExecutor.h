@@ -0,0 +1,95 @@
+#pragma once
+
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace medida
+{
+class Timer;
+}
+
+namespace stellar
+{
+
+class Application;
+
+// BucketMergeExecutor runs FutureBucket merges on its own threads, earliest
+// deadline first, rather than in arrival order on the generic background
+// pool, so that a merge that has to be done by the next spill of a shallow
+// level isn't stuck behind a merge of a deep level that has days to run.
+//
+// A merge into level i starts when level i-1 spills, and is needed (by
+// BucketLevel::commit) when it spills again, levelHalf(i-1) ledgers later
+// (see BucketList::levelShouldSpill); its deadline is that many expected
+// ledger close times after it was posted. Merges into level 0 are needed
+// immediately.
+//
+// At most `maxLongMerges` merges into levels LONG_MERGE_LEVEL and deeper run
+// at a time, so that (when there are more threads than that) some thread is
+// always free for shallow merges.
+class BucketMergeExecutor : public NonMovableOrCopyable
+{
+  public:
+    static uint32_t const LONG_MERGE_LEVEL;
+
+    BucketMergeExecutor(Application& app, size_t threads,
+                        size_t maxLongMerges);
+
+    // Shuts down.
+    ~BucketMergeExecutor();
+
+    // Number of ledgers between the start of a merge into `level` and the
+    // ledger that needs its result.
+    static uint32_t ledgersUntilNeeded(uint32_t level);
+
+    void post(uint32_t level, std::function<void()>&& f);
+
+    // Runs everything already posted, then joins the threads. Posting after
+    // shutdown runs the merge on the calling thread.
+    void shutdown();
+
+  private:
+    struct Task
+    {
+        uint32_t mLevel;
+        std::chrono::steady_clock::time_point mPosted;
+        std::chrono::steady_clock::time_point mDeadline;
+        std::function<void()> mFunc;
+    };
+
+    Application& mApp;
+    size_t const mMaxLongMerges;
+
+    std::mutex mMutex;
+    std::condition_variable mCV;
+    // Ordered by deadline, then by order of posting.
+    std::map<std::pair<std::chrono::steady_clock::time_point, uint64_t>, Task>
+        mQueue;
+    uint64_t mNextSeq{0};
+    size_t mRunningLongMerges{0};
+    bool mShutdown{false};
+    std::vector<std::thread> mThreads;
+
+    // Per level: time from posting to starting, and from posting to
+    // finishing.
+    std::vector<medida::Timer*> mQueueTime;
+    std::vector<medida::Timer*> mLatency;
+
+    void run();
+    // The first task that may start now, or mQueue.end().
+    decltype(mQueue)::iterator nextRunnable();
+};
+}
@@ -129,4 +129,19 @@ BucketMergeMap::getOutputsUsingInput(Hash const& input,
                    hexAbbrev(i->second), hexAbbrev(input));
     }
 }
+
+void
+BucketMergeMap::getInputsProducing(Hash const& output,
+                                   std::set<Hash>& inputs) const
+{
+    ZoneScoped;
+    auto pair = mOutputToMergeKey.equal_range(output);
+    for (auto i = pair.first; i != pair.second; ++i)
+    {
+        for (auto const& in : getMergeKeyHashes(i->second))
+        {
+            inputs.emplace(in);
+        }
+    }
+}
 }
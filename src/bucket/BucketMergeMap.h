@@ -45,5 +45,8 @@ class BucketMergeMap
     UnorderedSet<MergeKey> forgetAllMergesProducing(Hash const& output);
     bool findMergeFor(MergeKey const& input, Hash& output);
     void getOutputsUsingInput(Hash const& input, std::set<Hash>& outputs) const;
+    // The inverse of getOutputsUsingInput: adds every input (curr, snap and
+    // shadows) of every recorded merge producing `output` to `inputs`.
+    void getInputsProducing(Hash const& output, std::set<Hash>& inputs) const;
 };
 }
@@ -6,8 +6,13 @@
 #include "bucket/Bucket.h"
 #include "bucket/BucketManager.h"
 #include "crypto/Random.h"
+#include "util/Fs.h"
 #include "util/GlobalChecks.h"
 #include <Tracy.hpp>
+#include <cstdio>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
 
 namespace stellar
 {
@@ -29,6 +34,40 @@ randomBucketName(std::string const& tmpDir)
         }
     }
 }
+
+// Write large outputs in bigger chunks: a few dozen large writes cost less
+// than thousands of 256KiB ones, and the buffer is small next to the
+// bucket. Small outputs (most of the level 0-2 ones) keep the default.
+size_t
+writeBufferSize(size_t expectedBytes)
+{
+    size_t const maxBufferSize = 8 * 1024 * 1024;
+    size_t sz = fs::bufsz();
+    while (sz < maxBufferSize && sz * 64 < expectedBytes)
+    {
+        sz *= 2;
+    }
+    return sz;
+}
+
+// Feed the first `bytes` bytes of `filename` to `hasher`.
+void
+hashFilePrefix(std::string const& filename, size_t bytes, SHA256& hasher)
+{
+    ZoneScoped;
+    std::ifstream in(filename, std::ios::binary);
+    std::vector<char> buf(fs::bufsz());
+    while (bytes > 0)
+    {
+        size_t n = std::min(bytes, buf.size());
+        if (!in.read(buf.data(), n))
+        {
+            throw std::runtime_error("short read re-hashing " + filename);
+        }
+        hasher.add(ByteSlice(buf.data(), n));
+        bytes -= n;
+    }
+}
 }
 
 /**
@@ -39,22 +78,81 @@ BucketOutputIterator::BucketOutputIterator(std::string const& tmpDir,
                                            bool keepDeadEntries,
                                            BucketMetadata const& meta,
                                            MergeCounters& mc,
-                                           asio::io_context& ctx, bool doFsync)
+                                           asio::io_context& ctx, bool doFsync,
+                                           int compressionLevel,
+                                           size_t expectedBytes)
     : mFilename(randomBucketName(tmpDir))
-    , mOut(ctx, doFsync)
+    , mOut(ctx, doFsync, writeBufferSize(expectedBytes))
     , mBuf(nullptr)
     , mKeepDeadEntries(keepDeadEntries)
     , mMeta(meta)
     , mMergeCounters(mc)
+    , mIndex(std::make_unique<BucketIndex>())
+    , mDoFsync(doFsync)
+    , mCheckpointable(false)
 {
     ZoneScoped;
     CLOG_TRACE(Bucket, "BucketOutputIterator opening file to write: {}",
                mFilename);
     // Will throw if unable to open the file
     mOut.open(mFilename);
+    if (compressionLevel > 0)
+    {
+        mOut.enableCompression(compressionLevel);
+    }
+    putMeta();
+}
+
+BucketOutputIterator::BucketOutputIterator(
+    std::string const& filename,
+    std::optional<BucketMergeCheckpoint> const& resumeFrom,
+    bool keepDeadEntries, BucketMetadata const& meta, MergeCounters& mc,
+    asio::io_context& ctx, bool doFsync, size_t expectedBytes)
+    : mFilename(filename)
+    , mOut(ctx, doFsync, writeBufferSize(expectedBytes))
+    , mBuf(nullptr)
+    , mKeepDeadEntries(keepDeadEntries)
+    , mMeta(meta)
+    , mMergeCounters(mc)
+    , mDoFsync(doFsync)
+    , mCheckpointable(true)
+{
+    ZoneScoped;
+    if (!resumeFrom)
+    {
+        CLOG_TRACE(Bucket, "BucketOutputIterator opening file to write: {}",
+                   mFilename);
+        // Leftovers of an earlier attempt are useless without a checkpoint,
+        // and the file is opened for appending.
+        std::remove(mFilename.c_str());
+        mIndex = std::make_unique<BucketIndex>();
+        mOut.open(mFilename);
+        putMeta();
+        return;
+    }
+
+    CLOG_DEBUG(Bucket, "BucketOutputIterator resuming {} at offset {}",
+               mFilename, resumeFrom->mBytesPut);
+    // Anything past the checkpoint was written after it was saved, and will
+    // be written again. The hash of what's kept is recomputed from the file,
+    // since hasher state can't be carried across processes portably.
+    std::filesystem::resize_file(mFilename, resumeFrom->mBytesPut);
+    hashFilePrefix(mFilename, resumeFrom->mBytesPut, mHasher);
+    mOut.open(mFilename);
+    mBytesPut = resumeFrom->mBytesPut;
+    mObjectsPut = resumeFrom->mObjectsPut;
+    mPutMeta = resumeFrom->mPutMeta;
+    if (resumeFrom->mBuffered)
+    {
+        mBuf = std::make_unique<BucketEntry>(*resumeFrom->mBuffered);
+    }
+}
 
+void
+BucketOutputIterator::putMeta()
+{
     if (protocolVersionStartsFrom(
-            meta.ledgerVersion,
+            mMeta.ledgerVersion,
             Bucket::FIRST_PROTOCOL_SUPPORTING_INITENTRY_AND_METAENTRY))
     {
         BucketEntry bme;
@@ -97,8 +195,7 @@ BucketOutputIterator::put(BucketEntry const& e)
         if (mCmp(*mBuf, e))
         {
             ++mMergeCounters.mOutputIteratorActualWrites;
-            mOut.writeOne(*mBuf, &mHasher, &mBytesPut);
-            mObjectsPut++;
+            writeBuffered();
         }
     }
     else
@@ -111,6 +208,43 @@ BucketOutputIterator::put(BucketEntry const& e)
     *mBuf = e;
 }
 
+void
+BucketOutputIterator::checkpoint(BucketMergeCheckpoint& ckpt)
+{
+    ZoneScoped;
+    releaseAssert(mCheckpointable);
+    mOut.flush();
+    if (mDoFsync)
+    {
+        fs::flushFileChanges(mOut.getHandle());
+    }
+    ckpt.mBytesPut = mBytesPut;
+    ckpt.mObjectsPut = mObjectsPut;
+    ckpt.mPutMeta = mPutMeta;
+    ckpt.mBuffered.reset();
+    if (mBuf)
+    {
+        ckpt.mBuffered = std::make_optional<BucketEntry>(*mBuf);
+    }
+}
+
+size_t
+BucketOutputIterator::getBytesPut() const
+{
+    return mBytesPut;
+}
+
+void
+BucketOutputIterator::writeBuffered()
+{
+    if (mIndex && mBuf->type() != METAENTRY)
+    {
+        mIndex->add(getBucketLedgerKey(*mBuf), mBytesPut);
+    }
+    mOut.writeOne(*mBuf, &mHasher, &mBytesPut);
+    mObjectsPut++;
+}
+
 std::shared_ptr<Bucket>
 BucketOutputIterator::getBucket(BucketManager& bucketManager,
                                 MergeKey* mergeKey)
@@ -118,11 +252,17 @@ BucketOutputIterator::getBucket(BucketManager& bucketManager,
     ZoneScoped;
     if (mBuf)
     {
-        mOut.writeOne(*mBuf, &mHasher, &mBytesPut);
-        mObjectsPut++;
+        writeBuffered();
         mBuf.reset();
     }
 
+    // Inside a sync group, leave the fsync to the group so that a batch's
+    // buckets are synced back to back instead of one per merge.
+    bool deferSync = mDoFsync && bucketManager.hasBucketSyncGroup();
+    if (deferSync)
+    {
+        mOut.setFsyncOnClose(false);
+    }
     mOut.close();
     if (mObjectsPut == 0 || mBytesPut == 0)
     {
@@ -136,7 +276,18 @@ BucketOutputIterator::getBucket(BucketManager& bucketManager,
         }
         return std::make_shared<Bucket>();
     }
-    return bucketManager.adoptFileAsBucket(mFilename, mHasher.finish(),
-                                           mObjectsPut, mBytesPut, mergeKey);
+    auto b = bucketManager.adoptFileAsBucket(mFilename, mHasher.finish(),
+                                             mObjectsPut, mBytesPut, mergeKey);
+    if (deferSync && !bucketManager.deferBucketSync(b->getFilename()))
+    {
+        // The group closed while we were writing.
+        fs::flushPathChanges(b->getFilename());
+    }
+    if (mIndex)
+    {
+        mIndex->finish();
+    }
+    bucketManager.indexBucket(b, std::move(mIndex));
+    return b;
 }
 }
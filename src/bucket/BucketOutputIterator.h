@@ -4,12 +4,15 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "bucket/BucketIndex.h"
 #include "bucket/BucketManager.h"
+#include "bucket/BucketMergeCheckpoint.h"
 #include "bucket/LedgerCmp.h"
 #include "util/XDRStream.h"
 #include "xdr/Stellar-ledger.h"
 
 #include <memory>
+#include <optional>
 #include <string>
 
 namespace stellar
@@ -34,6 +37,14 @@ class BucketOutputIterator
     BucketMetadata mMeta;
     bool mPutMeta{false};
     MergeCounters& mMergeCounters;
+    // Null when resuming from a checkpoint; BucketManager::indexBucket
+    // indexes the bucket from its file instead.
+    std::unique_ptr<BucketIndex> mIndex;
+    bool const mDoFsync;
+    bool const mCheckpointable;
+
+    void putMeta();
+    void writeBuffered();
 
   public:
     // BucketOutputIterators must _always_ be constructed with BucketMetadata,
@@ -43,12 +54,36 @@ class BucketOutputIterator
     // version new enough that it should _write_ the metadata to the stream in
     // the form of a METAENTRY; but that's not a thing the caller gets to decide
     // (or forget to do), it's handled automatically.
+    //
+    // A nonzero `compressionLevel` writes the bucket file as seekable zstd
+    // frames (see XDROutputFileStream::enableCompression); the bucket's hash,
+    // and the offsets its index records, are still those of the raw XDR.
+    //
+    // `expectedBytes`, if known, is a rough size of the output, which picks
+    // a larger write buffer for large outputs.
     BucketOutputIterator(std::string const& tmpDir, bool keepDeadEntries,
                          BucketMetadata const& meta, MergeCounters& mc,
-                         asio::io_context& ctx, bool doFsync);
+                         asio::io_context& ctx, bool doFsync,
+                         int compressionLevel = 0, size_t expectedBytes = 0);
+
+    // Writes uncompressed to `filename`, so that the output can be
+    // checkpointed and picked up again by a later process. If `resumeFrom` is
+    // set, the file is first cut back to the checkpointed length, and writing
+    // carries on as the iterator that saved the checkpoint would have.
+    BucketOutputIterator(std::string const& filename,
+                         std::optional<BucketMergeCheckpoint> const& resumeFrom,
+                         bool keepDeadEntries, BucketMetadata const& meta,
+                         MergeCounters& mc, asio::io_context& ctx,
+                         bool doFsync, size_t expectedBytes = 0);
 
     void put(BucketEntry const& e);
 
+    // Make everything written so far durable, and record the state of the
+    // output in `ckpt`. Only for iterators built by the constructor above.
+    void checkpoint(BucketMergeCheckpoint& ckpt);
+
+    size_t getBytesPut() const;
+
     std::shared_ptr<Bucket> getBucket(BucketManager& bucketManager,
                                       MergeKey* mergeKey = nullptr);
 };
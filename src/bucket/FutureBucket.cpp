@@ -395,8 +395,7 @@ FutureBucket::startMerge(Application& app, uint32_t maxProtocolVersion,
 
     mOutputBucketFuture = task->get_future().share();
     bm.putMergeFuture(mk, mOutputBucketFuture);
-    app.postOnBackgroundThread(bind(&task_t::operator(), task),
-                               "FutureBucket: merge");
+    bm.postMerge(level, bind(&task_t::operator(), task));
     checkState();
 }
 
@@ -429,6 +428,9 @@ FutureBucket::makeLive(Application& app, uint32_t maxProtocolVersion,
             mInputShadowBuckets.push_back(b);
         }
         mState = FB_LIVE_INPUTS;
+        // With BUCKET_MERGE_CHECKPOINT_BYTES set, a merge that finished or
+        // was checkpointed before a restart is reattached to or resumed here
+        // rather than run again (see BucketMergeStateDir).
         startMerge(app, maxProtocolVersion, /*countMergeEvents=*/true, level);
         releaseAssert(isLive());
     }
@@ -6,6 +6,8 @@
 
 #include "overlay/StellarXDR.h"
 #include "util/XDROperators.h"
+#include <array>
+#include <cstring>
 
 namespace stellar
 {
@@ -146,4 +148,86 @@ struct BucketEntryIdCmp
         }
     }
 };
+
+/**
+ * A fixed-width prefix of the identity of a BucketEntry: its LedgerEntryType
+ * as a big-endian 32-bit tag, then the leading bytes of the first field of its
+ * key (the account ID of accounts, trustlines, offers and data, the balance ID
+ * of claimable balances and the pool ID of liquidity pools).
+ *
+ * Whenever the prefixes of two entries differ, memcmp on them orders the
+ * entries the same way BucketEntryIdCmp does, so a merge only has to fall
+ * back to BucketEntryIdCmp when they are equal.
+ */
+class BucketEntryKeyPrefix
+{
+  public:
+    static size_t const SIZE = 16;
+
+  private:
+    std::array<uint8_t, SIZE> mBytes{};
+
+    template <typename T>
+    void
+    set(T const& k)
+    {
+        // LedgerEntryType values are all non-negative.
+        auto ty = static_cast<uint32_t>(k.type());
+        mBytes[0] = static_cast<uint8_t>(ty >> 24);
+        mBytes[1] = static_cast<uint8_t>(ty >> 16);
+        mBytes[2] = static_cast<uint8_t>(ty >> 8);
+        mBytes[3] = static_cast<uint8_t>(ty);
+
+        // PublicKey and ClaimableBalanceID each have a single arm, so their
+        // key bytes are the first thing they compare on.
+        uint8_t const* key = nullptr;
+        switch (k.type())
+        {
+        case ACCOUNT:
+            key = k.account().accountID.ed25519().data();
+            break;
+        case TRUSTLINE:
+            key = k.trustLine().accountID.ed25519().data();
+            break;
+        case OFFER:
+            key = k.offer().sellerID.ed25519().data();
+            break;
+        case DATA:
+            key = k.data().accountID.ed25519().data();
+            break;
+        case CLAIMABLE_BALANCE:
+            key = k.claimableBalance().balanceID.v0().data();
+            break;
+        case LIQUIDITY_POOL:
+            key = k.liquidityPool().liquidityPoolID.data();
+            break;
+        }
+        if (key)
+        {
+            std::memcpy(mBytes.data() + 4, key, SIZE - 4);
+        }
+    }
+
+  public:
+    BucketEntryKeyPrefix() = default;
+
+    explicit BucketEntryKeyPrefix(BucketEntry const& e)
+    {
+        if (e.type() == LIVEENTRY || e.type() == INITENTRY)
+        {
+            set(e.liveEntry().data);
+        }
+        else if (e.type() == DEADENTRY)
+        {
+            set(e.deadEntry());
+        }
+    }
+
+    // Negative, zero or positive like memcmp.
+    int
+    compare(BucketEntryKeyPrefix const& other) const
+    {
+        return std::memcmp(mBytes.data(), other.mBytes.data(), SIZE);
+    }
+};
 }
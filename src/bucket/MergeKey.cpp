@@ -25,6 +25,16 @@ MergeKey::MergeKey(bool keepDeadEntries,
     }
 }
 
+MergeKey::MergeKey(bool keepDeadEntries, Hash const& inputCurr,
+                   Hash const& inputSnap,
+                   std::vector<Hash> const& inputShadows)
+    : mKeepDeadEntries(keepDeadEntries)
+    , mInputCurrBucket(inputCurr)
+    , mInputSnapBucket(inputSnap)
+    , mInputShadowBuckets(inputShadows)
+{
+}
+
 bool
 MergeKey::operator==(MergeKey const& other) const
 {
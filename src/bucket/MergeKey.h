@@ -21,6 +21,8 @@ struct MergeKey
     MergeKey(bool keepDeadEntries, std::shared_ptr<Bucket> const& inputCurr,
              std::shared_ptr<Bucket> const& inputSnap,
              std::vector<std::shared_ptr<Bucket>> const& inputShadows);
+    MergeKey(bool keepDeadEntries, Hash const& inputCurr,
+             Hash const& inputSnap, std::vector<Hash> const& inputShadows);
 
     bool mKeepDeadEntries;
     Hash mInputCurrBucket;
@@ -0,0 +1,532 @@
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+// ASIO is somewhat particular about when it gets included -- it wants to be the
+// first to include <windows.h> -- so we try to include it before everything
+#include "util/asio.h"
+#include "bucket/test/BucketListBenchmark.h"
+#include "bucket/Bucket.h"
+#include "bucket/BucketList.h"
+#include "bucket/BucketManager.h"
+#include "crypto/Hex.h"
+#include "ledger/test/LedgerTestUtils.h"
+#include "lib/json/json.h"
+#include "main/Application.h"
+#include "main/Config.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+#include "test/TestUtils.h"
+#include "test/test.h"
+#include "util/Fs.h"
+#include "util/GlobalChecks.h"
+#include "util/Logging.h"
+#include "util/Math.h"
+#include "util/Timer.h"
+#include "util/types.h"
+
+#include <chrono>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+namespace stellar
+{
+
+namespace
+{
+// Entries per fresh bucket when synthesizing a level; larger levels are
+// merged together from these, to bound the memory synthesis takes.
+size_t const kSynthesisChunk = 100000;
+
+// Most entries updated or deleted by the timed run are drawn from a random
+// sample of this many entries of the BucketList.
+size_t const kHotSetSize = 100000;
+
+// Draws entries of the configured types, in the configured proportions.
+class EntryGenerator
+{
+    std::vector<std::pair<LedgerEntryType, uint32_t>> const mMix;
+    uint32_t mTotalWeight{0};
+
+  public:
+    explicit EntryGenerator(
+        std::vector<std::pair<LedgerEntryType, uint32_t>> const& mix)
+        : mMix(mix)
+    {
+        for (auto const& m : mMix)
+        {
+            mTotalWeight += m.second;
+        }
+        releaseAssert(mTotalWeight > 0);
+    }
+
+    LedgerEntry
+    generate(uint32_t ledgerSeq)
+    {
+        auto pick = rand_uniform<uint32_t>(0, mTotalWeight - 1);
+        auto it = mMix.begin();
+        while (pick >= it->second)
+        {
+            pick -= it->second;
+            ++it;
+        }
+
+        LedgerEntry le;
+        le.lastModifiedLedgerSeq = ledgerSeq;
+        le.data.type(it->first);
+        switch (it->first)
+        {
+        case ACCOUNT:
+            le.data.account() = LedgerTestUtils::generateValidAccountEntry();
+            break;
+        case TRUSTLINE:
+            le.data.trustLine() =
+                LedgerTestUtils::generateValidTrustLineEntry();
+            break;
+        case OFFER:
+            le.data.offer() = LedgerTestUtils::generateValidOfferEntry();
+            break;
+        case DATA:
+            le.data.data() = LedgerTestUtils::generateValidDataEntry();
+            break;
+        case CLAIMABLE_BALANCE:
+            le.data.claimableBalance() =
+                LedgerTestUtils::generateValidClaimableBalanceEntry();
+            break;
+        case LIQUIDITY_POOL:
+            le.data.liquidityPool() =
+                LedgerTestUtils::generateValidLiquidityPoolEntry();
+            break;
+        }
+        return le;
+    }
+};
+
+struct Batch
+{
+    std::vector<LedgerEntry> mInit;
+    std::vector<LedgerEntry> mLive;
+    std::vector<LedgerKey> mDead;
+};
+
+// Keeps a uniform sample of the entries seen (reservoir sampling).
+void
+addToHotSet(std::vector<LedgerEntry>& hot, uint64_t& seen,
+            LedgerEntry const& le)
+{
+    ++seen;
+    if (hot.size() < kHotSetSize)
+    {
+        hot.emplace_back(le);
+        return;
+    }
+    auto i = rand_uniform<uint64_t>(0, seen - 1);
+    if (i < hot.size())
+    {
+        hot[i] = le;
+    }
+}
+
+// Writes `n` new entries into a single bucket, a chunk at a time, merging
+// chunks pairwise as they pile up so that every entry is rewritten only
+// log(n / kSynthesisChunk) times.
+std::shared_ptr<Bucket>
+synthesizeBucket(Application& app, uint32_t protocolVersion, uint64_t n,
+                 EntryGenerator& gen, uint32_t ledgerSeq,
+                 std::vector<LedgerEntry>& hot, uint64_t& seen)
+{
+    auto& bm = app.getBucketManager();
+    auto& ctx = app.getClock().getIOContext();
+    bool doFsync = !app.getConfig().DISABLE_XDR_FSYNC;
+
+    // Buckets paired with how many chunk-merges they've been through.
+    std::vector<std::pair<uint32_t, std::shared_ptr<Bucket>>> pending;
+    while (n > 0)
+    {
+        auto count = std::min<uint64_t>(n, kSynthesisChunk);
+        n -= count;
+        std::vector<LedgerEntry> live;
+        live.reserve(count);
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            live.emplace_back(gen.generate(ledgerSeq));
+            addToHotSet(hot, seen, live.back());
+        }
+        auto b = Bucket::fresh(bm, protocolVersion, {}, live, {},
+                               /*countMergeEvents=*/false, ctx, doFsync);
+        uint32_t rank = 0;
+        while (!pending.empty() && pending.back().first == rank)
+        {
+            b = Bucket::merge(bm, protocolVersion, pending.back().second, b,
+                              {}, /*keepDeadEntries=*/true,
+                              /*countMergeEvents=*/false, ctx, doFsync);
+            pending.pop_back();
+            ++rank;
+        }
+        pending.emplace_back(rank, b);
+    }
+
+    auto b = std::make_shared<Bucket>();
+    while (!pending.empty())
+    {
+        b = Bucket::merge(bm, protocolVersion, pending.back().second, b, {},
+                          /*keepDeadEntries=*/true,
+                          /*countMergeEvents=*/false, ctx, doFsync);
+        pending.pop_back();
+    }
+    return b;
+}
+
+// Fills every level of the BucketList as it would be after `lastLedger`
+// ledgers of `entriesPerLedger` new entries each.
+void
+synthesizeBucketList(Application& app, uint32_t protocolVersion,
+                     uint32_t lastLedger, double entriesPerLedger,
+                     EntryGenerator& gen, std::vector<LedgerEntry>& hot)
+{
+    if (lastLedger == 0)
+    {
+        return;
+    }
+    auto& bl = app.getBucketManager().getBucketList();
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < BucketList::kNumLevels; ++i)
+    {
+        auto currEntries = static_cast<uint64_t>(
+            BucketList::sizeOfCurr(lastLedger, i) * entriesPerLedger);
+        auto snapEntries = static_cast<uint64_t>(
+            BucketList::sizeOfSnap(lastLedger, i) * entriesPerLedger);
+        CLOG_INFO(Bucket, "Synthesizing level {}: {} curr, {} snap entries", i,
+                  currEntries, snapEntries);
+        auto& level = bl.getLevel(i);
+        level.setCurr(synthesizeBucket(app, protocolVersion, currEntries, gen,
+                                       lastLedger, hot, seen));
+        level.setSnap(synthesizeBucket(app, protocolVersion, snapEntries, gen,
+                                       lastLedger, hot, seen));
+        app.getBucketManager().forgetUnreferencedBuckets();
+    }
+}
+
+Batch
+makeBatch(BucketListBenchmarkConfig const& cfg, uint32_t ledgerSeq,
+          EntryGenerator& gen, std::vector<LedgerEntry>& hot)
+{
+    Batch batch;
+    uint64_t const n = cfg.mEntriesPerLedger;
+    auto nUpdate = std::min<uint64_t>(n * cfg.mUpdatePercent / 100, hot.size());
+    auto nDelete = std::min<uint64_t>(n * cfg.mDeletePercent / 100,
+                                      hot.size() - nUpdate);
+    auto nCreate = n - nUpdate - nDelete;
+
+    // Move a distinct random choice of nUpdate + nDelete entries to the back
+    // of the hot set, updating the first of them and deleting the rest.
+    for (uint64_t k = 0; k < nUpdate + nDelete; ++k)
+    {
+        auto pos = hot.size() - 1 - k;
+        std::swap(hot[pos], hot[rand_uniform<size_t>(0, pos)]);
+    }
+    auto firstChosen = hot.size() - nUpdate - nDelete;
+    for (auto i = firstChosen; i < firstChosen + nUpdate; ++i)
+    {
+        LedgerTestUtils::randomlyModifyEntry(hot[i]);
+        hot[i].lastModifiedLedgerSeq = ledgerSeq;
+        batch.mLive.emplace_back(hot[i]);
+    }
+    for (uint64_t i = 0; i < nDelete; ++i)
+    {
+        batch.mDead.emplace_back(LedgerEntryKey(hot.back()));
+        hot.pop_back();
+    }
+
+    for (uint64_t i = 0; i < nCreate; ++i)
+    {
+        batch.mInit.emplace_back(gen.generate(ledgerSeq));
+        if (hot.size() < kHotSetSize)
+        {
+            hot.emplace_back(batch.mInit.back());
+        }
+        else
+        {
+            hot[rand_uniform<size_t>(0, hot.size() - 1)] = batch.mInit.back();
+        }
+    }
+    return batch;
+}
+
+// The peak resident set size of the process, in bytes, or 0 where we don't
+// know how to get it.
+uint64_t
+getPeakRssBytes()
+{
+#if defined(__linux__)
+    // ru_maxrss isn't reset by resetPeakRss, VmHWM is.
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.rfind("VmHWM:", 0) == 0)
+        {
+            std::istringstream in(line.substr(6));
+            uint64_t kb = 0;
+            in >> kb;
+            return kb * 1024;
+        }
+    }
+    return 0;
+#elif defined(_WIN32)
+    return 0;
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0)
+    {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<uint64_t>(ru.ru_maxrss);
+#else
+    return static_cast<uint64_t>(ru.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+// Makes getPeakRssBytes report the peak from now on, where possible (Linux).
+void
+resetPeakRss()
+{
+#if defined(__linux__)
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+#endif
+}
+
+Json::Value
+timerPercentiles(medida::Timer& timer)
+{
+    Json::Value res;
+    auto snap = timer.GetSnapshot();
+    res["count"] = static_cast<Json::UInt64>(timer.count());
+    res["p50"] = snap.getMedian();
+    res["p75"] = snap.get75thPercentile();
+    res["p95"] = snap.get95thPercentile();
+    res["p99"] = snap.get99thPercentile();
+    res["max"] = timer.max();
+    return res;
+}
+
+uint64_t
+entriesMerged(MergeCounters const& mc)
+{
+    return mc.mOldInitEntries + mc.mOldLiveEntries + mc.mOldDeadEntries +
+           mc.mNewInitEntries + mc.mNewLiveEntries + mc.mNewDeadEntries;
+}
+}
+
+BucketListBenchmarkConfig::BucketListBenchmarkConfig()
+    : mEntryMix{{ACCOUNT, 40}, {TRUSTLINE, 40}, {OFFER, 15}, {DATA, 5}}
+{
+}
+
+std::vector<std::pair<LedgerEntryType, uint32_t>>
+parseEntryMix(std::string const& mix)
+{
+    std::vector<std::pair<LedgerEntryType, uint32_t>> res;
+    std::istringstream in(mix);
+    std::string item;
+    uint32_t total = 0;
+    while (std::getline(in, item, ','))
+    {
+        auto eq = item.find('=');
+        if (eq == std::string::npos)
+        {
+            throw std::invalid_argument("expected TYPE=WEIGHT, got '" + item +
+                                        "'");
+        }
+        auto name = item.substr(0, eq);
+        std::optional<LedgerEntryType> type;
+        for (auto v : xdr::xdr_traits<LedgerEntryType>::enum_values())
+        {
+            auto t = static_cast<LedgerEntryType>(v);
+            if (name == xdr::xdr_traits<LedgerEntryType>::enum_name(t))
+            {
+                type = t;
+            }
+        }
+        if (!type)
+        {
+            throw std::invalid_argument("unknown ledger entry type '" + name +
+                                        "'");
+        }
+        uint32_t weight;
+        try
+        {
+            weight = static_cast<uint32_t>(std::stoul(item.substr(eq + 1)));
+        }
+        catch (std::exception const&)
+        {
+            throw std::invalid_argument("bad weight in '" + item + "'");
+        }
+        total += weight;
+        res.emplace_back(*type, weight);
+    }
+    if (total == 0)
+    {
+        throw std::invalid_argument("entry mix must have a nonzero weight");
+    }
+    return res;
+}
+
+Json::Value
+runBucketListBenchmark(BucketListBenchmarkConfig const& cfg)
+{
+    releaseAssert(cfg.mUpdatePercent + cfg.mDeletePercent <= 100);
+
+    uint32_t firstLedger = cfg.mFirstLedger;
+    if (firstLedger == 0)
+    {
+        uint32_t center = BucketList::levelHalf(BucketList::kNumLevels - 2);
+        firstLedger = center > cfg.mLedgers / 2 ? center - cfg.mLedgers / 2 : 1;
+    }
+
+    Config appCfg = getTestConfig(0, Config::TESTDB_IN_MEMORY_SQLITE);
+    appCfg.DISABLE_XDR_FSYNC = !cfg.mFsync;
+    appCfg.INVARIANT_CHECKS = {};
+    if (cfg.mMergeThreads != 0)
+    {
+        appCfg.BUCKET_MERGE_THREADS = static_cast<int>(cfg.mMergeThreads);
+    }
+    if (!cfg.mBucketDir.empty())
+    {
+        if (fs::exists(cfg.mBucketDir))
+        {
+            throw std::runtime_error("bucket dir " + cfg.mBucketDir +
+                                     " already exists");
+        }
+        appCfg.BUCKET_DIR_PATH = cfg.mBucketDir;
+    }
+
+    reinitializeAllGlobalStateWithSeed(cfg.mSeed);
+    Json::Value res;
+    {
+        VirtualClock clock;
+        auto app = createTestApplication(clock, appCfg);
+        auto& bm = app->getBucketManager();
+        auto& bl = bm.getBucketList();
+        uint32_t protocolVersion = app->getConfig().LEDGER_PROTOCOL_VERSION;
+
+        EntryGenerator gen(cfg.mEntryMix);
+        std::vector<LedgerEntry> hot;
+        double entriesPerLedger =
+            firstLedger > 1
+                ? static_cast<double>(cfg.mInitialEntries) / (firstLedger - 1)
+                : 0;
+        synthesizeBucketList(*app, protocolVersion, firstLedger - 1,
+                             entriesPerLedger, gen, hot);
+
+        CLOG_INFO(Bucket, "Generating {} batches of {} entries", cfg.mLedgers,
+                  cfg.mEntriesPerLedger);
+        std::vector<Batch> batches;
+        batches.reserve(cfg.mLedgers);
+        for (uint32_t i = 0; i < cfg.mLedgers; ++i)
+        {
+            batches.emplace_back(makeBatch(cfg, firstLedger + i, gen, hot));
+        }
+        hot.clear();
+        hot.shrink_to_fit();
+
+        CLOG_INFO(Bucket, "Applying ledgers {} to {}", firstLedger,
+                  firstLedger + cfg.mLedgers - 1);
+        std::vector<Hash> lastCurr;
+        for (uint32_t i = 0; i < BucketList::kNumLevels; ++i)
+        {
+            lastCurr.emplace_back(bl.getLevel(i).getCurr()->getHash());
+        }
+        uint64_t bytesMerged = 0;
+        resetPeakRss();
+        uint64_t rssBefore = getPeakRssBytes();
+        auto countersBefore = bm.readMergeCounters();
+        auto start = std::chrono::steady_clock::now();
+
+        for (uint32_t i = 0; i < cfg.mLedgers; ++i)
+        {
+            auto& batch = batches[i];
+            bm.addBatch(*app, firstLedger + i, protocolVersion, batch.mInit,
+                        batch.mLive, batch.mDead);
+            batch = Batch{};
+
+            // Every merge into a level becomes its curr when it's committed.
+            for (uint32_t l = 0; l < BucketList::kNumLevels; ++l)
+            {
+                auto curr = bl.getLevel(l).getCurr();
+                if (curr->getHash() != lastCurr[l])
+                {
+                    lastCurr[l] = curr->getHash();
+                    bytesMerged += curr->getSize();
+                }
+            }
+            bm.forgetUnreferencedBuckets();
+        }
+
+        // Merges still running are part of the work of the run.
+        for (uint32_t l = 0; l < BucketList::kNumLevels; ++l)
+        {
+            auto& next = bl.getLevel(l).getNext();
+            if (next.isMerging())
+            {
+                bytesMerged += next.resolve()->getSize();
+            }
+        }
+
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        auto counters = bm.readMergeCounters();
+        uint64_t entries =
+            entriesMerged(counters) - entriesMerged(countersBefore);
+
+        res["firstLedger"] = firstLedger;
+        res["ledgers"] = cfg.mLedgers;
+        res["initialEntries"] = static_cast<Json::UInt64>(cfg.mInitialEntries);
+        res["entriesPerLedger"] = cfg.mEntriesPerLedger;
+        res["seed"] = cfg.mSeed;
+        res["fsync"] = cfg.mFsync;
+        res["bucketListHash"] = binToHex(bl.getHash());
+        res["seconds"] = elapsed.count();
+        res["entriesMerged"] = static_cast<Json::UInt64>(entries);
+        res["bytesMerged"] = static_cast<Json::UInt64>(bytesMerged);
+        res["entriesPerSecond"] = entries / elapsed.count();
+        res["mbPerSecond"] = bytesMerged / elapsed.count() / (1024 * 1024);
+        res["rssBeforeRunBytes"] = static_cast<Json::UInt64>(rssBefore);
+        res["peakRssBytes"] = static_cast<Json::UInt64>(getPeakRssBytes());
+
+        auto& metrics = app->getMetrics();
+        for (uint32_t l = 0; l < BucketList::kNumLevels; ++l)
+        {
+            auto name = "level-" + std::to_string(l);
+            Json::Value level;
+            level["level"] = l;
+            level["mergeTimeMs"] = timerPercentiles(
+                metrics.NewTimer({"bucket", "merge-time", name}));
+            level["mergeLatencyMs"] = timerPercentiles(
+                metrics.NewTimer({"bucket", "merge-latency", name}));
+            level["deadlineMisses"] = static_cast<Json::UInt64>(
+                metrics
+                    .NewMeter({"bucket", "merge-deadline-miss", name}, "merge")
+                    .count());
+            res["levels"].append(level);
+        }
+    }
+
+    if (!cfg.mBucketDir.empty())
+    {
+        fs::deltree(cfg.mBucketDir);
+    }
+    cleanupTmpDirs();
+    return res;
+}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "xdr/Stellar-ledger-entries.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Json
+{
+class Value;
+}
+
+namespace stellar
+{
+
+// Parameters of the bucket-merge benchmark run by `stellar-core
+// bench-bucketlist`. Everything random is derived from `mSeed`, so two runs
+// with the same parameters merge byte-identical buckets.
+struct BucketListBenchmarkConfig
+{
+    // Entries written into the BucketList before the timed run. They're
+    // spread over the levels in proportion to the number of ledgers each
+    // level would hold as of the ledger before `mFirstLedger`.
+    uint64_t mInitialEntries{1000000};
+
+    // Ledgers of `addBatch` to time, and the size and make-up of each batch:
+    // `mUpdatePercent` percent of the entries update, and `mDeletePercent`
+    // percent delete, entries already in the BucketList; the rest are new.
+    uint32_t mLedgers{1000};
+    uint32_t mEntriesPerLedger{1000};
+    uint32_t mUpdatePercent{60};
+    uint32_t mDeletePercent{5};
+
+    // Relative weights of the types of the entries written (see
+    // parseEntryMix).
+    std::vector<std::pair<LedgerEntryType, uint32_t>> mEntryMix;
+
+    // Sequence number of the first timed ledger. If 0, the run is centered on
+    // a ledger at which every level but the last spills, so that each level
+    // merges at least once if there are enough ledgers.
+    uint32_t mFirstLedger{0};
+
+    unsigned int mSeed{1};
+    bool mFsync{true};
+
+    // If 0, BUCKET_MERGE_THREADS keeps its default.
+    uint32_t mMergeThreads{0};
+
+    // Directory to write buckets to, which must not exist and is deleted
+    // afterwards. If empty, a temporary directory is used.
+    std::string mBucketDir;
+
+    BucketListBenchmarkConfig();
+};
+
+// Parses a comma-separated list of TYPE=WEIGHT pairs, such as
+// "ACCOUNT=40,TRUSTLINE=40,OFFER=15,DATA=5". Throws std::invalid_argument if
+// `mix` is malformed or names an unknown type.
+std::vector<std::pair<LedgerEntryType, uint32_t>>
+parseEntryMix(std::string const& mix);
+
+// Builds a BucketList as described by `cfg`, drives `cfg.mLedgers` ledgers of
+// `addBatch` over it and waits for the merges they started to finish. Returns
+// the merge throughput over the timed run, the per-level merge timings (from
+// the bucket.merge-time and bucket.merge-latency timers) and the peak RSS of
+// the process, as JSON.
+Json::Value runBucketListBenchmark(BucketListBenchmarkConfig const& cfg);
+}
@@ -29,6 +29,8 @@
 #include "xdrpp/autocheck.h"
 
 #include <deque>
+#include <map>
+#include <set>
 #include <sstream>
 
 using namespace stellar;
@@ -466,6 +468,100 @@ TEST_CASE("single entry bubbling up", "[bucket][bucketlist][bucketbubble]")
     }
 }
 
+TEST_CASE("BucketList point lookups", "[bucket][bucketlist][bucketindex]")
+{
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    for_versions_with_differing_bucket_logic(cfg, [&](Config const& cfg) {
+        Application::pointer app = createTestApplication(clock, cfg);
+        BucketList bl;
+
+        // Expected state of every key ever added; null once deleted.
+        std::map<LedgerKey, std::shared_ptr<LedgerEntry const>> expected;
+        std::uniform_int_distribution<size_t> opDist(0, 3);
+
+        auto checkAll = [&]() {
+            for (auto const& kv : expected)
+            {
+                auto le = bl.getLedgerEntry(kv.first);
+                if (kv.second)
+                {
+                    REQUIRE(le);
+                    REQUIRE(*le == *kv.second);
+                }
+                else
+                {
+                    REQUIRE(!le);
+                }
+            }
+            for (auto const& le :
+                 LedgerTestUtils::generateValidLedgerEntries(10))
+            {
+                auto k = LedgerEntryKey(le);
+                if (expected.find(k) == expected.end())
+                {
+                    REQUIRE(!bl.getLedgerEntry(k));
+                }
+            }
+        };
+
+        for (uint32_t i = 1;
+             !app->getClock().getIOContext().stopped() && i < 130; ++i)
+        {
+            app->getClock().crank(false);
+
+            std::map<LedgerKey, LedgerEntry> live;
+            std::set<LedgerKey> dead;
+            for (auto const& le :
+                 LedgerTestUtils::generateValidLedgerEntries(8))
+            {
+                live[LedgerEntryKey(le)] = le;
+            }
+            // Update or delete some of the entries added earlier
+            for (auto const& kv : expected)
+            {
+                if (!kv.second || live.count(kv.first) != 0)
+                {
+                    continue;
+                }
+                auto op = opDist(gRandomEngine);
+                if (op == 0)
+                {
+                    auto le = LedgerTestUtils::generateValidLedgerEntry();
+                    le.data = kv.second->data;
+                    le.lastModifiedLedgerSeq = i;
+                    live[kv.first] = le;
+                }
+                else if (op == 1 && dead.size() < 4)
+                {
+                    dead.emplace(kv.first);
+                }
+            }
+
+            std::vector<LedgerEntry> liveEntries;
+            for (auto const& kv : live)
+            {
+                liveEntries.emplace_back(kv.second);
+                expected[kv.first] =
+                    std::make_shared<LedgerEntry const>(kv.second);
+            }
+            std::vector<LedgerKey> deadEntries(dead.begin(), dead.end());
+            for (auto const& k : deadEntries)
+            {
+                expected[k] = nullptr;
+            }
+            bl.addBatch(*app, i, getAppLedgerVersion(app), {}, liveEntries,
+                        deadEntries);
+
+            if (i % 16 == 0)
+            {
+                checkAll();
+            }
+        }
+        checkAll();
+    });
+}
+
 TEST_CASE("BucketList sizeOf and oldestLedgerIn relations",
           "[bucket][bucketlist][count]")
 {
@@ -12,9 +12,12 @@
 #include "util/asio.h"
 #include "bucket/Bucket.h"
 #include "bucket/BucketInputIterator.h"
+#include "bucket/BucketListSnapshot.h"
 #include "bucket/BucketManager.h"
 #include "bucket/BucketManagerImpl.h"
+#include "bucket/BucketMergeExecutor.h"
 #include "bucket/BucketTests.h"
+#include "crypto/Hex.h"
 #include "history/HistoryArchiveManager.h"
 #include "history/test/HistoryTestsUtils.h"
 #include "ledger/LedgerTxn.h"
@@ -23,12 +26,17 @@
 #include "main/Application.h"
 #include "main/Config.h"
 #include "main/ExternalQueue.h"
+#include "medida/counter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
 #include "test/TestUtils.h"
 #include "test/test.h"
 #include "util/Math.h"
 #include "util/Timer.h"
 
 #include <cstdio>
+#include <functional>
+#include <future>
 #include <optional>
 #include <thread>
 
@@ -121,35 +129,43 @@ clearFutures(Application::pointer app, BucketList& bl)
         bl.getLevel(i).getNext().clear();
     }
 
-    // Then go through all the _worker threads_ and mop up any work they
-    // might still be doing (that might be "dropping a shared_ptr<Bucket>").
-
-    size_t n = (size_t)app->getConfig().WORKER_THREADS;
-    std::mutex mutex;
-    std::condition_variable cv, cv2;
-    size_t waiting = 0, finished = 0;
-    for (size_t i = 0; i < n; ++i)
-    {
-        app->postOnBackgroundThread(
-            [&] {
-                std::unique_lock<std::mutex> lock(mutex);
-                if (++waiting == n)
-                {
-                    cv.notify_all();
-                }
-                else
-                {
-                    cv.wait(lock, [&] { return waiting == n; });
-                }
-                ++finished;
-                cv2.notify_one();
-            },
-            "BucketTests: clearFutures");
-    }
-    {
-        std::unique_lock<std::mutex> lock(mutex);
-        cv2.wait(lock, [&] { return finished == n; });
-    }
+    // Then go through all the _worker threads_ and the merge threads and mop
+    // up any work they might still be doing (that might be "dropping a
+    // shared_ptr<Bucket>").
+    auto waitForThreads =
+        [](size_t n, std::function<void(std::function<void()>&&)> post) {
+            std::mutex mutex;
+            std::condition_variable cv, cv2;
+            size_t waiting = 0, finished = 0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                post([&] {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (++waiting == n)
+                    {
+                        cv.notify_all();
+                    }
+                    else
+                    {
+                        cv.wait(lock, [&] { return waiting == n; });
+                    }
+                    ++finished;
+                    cv2.notify_one();
+                });
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            cv2.wait(lock, [&] { return finished == n; });
+        };
+    waitForThreads((size_t)app->getConfig().WORKER_THREADS,
+                   [&](std::function<void()>&& f) {
+                       app->postOnBackgroundThread(std::move(f),
+                                                   "BucketTests: clearFutures");
+                   });
+    // Level 0 merges are never held back by the long-merge limit.
+    waitForThreads((size_t)app->getConfig().BUCKET_MERGE_THREADS,
+                   [&](std::function<void()>&& f) {
+                       app->getBucketManager().postMerge(0, std::move(f));
+                   });
 
     // Tell the BucketManager to forget all about the futures it knows.
     app->getBucketManager().clearMergeFuturesForTesting();
@@ -297,8 +313,9 @@ TEST_CASE("bucketmanager ownership", "[bucket][bucketmanager]")
                 /*doFsync=*/true);
             b1 = b2;
 
-            // Bucket is referenced by b1, b2 and the BucketManager.
-            CHECK(b1.use_count() == 3);
+            // Bucket is referenced by b1 and b2; the BucketManager's own
+            // reference doesn't count.
+            CHECK(b1.use_count() == 2);
 
             std::shared_ptr<Bucket> b3 = Bucket::fresh(
                 app->getBucketManager(), getAppLedgerVersion(app), {}, live,
@@ -308,12 +325,12 @@ TEST_CASE("bucketmanager ownership", "[bucket][bucketmanager]")
                 app->getBucketManager(), getAppLedgerVersion(app), {}, live,
                 dead, /*countMergeEvents=*/true, clock.getIOContext(),
                 /*doFsync=*/true);
-            // Bucket is referenced by b1, b2, b3, b4 and the BucketManager.
-            CHECK(b1.use_count() == 5);
+            // Bucket is referenced by b1, b2, b3 and b4.
+            CHECK(b1.use_count() == 4);
         }
 
-        // Bucket is now only referenced by b1 and the BucketManager.
-        CHECK(b1.use_count() == 2);
+        // Bucket is now only referenced by b1.
+        CHECK(b1.use_count() == 1);
 
         // Drop bucket ourselves then purge bucketManager.
         std::string filename = b1->getFilename();
@@ -328,20 +345,19 @@ TEST_CASE("bucketmanager ownership", "[bucket][bucketmanager]")
         clearFutures(app, bl);
         b1 = bl.getLevel(0).getCurr();
 
-        // Bucket should be referenced by bucketlist itself, BucketManager cache
-        // and b1.
-        CHECK(b1.use_count() == 3);
+        // Bucket should be referenced by bucketlist itself and b1.
+        CHECK(b1.use_count() == 2);
 
         // This shouldn't change if we forget unreferenced buckets since it's
         // referenced by bucketlist.
         app->getBucketManager().forgetUnreferencedBuckets();
-        CHECK(b1.use_count() == 3);
+        CHECK(b1.use_count() == 2);
 
         // But if we mutate the curr bucket of the bucketlist, it should.
         live[0] = LedgerTestUtils::generateValidLedgerEntry(10);
         bl.addBatch(*app, 1, getAppLedgerVersion(app), {}, live, dead);
         clearFutures(app, bl);
-        CHECK(b1.use_count() == 2);
+        CHECK(b1.use_count() == 1);
 
         // Drop it again.
         filename = b1->getFilename();
@@ -352,6 +368,152 @@ TEST_CASE("bucketmanager ownership", "[bucket][bucketmanager]")
     });
 }
 
+TEST_CASE("bucketmanager keeps buckets named by LCL HAS",
+          "[bucket][bucketmanager]")
+{
+    VirtualClock clock;
+    Config cfg(getTestConfig(0, Config::TESTDB_IN_MEMORY_SQLITE));
+    Application::pointer app = createTestApplication(clock, cfg);
+
+    BucketManager& bm = app->getBucketManager();
+    auto& sharedBytes =
+        app->getMetrics().NewCounter({"bucket", "memory", "shared-bytes"});
+    auto bytesBefore = sharedBytes.count();
+
+    auto live = LedgerTestUtils::generateValidLedgerEntries(10);
+    auto b = Bucket::fresh(bm, getAppLedgerVersion(app), {}, live, {},
+                           /*countMergeEvents=*/true, clock.getIOContext(),
+                           /*doFsync=*/true);
+    auto filename = b->getFilename();
+    auto size = static_cast<int64_t>(b->getSize());
+    CHECK(sharedBytes.count() == bytesBefore + size);
+
+    // Nothing holds the bucket once we let go of it, but the LCL HAS still
+    // names it.
+    HistoryArchiveState has;
+    has.currentBuckets.at(1).snap = binToHex(b->getHash());
+    bm.noteLastClosedLedgerHAS(has);
+    b.reset();
+    bm.forgetUnreferencedBuckets();
+    CHECK(fs::exists(filename));
+    CHECK(sharedBytes.count() == bytesBefore + size);
+
+    // Once the next LCL HAS doesn't, it goes.
+    bm.noteLastClosedLedgerHAS(HistoryArchiveState());
+    bm.forgetUnreferencedBuckets();
+    CHECK(!fs::exists(filename));
+    CHECK(sharedBytes.count() == bytesBefore);
+}
+
+TEST_CASE("bucketlist snapshot pins buckets", "[bucket][bucketmanager]")
+{
+    VirtualClock clock;
+    Config cfg(getTestConfig(0, Config::TESTDB_IN_MEMORY_SQLITE));
+    Application::pointer app = createTestApplication(clock, cfg);
+
+    BucketManager& bm = app->getBucketManager();
+    BucketList& bl = bm.getBucketList();
+    auto vers = getAppLedgerVersion(app);
+
+    auto live = LedgerTestUtils::generateValidLedgerEntries(10);
+    uint32_t ledger = 1;
+    bm.addBatch(*app, ledger, vers, {}, live, {});
+
+    auto snap = bm.getBucketListSnapshot();
+    REQUIRE(snap);
+    REQUIRE(snap->getLedgerSeq() == ledger);
+    REQUIRE(snap->getNumLevels() == BucketList::kNumLevels);
+    Hash snapHash = bl.getHash();
+    REQUIRE(snap->getHash() == snapHash);
+
+    auto pinned = snap->getLevel(0).mCurr;
+    std::string filename = pinned->getFilename();
+    pinned.reset();
+    REQUIRE(fs::exists(filename));
+
+    // Replace level 0 a few times over, collecting garbage as a ledger close
+    // would. The snapshot is the only thing left keeping `filename` alive.
+    for (++ledger; ledger < 8; ++ledger)
+    {
+        bm.addBatch(*app, ledger, vers, {},
+                    LedgerTestUtils::generateValidLedgerEntries(10), {});
+        bm.forgetUnreferencedBuckets();
+    }
+    REQUIRE(bl.getHash() != snapHash);
+    REQUIRE(bm.getBucketListSnapshot()->getHash() == bl.getHash());
+    REQUIRE(fs::exists(filename));
+
+    // The snapshot is still readable, from another thread.
+    Hash threadHash;
+    std::shared_ptr<LedgerEntry const> threadEntry;
+    std::thread reader([&]() {
+        threadHash = snap->getHash();
+        threadEntry = snap->getLedgerEntry(LedgerEntryKey(live[0]));
+    });
+    reader.join();
+    REQUIRE(threadHash == snapHash);
+    REQUIRE(threadEntry);
+    REQUIRE(*threadEntry == live[0]);
+
+    // Once released, the next GC drops the bucket.
+    snap.reset();
+    bm.forgetUnreferencedBuckets();
+    REQUIRE(!fs::exists(filename));
+}
+
+TEST_CASE("bucket sync group defers fsyncs", "[bucket][bucketmanager]")
+{
+    VirtualClock clock;
+    Config cfg(getTestConfig(0, Config::TESTDB_IN_MEMORY_SQLITE));
+    cfg.DISABLE_XDR_FSYNC = false;
+    Application::pointer app = createTestApplication(clock, cfg);
+
+    BucketManager& bm = app->getBucketManager();
+    BucketList& bl = bm.getBucketList();
+    auto vers = getAppLedgerVersion(app);
+    auto& syncTimer =
+        app->getMetrics().NewTimer({"bucket", "batch", "synctime"});
+
+    SECTION("files are only deferred while a group is open")
+    {
+        REQUIRE(!bm.hasBucketSyncGroup());
+        REQUIRE(!bm.deferBucketSync(bm.getBucketDir()));
+        bm.openBucketSyncGroup();
+#ifndef _WIN32
+        REQUIRE(bm.hasBucketSyncGroup());
+        REQUIRE(bm.deferBucketSync(bm.getBucketDir()));
+#endif
+        bm.closeBucketSyncGroup();
+        REQUIRE(!bm.hasBucketSyncGroup());
+        REQUIRE(!bm.deferBucketSync(bm.getBucketDir()));
+    }
+
+    SECTION("addBatch syncs its buckets as a group")
+    {
+        auto before = syncTimer.count();
+        for (uint32_t ledger = 1; ledger < 16; ++ledger)
+        {
+            bm.addBatch(*app, ledger, vers, {},
+                        LedgerTestUtils::generateValidLedgerEntries(10), {});
+            REQUIRE(!bm.hasBucketSyncGroup());
+        }
+#ifndef _WIN32
+        REQUIRE(syncTimer.count() == before + 15);
+#endif
+        for (uint32_t i = 0; i < BucketList::kNumLevels; ++i)
+        {
+            auto const& lev = bl.getLevel(i);
+            for (auto const& b : {lev.getCurr(), lev.getSnap()})
+            {
+                if (b->getHash() != Hash{})
+                {
+                    REQUIRE(fs::exists(b->getFilename()));
+                }
+            }
+        }
+    }
+}
+
 TEST_CASE("bucketmanager missing buckets fail", "[bucket][bucketmanager]")
 {
     Config cfg(getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE));
@@ -591,6 +753,116 @@ TEST_CASE("bucketmanager do not leak empty-merge futures",
     REQUIRE(bmRefBuckets.size() == bmDirBuckets.size());
 }
 
+TEST_CASE("bucket merge executor runs earliest deadline first",
+          "[bucket][bucketmanager]")
+{
+    VirtualClock clock;
+    Config cfg(getTestConfig());
+    Application::pointer app = createTestApplication(clock, cfg);
+
+    REQUIRE(BucketMergeExecutor::ledgersUntilNeeded(0) == 0);
+    REQUIRE(BucketMergeExecutor::ledgersUntilNeeded(1) ==
+            BucketList::levelHalf(0));
+    REQUIRE(BucketMergeExecutor::ledgersUntilNeeded(5) ==
+            BucketList::levelHalf(4));
+
+    std::mutex mutex;
+    std::vector<uint32_t> order;
+    auto record = [&](uint32_t level) {
+        return [&, level]() {
+            std::lock_guard<std::mutex> guard(mutex);
+            order.emplace_back(level);
+        };
+    };
+
+    SECTION("by level")
+    {
+        BucketMergeExecutor executor(*app, 1, 1);
+        // Hold the only thread until everything is queued.
+        std::promise<void> unblock;
+        auto blocked = unblock.get_future().share();
+        executor.post(0, [blocked]() { blocked.wait(); });
+        executor.post(5, record(5));
+        executor.post(1, record(1));
+        executor.post(3, record(3));
+        executor.post(1, record(1));
+        unblock.set_value();
+        executor.shutdown();
+        REQUIRE(order == std::vector<uint32_t>{1, 1, 3, 5});
+    }
+
+    SECTION("long merges do not hold up short ones")
+    {
+        uint32_t const longLevel = BucketMergeExecutor::LONG_MERGE_LEVEL;
+        BucketMergeExecutor executor(*app, 2, 1);
+        std::promise<void> unblock;
+        auto blocked = unblock.get_future().share();
+        std::promise<void> started;
+        executor.post(longLevel, [blocked, &started]() {
+            started.set_value();
+            blocked.wait();
+        });
+        started.get_future().wait();
+        // The second thread is free, but may only run short merges while the
+        // first long merge is running.
+        executor.post(longLevel + 1, record(longLevel + 1));
+        std::promise<void> shortDone;
+        executor.post(2, [&]() {
+            record(2)();
+            shortDone.set_value();
+        });
+        shortDone.get_future().wait();
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            REQUIRE(order == std::vector<uint32_t>{2});
+        }
+        unblock.set_value();
+        executor.shutdown();
+        REQUIRE(order == std::vector<uint32_t>{2, longLevel + 1});
+    }
+
+    SECTION("default config does not queue a level behind the deepest ones")
+    {
+        auto const& appCfg = app->getConfig();
+        BucketMergeExecutor executor(
+            *app, static_cast<size_t>(appCfg.BUCKET_MERGE_THREADS),
+            static_cast<size_t>(appCfg.BUCKET_MERGE_MAX_LONG_MERGES));
+        std::promise<void> unblock;
+        auto blocked = unblock.get_future().share();
+        uint32_t const deepest = BucketList::kNumLevels - 1;
+        for (uint32_t level : {deepest - 1, deepest})
+        {
+            auto started = std::make_shared<std::promise<void>>();
+            auto startedFuture = started->get_future();
+            executor.post(level, [blocked, started]() {
+                started->set_value();
+                blocked.wait();
+            });
+            startedFuture.wait();
+        }
+
+        // Both deepest merges are still running.
+        std::promise<void> middleDone;
+        executor.post(5, [&]() {
+            record(5)();
+            middleDone.set_value();
+        });
+        REQUIRE(middleDone.get_future().wait_for(std::chrono::seconds(10)) ==
+                std::future_status::ready);
+        unblock.set_value();
+        executor.shutdown();
+        REQUIRE(order == std::vector<uint32_t>{5});
+    }
+
+    SECTION("runs inline after shutdown")
+    {
+        BucketMergeExecutor executor(*app, 1, 1);
+        executor.shutdown();
+        executor.post(3, record(3));
+        REQUIRE(order == std::vector<uint32_t>{3});
+    }
+}
+
 TEST_CASE("bucketmanager reattach HAS from publish queue to finished merge",
           "[bucket][bucketmanager]")
 {
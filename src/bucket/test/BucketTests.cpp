@@ -13,8 +13,11 @@
 #include "util/asio.h"
 #include "bucket/BucketTests.h"
 #include "bucket/Bucket.h"
+#include "bucket/BucketApplicator.h"
+#include "bucket/BucketIndex.h"
 #include "bucket/BucketInputIterator.h"
 #include "bucket/BucketManager.h"
+#include "bucket/BucketMergeCheckpoint.h"
 #include "bucket/BucketOutputIterator.h"
 #include "ledger/LedgerTxn.h"
 #include "ledger/test/LedgerTestUtils.h"
@@ -27,7 +30,10 @@
 #include "util/Logging.h"
 #include "util/Math.h"
 #include "util/Timer.h"
+#include "util/types.h"
 #include "xdrpp/autocheck.h"
+#include <filesystem>
+#include <set>
 
 using namespace stellar;
 
@@ -172,6 +178,308 @@ TEST_CASE("file backed buckets", "[bucket][bucketbench]")
     });
 }
 
+TEST_CASE("bucket index point lookups", "[bucket][bucketindex]")
+{
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    Application::pointer app = createTestApplication(clock, cfg);
+
+    autocheck::generator<LedgerKey> deadGen;
+    std::vector<LedgerEntry> live(9000);
+    std::vector<LedgerKey> dead(1000);
+    for (auto& e : live)
+        e = LedgerTestUtils::generateValidLedgerEntry(3);
+    for (auto& e : dead)
+        e = deadGen(3);
+    std::shared_ptr<Bucket> b = Bucket::fresh(
+        app->getBucketManager(), getAppLedgerVersion(app), {}, live, dead,
+        /*countMergeEvents=*/true, clock.getIOContext(),
+        /*doFsync=*/false);
+
+    // The index built while writing matches one built by reading the file.
+    auto index = BucketIndex::build(b->getFilename());
+    REQUIRE(index->numKeys() == countEntries(b));
+    REQUIRE(index->numPages() > 1);
+
+    std::set<LedgerKey> keys;
+    for (BucketInputIterator iter(b); iter; ++iter)
+    {
+        auto k = getBucketLedgerKey(*iter);
+        REQUIRE(index->lookup(k));
+        auto be = b->getBucketEntry(k);
+        REQUIRE(be);
+        REQUIRE(*be == *iter);
+        keys.emplace(k);
+    }
+
+    size_t absent = 0;
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        auto k = LedgerEntryKey(LedgerTestUtils::generateValidLedgerEntry(3));
+        if (keys.count(k) == 0)
+        {
+            ++absent;
+            REQUIRE(!b->getBucketEntry(k));
+        }
+    }
+    REQUIRE(absent > 0);
+}
+
+TEST_CASE("bucket index sidecar", "[bucket][bucketindex]")
+{
+    VirtualClock clock;
+    Config cfg = getTestConfig();
+    cfg.EXPERIMENTAL_BUCKET_POINT_LOADS = true;
+    Application::pointer app = createTestApplication(clock, cfg);
+
+    std::vector<LedgerEntry> live(5000);
+    for (auto& e : live)
+        e = LedgerTestUtils::generateValidLedgerEntry(3);
+    std::shared_ptr<Bucket> b = Bucket::fresh(
+        app->getBucketManager(), getAppLedgerVersion(app), {}, live, {},
+        /*countMergeEvents=*/true, clock.getIOContext(),
+        /*doFsync=*/false);
+
+    // Adopting the bucket saved its index next to it.
+    auto indexFilename = b->getFilename() + ".index";
+    REQUIRE(fs::exists(indexFilename));
+    auto loaded = BucketIndex::load(indexFilename, b->getHash());
+    REQUIRE(loaded);
+    auto built = BucketIndex::build(b->getFilename());
+    REQUIRE(loaded->numKeys() == built->numKeys());
+    REQUIRE(loaded->numPages() == built->numPages());
+    for (BucketInputIterator iter(b); iter; ++iter)
+    {
+        auto k = getBucketLedgerKey(*iter);
+        REQUIRE(loaded->lookup(k) == built->lookup(k));
+    }
+
+    SECTION("index of another bucket is ignored")
+    {
+        Hash other = b->getHash();
+        other[0] ^= 1;
+        REQUIRE(!BucketIndex::load(indexFilename, other));
+    }
+
+    SECTION("truncated index is ignored")
+    {
+        std::filesystem::resize_file(
+            indexFilename, std::filesystem::file_size(indexFilename) / 2);
+        REQUIRE(!BucketIndex::load(indexFilename, b->getHash()));
+    }
+
+    SECTION("index is dropped with its bucket")
+    {
+        b.reset();
+        app->getBucketManager().forgetUnreferencedBuckets();
+        REQUIRE(!fs::exists(indexFilename));
+    }
+}
+
+#ifdef USE_ZSTD
+TEST_CASE("compressed buckets", "[bucket][bucketcompression]")
+{
+    VirtualClock rawClock, compressedClock;
+    Config rawCfg(getTestConfig(0));
+    Config compressedCfg(getTestConfig(1));
+    compressedCfg.BUCKET_COMPRESSION_LEVEL = 3;
+    Application::pointer rawApp = createTestApplication(rawClock, rawCfg);
+    Application::pointer compressedApp =
+        createTestApplication(compressedClock, compressedCfg);
+
+    autocheck::generator<LedgerKey> deadGen;
+    auto makeBucket = [&](Application& app, VirtualClock& clock,
+                           std::vector<LedgerEntry> const& live,
+                           std::vector<LedgerKey> const& dead) {
+        return Bucket::fresh(app.getBucketManager(), getAppLedgerVersion(app),
+                             {}, live, dead, /*countMergeEvents=*/true,
+                             clock.getIOContext(), /*doFsync=*/false);
+    };
+    std::vector<LedgerEntry> live(9000);
+    std::vector<LedgerKey> dead(1000);
+    for (auto& e : live)
+        e = LedgerTestUtils::generateValidLedgerEntry(3);
+    for (auto& e : dead)
+        e = deadGen(3);
+    auto raw = makeBucket(*rawApp, rawClock, live, dead);
+    auto compressed = makeBucket(*compressedApp, compressedClock, live, dead);
+
+    // Same hash and XDR, smaller file.
+    REQUIRE(!raw->isCompressed());
+    REQUIRE(compressed->isCompressed());
+    REQUIRE(compressed->getHash() == raw->getHash());
+    REQUIRE(compressed->getSize() == raw->getSize());
+    REQUIRE(fs::size(compressed->getFilename()) <
+            fs::size(raw->getFilename()));
+    {
+        BucketInputIterator ri(raw), ci(compressed);
+        for (; ri && ci; ++ri, ++ci)
+        {
+            REQUIRE(*ri == *ci);
+            REQUIRE(ri.pos() == ci.pos());
+        }
+        REQUIRE(!ri);
+        REQUIRE(!ci);
+    }
+
+    SECTION("point lookups")
+    {
+        auto index = BucketIndex::build(compressed->getFilename());
+        REQUIRE(index->numKeys() == countEntries(compressed));
+        for (BucketInputIterator iter(compressed); iter; ++iter)
+        {
+            auto be = compressed->getBucketEntry(getBucketLedgerKey(*iter));
+            REQUIRE(be);
+            REQUIRE(*be == *iter);
+        }
+    }
+
+    SECTION("merges")
+    {
+        for (auto& e : live)
+            e = LedgerTestUtils::generateValidLedgerEntry(3);
+        for (auto& e : dead)
+            e = deadGen(3);
+        auto merge = [&](Application& app, VirtualClock& clock,
+                         std::shared_ptr<Bucket> const& b) {
+            return Bucket::merge(
+                app.getBucketManager(), app.getConfig().LEDGER_PROTOCOL_VERSION,
+                b, makeBucket(app, clock, live, dead), /*shadows=*/{},
+                /*keepDeadEntries=*/true, /*countMergeEvents=*/true,
+                clock.getIOContext(), /*doFsync=*/false);
+        };
+        auto rawMerged = merge(*rawApp, rawClock, raw);
+        auto compressedMerged =
+            merge(*compressedApp, compressedClock, compressed);
+        REQUIRE(compressedMerged->isCompressed());
+        REQUIRE(compressedMerged->getHash() == rawMerged->getHash());
+    }
+}
+#endif
+
+TEST_CASE("bucket merges resume from checkpoints", "[bucket][bucketmerge]")
+{
+    VirtualClock plainClock, ckptClock;
+    Config plainCfg(getTestConfig(0));
+    Config ckptCfg(getTestConfig(1));
+    ckptCfg.BUCKET_MERGE_CHECKPOINT_BYTES = 1;
+    Application::pointer plainApp = createTestApplication(plainClock, plainCfg);
+    Application::pointer ckptApp = createTestApplication(ckptClock, ckptCfg);
+
+    autocheck::generator<LedgerKey> deadGen;
+    std::vector<LedgerEntry> oldLive(4000), newLive(4000);
+    std::vector<LedgerKey> dead(500);
+    for (auto& e : oldLive)
+        e = LedgerTestUtils::generateValidLedgerEntry(3);
+    for (auto& e : newLive)
+        e = LedgerTestUtils::generateValidLedgerEntry(3);
+    for (auto& e : dead)
+        e = deadGen(3);
+
+    auto merge = [&](Application& app, VirtualClock& clock) {
+        auto& bm = app.getBucketManager();
+        auto vers = getAppLedgerVersion(app);
+        auto oldBucket =
+            Bucket::fresh(bm, vers, {}, oldLive, {}, /*countMergeEvents=*/true,
+                          clock.getIOContext(), /*doFsync=*/false);
+        auto newBucket =
+            Bucket::fresh(bm, vers, {}, newLive, dead,
+                          /*countMergeEvents=*/true, clock.getIOContext(),
+                          /*doFsync=*/false);
+        return Bucket::merge(bm, app.getConfig().LEDGER_PROTOCOL_VERSION,
+                             oldBucket, newBucket, /*shadows=*/{},
+                             /*keepDeadEntries=*/true,
+                             /*countMergeEvents=*/true, clock.getIOContext(),
+                             /*doFsync=*/false);
+    };
+    auto expected = merge(*plainApp, plainClock);
+    REQUIRE(!plainApp->getBucketManager().getMergeStateDir());
+
+    // A shut-down BucketManager stops merges every 1000 steps; with
+    // checkpointing on, each attempt carries on from where the last stopped.
+    auto& bm = ckptApp->getBucketManager();
+    REQUIRE(bm.getMergeStateDir());
+    bm.shutdown();
+    std::shared_ptr<Bucket> resumed;
+    size_t attempts = 0;
+    while (!resumed)
+    {
+        ++attempts;
+        try
+        {
+            resumed = merge(*ckptApp, ckptClock);
+        }
+        catch (std::runtime_error&)
+        {
+        }
+        REQUIRE(attempts < 100);
+    }
+    REQUIRE(attempts > 1);
+    REQUIRE(resumed->getHash() == expected->getHash());
+
+    // The stitched-together file really holds the merged bucket.
+    {
+        BucketInputIterator ei(expected), ri(resumed);
+        for (; ei && ri; ++ei, ++ri)
+        {
+            REQUIRE(*ei == *ri);
+        }
+        REQUIRE(!ei);
+        REQUIRE(!ri);
+    }
+
+    // And the finished merge is recorded for the next startup.
+    auto finished = bm.getMergeStateDir()->loadFinishedMerges();
+    REQUIRE(std::any_of(finished.begin(), finished.end(), [&](auto const& m) {
+        return m.second == resumed->getHash();
+    }));
+}
+
+TEST_CASE("bucket entry key prefixes order like BucketEntryIdCmp",
+          "[bucket]")
+{
+    autocheck::generator<LedgerKey> deadGen;
+    std::vector<BucketEntry> entries;
+    for (size_t i = 0; i < 500; ++i)
+    {
+        BucketEntry live(LIVEENTRY);
+        live.liveEntry() = LedgerTestUtils::generateValidLedgerEntry(3);
+        entries.emplace_back(live);
+
+        BucketEntry dead(DEADENTRY);
+        dead.deadEntry() = deadGen(3);
+        entries.emplace_back(dead);
+    }
+    // Trustlines of a single account only differ past the prefix.
+    auto account = LedgerTestUtils::generateValidAccountEntry(3).accountID;
+    for (auto const& tl : LedgerTestUtils::generateValidTrustLineEntries(50))
+    {
+        BucketEntry e(LIVEENTRY);
+        e.liveEntry().data.type(TRUSTLINE);
+        e.liveEntry().data.trustLine() = tl;
+        e.liveEntry().data.trustLine().accountID = account;
+        entries.emplace_back(e);
+    }
+
+    BucketEntryIdCmp cmp;
+    for (auto const& a : entries)
+    {
+        BucketEntryKeyPrefix pa(a);
+        for (auto const& b : entries)
+        {
+            int c = pa.compare(BucketEntryKeyPrefix(b));
+            if (c < 0)
+            {
+                REQUIRE(cmp(a, b));
+            }
+            else if (c > 0)
+            {
+                REQUIRE(cmp(b, a));
+            }
+        }
+    }
+}
+
 TEST_CASE("merging bucket entries", "[bucket]")
 {
     VirtualClock clock;
@@ -1010,6 +1318,82 @@ TEST_CASE("bucket apply", "[bucket]")
     });
 }
 
+TEST_CASE("bucket partition apply keeps newest entries", "[bucket]")
+{
+    VirtualClock clock;
+    Config cfg(getTestConfig());
+    for_versions_with_differing_bucket_logic(cfg, [&](Config const& cfg) {
+        Application::pointer app = createTestApplication(clock, cfg);
+
+        std::vector<LedgerEntry> older(10), newer, noLive;
+        std::vector<LedgerKey> dead, noDead;
+        for (auto& e : older)
+        {
+            e.data.type(ACCOUNT);
+            auto& a = e.data.account();
+            a = LedgerTestUtils::generateValidAccountEntry(5);
+            a.balance = 1000000000;
+        }
+        // The newer bucket updates the first half, deletes three more and
+        // deletes an account that was never created.
+        for (size_t i = 0; i < 5; ++i)
+        {
+            newer.emplace_back(older[i]);
+            newer.back().data.account().balance = 2000000000;
+        }
+        for (size_t i = 5; i < 8; ++i)
+        {
+            dead.emplace_back(LedgerEntryKey(older[i]));
+        }
+        LedgerEntry never;
+        never.data.type(ACCOUNT);
+        never.data.account() = LedgerTestUtils::generateValidAccountEntry(5);
+        dead.emplace_back(LedgerEntryKey(never));
+
+        auto vers = getAppLedgerVersion(app);
+        std::shared_ptr<Bucket const> oldBucket =
+            Bucket::fresh(app->getBucketManager(), vers, {}, older, noDead,
+                          /*countMergeEvents=*/true, clock.getIOContext(),
+                          /*doFsync=*/true);
+        std::shared_ptr<Bucket const> newBucket =
+            Bucket::fresh(app->getBucketManager(), vers, {}, newer, dead,
+                          /*countMergeEvents=*/true, clock.getIOContext(),
+                          /*doFsync=*/true);
+
+        BucketPartitionApplicator applicator(
+            app->getLedgerTxnRoot(), vers, {newBucket, oldBucket},
+            [](LedgerEntryType t) { return t == ACCOUNT; });
+        size_t applied = 0;
+        while (applicator)
+        {
+            applied += applicator.advance();
+        }
+        // Each key is written once: 5 updates, 4 deletes and the 2 accounts
+        // only in the older bucket.
+        REQUIRE(applied == 11);
+        REQUIRE(app->getLedgerTxnRoot().countObjects(ACCOUNT) ==
+                older.size() - 3 + 1 /* root account */);
+
+        LedgerTxn ltx(app->getLedgerTxnRoot());
+        for (size_t i = 0; i < older.size(); ++i)
+        {
+            auto entry = ltx.loadWithoutRecord(LedgerEntryKey(older[i]));
+            if (i < 5)
+            {
+                REQUIRE(entry.current().data.account().balance == 2000000000);
+            }
+            else if (i < 8)
+            {
+                REQUIRE(!entry);
+            }
+            else
+            {
+                REQUIRE(entry.current().data.account().balance == 1000000000);
+            }
+        }
+    });
+}
+
 TEST_CASE("bucket apply bench", "[bucketbench][!hide]")
 {
     auto runtest = [](Config::TestDbMode mode) {
@@ -1049,3 +1433,171 @@ TEST_CASE("bucket apply bench", "[bucketbench][!hide]")
     }
 #endif
 }
+
+#ifdef USE_ZSTD
+TEST_CASE("compressed bucket merge bench", "[bucketbench][!hide]")
+{
+    // Merge throughput and disk footprint of raw and compressed buckets.
+    auto runtest = [](int level) {
+        VirtualClock clock;
+        Config cfg(getTestConfig());
+        cfg.BUCKET_COMPRESSION_LEVEL = level;
+        Application::pointer app = createTestApplication(clock, cfg);
+        auto& bm = app->getBucketManager();
+
+        std::vector<LedgerEntry> live(100000);
+        std::vector<LedgerKey> noDead;
+        for (auto& e : live)
+            e = LedgerTestUtils::generateValidLedgerEntry(3);
+        auto b = Bucket::fresh(bm, getAppLedgerVersion(app), {}, live, noDead,
+                               /*countMergeEvents=*/false, clock.getIOContext(),
+                               /*doFsync=*/true);
+
+        std::chrono::nanoseconds mergeTime{0};
+        size_t mergedBytes = 0;
+        for (size_t i = 0; i < 5; ++i)
+        {
+            for (auto& e : live)
+                e = LedgerTestUtils::generateValidLedgerEntry(3);
+            auto fresh = Bucket::fresh(
+                bm, getAppLedgerVersion(app), {}, live, noDead,
+                /*countMergeEvents=*/false, clock.getIOContext(),
+                /*doFsync=*/true);
+            auto start = std::chrono::steady_clock::now();
+            b = Bucket::merge(bm, app->getConfig().LEDGER_PROTOCOL_VERSION, b,
+                              fresh, /*shadows=*/{}, /*keepDeadEntries=*/true,
+                              /*countMergeEvents=*/false, clock.getIOContext(),
+                              /*doFsync=*/true);
+            mergeTime += std::chrono::steady_clock::now() - start;
+            mergedBytes += b->getSize();
+        }
+
+        auto ms =
+            std::chrono::duration_cast<std::chrono::milliseconds>(mergeTime);
+        CLOG_INFO(Bucket,
+                  "Compression level {}: wrote {} of XDR in {} ms ({}/s), "
+                  "final bucket {} of XDR in a {} file",
+                  level, formatSize(mergedBytes), ms.count(),
+                  formatSize(mergedBytes * 1000 / (1 + ms.count())),
+                  formatSize(b->getSize()),
+                  formatSize(fs::size(b->getFilename())));
+    };
+
+    SECTION("raw")
+    {
+        runtest(0);
+    }
+    SECTION("level 1")
+    {
+        runtest(1);
+    }
+    SECTION("level 3")
+    {
+        runtest(3);
+    }
+    SECTION("level 9")
+    {
+        runtest(9);
+    }
+}
+#endif
+
+TEST_CASE("bucket merge key prefix bench", "[bucketbench][!hide]")
+{
+    // Trustline-heavy buckets, a few trustlines per account: compares the
+    // key comparisons a merge makes with and without key prefixes, then
+    // times a full merge.
+    VirtualClock clock;
+    Config cfg(getTestConfig());
+    Application::pointer app = createTestApplication(clock, cfg);
+    auto& bm = app->getBucketManager();
+
+    auto generate = [](size_t accounts, size_t perAccount) {
+        std::vector<LedgerEntry> live;
+        for (size_t i = 0; i < accounts; ++i)
+        {
+            auto id = LedgerTestUtils::generateValidAccountEntry(3).accountID;
+            for (auto const& tl :
+                 LedgerTestUtils::generateValidTrustLineEntries(perAccount))
+            {
+                LedgerEntry e;
+                e.data.type(TRUSTLINE);
+                e.data.trustLine() = tl;
+                e.data.trustLine().accountID = id;
+                live.emplace_back(e);
+            }
+        }
+        return live;
+    };
+    auto toSortedEntries = [](std::vector<LedgerEntry> const& live) {
+        std::vector<BucketEntry> entries;
+        for (auto const& l : live)
+        {
+            BucketEntry e(LIVEENTRY);
+            e.liveEntry() = l;
+            entries.emplace_back(e);
+        }
+        std::sort(entries.begin(), entries.end(), BucketEntryIdCmp{});
+        return entries;
+    };
+
+    std::vector<LedgerKey> noDead;
+    auto oldLive = generate(50000, 4);
+    auto newLive = generate(10000, 4);
+    auto oldEntries = toSortedEntries(oldLive);
+    auto newEntries = toSortedEntries(newLive);
+
+    // Walk both sorted sequences the way Bucket::merge does.
+    BucketEntryIdCmp cmp;
+    auto walk = [&](bool usePrefix) {
+        size_t o = 0, n = 0, steps = 0;
+        BucketEntryKeyPrefix po(oldEntries[0]), pn(newEntries[0]);
+        auto start = std::chrono::steady_clock::now();
+        while (o < oldEntries.size() && n < newEntries.size())
+        {
+            int c = usePrefix ? po.compare(pn) : 0;
+            if (c == 0)
+            {
+                c = cmp(oldEntries[o], newEntries[n])
+                        ? -1
+                        : (cmp(newEntries[n], oldEntries[o]) ? 1 : 0);
+            }
+            if (c <= 0 && ++o < oldEntries.size() && usePrefix)
+            {
+                po = BucketEntryKeyPrefix(oldEntries[o]);
+            }
+            if (c >= 0 && ++n < newEntries.size() && usePrefix)
+            {
+                pn = BucketEntryKeyPrefix(newEntries[n]);
+            }
+            ++steps;
+        }
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+        CLOG_INFO(Bucket, "{} key prefixes: {} merge steps, {} ns/step",
+                  usePrefix ? "With" : "Without", steps,
+                  ns / std::max<size_t>(steps, 1));
+    };
+    walk(false);
+    walk(true);
+
+    auto oldBucket =
+        Bucket::fresh(bm, getAppLedgerVersion(app), {}, oldLive, noDead,
+                      /*countMergeEvents=*/false, clock.getIOContext(),
+                      /*doFsync=*/true);
+    auto newBucket =
+        Bucket::fresh(bm, getAppLedgerVersion(app), {}, newLive, noDead,
+                      /*countMergeEvents=*/false, clock.getIOContext(),
+                      /*doFsync=*/true);
+    auto start = std::chrono::steady_clock::now();
+    auto merged = Bucket::merge(
+        bm, app->getConfig().LEDGER_PROTOCOL_VERSION, oldBucket, newBucket,
+        /*shadows=*/{}, /*keepDeadEntries=*/true,
+        /*countMergeEvents=*/false, clock.getIOContext(), /*doFsync=*/true);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    CLOG_INFO(Bucket, "Merged {} and {} trustlines into {} in {} ms",
+              oldLive.size(), newLive.size(), formatSize(merged->getSize()),
+              ms.count());
+}
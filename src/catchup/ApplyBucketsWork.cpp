@@ -10,15 +10,20 @@
 #include "catchup/CatchupManager.h"
 #include "crypto/Hex.h"
 #include "crypto/SecretKey.h"
+#include "database/Database.h"
 #include "historywork/Progress.h"
 #include "invariant/InvariantManager.h"
+#include "ledger/LedgerEntryCache.h"
 #include "ledger/LedgerManager.h"
 #include "ledger/LedgerTxn.h"
 #include "main/Application.h"
 #include "transactions/TransactionUtils.h"
 #include "util/GlobalChecks.h"
 #include <Tracy.hpp>
+#include <algorithm>
+#include <atomic>
 #include <fmt/format.h>
+#include <mutex>
 
 namespace stellar
 {
@@ -49,6 +54,19 @@ class TempLedgerVersionSetter : NonMovableOrCopyable
     }
 };
 
+// The LedgerTxnRoots of the parallel mode only ever write, so their entry
+// caches stay small.
+static size_t const PARALLEL_APPLY_ENTRY_CACHE_SIZE = 4096;
+
+struct ApplyBucketsWork::ParallelApplyState
+{
+    std::atomic<bool> mStop{false};
+    std::atomic<size_t> mRunning{0};
+    std::atomic<size_t> mAppliedEntries{0};
+    std::mutex mErrorMutex;
+    std::string mError;
+};
+
 ApplyBucketsWork::ApplyBucketsWork(
     Application& app,
     std::map<std::string, std::shared_ptr<Bucket>> const& buckets,
@@ -155,6 +173,8 @@ ApplyBucketsWork::onReset()
     mLevel = BucketList::kNumLevels - 1;
     mApplying = false;
     mDelayChecked = false;
+    mApplyInParallel = !isAborting() && canApplyInParallel();
+    mParallelState.reset();
 
     mSnapBucket.reset();
     mCurrBucket.reset();
@@ -220,6 +240,15 @@ ApplyBucketsWork::onRun()
         }
     }
 
+    if (mApplyInParallel)
+    {
+        if (!mParallelState)
+        {
+            startParallelApply();
+        }
+        return checkParallelApply();
+    }
+
     // Check if we're at the beginning of the new level
     if (isLevelComplete())
     {
@@ -319,6 +348,211 @@ ApplyBucketsWork::advance(std::string const& bucketName,
     }
 }
 
+bool
+ApplyBucketsWork::canApplyInParallel() const
+{
+    auto const& cfg = mApp.getConfig();
+    if (!cfg.PARALLEL_BUCKET_APPLY || cfg.MODE_USES_IN_MEMORY_LEDGER)
+    {
+        return false;
+    }
+    // SQLite only admits one writer at a time.
+    auto& db = mApp.getDatabase();
+    if (db.isSqlite() || !db.canUsePool())
+    {
+        CLOG_INFO(History, "ApplyBuckets : PARALLEL_BUCKET_APPLY needs a "
+                           "postgres database, applying level by level");
+        return false;
+    }
+    // This invariant compares each bucket with the database right after it
+    // is applied, which only holds when applying level by level.
+    auto invariants = mApp.getInvariantManager().getEnabledInvariants();
+    if (std::find(invariants.begin(), invariants.end(),
+                  "BucketListIsConsistentWithDatabase") != invariants.end())
+    {
+        CLOG_INFO(History,
+                  "ApplyBuckets : PARALLEL_BUCKET_APPLY is not compatible "
+                  "with BucketListIsConsistentWithDatabase, applying level "
+                  "by level");
+        return false;
+    }
+    return true;
+}
+
+std::vector<std::shared_ptr<Bucket const>>
+ApplyBucketsWork::getBucketsToApplyNewestFirst()
+{
+    // Same selection as startLevel: skip the oldest levels for as long as
+    // they match the local BucketList, then apply everything from there on.
+    std::vector<std::shared_ptr<Bucket const>> buckets;
+    bool applying = false;
+    for (uint32_t i = BucketList::kNumLevels; i-- > 0;)
+    {
+        auto& level = getBucketLevel(i);
+        HistoryStateBucket const& hsb = mApplyState.currentBuckets.at(i);
+        if (applying || hsb.snap != binToHex(level.getSnap()->getHash()))
+        {
+            buckets.emplace_back(getBucket(hsb.snap));
+            applying = true;
+        }
+        if (applying || hsb.curr != binToHex(level.getCurr()->getHash()))
+        {
+            buckets.emplace_back(getBucket(hsb.curr));
+            applying = true;
+        }
+    }
+    std::reverse(buckets.begin(), buckets.end());
+    return buckets;
+}
+
+void
+ApplyBucketsWork::startParallelApply()
+{
+    ZoneScoped;
+    auto buckets = getBucketsToApplyNewestFirst();
+    mAppliedBuckets = buckets.size();
+    mParallelState = std::make_shared<ParallelApplyState>();
+
+    std::vector<LedgerEntryType> partitions;
+    for (auto let : xdr::xdr_traits<LedgerEntryType>::enum_values())
+    {
+        auto t = static_cast<LedgerEntryType>(let);
+        if (mEntryTypeFilter(t))
+        {
+            partitions.emplace_back(t);
+        }
+    }
+    CLOG_INFO(History, "ApplyBuckets : applying {} buckets in {} partitions",
+              buckets.size(), partitions.size());
+
+    // Each partition writes through a LedgerTxnRoot of its own, whose
+    // header is that of the main root at the version buckets are applied at.
+    LedgerHeader header = mApp.getLedgerTxnRoot().getHeader();
+    header.ledgerVersion = mMaxProtocolVersion;
+
+    Application& app = mApp;
+    auto state = mParallelState;
+    auto maxProtocolVersion = mMaxProtocolVersion;
+    std::weak_ptr<ApplyBucketsWork> weak(
+        std::static_pointer_cast<ApplyBucketsWork>(shared_from_this()));
+    state->mRunning = partitions.size();
+    for (auto t : partitions)
+    {
+        std::string name = xdr::xdr_traits<LedgerEntryType>::enum_name(t);
+        app.postOnBackgroundThread(
+            [&app, state, weak, buckets, header, maxProtocolVersion, t,
+             name]() {
+                ZoneNamedN(applyZone, "apply bucket partition", true);
+                try
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    auto const& cfg = app.getConfig();
+                    Database::WorkerSession session(app.getDatabase());
+                    LedgerTxnRoot root(
+                        app.getDatabase(), app.getMetrics(),
+                        PARALLEL_APPLY_ENTRY_CACHE_SIZE,
+                        parseLedgerEntryCachePolicy(cfg.ENTRY_CACHE_POLICY),
+                        cfg.PREFETCH_BATCH_SIZE, false, nullptr
+#ifdef BEST_OFFER_DEBUGGING
+                        ,
+                        false
+#endif
+                    );
+                    {
+                        LedgerTxn ltx(root);
+                        ltx.loadHeader().current() = header;
+                        ltx.commit();
+                    }
+
+                    BucketPartitionApplicator applicator(
+                        root, maxProtocolVersion, buckets,
+                        [t](LedgerEntryType let) { return let == t; });
+                    size_t applied = 0;
+                    while (applicator && !state->mStop)
+                    {
+                        auto n = applicator.advance();
+                        applied += n;
+                        state->mAppliedEntries += n;
+                    }
+                    auto elapsed =
+                        std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::steady_clock::now() - start);
+                    CLOG_INFO(History,
+                              "ApplyBuckets : applied {} {} entries in {}ms",
+                              applied, name, elapsed.count());
+                }
+                catch (std::exception const& e)
+                {
+                    std::lock_guard<std::mutex> guard(state->mErrorMutex);
+                    if (state->mError.empty())
+                    {
+                        state->mError = fmt::format(
+                            FMT_STRING("applying {} entries: {}"), name,
+                            e.what());
+                    }
+                    state->mStop = true;
+                }
+                --state->mRunning;
+
+                app.postOnMainThread(
+                    [weak]() {
+                        auto self = weak.lock();
+                        if (self)
+                        {
+                            self->wakeUp();
+                        }
+                    },
+                    "ApplyBuckets: partition done");
+            },
+            "ApplyBuckets: apply " + name);
+    }
+}
+
+BasicWork::State
+ApplyBucketsWork::checkParallelApply()
+{
+    if (mParallelState->mRunning != 0)
+    {
+        return State::WORK_WAITING;
+    }
+
+    mAppliedEntries = mParallelState->mAppliedEntries;
+    {
+        std::lock_guard<std::mutex> guard(mParallelState->mErrorMutex);
+        if (!mParallelState->mError.empty())
+        {
+            CLOG_ERROR(History, "ApplyBuckets : failed {}",
+                       mParallelState->mError);
+            return State::WORK_FAILURE;
+        }
+    }
+
+    // The partitions wrote through their own connections, behind the back of
+    // the main LedgerTxnRoot.
+    mApp.getLedgerTxnRoot().clearCaches();
+    mApp.getCatchupManager().bucketsApplied(
+        static_cast<uint32_t>(mAppliedBuckets));
+
+    CLOG_INFO(History,
+              "ApplyBuckets : done, {} entries from {} buckets, restarting "
+              "merges",
+              mAppliedEntries, mAppliedBuckets);
+    mApp.getBucketManager().assumeState(mApplyState, mMaxProtocolVersion);
+
+    return State::WORK_SUCCESS;
+}
+
+bool
+ApplyBucketsWork::onAbort()
+{
+    if (mParallelState && mParallelState->mRunning != 0)
+    {
+        mParallelState->mStop = true;
+        return false;
+    }
+    return true;
+}
+
 bool
 ApplyBucketsWork::isLevelComplete()
 {
@@ -328,6 +562,12 @@ ApplyBucketsWork::isLevelComplete()
 std::string
 ApplyBucketsWork::getStatus() const
 {
+    if (mParallelState)
+    {
+        return fmt::format(
+            FMT_STRING("Applying buckets in parallel, {:d} entries applied"),
+            mParallelState->mAppliedEntries.load());
+    }
     auto size = mTotalSize == 0 ? 0 : (100 * mAppliedSize / mTotalSize);
     return fmt::format(
         FMT_STRING("Applying buckets {:d}%. Currently on level {:d}"), size,
@@ -40,6 +40,16 @@ class ApplyBucketsWork : public BasicWork
 
     BucketApplicator::Counters mCounters;
 
+    // State shared with the worker threads of the parallel mode (see
+    // Config::PARALLEL_BUCKET_APPLY), which may outlive this work.
+    struct ParallelApplyState;
+    std::shared_ptr<ParallelApplyState> mParallelState;
+
+    bool canApplyInParallel() const;
+    std::vector<std::shared_ptr<Bucket const>> getBucketsToApplyNewestFirst();
+    void startParallelApply();
+    BasicWork::State checkParallelApply();
+
     void advance(std::string const& name, BucketApplicator& applicator);
     std::shared_ptr<Bucket const> getBucket(std::string const& bucketHash);
     BucketLevel& getBucketLevel(uint32_t level);
@@ -47,6 +57,7 @@ class ApplyBucketsWork : public BasicWork
     bool isLevelComplete();
 
     bool mDelayChecked{false};
+    bool mApplyInParallel{false};
 
   public:
     ApplyBucketsWork(
@@ -65,10 +76,6 @@ class ApplyBucketsWork : public BasicWork
   protected:
     void onReset() override;
     BasicWork::State onRun() override;
-    bool
-    onAbort() override
-    {
-        return true;
-    };
+    bool onAbort() override;
 };
 }
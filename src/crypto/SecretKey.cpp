@@ -324,6 +324,14 @@ PubKeyUtils::flushVerifySigCacheCounts(uint64_t& hits, uint64_t& misses)
     gVerifyCacheMiss = 0;
 }
 
+void
+PubKeyUtils::seeVerifySigCacheCounts(uint64_t& hits, uint64_t& misses)
+{
+    std::lock_guard<std::mutex> guard(gVerifySigCacheMutex);
+    hits = gVerifyCacheHit;
+    misses = gVerifyCacheMiss;
+}
+
 std::string
 KeyFunctions<PublicKey>::getKeyTypeName()
 {
@@ -136,6 +136,8 @@ bool verifySig(PublicKey const& key, Signature const& signature,
 
 void clearVerifySigCache();
 void flushVerifySigCacheCounts(uint64_t& hits, uint64_t& misses);
+// Read the counts accumulated since the last flush without resetting them.
+void seeVerifySigCacheCounts(uint64_t& hits, uint64_t& misses);
 
 PublicKey random();
 #ifdef BUILD_TESTS
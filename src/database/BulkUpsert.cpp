@@ -0,0 +1,294 @@
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "database/BulkUpsert.h"
+#include "util/GlobalChecks.h"
+#include <Tracy.hpp>
+
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+namespace stellar
+{
+
+// SQLITE_MAX_VARIABLE_NUMBER defaults to 999 before SQLite 3.32.
+size_t const BulkUpsert::MAX_SQLITE_VARIABLES = 999;
+
+BulkUpsert::BulkUpsert(Database& db, std::string const& table,
+                       std::vector<std::string> const& keyColumns)
+    : mDB(db), mTable(table), mKeyColumns(keyColumns)
+{
+}
+
+void
+BulkUpsert::addColumn(std::string const& name, std::string const& pgType,
+                      Values values, size_t size,
+                      std::vector<soci::indicator> const* inds)
+{
+    releaseAssert(mColumns.empty() || size == mRows);
+    releaseAssert(!inds || inds->size() == size);
+    mRows = size;
+    mColumns.push_back(Column{name, pgType, values,
+                              inds ? *inds : std::vector<soci::indicator>()});
+}
+
+void
+BulkUpsert::addColumn(std::string const& name, std::string const& pgType,
+                      std::vector<std::string> const& values,
+                      std::vector<soci::indicator> const* inds)
+{
+    addColumn(name, pgType, &values, values.size(), inds);
+}
+
+void
+BulkUpsert::addColumn(std::string const& name, std::string const& pgType,
+                      std::vector<int64_t> const& values)
+{
+    addColumn(name, pgType, &values, values.size(), nullptr);
+}
+
+void
+BulkUpsert::addColumn(std::string const& name, std::string const& pgType,
+                      std::vector<int32_t> const& values)
+{
+    addColumn(name, pgType, &values, values.size(), nullptr);
+}
+
+void
+BulkUpsert::addColumn(std::string const& name, std::string const& pgType,
+                      std::vector<double> const& values)
+{
+    addColumn(name, pgType, &values, values.size(), nullptr);
+}
+
+std::string
+BulkUpsert::columnList() const
+{
+    std::string res;
+    for (auto const& col : mColumns)
+    {
+        res += (res.empty() ? "" : ", ") + col.mName;
+    }
+    return res;
+}
+
+std::string
+BulkUpsert::onConflictClause() const
+{
+    std::string keys, updates;
+    for (auto const& k : mKeyColumns)
+    {
+        keys += (keys.empty() ? "" : ", ") + k;
+    }
+    for (auto const& col : mColumns)
+    {
+        if (std::find(mKeyColumns.begin(), mKeyColumns.end(), col.mName) ==
+            mKeyColumns.end())
+        {
+            updates += (updates.empty() ? "" : ", ") + col.mName +
+                       " = excluded." + col.mName;
+        }
+    }
+    return " ON CONFLICT (" + keys + ") DO UPDATE SET " + updates;
+}
+
+std::string
+BulkUpsert::insertValuesSQL(size_t rows) const
+{
+    std::string sql = "INSERT INTO " + mTable + " (" + columnList() + ") VALUES ";
+    size_t var = 0;
+    for (size_t r = 0; r < rows; ++r)
+    {
+        sql += r == 0 ? "(" : ", (";
+        for (size_t c = 0; c < mColumns.size(); ++c)
+        {
+            sql += (c == 0 ? ":v" : ", :v") + std::to_string(var++);
+        }
+        sql += ")";
+    }
+    return sql + onConflictClause();
+}
+
+void
+BulkUpsert::bindRow(soci::statement& st, size_t row)
+{
+    for (auto& col : mColumns)
+    {
+        std::visit(
+            [&](auto values) {
+                if (col.mInds.empty())
+                {
+                    st.exchange(soci::use((*values)[row]));
+                }
+                else
+                {
+                    st.exchange(soci::use((*values)[row], col.mInds[row]));
+                }
+            },
+            col.mValues);
+    }
+}
+
+void
+BulkUpsert::executeSqlite()
+{
+    ZoneScoped;
+    releaseAssert(!mColumns.empty());
+    size_t const rowsPerStatement =
+        std::max<size_t>(1, MAX_SQLITE_VARIABLES / mColumns.size());
+
+    size_t written = 0;
+    for (size_t begin = 0; begin < mRows; begin += rowsPerStatement)
+    {
+        size_t n = std::min(rowsPerStatement, mRows - begin);
+        auto prep = mDB.getPreparedStatement(insertValuesSQL(n));
+        soci::statement& st = prep.statement();
+        for (size_t row = begin; row < begin + n; ++row)
+        {
+            bindRow(st, row);
+        }
+        st.define_and_bind();
+        st.execute(true);
+        written += static_cast<size_t>(st.get_affected_rows());
+    }
+    if (written != mRows)
+    {
+        throw std::runtime_error("Could not update data in SQL");
+    }
+}
+
+#ifdef USE_POSTGRES
+namespace
+{
+void
+appendCopyText(std::string& out, std::string const& s)
+{
+    for (char c : s)
+    {
+        switch (c)
+        {
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        default:
+            out += c;
+        }
+    }
+}
+
+template <typename T>
+void
+appendCopyText(std::string& out, T const& v)
+{
+    std::ostringstream oss;
+    // As in marshalToPGArrayItem: enough digits to round-trip doubles.
+    oss << std::setprecision(std::numeric_limits<T>::max_digits10) << v;
+    out += oss.str();
+}
+
+void
+checkResult(PGconn* conn, PGresult* res, ExecStatusType expected,
+            std::string const& what)
+{
+    bool ok = res && PQresultStatus(res) == expected;
+    PQclear(res);
+    if (!ok)
+    {
+        throw std::runtime_error(what + ": " + PQerrorMessage(conn));
+    }
+}
+}
+
+void
+BulkUpsert::executePostgres(PGconn* conn)
+{
+    ZoneScoped;
+    releaseAssert(!mColumns.empty());
+    std::string const tmpTable = "bulkupsert_" + mTable;
+
+    std::string columnDefs;
+    for (auto const& col : mColumns)
+    {
+        columnDefs +=
+            (columnDefs.empty() ? "" : ", ") + col.mName + " " + col.mPGType;
+    }
+    // The temporary table lives as long as the session, so it's only created
+    // by the first upsert into each table (or recreated after a rollback).
+    mDB.getSession() << "CREATE TEMP TABLE IF NOT EXISTS " << tmpTable << " ("
+                     << columnDefs << ")";
+    mDB.getSession() << "TRUNCATE " << tmpTable;
+
+    std::string data;
+    for (size_t row = 0; row < mRows; ++row)
+    {
+        for (size_t c = 0; c < mColumns.size(); ++c)
+        {
+            auto const& col = mColumns[c];
+            if (c != 0)
+            {
+                data += '\t';
+            }
+            if (!col.mInds.empty() && col.mInds[row] == soci::i_null)
+            {
+                data += "\\N";
+                continue;
+            }
+            std::visit([&](auto values) { appendCopyText(data, (*values)[row]); },
+                       col.mValues);
+        }
+        data += '\n';
+    }
+
+    std::string copy =
+        "COPY " + tmpTable + " (" + columnList() + ") FROM STDIN";
+    checkResult(conn, PQexec(conn, copy.c_str()), PGRES_COPY_IN,
+                "Could not start COPY");
+    size_t const CHUNK_SIZE = 1 << 20;
+    for (size_t pos = 0; pos < data.size(); pos += CHUNK_SIZE)
+    {
+        int len = static_cast<int>(std::min(CHUNK_SIZE, data.size() - pos));
+        if (PQputCopyData(conn, data.data() + pos, len) != 1)
+        {
+            throw std::runtime_error(std::string("Could not COPY data: ") +
+                                     PQerrorMessage(conn));
+        }
+    }
+    if (PQputCopyEnd(conn, nullptr) != 1)
+    {
+        throw std::runtime_error(std::string("Could not COPY data: ") +
+                                 PQerrorMessage(conn));
+    }
+    checkResult(conn, PQgetResult(conn), PGRES_COMMAND_OK,
+                "Could not COPY data");
+    // Drain the (NULL-terminated) result queue before using the connection
+    // again.
+    while (auto res = PQgetResult(conn))
+    {
+        PQclear(res);
+    }
+
+    auto prep = mDB.getPreparedStatement(
+        "INSERT INTO " + mTable + " (" + columnList() + ") SELECT " +
+        columnList() + " FROM " + tmpTable + onConflictClause());
+    soci::statement& st = prep.statement();
+    st.define_and_bind();
+    st.execute(true);
+    if (static_cast<size_t>(st.get_affected_rows()) != mRows)
+    {
+        throw std::runtime_error("Could not update data in SQL");
+    }
+}
+#endif
+}
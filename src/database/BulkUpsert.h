@@ -0,0 +1,89 @@
+#pragma once
+
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "database/Database.h"
+#include "database/DatabaseTypeSpecificOperation.h"
+
+#include <cstdint>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace stellar
+{
+
+// BulkUpsert inserts-or-updates many rows of one table without planning one
+// huge statement per batch:
+//
+//  - On postgres the rows are streamed, in COPY text format, into a temporary
+//    table shaped like the columns being written, and merged into the target
+//    table with a single INSERT ... SELECT ... ON CONFLICT.
+//
+//  - On SQLite the rows are bound MAX_SQLITE_VARIABLES at a time into a
+//    prepared multi-row INSERT ... ON CONFLICT, so that each statement step
+//    writes many rows.
+//
+// Columns are added in table order, each as a vector holding one value per
+// row (and optionally indicators marking NULL values); the vectors must
+// outlive the BulkUpsert. Every column not in `keyColumns` is overwritten on
+// conflict.
+class BulkUpsert
+{
+  public:
+    static size_t const MAX_SQLITE_VARIABLES;
+
+    BulkUpsert(Database& db, std::string const& table,
+               std::vector<std::string> const& keyColumns);
+
+    void addColumn(std::string const& name, std::string const& pgType,
+                   std::vector<std::string> const& values,
+                   std::vector<soci::indicator> const* inds = nullptr);
+    void addColumn(std::string const& name, std::string const& pgType,
+                   std::vector<int64_t> const& values);
+    void addColumn(std::string const& name, std::string const& pgType,
+                   std::vector<int32_t> const& values);
+    void addColumn(std::string const& name, std::string const& pgType,
+                   std::vector<double> const& values);
+
+    // Both throw if fewer rows than were added were written.
+    void executeSqlite();
+#ifdef USE_POSTGRES
+    void executePostgres(PGconn* conn);
+#endif
+
+  private:
+    typedef std::variant<std::vector<std::string> const*,
+                         std::vector<int64_t> const*,
+                         std::vector<int32_t> const*,
+                         std::vector<double> const*>
+        Values;
+
+    struct Column
+    {
+        std::string mName;
+        std::string mPGType;
+        Values mValues;
+        // Copied, since soci wants to bind them by non-const reference.
+        std::vector<soci::indicator> mInds;
+    };
+
+    Database& mDB;
+    std::string const mTable;
+    std::vector<std::string> const mKeyColumns;
+    std::vector<Column> mColumns;
+    size_t mRows{0};
+
+    void addColumn(std::string const& name, std::string const& pgType,
+                   Values values, size_t size,
+                   std::vector<soci::indicator> const* inds);
+    std::string columnList() const;
+    std::string onConflictClause() const;
+    // INSERT of `rows` rows of bound values.
+    std::string insertValuesSQL(size_t rows) const;
+    // Bind row `row` of every column to `st`.
+    void bindRow(soci::statement& st, size_t row);
+};
+}
@@ -61,6 +61,9 @@ using namespace std;
 
 bool Database::gDriversRegistered = false;
 
+// The WorkerSession, if any, held by the calling thread.
+static thread_local Database::WorkerSession* gWorkerSession = nullptr;
+
 // smallest schema version supported
 static unsigned long const MIN_SCHEMA_VERSION = 13;
 static unsigned long const SCHEMA_VERSION = 17;
@@ -364,6 +367,12 @@ Database::isSqlite() const
            std::string::npos;
 }
 
+bool
+Database::useFastBulkUpsert() const
+{
+    return mApp.getConfig().FAST_BULK_UPSERT;
+}
+
 std::string
 Database::getSimpleCollationClause() const
 {
@@ -383,17 +392,31 @@ Database::canUsePool() const
     return !(mApp.getConfig().DATABASE.value == ("sqlite3://:memory:"));
 }
 
+std::map<std::string, std::shared_ptr<soci::statement>>&
+Database::getStatementCache()
+{
+    if (gWorkerSession && &gWorkerSession->mDatabase == this)
+    {
+        return gWorkerSession->mStatements;
+    }
+    return mApp.threadIsLedgerClose() ? mLedgerCloseStatements : mStatements;
+}
+
 void
 Database::clearPreparedStatementCache()
 {
     // Flush all prepared statements; in sqlite they represent open cursors
     // and will conflict with any DROP TABLE commands issued below
-    for (auto st : mStatements)
+    auto& statements = getStatementCache();
+    for (auto st : statements)
     {
         st.second->clean_up(true);
     }
-    mStatements.clear();
-    mStatementsSize.set_count(mStatements.size());
+    statements.clear();
+    if (&statements == &mStatements)
+    {
+        mStatementsSize.set_count(mStatements.size());
+    }
 }
 
 void
@@ -450,9 +473,54 @@ Database::initialize()
     LOG_INFO(DEFAULT_LOG, "* ");
 }
 
+Database::WorkerSession::WorkerSession(Database& db) : mDatabase(db)
+{
+    auto const& c = db.mApp.getConfig().DATABASE;
+    releaseAssert(db.canUsePool());
+    releaseAssert(!gWorkerSession);
+    CLOG_DEBUG(Database, "Opening worker connection to: {}",
+               removePasswordFromConnectionString(c.value));
+    mSession.open(c.value);
+    DatabaseConfigureSessionOp op(mSession);
+    stellar::doDatabaseTypeSpecificOperation(mSession, op);
+    gWorkerSession = this;
+}
+
+Database::WorkerSession::~WorkerSession()
+{
+    releaseAssert(gWorkerSession == this);
+    gWorkerSession = nullptr;
+    for (auto& st : mStatements)
+    {
+        st.second->clean_up(true);
+    }
+    mStatements.clear();
+}
+
 soci::session&
 Database::getSession()
 {
+    if (gWorkerSession && &gWorkerSession->mDatabase == this)
+    {
+        return gWorkerSession->mSession;
+    }
+    if (mApp.threadIsLedgerClose())
+    {
+        if (!mLedgerCloseSession)
+        {
+            auto const& c = mApp.getConfig().DATABASE;
+            releaseAssert(canUsePool());
+            CLOG_INFO(Database, "Opening ledger close connection to: {}",
+                      removePasswordFromConnectionString(c.value));
+            mLedgerCloseSession = std::make_unique<soci::session>();
+            mLedgerCloseSession->open(c.value);
+            DatabaseConfigureSessionOp op(*mLedgerCloseSession);
+            stellar::doDatabaseTypeSpecificOperation(*mLedgerCloseSession,
+                                                     op);
+        }
+        return *mLedgerCloseSession;
+    }
+
     // global session can only be used from the main thread
     assertThreadIsMain();
     return mSession;
@@ -526,15 +594,19 @@ class SQLLogContext : NonCopyable
 StatementContext
 Database::getPreparedStatement(std::string const& query)
 {
-    auto i = mStatements.find(query);
+    auto& statements = getStatementCache();
+    auto i = statements.find(query);
     std::shared_ptr<soci::statement> p;
-    if (i == mStatements.end())
+    if (i == statements.end())
     {
-        p = std::make_shared<soci::statement>(mSession);
+        p = std::make_shared<soci::statement>(getSession());
         p->alloc();
         p->prepare(query);
-        mStatements.insert(std::make_pair(query, p));
-        mStatementsSize.set_count(mStatements.size());
+        statements.insert(std::make_pair(query, p));
+        if (&statements == &mStatements)
+        {
+            mStatementsSize.set_count(mStatements.size());
+        }
     }
     else
     {
@@ -80,6 +80,12 @@ class StatementContext : NonCopyable
  * pool will connect to the same target and only one connection will be made per
  * worker thread.
  *
+ * When ledgers are applied on the dedicated ledger-close thread, that thread
+ * gets its own read-write connection: getSession() and getPreparedStatement()
+ * return it, rather than the main connection, when called from there. A worker
+ * thread can likewise hold a Database::WorkerSession to write through a
+ * connection of its own for a while.
+ *
  * All database connections and transactions are set to snapshot isolation level
  * (SQL isolation level 'SERIALIZABLE' in Postgresql and Sqlite, neither of
  * which provide true serializability).
@@ -94,14 +100,43 @@ class Database : NonMovableOrCopyable
     std::map<std::string, std::shared_ptr<soci::statement>> mStatements;
     medida::Counter& mStatementsSize;
 
+    // Connection, and its prepared statements, used instead of the main one
+    // when called from the ledger-close thread (see
+    // Config::PARALLEL_LEDGER_APPLY). Opened on first use from that thread
+    // and never touched from any other.
+    std::unique_ptr<soci::session> mLedgerCloseSession;
+    std::map<std::string, std::shared_ptr<soci::statement>>
+        mLedgerCloseStatements;
+
     std::set<std::string> mEntityTypes;
 
     static bool gDriversRegistered;
     static void registerDrivers();
     void applySchemaUpgrade(unsigned long vers);
     void open();
+    std::map<std::string, std::shared_ptr<soci::statement>>&
+    getStatementCache();
 
   public:
+    // While a WorkerSession is alive, getSession() and getPreparedStatement()
+    // called from the thread that created it use a read-write connection
+    // opened for it alone, with its own prepared statement cache. This lets
+    // several worker threads write through their own LedgerTxnRoot at once
+    // (see ApplyBucketsWork). A thread holds at most one WorkerSession, and
+    // must destroy it on the thread that created it.
+    class WorkerSession : NonMovableOrCopyable
+    {
+        Database& mDatabase;
+        soci::session mSession;
+        std::map<std::string, std::shared_ptr<soci::statement>> mStatements;
+
+        friend class Database;
+
+      public:
+        explicit WorkerSession(Database& db);
+        ~WorkerSession();
+    };
+
     // Instantiate object and connect to app.getConfig().DATABASE;
     // if there is a connection error, this will throw.
     Database(Application& app);
@@ -142,6 +177,10 @@ class Database : NonMovableOrCopyable
     // Return true if the Database target is SQLite, otherwise false.
     bool isSqlite() const;
 
+    // Return true if bulk upserts of ledger entries should go through
+    // BulkUpsert (see Config::FAST_BULK_UPSERT).
+    bool useFastBulkUpsert() const;
+
     // Return an optional SQL COLLATION clause to use for text-typed columns in
     // this database, in order to ensure they're compared "simply" using
     // byte-value comparisons, i.e. in a non-language-sensitive fashion.  For
@@ -173,7 +212,9 @@ class Database : NonMovableOrCopyable
     // Check schema version and apply any upgrades if necessary.
     void upgradeToCurrentSchema();
 
-    // Access the underlying SOCI session object
+    // Access the underlying SOCI session object: the main connection, or the
+    // ledger-close connection when called from the ledger-close thread, or
+    // the calling thread's WorkerSession connection.
     soci::session& getSession();
 
     // Access the optional SOCI connection pool available for worker
@@ -208,7 +249,7 @@ template <typename T>
 T
 Database::doDatabaseTypeSpecificOperation(DatabaseTypeSpecificOperation<T>& op)
 {
-    return stellar::doDatabaseTypeSpecificOperation(mSession, op);
+    return stellar::doDatabaseTypeSpecificOperation(getSession(), op);
 }
 
 // Select a set of records using a client-defined query string, then map
@@ -108,6 +108,10 @@ class Herder
 
     virtual void lastClosedLedgerIncreased() = 0;
 
+    // Called once a ledger applied on the ledger close thread has been
+    // closed, to catch up on the work that was deferred while it was applied.
+    virtual void ledgerClosedInBackground() = 0;
+
     // Setup Herder's state to fully participate in consensus
     virtual void setTrackingSCPState(uint64_t index, StellarValue const& value,
                                      bool isTrackingNetwork) = 0;
@@ -118,6 +122,13 @@ class Herder
     // We are learning about a new transaction.
     virtual TransactionQueue::AddResult
     recvTransaction(TransactionFrameBasePtr tx) = 0;
+    // Like recvTransaction, but the TransactionQueue may check the transaction
+    // on the worker threads (see TransactionQueue::tryAddAsync). `onResult` is
+    // called with the result on the main thread, possibly before this
+    // returns.
+    virtual void recvTransactionAsync(
+        TransactionFrameBasePtr tx,
+        std::function<void(TransactionQueue::AddResult)> onResult) = 0;
     virtual void peerDoesntHave(stellar::MessageType type,
                                 uint256 const& itemID, Peer::pointer peer) = 0;
     virtual TxSetFramePtr getTxSet(Hash const& hash) = 0;
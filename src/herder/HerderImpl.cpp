@@ -50,6 +50,9 @@ namespace stellar
 constexpr uint32 const TRANSACTION_QUEUE_TIMEOUT_LEDGERS = 4;
 constexpr uint32 const TRANSACTION_QUEUE_BAN_LEDGERS = 10;
 constexpr uint32 const TRANSACTION_QUEUE_SIZE_MULTIPLIER = 2;
+// How many times triggerNextLedger refills a proposed tx set after trimming
+// invalid transactions out of it.
+constexpr uint32 const TX_SET_MAX_REFILLS = 4;
 
 std::unique_ptr<Herder>
 Herder::create(Application& app)
@@ -216,7 +219,14 @@ HerderImpl::newSlotExternalized(bool synchronous, StellarValue const& value)
     TxSetFramePtr externalizedSet = mPendingEnvelopes.getTxSet(value.txSetHash);
     if (externalizedSet)
     {
-        updateTransactionQueue(externalizedSet->mTransactions);
+        if (mLedgerManager.isApplying())
+        {
+            mAppliedDuringApply.emplace_back(externalizedSet->mTransactions);
+        }
+        else
+        {
+            updateTransactionQueue(externalizedSet->mTransactions);
+        }
     }
 
     // Evict slots that are outside of our ledger validity bracket
@@ -443,6 +453,23 @@ TransactionQueue::AddResult
 HerderImpl::recvTransaction(TransactionFrameBasePtr tx)
 {
     ZoneScoped;
+    if (mLedgerManager.isApplying())
+    {
+        // Held transactions are only checked (and possibly rejected) by
+        // tryAdd once the ledger closes, see ledgerClosedInBackground, so
+        // they can't be reported as pending yet: the submitter is told to
+        // try again, and will then get the queue's answer.
+        size_t maxHeld = TRANSACTION_QUEUE_SIZE_MULTIPLIER *
+                         mLedgerManager.getLastMaxTxSetSizeOps();
+        if (mReceivedDuringApplyHashes.count(tx->getFullHash()) == 0 &&
+            mReceivedDuringApply.size() < maxHeld)
+        {
+            mReceivedDuringApplyHashes.emplace(tx->getFullHash());
+            mReceivedDuringApply.emplace_back(tx);
+        }
+        return TransactionQueue::AddResult::ADD_STATUS_TRY_AGAIN_LATER;
+    }
+
     auto result = mTransactionQueue.tryAdd(tx);
     if (result == TransactionQueue::AddResult::ADD_STATUS_PENDING)
     {
@@ -453,6 +480,31 @@ HerderImpl::recvTransaction(TransactionFrameBasePtr tx)
     return result;
 }
 
+void
+HerderImpl::recvTransactionAsync(
+    TransactionFrameBasePtr tx,
+    std::function<void(TransactionQueue::AddResult)> onResult)
+{
+    ZoneScoped;
+    if (mLedgerManager.isApplying())
+    {
+        onResult(recvTransaction(tx));
+        return;
+    }
+
+    mTransactionQueue.tryAddAsync(
+        tx, [tx, onResult = std::move(onResult)](
+                TransactionQueue::AddResult result) {
+            if (result == TransactionQueue::AddResult::ADD_STATUS_PENDING)
+            {
+                CLOG_TRACE(Herder, "recv transaction {} for {}",
+                           hexAbbrev(tx->getFullHash()),
+                           KeyUtils::toShortString(tx->getSourceID()));
+            }
+            onResult(result);
+        });
+}
+
 bool
 HerderImpl::checkCloseTime(SCPEnvelope const& envelope, bool enforceRecent)
 {
@@ -779,6 +831,12 @@ void
 HerderImpl::processSCPQueueUpToIndex(uint64 slotIndex)
 {
     ZoneScoped;
+    // Values for the next slot can only be validated against the ledger that
+    // is being applied; the queue is processed again once it is closed.
+    if (mLedgerManager.isApplying())
+    {
+        return;
+    }
     while (true)
     {
         SCPEnvelopeWrapperPtr envW = mPendingEnvelopes.pop(slotIndex);
@@ -871,6 +929,30 @@ HerderImpl::lastClosedLedgerIncreased()
     setupTriggerNextLedger();
 }
 
+void
+HerderImpl::ledgerClosedInBackground()
+{
+    ZoneScoped;
+    releaseAssert(!mLedgerManager.isApplying());
+    auto applied = std::move(mAppliedDuringApply);
+    mAppliedDuringApply.clear();
+    for (auto const& txs : applied)
+    {
+        updateTransactionQueue(txs);
+    }
+
+    auto received = std::move(mReceivedDuringApply);
+    mReceivedDuringApply.clear();
+    mReceivedDuringApplyHashes.clear();
+    for (auto const& tx : received)
+    {
+        // the queue floods whatever it accepts
+        recvTransaction(tx);
+    }
+
+    safelyProcessSCPQueue(false);
+}
+
 void
 HerderImpl::setupTriggerNextLedger()
 {
@@ -1061,10 +1143,11 @@ HerderImpl::triggerNextLedger(uint32_t ledgerSeqToTrigger,
         return;
     }
 
-    // our first choice for this round's set is all the tx we have collected
-    // during last few ledger closes
+    // our first choice for this round's set is the best of the tx we have
+    // collected during last few ledger closes that fit in a ledger
     auto const& lcl = mLedgerManager.getLastClosedLedgerHeader();
-    auto proposedSet = mTransactionQueue.toTxSet(lcl);
+    auto const maxOps = mLedgerManager.getLastMaxTxSetSizeOps();
+    auto proposedSet = mTransactionQueue.toSurgePricedTxSet(lcl, maxOps);
 
     // We pick as next close time the current time unless it's before the last
     // close time. We don't know how much time it will take to reach consensus
@@ -1097,16 +1180,31 @@ HerderImpl::triggerNextLedger(uint32_t ledgerSeqToTrigger,
     upperBoundCloseTimeOffset = nextCloseTime - lcl.header.scpValue.closeTime;
     lowerBoundCloseTimeOffset = upperBoundCloseTimeOffset;
 
+    auto& validityCache = mHerderSCPDriver.getTxSetValidityCache();
     auto removed = proposedSet->trimInvalid(mApp, lowerBoundCloseTimeOffset,
-                                            upperBoundCloseTimeOffset);
+                                            upperBoundCloseTimeOffset,
+                                            &validityCache);
     mTransactionQueue.ban(removed);
+    // The invalid transactions took room that, now they're banned, can go to
+    // the next best ones in the queue, which may in turn be invalid. Stop
+    // refilling after a few rounds, so that a queue full of invalid
+    // transactions can't hold up nomination; the set is valid either way.
+    for (uint32 refills = 0; !removed.empty() && refills < TX_SET_MAX_REFILLS;
+         ++refills)
+    {
+        proposedSet = mTransactionQueue.toSurgePricedTxSet(lcl, maxOps);
+        removed = proposedSet->trimInvalid(mApp, lowerBoundCloseTimeOffset,
+                                           upperBoundCloseTimeOffset,
+                                           &validityCache);
+        mTransactionQueue.ban(removed);
+    }
 
     proposedSet->surgePricingFilter(mApp);
 
     // we not only check that the value is valid for consensus (offset=0) but
     // also that we performed the proper cleanup above
     if (!proposedSet->checkValid(mApp, lowerBoundCloseTimeOffset,
-                                 upperBoundCloseTimeOffset))
+                                 upperBoundCloseTimeOffset, &validityCache))
     {
         throw std::runtime_error("wanting to emit an invalid txSet");
     }
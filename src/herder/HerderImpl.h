@@ -11,6 +11,7 @@
 #include "herder/Upgrades.h"
 #include "util/Timer.h"
 #include "util/UnorderedMap.h"
+#include "util/UnorderedSet.h"
 #include "util/XDROperators.h"
 #include <deque>
 #include <memory>
@@ -74,6 +75,7 @@ class HerderImpl : public Herder
     void start() override;
 
     void lastClosedLedgerIncreased() override;
+    void ledgerClosedInBackground() override;
 
     SCP& getSCP();
     HerderSCPDriver&
@@ -95,6 +97,9 @@ class HerderImpl : public Herder
 
     TransactionQueue::AddResult
     recvTransaction(TransactionFrameBasePtr tx) override;
+    void recvTransactionAsync(
+        TransactionFrameBasePtr tx,
+        std::function<void(TransactionQueue::AddResult)> onResult) override;
 
     EnvelopeStatus recvSCPEnvelope(SCPEnvelope const& envelope) override;
 #ifdef BUILD_TESTS
@@ -203,6 +208,15 @@ class HerderImpl : public Herder
     void
     updateTransactionQueue(std::vector<TransactionFrameBasePtr> const& applied);
 
+    // While LedgerManager applies a ledger on the ledger close thread, the
+    // transaction queue can't be validated against the ledger: transaction
+    // sets that got externalized are kept here until the queue can be
+    // updated, and received transactions are held back (up to the size of
+    // the queue) and added once the ledger is closed.
+    std::vector<std::vector<TransactionFrameBasePtr>> mAppliedDuringApply;
+    std::vector<TransactionFrameBasePtr> mReceivedDuringApply;
+    UnorderedSet<Hash> mReceivedDuringApplyHashes;
+
     PendingEnvelopes mPendingEnvelopes;
     Upgrades mUpgrades;
     HerderSCPDriver mHerderSCPDriver;
@@ -33,6 +33,10 @@
 namespace stellar
 {
 
+// Tx sets and transactions TxSetValidityCache remembers the validity of.
+constexpr size_t TXSET_VALIDITY_CACHE_SIZE = 1000;
+constexpr size_t TX_VALIDITY_CACHE_SIZE = 100000;
+
 Hash
 HerderSCPDriver::getHashOf(std::vector<xdr::opaque_vec<>> const& vals) const
 {
@@ -60,6 +64,8 @@ HerderSCPDriver::SCPMetrics::SCPMetrics(Application& app)
           {"scp", "timing", "first-to-self-externalize-lag"}))
     , mSelfToOthersExternalizeLag(app.getMetrics().NewTimer(
           {"scp", "timing", "self-to-others-externalize-lag"}))
+    , mValidityCacheTimeSaved(app.getMetrics().NewTimer(
+          {"scp", "txset", "validity-cache-time-saved"}))
 {
 }
 
@@ -79,6 +85,8 @@ HerderSCPDriver::HerderSCPDriver(Application& app, HerderImpl& herder,
     , mPrepareTimeout{mApp.getMetrics().NewHistogram(
           {"scp", "timeout", "prepare"})}
     , mLedgerSeqNominating(0)
+    , mTxSetValidityCache(mApp, TXSET_VALIDITY_CACHE_SIZE,
+                          TX_VALIDITY_CACHE_SIZE)
 {
 }
 
@@ -191,7 +199,7 @@ HerderSCPDriver::checkCloseTime(uint64_t slotIndex, uint64_t lastCloseTime,
 
 SCPDriver::ValidationLevel
 HerderSCPDriver::validateValueHelper(uint64_t slotIndex, StellarValue const& b,
-                                     bool nomination) const
+                                     bool nomination)
 {
     uint64_t lastCloseTime;
     ZoneScoped;
@@ -314,7 +322,8 @@ HerderSCPDriver::validateValueHelper(uint64_t slotIndex, StellarValue const& b,
 
         res = SCPDriver::kInvalidValue;
     }
-    else if (!txSet->checkValid(mApp, closeTimeOffset, closeTimeOffset))
+    else if (!txSet->checkValid(mApp, closeTimeOffset, closeTimeOffset,
+                                &mTxSetValidityCache))
     {
         CLOG_DEBUG(Herder,
                    "HerderSCPDriver::validateValue i: {} invalid txSet {}",
@@ -328,6 +337,11 @@ HerderSCPDriver::validateValueHelper(uint64_t slotIndex, StellarValue const& b,
                    slotIndex, hexAbbrev(txSetHash));
         res = SCPDriver::kFullyValidatedValue;
     }
+    if (txSet)
+    {
+        mSCPExecutionTimes[slotIndex].mValidityCacheTimeSaved +=
+            mTxSetValidityCache.takeTimeSaved();
+    }
     return res;
 }
 
@@ -1025,6 +1039,8 @@ HerderSCPDriver::recordSCPExecutionMetrics(uint64_t slotIndex)
 
     mNominateTimeout.Update(SCPTiming.mNominationTimeoutCount);
     mPrepareTimeout.Update(SCPTiming.mPrepareTimeoutCount);
+    mSCPMetrics.mValidityCacheTimeSaved.Update(
+        SCPTiming.mValidityCacheTimeSaved);
 
     // Compute nomination time
     if (SCPTiming.mNominationStart && SCPTiming.mPrepareStart)
@@ -6,6 +6,7 @@
 
 #include "herder/Herder.h"
 #include "herder/TxSetFrame.h"
+#include "herder/TxSetValidityCache.h"
 #include "medida/timer.h"
 #include "scp/SCPDriver.h"
 #include "xdr/Stellar-ledger.h"
@@ -124,6 +125,12 @@ class HerderSCPDriver : public SCPDriver
 
     Json::Value getQsetLagInfo(bool summary, bool fullKeys);
 
+    TxSetValidityCache&
+    getTxSetValidityCache()
+    {
+        return mTxSetValidityCache;
+    }
+
   private:
     Application& mApp;
     HerderImpl& mHerder;
@@ -150,6 +157,9 @@ class HerderSCPDriver : public SCPDriver
         medida::Timer& mFirstToSelfExternalizeLag;
         medida::Timer& mSelfToOthersExternalizeLag;
 
+        // Time mTxSetValidityCache saved validating values, per slot
+        medida::Timer& mValidityCacheTimeSaved;
+
         SCPMetrics(Application& app);
     };
 
@@ -176,6 +186,9 @@ class HerderSCPDriver : public SCPDriver
         // externalize timing information
         std::optional<VirtualClock::time_point> mFirstExternalize;
         std::optional<VirtualClock::time_point> mSelfExternalize;
+
+        // Time mTxSetValidityCache saved validating values for the slot
+        std::chrono::nanoseconds mValidityCacheTimeSaved{0};
     };
 
     // Map of time points for each slot to measure key protocol metrics:
@@ -190,9 +203,11 @@ class HerderSCPDriver : public SCPDriver
     // indexed by slotIndex, timerID
     std::map<uint64_t, std::map<int, std::unique_ptr<VirtualTimer>>> mSCPTimers;
 
+    TxSetValidityCache mTxSetValidityCache;
+
     SCPDriver::ValidationLevel validateValueHelper(uint64_t slotIndex,
                                                    StellarValue const& sv,
-                                                   bool nomination) const;
+                                                   bool nomination);
 
     void logQuorumInformation(uint64_t index);
 
@@ -3,11 +3,16 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "herder/TransactionQueue.h"
+#include "bucket/BucketListSnapshot.h"
+#include "bucket/BucketManager.h"
+#include "crypto/Hex.h"
 #include "crypto/SecretKey.h"
+#include "herder/Herder.h"
 #include "herder/TxQueueLimiter.h"
 #include "ledger/LedgerHashUtils.h"
 #include "ledger/LedgerManager.h"
 #include "ledger/LedgerTxn.h"
+#include "ledger/SnapshotLedgerTxnRoot.h"
 #include "main/Application.h"
 #include "overlay/OverlayManager.h"
 #include "test/TxTests.h"
@@ -18,6 +23,7 @@
 #include "util/BitSet.h"
 #include "util/GlobalChecks.h"
 #include "util/HashOfHash.h"
+#include "util/Logging.h"
 #include "util/Math.h"
 #include "util/ProtocolVersion.h"
 #include "util/TarjanSCCCalculator.h"
@@ -50,6 +56,8 @@ TransactionQueue::TransactionQueue(Application& app, uint32 pendingDepth,
     : mApp(app)
     , mPendingDepth(pendingDepth)
     , mBannedTransactions(banDepth)
+    , mAccountHeads(HigherFeeRate{
+          rand_uniform<size_t>(0, std::numeric_limits<size_t>::max())})
     , mLedgerVersion(app.getLedgerManager()
                          .getLastClosedLedgerHeader()
                          .header.ledgerVersion)
@@ -61,10 +69,18 @@ TransactionQueue::TransactionQueue(Application& app, uint32 pendingDepth,
           app.getMetrics().NewCounter({"herder", "arb-tx", "dropped"}))
     , mTransactionsDelay(
           app.getMetrics().NewTimer({"herder", "pending-txs", "delay"}))
+    , mAdmissionRechecks(app.getMetrics().NewMeter(
+          {"herder", "pending-txs", "admission-recheck"}, "transaction"))
     , mBroadcastTimer(app)
 {
     mTxQueueLimiter = std::make_unique<TxQueueLimiter>(poolLedgerMultiplier,
                                                        app.getLedgerManager());
+    for (uint32_t i = 0; i < app.getConfig().TRANSACTION_QUEUE_ADMISSION_SHARDS;
+         ++i)
+    {
+        mAdmissionShards.emplace_back(std::make_shared<AdmissionShard>());
+        mAdmissionShards.back()->mQueue = this;
+    }
     for (uint32 i = 0; i < pendingDepth; i++)
     {
         mSizeByAge.emplace_back(&app.getMetrics().NewCounter(
@@ -80,7 +96,11 @@ TransactionQueue::TransactionQueue(Application& app, uint32 pendingDepth,
 
 TransactionQueue::~TransactionQueue()
 {
-    // empty destructor needed here due to the dependency on TxQueueLimiter
+    // Checks still running finish, but their results are dropped.
+    for (auto& shard : mAdmissionShards)
+    {
+        shard->mQueue = nullptr;
+    }
 }
 
 // returns true, if a transaction can be replaced by another
@@ -163,7 +183,8 @@ isDuplicateTx(TransactionFrameBasePtr oldTx, TransactionFrameBasePtr newTx)
 TransactionQueue::AddResult
 TransactionQueue::canAdd(TransactionFrameBasePtr tx,
                          AccountStates::iterator& stateIter,
-                         TimestampedTransactions::iterator& oldTxIter)
+                         TimestampedTransactions::iterator& oldTxIter,
+                         PreValidation const* preValidation)
 {
     ZoneScoped;
     if (isBanned(tx->getFullHash()))
@@ -249,29 +270,50 @@ TransactionQueue::canAdd(TransactionFrameBasePtr tx,
         return TransactionQueue::AddResult::ADD_STATUS_TRY_AGAIN_LATER;
     }
 
-    auto closeTime = mApp.getLedgerManager()
-                         .getLastClosedLedgerHeader()
-                         .header.scpValue.closeTime;
-
-    // Transaction queue performs read-only transactions to the database and
-    // there are no concurrent writers, so it is safe to not enclose all the SQL
-    // statements into one transaction here.
-    LedgerTxn ltx(mApp.getLedgerTxnRoot(), /* shouldUpdateLastModified */ true,
-                  TransactionMode::READ_ONLY_WITHOUT_SQL_TXN);
-    if (!tx->checkValid(ltx, seqNum, 0,
-                        getUpperBoundCloseTimeOffset(mApp, closeTime)))
+    auto const& lcl = mApp.getLedgerManager().getLastClosedLedgerHeader();
+    int64_t feeSourceBalance;
+    if (preValidation && preValidation->mLedgerSeq == lcl.header.ledgerSeq &&
+        preValidation->mSeqNum == seqNum)
     {
-        return TransactionQueue::AddResult::ADD_STATUS_ERROR;
+        // tryAddAsync already checked the transaction against this ledger,
+        // and with the same sequence number.
+        if (!preValidation->mValid)
+        {
+            tx->getResult() = preValidation->mResult;
+            return TransactionQueue::AddResult::ADD_STATUS_ERROR;
+        }
+        feeSourceBalance = preValidation->mFeeSourceBalance;
+    }
+    else
+    {
+        if (preValidation)
+        {
+            mAdmissionRechecks.Mark();
+        }
+        auto closeTime = lcl.header.scpValue.closeTime;
+
+        // Transaction queue performs read-only transactions to the database
+        // and there are no concurrent writers, so it is safe to not enclose
+        // all the SQL statements into one transaction here.
+        LedgerTxn ltx(mApp.getLedgerTxnRoot(),
+                      /* shouldUpdateLastModified */ true,
+                      TransactionMode::READ_ONLY_WITHOUT_SQL_TXN);
+        if (!tx->checkValid(ltx, seqNum, 0,
+                            getUpperBoundCloseTimeOffset(mApp, closeTime)))
+        {
+            return TransactionQueue::AddResult::ADD_STATUS_ERROR;
+        }
+        auto feeSource = stellar::loadAccount(ltx, tx->getFeeSourceID());
+        feeSourceBalance = getAvailableBalance(ltx.loadHeader(), feeSource);
     }
 
     // Note: stateIter corresponds to getSourceID() which is not necessarily
     // the same as getFeeSourceID()
-    auto feeSource = stellar::loadAccount(ltx, tx->getFeeSourceID());
     auto feeStateIter = mAccountStates.find(tx->getFeeSourceID());
     int64_t totalFees = feeStateIter == mAccountStates.end()
                             ? 0
                             : feeStateIter->second.mTotalFees;
-    if (getAvailableBalance(ltx.loadHeader(), feeSource) - netFee < totalFees)
+    if (feeSourceBalance - netFee < totalFees)
     {
         tx->getResult().result.code(txINSUFFICIENT_BALANCE);
         return TransactionQueue::AddResult::ADD_STATUS_ERROR;
@@ -297,6 +339,31 @@ TransactionQueue::releaseFeeMaybeEraseAccountState(TransactionFrameBasePtr tx)
     }
 }
 
+bool
+TransactionQueue::HigherFeeRate::operator()(
+    TransactionFrameBasePtr const& l, TransactionFrameBasePtr const& r) const
+{
+    return lessThanXored(r, l, mSeed);
+}
+
+void
+TransactionQueue::forgetAccountHead(AccountState const& as)
+{
+    if (!as.mTransactions.empty())
+    {
+        mAccountHeads.erase(as.mTransactions.front().mTx);
+    }
+}
+
+void
+TransactionQueue::noteAccountHead(AccountState const& as)
+{
+    if (!as.mTransactions.empty())
+    {
+        mAccountHeads.emplace(as.mTransactions.front().mTx);
+    }
+}
+
 void
 TransactionQueue::prepareDropTransaction(AccountState& as, TimestampedTx& tstx)
 {
@@ -421,11 +488,18 @@ TransactionQueue::findAllAssetPairsInvolvedInPaymentLoops(
 
 TransactionQueue::AddResult
 TransactionQueue::tryAdd(TransactionFrameBasePtr tx)
+{
+    return tryAdd(tx, nullptr);
+}
+
+TransactionQueue::AddResult
+TransactionQueue::tryAdd(TransactionFrameBasePtr tx,
+                         PreValidation const* preValidation)
 {
     ZoneScoped;
     AccountStates::iterator stateIter;
     TimestampedTransactions::iterator oldTxIter;
-    auto const res = canAdd(tx, stateIter, oldTxIter);
+    auto const res = canAdd(tx, stateIter, oldTxIter, preValidation);
     if (res != TransactionQueue::AddResult::ADD_STATUS_PENDING)
     {
         return res;
@@ -438,6 +512,7 @@ TransactionQueue::tryAdd(TransactionFrameBasePtr tx)
         oldTxIter = stateIter->second.mTransactions.end();
     }
 
+    forgetAccountHead(stateIter->second);
     if (oldTxIter != stateIter->second.mTransactions.end())
     {
         prepareDropTransaction(stateIter->second, *oldTxIter);
@@ -450,6 +525,7 @@ TransactionQueue::tryAdd(TransactionFrameBasePtr tx)
         oldTxIter = --stateIter->second.mTransactions.end();
         mSizeByAge[stateIter->second.mAge]->inc();
     }
+    noteAccountHead(stateIter->second);
     auto ops = tx->getNumOperations();
     stateIter->second.mQueueSizeOps += ops;
     stateIter->second.mBroadcastQueueOps += ops;
@@ -473,6 +549,202 @@ TransactionQueue::tryAdd(TransactionFrameBasePtr tx)
     return res;
 }
 
+void
+TransactionQueue::tryAddAsync(TransactionFrameBasePtr tx,
+                              std::function<void(AddResult)> onResult)
+{
+    ZoneScoped;
+    std::shared_ptr<BucketListSnapshot const> snapshot;
+    if (!mAdmissionShards.empty())
+    {
+        snapshot = mApp.getBucketManager().getBucketListSnapshot();
+    }
+    auto const& lcl =
+        mApp.getLedgerManager().getLastClosedLedgerHeader().header;
+    bool canCheckOffMain =
+        snapshot && snapshot->getLedgerSeq() == lcl.ledgerSeq;
+#ifdef BUILD_TESTS
+    canCheckOffMain = canCheckOffMain && !mNoAdmissionSnapshotForTesting;
+#endif
+
+    // Transactions that are going to be turned away before anything is
+    // loaded aren't worth a trip to the worker threads. Otherwise, while
+    // transactions from the same account are being checked, this one has to
+    // queue up behind them even if it can't be checked off the main thread,
+    // or it would get ahead of them.
+    auto const& source = tx->getSourceID();
+    if (isBanned(tx->getFullHash()) || isFiltered(tx) ||
+        (!canCheckOffMain &&
+         mAdmissionsInFlight.find(source) == mAdmissionsInFlight.end()))
+    {
+        onResult(tryAdd(tx));
+        return;
+    }
+
+    if (canCheckOffMain &&
+        (!mAdmissionRoot ||
+         mAdmissionRoot->getHeader().ledgerSeq != lcl.ledgerSeq))
+    {
+        mAdmissionRoot = std::make_shared<SnapshotLedgerTxnRoot>(
+            snapshot, lcl
+#ifdef BEST_OFFER_DEBUGGING
+            ,
+            mApp.getConfig().BEST_OFFER_DEBUGGING_ENABLED
+#endif
+        );
+    }
+
+    // Work out the sequence number canAdd is going to check the transaction
+    // with, assuming the transactions from the same account already being
+    // checked all get in. If they don't, canAdd notices that the sequence
+    // number differs and checks the transaction again.
+    bool isFeeBump = tx->getEnvelope().type() == ENVELOPE_TYPE_TX_FEE_BUMP;
+    auto& inFlight = mAdmissionsInFlight[source];
+    int64_t seqNum = 0;
+    auto stateIter = mAccountStates.find(source);
+    if (stateIter != mAccountStates.end() &&
+        !stateIter->second.mTransactions.empty())
+    {
+        seqNum = isFeeBump
+                     ? tx->getSeqNum() - 1
+                     : stateIter->second.mTransactions.back().mTx->getSeqNum();
+    }
+    if (!isFeeBump && inFlight.mLastSeqNum != 0)
+    {
+        seqNum = inFlight.mLastSeqNum;
+    }
+    ++inFlight.mCount;
+    if (!isFeeBump)
+    {
+        inFlight.mLastSeqNum = tx->getSeqNum();
+    }
+
+    PendingAdmission pending;
+    pending.mTx = tx;
+    pending.mOnResult = std::move(onResult);
+    if (canCheckOffMain)
+    {
+        pending.mRoot = mAdmissionRoot;
+    }
+    pending.mSeqNum = seqNum;
+    pending.mUpperBoundCloseTimeOffset =
+        getUpperBoundCloseTimeOffset(mApp, lcl.scpValue.closeTime);
+
+    auto const& shard =
+        mAdmissionShards[std::hash<AccountID>()(source) %
+                         mAdmissionShards.size()];
+    bool start;
+    {
+        std::lock_guard<std::mutex> guard(shard->mMutex);
+        shard->mPending.emplace_back(std::move(pending));
+        start = !shard->mRunning;
+        shard->mRunning = true;
+    }
+    if (start)
+    {
+        mApp.postOnBackgroundThread(
+            [shard, &app = mApp]() { checkAdmissions(shard, app); },
+            "TransactionQueue: check admissions");
+    }
+}
+
+void
+TransactionQueue::checkAdmissions(std::shared_ptr<AdmissionShard> shard,
+                                  Application& app)
+{
+    ZoneScoped;
+    while (true)
+    {
+        PendingAdmission pending;
+        {
+            std::lock_guard<std::mutex> guard(shard->mMutex);
+            if (shard->mPending.empty())
+            {
+                shard->mRunning = false;
+                return;
+            }
+            pending = std::move(shard->mPending.front());
+            shard->mPending.pop_front();
+        }
+
+        // The same checks as canAdd makes against LedgerTxnRoot, on a copy
+        // of the transaction since checkValid writes to it. If they can't be
+        // made here, the main thread makes them.
+        try
+        {
+            if (pending.mRoot)
+            {
+                auto tx = TransactionFrameBase::makeTransactionFromWire(
+                    app.getNetworkID(), pending.mTx->getEnvelope());
+                LedgerTxn ltx(*pending.mRoot,
+                              /* shouldUpdateLastModified */ true,
+                              TransactionMode::READ_ONLY_WITHOUT_SQL_TXN);
+                PreValidation pre;
+                pre.mLedgerSeq = ltx.loadHeader().current().ledgerSeq;
+                pre.mSeqNum = pending.mSeqNum;
+                pre.mValid = tx->checkValid(ltx, pending.mSeqNum, 0,
+                                            pending.mUpperBoundCloseTimeOffset);
+                if (pre.mValid)
+                {
+                    auto feeSource =
+                        stellar::loadAccount(ltx, tx->getFeeSourceID());
+                    pre.mFeeSourceBalance =
+                        getAvailableBalance(ltx.loadHeader(), feeSource);
+                }
+                else
+                {
+                    pre.mResult = tx->getResult();
+                }
+                pending.mPreValidation = std::make_optional(std::move(pre));
+            }
+        }
+        catch (std::exception const& e)
+        {
+            CLOG_DEBUG(Herder, "Could not check transaction {} off main: {}",
+                       hexAbbrev(pending.mTx->getFullHash()), e.what());
+        }
+        pending.mRoot.reset();
+
+        std::weak_ptr<AdmissionShard> weakShard = shard;
+        app.postOnMainThread(
+            [weakShard, pending = std::move(pending)]() mutable {
+                auto s = weakShard.lock();
+                if (s && s->mQueue)
+                {
+                    s->mQueue->finishAdmission(pending);
+                }
+            },
+            "TransactionQueue: admit");
+    }
+}
+
+void
+TransactionQueue::finishAdmission(PendingAdmission& pending)
+{
+    ZoneScoped;
+    auto inFlight = mAdmissionsInFlight.find(pending.mTx->getSourceID());
+    releaseAssert(inFlight != mAdmissionsInFlight.end());
+    if (--inFlight->second.mCount == 0)
+    {
+        mAdmissionsInFlight.erase(inFlight);
+    }
+
+    AddResult res;
+    if (mApp.getLedgerManager().isApplying())
+    {
+        // The ledger close thread owns the ledger; the herder holds on to
+        // transactions received meanwhile and adds them once it's done.
+        res = mApp.getHerder().recvTransaction(pending.mTx);
+    }
+    else
+    {
+        res = tryAdd(pending.mTx, pending.mPreValidation
+                                      ? &*pending.mPreValidation
+                                      : nullptr);
+    }
+    pending.mOnResult(res);
+}
+
 void
 TransactionQueue::dropTransactions(AccountStates::iterator stateIter,
                                    TimestampedTransactions::iterator begin,
@@ -489,7 +761,9 @@ TransactionQueue::dropTransactions(AccountStates::iterator stateIter,
     }
 
     // Actually erase the transactions to be dropped.
+    forgetAccountHead(stateIter->second);
     stateIter->second.mTransactions.erase(begin, end);
+    noteAccountHead(stateIter->second);
 
     // If the queue for stateIter is now empty, then (1) erase it if it is not
     // the fee-source for some other transaction or (2) reset the age otherwise.
@@ -727,6 +1001,7 @@ TransactionQueue::shift()
             }
             mBannedTransactionsCounter.inc(
                 static_cast<int64_t>(it->second.mTransactions.size()));
+            forgetAccountHead(it->second);
             it->second.mTransactions.clear();
             if (it->second.mTotalFees == 0)
             {
@@ -801,10 +1076,101 @@ TransactionQueue::toTxSet(LedgerHeaderHistoryEntry const& lcl) const
     return result;
 }
 
+std::shared_ptr<TxSetFrame>
+TransactionQueue::toSurgePricedTxSet(LedgerHeaderHistoryEntry const& lcl,
+                                     size_t maxOps) const
+{
+    ZoneScoped;
+    auto result = std::make_shared<TxSetFrame>(lcl.hash);
+
+    uint32_t const nextLedgerSeq = lcl.header.ledgerSeq + 1;
+    int64_t const startingSeq = getStartingSequenceNumber(nextLedgerSeq);
+    bool const maxIsOps = protocolVersionStartsFrom(lcl.header.ledgerVersion,
+                                                    ProtocolVersion::V_11);
+
+    // The next transaction to consider from an account, once the ones before
+    // it are in the set.
+    struct NextTx
+    {
+        TimestampedTransactions const* mTransactions;
+        size_t mIndex;
+    };
+    auto txOf = [](NextTx const& n) -> TransactionFrameBasePtr const& {
+        return (*n.mTransactions)[n.mIndex].mTx;
+    };
+    auto const higherFeeRate = mAccountHeads.key_comp();
+    auto worseNextTx = [&](NextTx const& l, NextTx const& r) {
+        return higherFeeRate(txOf(r), txOf(l));
+    };
+
+    // Accounts are picked off mAccountHeads best first; once an account's
+    // head is in the set, its next transaction competes from `nextTxs`.
+    auto headIter = mAccountHeads.begin();
+    std::vector<NextTx> nextTxs;
+    size_t opsLeft = maxOps;
+    bool surgePricing = false;
+    while (headIter != mAccountHeads.end() || !nextTxs.empty())
+    {
+        if (opsLeft == 0)
+        {
+            surgePricing = true;
+            break;
+        }
+
+        NextTx cur;
+        if (headIter != mAccountHeads.end() &&
+            (nextTxs.empty() ||
+             higherFeeRate(*headIter, txOf(nextTxs.front()))))
+        {
+            auto stateIter = mAccountStates.find((*headIter)->getSourceID());
+            releaseAssert(stateIter != mAccountStates.end());
+            cur = {&stateIter->second.mTransactions, 0};
+            ++headIter;
+        }
+        else
+        {
+            std::pop_heap(nextTxs.begin(), nextTxs.end(), worseNextTx);
+            cur = nextTxs.back();
+            nextTxs.pop_back();
+        }
+
+        auto const& tx = txOf(cur);
+        // See toTxSet: the account has no more transactions for this set.
+        if (tx->getSeqNum() == startingSeq)
+        {
+            continue;
+        }
+        size_t opsCount = maxIsOps ? tx->getNumOperations() : MAX_OPS_PER_TX;
+        if (opsCount > opsLeft)
+        {
+            // Like surgePricingFilter, skip the rest of the account too.
+            surgePricing = true;
+            continue;
+        }
+        result->add(tx);
+        opsLeft -= opsCount;
+        if (++cur.mIndex < cur.mTransactions->size())
+        {
+            nextTxs.emplace_back(cur);
+            std::push_heap(nextTxs.begin(), nextTxs.end(), worseNextTx);
+        }
+    }
+
+    if (surgePricing)
+    {
+        CLOG_WARNING(Herder,
+                     "surge pricing in effect! queue doesn't fit in {} "
+                     "operations",
+                     maxOps);
+    }
+    return result;
+}
+
 void
 TransactionQueue::clearAll()
 {
     mAccountStates.clear();
+    mAccountHeads.clear();
     for (auto& b : mBannedTransactions)
     {
         b.clear();
@@ -17,12 +17,17 @@
 #include "util/UnorderedSet.h"
 #include <chrono>
 #include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <vector>
 
 namespace medida
 {
 class Counter;
+class Meter;
 class Timer;
 }
 
@@ -30,6 +35,7 @@ namespace stellar
 {
 
 class Application;
+class SnapshotLedgerTxnRoot;
 class TxQueueLimiter;
 
 /**
@@ -41,8 +47,9 @@ class TxQueueLimiter;
  * This invariant is maintained by releaseFeeMaybeEraseAccountState.
  *
  * Transactions received from the HTTP "tx" endpoint and the overlay network
- * should be added by calling tryAdd. If that succeeds, the transaction may be
- * removed later in three ways:
+ * should be added by calling tryAdd, or tryAddAsync to check them on the
+ * worker threads first. If that succeeds, the transaction may be removed later
+ * in three ways:
  * - removeApplied() should be called after transactions are applied. It removes
  *   the specified transactions, but leaves transactions with subsequent
  *   sequence numbers in the TransactionQueue. It also resets the age for the
@@ -126,6 +133,28 @@ class TransactionQueue
     findAllAssetPairsInvolvedInPaymentLoops(TransactionFrameBasePtr tx);
 
     AddResult tryAdd(TransactionFrameBasePtr tx);
+
+    /**
+     * Like tryAdd, but the expensive part of the checks -- signatures and
+     * everything that loads ledger entries -- runs on a worker thread against
+     * a snapshot of the last closed ledger, and only the final insertion on
+     * the main thread. Transactions are spread over
+     * TRANSACTION_QUEUE_ADMISSION_SHARDS shards by source account, and each
+     * shard checks its transactions one at a time in the order they came, so
+     * transactions from one account are inserted in that order. A check that
+     * turns out to have assumed the wrong ledger or sequence number (because
+     * a ledger closed, or an earlier transaction from the account was
+     * rejected) is redone on the main thread, so the result is always the
+     * one tryAdd would give at the time of insertion.
+     *
+     * `onResult` is called with the result on the main thread, before this
+     * returns if the transaction is checked synchronously: when sharded
+     * admission is disabled, there's no snapshot of the last closed ledger
+     * (and nothing from the same account is being checked), or the
+     * transaction is rejected by the cheap checks up front.
+     */
+    void tryAddAsync(TransactionFrameBasePtr tx,
+                     std::function<void(AddResult)> onResult);
     void removeApplied(Transactions const& txs);
     void ban(Transactions const& txs);
 
@@ -145,6 +174,18 @@ class TransactionQueue
     std::shared_ptr<TxSetFrame>
     toTxSet(LedgerHeaderHistoryEntry const& lcl) const;
 
+    /**
+     * Like toTxSet, but takes only the transactions surgePricingFilter would
+     * keep with `maxOps` operations to fill (as counted by
+     * LedgerManager::getLastMaxTxSetSizeOps): the best by fee rate among the
+     * next transactions of each account. The transactions are picked off
+     * mAccountHeads, so this costs O(k log k) for k transactions picked
+     * rather than O(n log n) over the whole queue.
+     */
+    std::shared_ptr<TxSetFrame>
+    toSurgePricedTxSet(LedgerHeaderHistoryEntry const& lcl,
+                       size_t maxOps) const;
+
     struct ReplacedTransaction
     {
         TransactionFrameBasePtr mOld;
@@ -173,11 +214,29 @@ class TransactionQueue
      */
     using BannedTransactions = std::deque<UnorderedSet<Hash>>;
 
+    /**
+     * Orders transactions by decreasing fee rate, breaking ties with a
+     * random seed picked when the TransactionQueue is created (so the order
+     * of a set of transactions never changes while they're queued).
+     */
+    struct HigherFeeRate
+    {
+        size_t mSeed;
+        bool operator()(TransactionFrameBasePtr const& l,
+                        TransactionFrameBasePtr const& r) const;
+    };
+    using AccountHeads = std::set<TransactionFrameBasePtr, HigherFeeRate>;
+
     Application& mApp;
     uint32 const mPendingDepth;
 
     AccountStates mAccountStates;
     BannedTransactions mBannedTransactions;
+    // The first transaction of every account with transactions in
+    // mAccountStates, best first. Kept up to date by
+    // forgetAccountHead/noteAccountHead around every change to the front of
+    // an AccountState's mTransactions.
+    AccountHeads mAccountHeads;
     uint32_t mLedgerVersion;
 
     // counters
@@ -186,6 +245,7 @@ class TransactionQueue
     medida::Counter& mArbTxSeenCounter;
     medida::Counter& mArbTxDroppedCounter;
     medida::Timer& mTransactionsDelay;
+    medida::Meter& mAdmissionRechecks;
 
     UnorderedSet<OperationType> mFilteredTypes;
 
@@ -206,12 +266,78 @@ class TransactionQueue
     };
     BroadcastStatus broadcastTx(AccountState& state, TimestampedTx& tx);
 
+    // The outcome of the ledger-dependent part of canAdd, computed on a
+    // worker thread for ledger `mLedgerSeq`, passing `mSeqNum` to checkValid.
+    // `mFeeSourceBalance` is the available balance of the fee source, if the
+    // transaction is valid, and `mResult` what checkValid left in the
+    // transaction's result otherwise. The worker checks a copy of the
+    // transaction, so that the one handed to tryAddAsync is only ever
+    // touched on the main thread.
+    struct PreValidation
+    {
+        uint32_t mLedgerSeq{0};
+        int64_t mSeqNum{0};
+        bool mValid{false};
+        int64_t mFeeSourceBalance{0};
+        TransactionResult mResult;
+    };
+
+    // A transaction waiting for, or done with, its check in tryAddAsync.
+    // Without `mRoot`, the worker leaves the whole check to the main thread;
+    // the transaction still waits its turn behind the ones from the same
+    // account.
+    struct PendingAdmission
+    {
+        TransactionFrameBasePtr mTx;
+        std::function<void(AddResult)> mOnResult;
+        std::shared_ptr<SnapshotLedgerTxnRoot> mRoot;
+        int64_t mSeqNum{0};
+        uint64_t mUpperBoundCloseTimeOffset{0};
+        std::optional<PreValidation> mPreValidation;
+    };
+
+    // One shard of tryAddAsync: the transactions queued for checking, and
+    // whether a worker is checking them. Shared with the worker, which can
+    // outlive the TransactionQueue; mQueue is cleared (on the main thread)
+    // when the queue goes away.
+    struct AdmissionShard
+    {
+        TransactionQueue* mQueue{nullptr};
+        std::mutex mMutex;
+        std::deque<PendingAdmission> mPending;
+        bool mRunning{false};
+    };
+
+    // The transactions from each source account in tryAddAsync, and the
+    // sequence number of the last of them that's not a fee bump, so that a
+    // transaction can be checked assuming the ones before it get in.
+    struct AdmissionsInFlight
+    {
+        size_t mCount{0};
+        int64_t mLastSeqNum{0};
+    };
+
+    std::vector<std::shared_ptr<AdmissionShard>> mAdmissionShards;
+    UnorderedMap<AccountID, AdmissionsInFlight> mAdmissionsInFlight;
+    // Root to check transactions against, replaced when a ledger closes.
+    std::shared_ptr<SnapshotLedgerTxnRoot> mAdmissionRoot;
+
+    static void checkAdmissions(std::shared_ptr<AdmissionShard> shard,
+                                Application& app);
+    void finishAdmission(PendingAdmission& pending);
+
+    AddResult tryAdd(TransactionFrameBasePtr tx,
+                     PreValidation const* preValidation);
     AddResult canAdd(TransactionFrameBasePtr tx,
                      AccountStates::iterator& stateIter,
-                     TimestampedTransactions::iterator& oldTxIter);
+                     TimestampedTransactions::iterator& oldTxIter,
+                     PreValidation const* preValidation);
 
     void releaseFeeMaybeEraseAccountState(TransactionFrameBasePtr tx);
 
+    void forgetAccountHead(AccountState const& as);
+    void noteAccountHead(AccountState const& as);
+
     void prepareDropTransaction(AccountState& as, TimestampedTx& tstx);
     void dropTransactions(AccountStates::iterator stateIter,
                           TimestampedTransactions::iterator begin,
@@ -232,6 +358,9 @@ class TransactionQueue
   public:
     size_t getQueueSizeOps() const;
     std::function<void(TransactionFrameBasePtr&)> mTxBroadcastedEvent;
+    // Makes tryAddAsync behave as if there was no snapshot of the last
+    // closed ledger to check transactions against.
+    bool mNoAdmissionSnapshotForTesting{false};
 #endif
 };
 
@@ -4,17 +4,23 @@
 
 #include "util/asio.h"
 #include "TxSetFrame.h"
+#include "bucket/BucketListSnapshot.h"
+#include "bucket/BucketManager.h"
 #include "crypto/Hex.h"
 #include "crypto/Random.h"
 #include "crypto/SHA.h"
 #include "database/Database.h"
 #include "herder/SurgePricingUtils.h"
+#include "herder/TxSetValidityCache.h"
 #include "ledger/LedgerManager.h"
 #include "ledger/LedgerTxn.h"
 #include "ledger/LedgerTxnEntry.h"
 #include "ledger/LedgerTxnHeader.h"
+#include "ledger/SnapshotLedgerTxnRoot.h"
 #include "main/Application.h"
 #include "main/Config.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
 #include "transactions/TransactionUtils.h"
 #include "util/GlobalChecks.h"
 #include "util/Logging.h"
@@ -25,7 +31,11 @@
 
 #include <Tracy.hpp>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <list>
+#include <mutex>
 #include <numeric>
 
 namespace stellar
@@ -279,26 +289,298 @@ TxSetFrame::surgePricingFilter(Application& app)
     }
 }
 
+namespace
+{
+// Checks the transactions of a tx set account by account against a snapshot
+// of the last closed ledger, on the worker threads as well as on the calling
+// thread (see SignaturePreVerifier, whose start/finish protocol this
+// follows). Transactions from different source accounts don't depend on each
+// other, so every account is checked the way checkOrTrim's loop would check
+// it, and checkOrTrim takes each outcome as long as it was reached with the
+// same sequence number it is going to check the transaction with.
+class ParallelAccountChecker
+    : public std::enable_shared_from_this<ParallelAccountChecker>
+{
+  public:
+    struct Check
+    {
+        bool mDone{false};
+        bool mValid{false};
+        // Known valid from the TxSetValidityCache rather than checked here.
+        bool mFromCache{false};
+        int64_t mLastSeq{0};
+        std::chrono::nanoseconds mTime{0};
+    };
+
+    struct Account
+    {
+        std::deque<TransactionFrameBasePtr> const* mTxs;
+        // mChecks[i] is the outcome for (*mTxs)[i]; checking starts at
+        // mFirst, with mLastSeq, past the transactions known to be valid.
+        std::vector<Check> mChecks;
+        size_t mFirst{0};
+        int64_t mLastSeq{0};
+    };
+
+  private:
+    std::shared_ptr<SnapshotLedgerTxnRoot> const mRoot;
+    bool const mJustCheck;
+    uint64_t const mLowerBoundCloseTimeOffset;
+    uint64_t const mUpperBoundCloseTimeOffset;
+    std::vector<Account> mAccounts;
+
+    std::atomic<size_t> mNextAccount{0};
+    std::atomic<size_t> mDoneAccounts{0};
+    std::atomic<size_t> mChecked{0};
+    std::mutex mDoneMutex;
+    std::condition_variable mDoneCV;
+
+    void
+    checkAccount(Account& account)
+    {
+        LedgerTxn ltx(*mRoot, true, TransactionMode::READ_ONLY_WITHOUT_SQL_TXN);
+        int64_t lastSeq = account.mLastSeq;
+        try
+        {
+            for (size_t i = account.mFirst; i < account.mTxs->size(); ++i)
+            {
+                auto const& tx = (*account.mTxs)[i];
+                auto& check = account.mChecks[i];
+                auto start = std::chrono::steady_clock::now();
+                check.mValid =
+                    tx->checkValid(ltx, lastSeq, mLowerBoundCloseTimeOffset,
+                                   mUpperBoundCloseTimeOffset);
+                check.mTime = std::chrono::steady_clock::now() - start;
+                check.mLastSeq = lastSeq;
+                check.mDone = true;
+                ++mChecked;
+                if (check.mValid)
+                {
+                    lastSeq = tx->getSeqNum();
+                }
+                else if (mJustCheck)
+                {
+                    break;
+                }
+            }
+        }
+        catch (std::exception const& e)
+        {
+            // Whatever wasn't checked is checked again on the main thread.
+            CLOG_DEBUG(Herder, "Checking txs against snapshot failed: {}",
+                       e.what());
+        }
+    }
+
+    void
+    drain()
+    {
+        ZoneScoped;
+        size_t n = 0;
+        for (size_t i = mNextAccount++; i < mAccounts.size();
+             i = mNextAccount++)
+        {
+            checkAccount(mAccounts[i]);
+            ++n;
+        }
+
+        if (n != 0 && (mDoneAccounts += n) == mAccounts.size())
+        {
+            std::lock_guard<std::mutex> lock(mDoneMutex);
+            mDoneCV.notify_all();
+        }
+    }
+
+  public:
+    ParallelAccountChecker(std::shared_ptr<SnapshotLedgerTxnRoot> root,
+                           bool justCheck, uint64_t lowerBoundCloseTimeOffset,
+                           uint64_t upperBoundCloseTimeOffset,
+                           std::vector<Account>&& accounts)
+        : mRoot(std::move(root))
+        , mJustCheck(justCheck)
+        , mLowerBoundCloseTimeOffset(lowerBoundCloseTimeOffset)
+        , mUpperBoundCloseTimeOffset(upperBoundCloseTimeOffset)
+        , mAccounts(std::move(accounts))
+    {
+    }
+
+    void
+    start(Application& app, size_t maxTasks)
+    {
+        auto tasks = std::min(maxTasks, mAccounts.size());
+        for (size_t i = 0; i < tasks; ++i)
+        {
+            app.postOnBackgroundThread(
+                [self = shared_from_this()]() { self->drain(); },
+                "ParallelAccountChecker: check");
+        }
+    }
+
+    void
+    finish()
+    {
+        ZoneScoped;
+        drain();
+
+        std::unique_lock<std::mutex> lock(mDoneMutex);
+        mDoneCV.wait(lock, [&] { return mDoneAccounts == mAccounts.size(); });
+    }
+
+    Account const&
+    getAccount(size_t i) const
+    {
+        return mAccounts[i];
+    }
+
+    // Number of transactions checked against the snapshot.
+    size_t
+    getChecked() const
+    {
+        return mChecked;
+    }
+};
+
+// Check the transactions of every account in `accountTxMap` on the worker
+// threads, if PARALLEL_TXSET_VALIDATION is set and the BucketList snapshot is
+// at the last closed ledger. Accounts are kept in the iteration order of
+// `accountTxMap`. Returns nullptr if there's nothing to gain.
+std::shared_ptr<ParallelAccountChecker>
+checkAccountsInParallel(
+    Application& app,
+    UnorderedMap<AccountID, std::deque<TransactionFrameBasePtr>> const&
+        accountTxMap,
+    bool justCheck, uint64_t lowerBoundCloseTimeOffset,
+    uint64_t upperBoundCloseTimeOffset, TxSetValidityCache* cache)
+{
+    ZoneScoped;
+    auto const& cfg = app.getConfig();
+    if (!cfg.PARALLEL_TXSET_VALIDATION || cfg.WORKER_THREADS == 0 ||
+        accountTxMap.size() < 2)
+    {
+        return nullptr;
+    }
+    auto const& lcl = app.getLedgerManager().getLastClosedLedgerHeader();
+    auto snapshot = app.getBucketManager().getBucketListSnapshot();
+    if (!snapshot || snapshot->getLedgerSeq() != lcl.header.ledgerSeq)
+    {
+        return nullptr;
+    }
+
+    // Transactions the cache knows to be valid are taken off the front of
+    // each account first, so that the workers only check what's left.
+    std::vector<ParallelAccountChecker::Account> accounts;
+    accounts.reserve(accountTxMap.size());
+    for (auto const& kv : accountTxMap)
+    {
+        ParallelAccountChecker::Account account;
+        account.mTxs = &kv.second;
+        account.mChecks.resize(kv.second.size());
+        while (cache && account.mFirst < kv.second.size())
+        {
+            auto const& tx = kv.second[account.mFirst];
+            if (!cache->isKnownValidTx(lcl.hash, tx->getFullHash(),
+                                       account.mLastSeq,
+                                       lowerBoundCloseTimeOffset,
+                                       upperBoundCloseTimeOffset))
+            {
+                break;
+            }
+            auto& check = account.mChecks[account.mFirst++];
+            check.mDone = true;
+            check.mValid = true;
+            check.mFromCache = true;
+            check.mLastSeq = account.mLastSeq;
+            account.mLastSeq = tx->getSeqNum();
+        }
+        accounts.emplace_back(std::move(account));
+    }
+
+    auto root = std::make_shared<SnapshotLedgerTxnRoot>(
+        snapshot, lcl.header
+#ifdef BEST_OFFER_DEBUGGING
+        ,
+        cfg.BEST_OFFER_DEBUGGING_ENABLED
+#endif
+    );
+    auto checker = std::make_shared<ParallelAccountChecker>(
+        root, justCheck, lowerBoundCloseTimeOffset, upperBoundCloseTimeOffset,
+        std::move(accounts));
+    checker->start(app, cfg.WORKER_THREADS);
+    checker->finish();
+    return checker;
+}
+}
+
 bool
 TxSetFrame::checkOrTrim(Application& app,
                         std::vector<TransactionFrameBasePtr>& trimmed,
                         bool justCheck, uint64_t lowerBoundCloseTimeOffset,
-                        uint64_t upperBoundCloseTimeOffset)
+                        uint64_t upperBoundCloseTimeOffset,
+                        TxSetValidityCache* cache)
 {
     ZoneScoped;
     LedgerTxn ltx(app.getLedgerTxnRoot());
+    auto const& lclHash =
+        app.getLedgerManager().getLastClosedLedgerHeader().hash;
 
     UnorderedMap<AccountID, int64_t> accountFeeMap;
     auto accountTxMap = buildAccountTxQueues();
+    auto checker = checkAccountsInParallel(app, accountTxMap, justCheck,
+                                           lowerBoundCloseTimeOffset,
+                                           upperBoundCloseTimeOffset, cache);
+    if (checker)
+    {
+        app.getMetrics()
+            .NewMeter({"herder", "txset", "parallel-checked"}, "transaction")
+            .Mark(checker->getChecked());
+    }
+    // accountTxMap isn't inserted into from here on, so it's iterated in the
+    // same order as the checker's accounts.
+    size_t accountIndex = 0;
     for (auto& kv : accountTxMap)
     {
+        auto const* account =
+            checker ? &checker->getAccount(accountIndex++) : nullptr;
+        size_t pos = 0;
         int64_t lastSeq = 0;
         auto iter = kv.second.begin();
         while (iter != kv.second.end())
         {
             auto tx = *iter;
-            if (!tx->checkValid(ltx, lastSeq, lowerBoundCloseTimeOffset,
-                                upperBoundCloseTimeOffset))
+            bool valid;
+            auto const* check = account ? &account->mChecks[pos] : nullptr;
+            ++pos;
+            if (check && check->mDone && check->mLastSeq == lastSeq)
+            {
+                valid = check->mValid;
+                if (valid && cache && !check->mFromCache)
+                {
+                    cache->putValidTx(lclHash, tx->getFullHash(), lastSeq,
+                                      lowerBoundCloseTimeOffset,
+                                      upperBoundCloseTimeOffset, check->mTime);
+                }
+            }
+            else if (cache && cache->isKnownValidTx(lclHash, tx->getFullHash(),
+                                                    lastSeq,
+                                                    lowerBoundCloseTimeOffset,
+                                                    upperBoundCloseTimeOffset))
+            {
+                valid = true;
+            }
+            else
+            {
+                auto start = std::chrono::steady_clock::now();
+                valid = tx->checkValid(ltx, lastSeq, lowerBoundCloseTimeOffset,
+                                       upperBoundCloseTimeOffset);
+                if (valid && cache)
+                {
+                    cache->putValidTx(lclHash, tx->getFullHash(), lastSeq,
+                                      lowerBoundCloseTimeOffset,
+                                      upperBoundCloseTimeOffset,
+                                      std::chrono::steady_clock::now() - start);
+                }
+            }
+            if (!valid)
             {
                 if (justCheck)
                 {
@@ -371,13 +653,14 @@ TxSetFrame::checkOrTrim(Application& app,
 
 std::vector<TransactionFrameBasePtr>
 TxSetFrame::trimInvalid(Application& app, uint64_t lowerBoundCloseTimeOffset,
-                        uint64_t upperBoundCloseTimeOffset)
+                        uint64_t upperBoundCloseTimeOffset,
+                        TxSetValidityCache* cache)
 {
     ZoneScoped;
     std::vector<TransactionFrameBasePtr> trimmed;
     sortForHash();
     checkOrTrim(app, trimmed, false, lowerBoundCloseTimeOffset,
-                upperBoundCloseTimeOffset);
+                upperBoundCloseTimeOffset, cache);
     return trimmed;
 }
 
@@ -386,20 +669,58 @@ TxSetFrame::trimInvalid(Application& app, uint64_t lowerBoundCloseTimeOffset,
 // check seq num
 bool
 TxSetFrame::checkValid(Application& app, uint64_t lowerBoundCloseTimeOffset,
-                       uint64_t upperBoundCloseTimeOffset)
+                       uint64_t upperBoundCloseTimeOffset,
+                       TxSetValidityCache* cache)
 {
     ZoneScoped;
     auto& lcl = app.getLedgerManager().getLastClosedLedgerHeader();
-    if (mValid && mValid->first == lcl.hash)
+    if (mValid && mValid->mLastClosedLedgerHash == lcl.hash &&
+        mValid->mLowerBoundCloseTimeOffset == lowerBoundCloseTimeOffset &&
+        mValid->mUpperBoundCloseTimeOffset == upperBoundCloseTimeOffset)
+    {
+        return mValid->mValid;
+    }
+
+    // Only a set whose hash is already known can be looked up: computing it
+    // here would sort mTransactions, and hide a set that isn't sorted.
+    std::optional<bool> valid;
+    if (cache && mHash)
     {
-        return mValid->second;
+        valid = cache->getTxSetValidity(lcl.hash, *mHash,
+                                        lowerBoundCloseTimeOffset,
+                                        upperBoundCloseTimeOffset);
     }
+    if (!valid)
+    {
+        auto start = std::chrono::steady_clock::now();
+        valid = checkValidUncached(app, lowerBoundCloseTimeOffset,
+                                   upperBoundCloseTimeOffset, cache);
+        if (cache && mHash)
+        {
+            cache->putTxSetValidity(lcl.hash, *mHash,
+                                    lowerBoundCloseTimeOffset,
+                                    upperBoundCloseTimeOffset, *valid,
+                                    std::chrono::steady_clock::now() - start);
+        }
+    }
+    mValid = ValidityCheck{lcl.hash, lowerBoundCloseTimeOffset,
+                           upperBoundCloseTimeOffset, *valid};
+    return *valid;
+}
+
+bool
+TxSetFrame::checkValidUncached(Application& app,
+                               uint64_t lowerBoundCloseTimeOffset,
+                               uint64_t upperBoundCloseTimeOffset,
+                               TxSetValidityCache* cache)
+{
+    ZoneScoped;
+    auto& lcl = app.getLedgerManager().getLastClosedLedgerHeader();
     // Start by checking previousLedgerHash
     if (lcl.hash != mPreviousLedgerHash)
     {
         CLOG_DEBUG(Herder, "Got bad txSet: {}, expected {}",
                    hexAbbrev(mPreviousLedgerHash), hexAbbrev(lcl.hash));
-        mValid = std::make_optional<std::pair<Hash, bool>>(lcl.hash, false);
         return false;
     }
 
@@ -407,7 +728,6 @@ TxSetFrame::checkValid(Application& app, uint64_t lowerBoundCloseTimeOffset,
     {
         CLOG_DEBUG(Herder, "Got bad txSet: too many txs {} > {}",
                    this->size(lcl.header), lcl.header.maxTxSetSize);
-        mValid = std::make_optional<std::pair<Hash, bool>>(lcl.hash, false);
         return false;
     }
 
@@ -418,15 +738,12 @@ TxSetFrame::checkValid(Application& app, uint64_t lowerBoundCloseTimeOffset,
     {
         CLOG_DEBUG(Herder, "Got bad txSet: {} not sorted correctly",
                    hexAbbrev(mPreviousLedgerHash));
-        mValid = std::make_optional<std::pair<Hash, bool>>(lcl.hash, false);
         return false;
     }
 
     std::vector<TransactionFrameBasePtr> trimmed;
-    bool valid = checkOrTrim(app, trimmed, true, lowerBoundCloseTimeOffset,
-                             upperBoundCloseTimeOffset);
-    mValid = std::make_optional<std::pair<Hash, bool>>(lcl.hash, valid);
-    return valid;
+    return checkOrTrim(app, trimmed, true, lowerBoundCloseTimeOffset,
+                       upperBoundCloseTimeOffset, cache);
 }
 
 void
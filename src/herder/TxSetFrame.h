@@ -15,6 +15,7 @@
 namespace stellar
 {
 class Application;
+class TxSetValidityCache;
 
 class TxSetFrame;
 typedef std::shared_ptr<TxSetFrame> TxSetFramePtr;
@@ -43,9 +44,16 @@ class TxSetFrame : public AbstractTxSetFrameForApply
 {
     std::optional<Hash> mHash;
 
-    // mValid caches both the last app LCL that we checked
-    // vaidity for, and the result of that validity check.
-    std::optional<std::pair<Hash, bool>> mValid;
+    // mValid caches both the last app LCL and close time offsets that we
+    // checked vaidity for, and the result of that validity check.
+    struct ValidityCheck
+    {
+        Hash mLastClosedLedgerHash;
+        uint64_t mLowerBoundCloseTimeOffset;
+        uint64_t mUpperBoundCloseTimeOffset;
+        bool mValid;
+    };
+    std::optional<ValidityCheck> mValid;
 
     Hash mPreviousLedgerHash;
 
@@ -54,7 +62,12 @@ class TxSetFrame : public AbstractTxSetFrameForApply
     bool checkOrTrim(Application& app,
                      std::vector<TransactionFrameBasePtr>& trimmed,
                      bool justCheck, uint64_t lowerBoundCloseTimeOffset,
-                     uint64_t upperBoundCloseTimeOffset);
+                     uint64_t upperBoundCloseTimeOffset,
+                     TxSetValidityCache* cache);
+    bool checkValidUncached(Application& app,
+                            uint64_t lowerBoundCloseTimeOffset,
+                            uint64_t upperBoundCloseTimeOffset,
+                            TxSetValidityCache* cache);
 
     UnorderedMap<AccountID, AccountTransactionQueue> buildAccountTxQueues();
     friend struct SurgeCompare;
@@ -81,14 +94,18 @@ class TxSetFrame : public AbstractTxSetFrameForApply
 
     std::vector<TransactionFrameBasePtr> sortForApply() override;
 
+    // If `cache` is given, the result for the whole set (once its hash is
+    // known) and for each transaction is looked up in it and remembered in it.
     bool checkValid(Application& app, uint64_t lowerBoundCloseTimeOffset,
-                    uint64_t upperBoundCloseTimeOffset);
+                    uint64_t upperBoundCloseTimeOffset,
+                    TxSetValidityCache* cache = nullptr);
 
     // remove invalid transaction from this set and return those removed
     // transactions
     std::vector<TransactionFrameBasePtr>
     trimInvalid(Application& app, uint64_t lowerBoundCloseTimeOffset,
-                uint64_t upperBoundCloseTimeOffset);
+                uint64_t upperBoundCloseTimeOffset,
+                TxSetValidityCache* cache = nullptr);
     void surgePricingFilter(Application& app);
 
     void removeTx(TransactionFrameBasePtr tx);
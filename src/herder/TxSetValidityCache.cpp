@@ -0,0 +1,131 @@
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "herder/TxSetValidityCache.h"
+#include "main/Application.h"
+#include "util/HashOfHash.h"
+
+#include <medida/meter.h>
+#include <medida/metrics_registry.h>
+
+namespace stellar
+{
+
+bool
+TxSetValidityCache::Key::operator==(Key const& other) const
+{
+    return mHash == other.mHash && mLastSeq == other.mLastSeq &&
+           mLowerBoundCloseTimeOffset == other.mLowerBoundCloseTimeOffset &&
+           mUpperBoundCloseTimeOffset == other.mUpperBoundCloseTimeOffset;
+}
+
+size_t
+TxSetValidityCache::KeyHash::operator()(Key const& key) const noexcept
+{
+    // Combine as in Boost's hash_combine.
+    size_t seed = std::hash<Hash>()(key.mHash);
+    for (uint64_t v : {static_cast<uint64_t>(key.mLastSeq),
+                       key.mLowerBoundCloseTimeOffset,
+                       key.mUpperBoundCloseTimeOffset})
+    {
+        seed ^= std::hash<uint64_t>()(v) + 0x9e3779b9 + (seed << 6) +
+                (seed >> 2);
+    }
+    return seed;
+}
+
+TxSetValidityCache::TxSetValidityCache(Application& app, size_t maxTxSets,
+                                       size_t maxTxs)
+    : mTxSets(maxTxSets)
+    , mValidTxs(maxTxs)
+    , mTxSetHits(app.getMetrics().NewMeter(
+          {"scp", "txset", "validity-cache-hit"}, "txset"))
+    , mTxHits(app.getMetrics().NewMeter(
+          {"scp", "txset", "tx-validity-cache-hit"}, "transaction"))
+{
+}
+
+void
+TxSetValidityCache::forgetUnless(Hash const& lclHash)
+{
+    if (lclHash != mLastClosedLedgerHash)
+    {
+        mTxSets.clear();
+        mValidTxs.clear();
+        mLastClosedLedgerHash = lclHash;
+    }
+}
+
+std::optional<bool>
+TxSetValidityCache::getTxSetValidity(Hash const& lclHash,
+                                     Hash const& txSetHash,
+                                     uint64_t lowerBoundCloseTimeOffset,
+                                     uint64_t upperBoundCloseTimeOffset)
+{
+    forgetUnless(lclHash);
+    auto res = mTxSets.maybeGet(
+        {txSetHash, 0, lowerBoundCloseTimeOffset, upperBoundCloseTimeOffset});
+    if (!res)
+    {
+        return std::nullopt;
+    }
+    mTxSetHits.Mark();
+    mTimeSaved += res->mCheckTime;
+    return std::make_optional(res->mValid);
+}
+
+void
+TxSetValidityCache::putTxSetValidity(Hash const& lclHash,
+                                     Hash const& txSetHash,
+                                     uint64_t lowerBoundCloseTimeOffset,
+                                     uint64_t upperBoundCloseTimeOffset,
+                                     bool valid,
+                                     std::chrono::nanoseconds checkTime)
+{
+    forgetUnless(lclHash);
+    mTxSets.put(
+        {txSetHash, 0, lowerBoundCloseTimeOffset, upperBoundCloseTimeOffset},
+        {valid, checkTime});
+}
+
+bool
+TxSetValidityCache::isKnownValidTx(Hash const& lclHash, Hash const& txHash,
+                                   int64_t lastSeq,
+                                   uint64_t lowerBoundCloseTimeOffset,
+                                   uint64_t upperBoundCloseTimeOffset)
+{
+    forgetUnless(lclHash);
+    auto checkTime = mValidTxs.maybeGet({txHash, lastSeq,
+                                         lowerBoundCloseTimeOffset,
+                                         upperBoundCloseTimeOffset});
+    if (!checkTime)
+    {
+        return false;
+    }
+    mTxHits.Mark();
+    mTimeSaved += *checkTime;
+    return true;
+}
+
+void
+TxSetValidityCache::putValidTx(Hash const& lclHash, Hash const& txHash,
+                               int64_t lastSeq,
+                               uint64_t lowerBoundCloseTimeOffset,
+                               uint64_t upperBoundCloseTimeOffset,
+                               std::chrono::nanoseconds checkTime)
+{
+    forgetUnless(lclHash);
+    mValidTxs.put(
+        {txHash, lastSeq, lowerBoundCloseTimeOffset, upperBoundCloseTimeOffset},
+        checkTime);
+}
+
+std::chrono::nanoseconds
+TxSetValidityCache::takeTimeSaved()
+{
+    auto res = mTimeSaved;
+    mTimeSaved = std::chrono::nanoseconds::zero();
+    return res;
+}
+}
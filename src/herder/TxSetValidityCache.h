@@ -0,0 +1,88 @@
+#pragma once
+
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+#include "util/RandomEvictionCache.h"
+#include "xdr/Stellar-types.h"
+
+#include <chrono>
+#include <optional>
+
+namespace medida
+{
+class Meter;
+}
+
+namespace stellar
+{
+class Application;
+
+// Remembers what TxSetFrame::checkValid found against the last closed ledger:
+// - whole tx sets, by contents hash and close time offsets, so that a value
+//   seen again in a later nomination or ballot round isn't checked again;
+// - single transactions that were valid, by full hash, close time offsets
+//   and the sequence number of the transaction before them in the set, so
+//   that tx sets from different nominators only check the transactions they
+//   share once.
+// Everything is forgotten when the last closed ledger changes. Each hit adds
+// the time the original check took to a running total of the time saved.
+class TxSetValidityCache : public NonMovableOrCopyable
+{
+    struct Key
+    {
+        Hash mHash;
+        int64_t mLastSeq;
+        uint64_t mLowerBoundCloseTimeOffset;
+        uint64_t mUpperBoundCloseTimeOffset;
+
+        bool operator==(Key const& other) const;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(Key const& key) const noexcept;
+    };
+
+    struct TxSetResult
+    {
+        bool mValid;
+        std::chrono::nanoseconds mCheckTime;
+    };
+
+    Hash mLastClosedLedgerHash;
+    RandomEvictionCache<Key, TxSetResult, KeyHash> mTxSets;
+    RandomEvictionCache<Key, std::chrono::nanoseconds, KeyHash> mValidTxs;
+    std::chrono::nanoseconds mTimeSaved{0};
+
+    medida::Meter& mTxSetHits;
+    medida::Meter& mTxHits;
+
+    void forgetUnless(Hash const& lclHash);
+
+  public:
+    TxSetValidityCache(Application& app, size_t maxTxSets, size_t maxTxs);
+
+    std::optional<bool> getTxSetValidity(Hash const& lclHash,
+                                         Hash const& txSetHash,
+                                         uint64_t lowerBoundCloseTimeOffset,
+                                         uint64_t upperBoundCloseTimeOffset);
+    void putTxSetValidity(Hash const& lclHash, Hash const& txSetHash,
+                          uint64_t lowerBoundCloseTimeOffset,
+                          uint64_t upperBoundCloseTimeOffset, bool valid,
+                          std::chrono::nanoseconds checkTime);
+
+    bool isKnownValidTx(Hash const& lclHash, Hash const& txHash,
+                        int64_t lastSeq, uint64_t lowerBoundCloseTimeOffset,
+                        uint64_t upperBoundCloseTimeOffset);
+    void putValidTx(Hash const& lclHash, Hash const& txHash, int64_t lastSeq,
+                    uint64_t lowerBoundCloseTimeOffset,
+                    uint64_t upperBoundCloseTimeOffset,
+                    std::chrono::nanoseconds checkTime);
+
+    // Returns the time saved by hits since the last call, and resets it.
+    std::chrono::nanoseconds takeTimeSaved();
+};
+}
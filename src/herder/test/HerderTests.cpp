@@ -4,6 +4,7 @@
 
 #include "herder/HerderImpl.h"
 #include "herder/LedgerCloseData.h"
+#include "herder/TxSetValidityCache.h"
 #include "main/Application.h"
 #include "main/Config.h"
 #include "scp/SCP.h"
@@ -31,12 +32,18 @@
 #include "transactions/TransactionUtils.h"
 #include "util/Math.h"
 #include "util/ProtocolVersion.h"
+#include "util/finally.h"
 
 #include "xdr/Stellar-ledger.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
 #include "xdrpp/marshal.h"
 #include <algorithm>
 #include <fmt/format.h>
+#include <future>
 #include <optional>
+#include <tuple>
 
 using namespace stellar;
 using namespace stellar::txbridge;
@@ -1592,6 +1599,152 @@ testSCPDriver(uint32 protocolVersion, uint32_t maxTxSetSize, size_t expectedOps)
     }
 }
 
+TEST_CASE("txset validity cache", "[herder][txset]")
+{
+    VirtualClock clock;
+    auto app = createTestApplication(clock, getTestConfig());
+    auto root = TestAccount::createRoot(*app);
+    auto a1 = root.create("a1", 500000000);
+    auto a2 = root.create("a2", 500000000);
+
+    auto const& lcl = app->getLedgerManager().getLastClosedLedgerHeader();
+    auto const lclCloseTime = lcl.header.scpValue.closeTime;
+    TxSetValidityCache cache(*app, 10, 10);
+    auto& txSetHits = app->getMetrics().NewMeter(
+        {"scp", "txset", "validity-cache-hit"}, "txset");
+    auto& txHits = app->getMetrics().NewMeter(
+        {"scp", "txset", "tx-validity-cache-hit"}, "transaction");
+
+    // tx1 expires after the next ledger if that closes a second after the
+    // last one.
+    auto tx1 = a1.tx({payment(root, 1)});
+    setMaxTime(tx1, lclCloseTime + 1);
+    getSignatures(tx1).clear();
+    tx1->addSignature(a1.getSecretKey());
+    auto tx2 = a2.tx({payment(root, 1)});
+
+    auto makeTxSet = [&](std::vector<TransactionFrameBasePtr> const& txs) {
+        auto txSet = std::make_shared<TxSetFrame>(lcl.hash);
+        for (auto const& tx : txs)
+        {
+            txSet->add(tx);
+        }
+        txSet->getContentsHash();
+        return txSet;
+    };
+
+    auto txSet = makeTxSet({tx1, tx2});
+    REQUIRE(txSet->checkValid(*app, 1, 1, &cache));
+    REQUIRE(txSetHits.count() == 0);
+    REQUIRE(txHits.count() == 0);
+
+    // The same set, received again, isn't checked again.
+    TransactionSet xdrSet;
+    txSet->toXDR(xdrSet);
+    auto received = std::make_shared<TxSetFrame>(app->getNetworkID(), xdrSet);
+    received->getContentsHash();
+    REQUIRE(received->checkValid(*app, 1, 1, &cache));
+    REQUIRE(txSetHits.count() == 1);
+    REQUIRE(txHits.count() == 0);
+
+    // Nor are the transactions another set shares with it.
+    REQUIRE(makeTxSet({tx2})->checkValid(*app, 1, 1, &cache));
+    REQUIRE(txSetHits.count() == 1);
+    REQUIRE(txHits.count() == 1);
+
+    REQUIRE(cache.takeTimeSaved() > std::chrono::nanoseconds::zero());
+    REQUIRE(cache.takeTimeSaved() == std::chrono::nanoseconds::zero());
+
+    // A later close time is a different check, both for the cache and for
+    // the set itself.
+    REQUIRE(!txSet->checkValid(*app, 2, 2, &cache));
+    REQUIRE(!received->checkValid(*app, 2, 2));
+    REQUIRE(txSetHits.count() == 1);
+}
+
+TEST_CASE("parallel txset validation", "[herder][txset]")
+{
+    // Checks and trims the same set on an app that checks transactions on
+    // the worker threads and on one that doesn't, returning whether the set
+    // was valid, the full hashes of the trimmed transactions and the hash of
+    // what's left.
+    auto checkAndTrim = [](bool parallel) {
+        VirtualClock clock;
+        auto cfg = getTestConfig();
+        cfg.PARALLEL_TXSET_VALIDATION = parallel;
+        auto app = createTestApplication(clock, cfg);
+        auto const minBalance = app->getLedgerManager().getLastMinBalance(2);
+
+        // Transactions are checked against the BucketList, so create the
+        // accounts by closing a ledger.
+        auto root = TestAccount::createRoot(*app);
+        std::vector<TestAccount> accounts;
+        accounts.reserve(4);
+        std::vector<Operation> ops;
+        for (int i = 0; i < 4; ++i)
+        {
+            accounts.emplace_back(*app, getAccount(fmt::format("a{}", i)));
+            ops.emplace_back(createAccount(accounts.back(), minBalance * 10));
+        }
+        closeLedgerOn(*app, 2, 1, 1, 2020, {root.tx(ops)});
+
+        auto const& lcl = app->getLedgerManager().getLastClosedLedgerHeader();
+        auto txSet = std::make_shared<TxSetFrame>(lcl.hash);
+        auto addTx = [&](TestAccount& account, SequenceNumber sn,
+                         bool badSignature) {
+            auto tx = account.tx({payment(root, 1)}, sn);
+            if (badSignature)
+            {
+                getSignatures(tx).clear();
+                tx->addSignature(root.getSecretKey());
+            }
+            txSet->add(tx);
+        };
+        for (size_t i = 0; i < accounts.size(); ++i)
+        {
+            auto seq = accounts[i].getLastSequenceNumber();
+            addTx(accounts[i], seq + 1, false);
+            // The second transaction of the odd accounts is invalid, which
+            // takes the third with it.
+            addTx(accounts[i], seq + 2, i % 2 == 1);
+            addTx(accounts[i], seq + 3, false);
+        }
+        txSet->sortForHash();
+
+        bool valid = txSet->checkValid(*app, 0, 0);
+        std::vector<Hash> trimmed;
+        for (auto const& tx : txSet->trimInvalid(*app, 0, 0))
+        {
+            trimmed.emplace_back(tx->getFullHash());
+        }
+        std::sort(trimmed.begin(), trimmed.end());
+        REQUIRE(txSet->checkValid(*app, 0, 0));
+
+        auto parallelChecked =
+            app->getMetrics()
+                .NewMeter({"herder", "txset", "parallel-checked"},
+                          "transaction")
+                .count();
+        if (parallel)
+        {
+            // The outcomes came from the parallel check, not the fallback
+            // on the main thread.
+            REQUIRE(parallelChecked > 0);
+        }
+        else
+        {
+            REQUIRE(parallelChecked == 0);
+        }
+        return std::make_tuple(valid, trimmed, txSet->getContentsHash());
+    };
+
+    auto serial = checkAndTrim(false);
+    auto parallel = checkAndTrim(true);
+    REQUIRE(!std::get<0>(serial));
+    REQUIRE(std::get<1>(serial).size() == 4);
+    REQUIRE(parallel == serial);
+}
+
 TEST_CASE("SCP Driver", "[herder][acceptance]")
 {
     SECTION("protocol current")
@@ -2918,3 +3071,93 @@ TEST_CASE("exclude transactions by operation type", "[herder]")
                 TransactionQueue::AddResult::ADD_STATUS_PENDING);
     }
 }
+
+TEST_CASE("parallel ledger apply", "[herder][ledger]")
+{
+    auto mode = Simulation::OVER_LOOPBACK;
+    auto networkID = sha256(getTestConfig().NETWORK_PASSPHRASE);
+
+    auto sim = Topologies::core(4, 0.75, mode, networkID, [](int i) {
+        auto cfg = getTestConfig(i, Config::TESTDB_ON_DISK_SQLITE);
+        cfg.PARALLEL_LEDGER_APPLY = true;
+        return cfg;
+    });
+
+    sim->startAllNodes();
+    sim->crankUntil([&]() { return sim->haveAllExternalized(6, 1); },
+                    std::chrono::seconds(30), false);
+
+    // every node went through the background apply path and closed the same
+    // ledgers (a node may already be applying the next one)
+    auto nodes = sim->getNodes();
+    auto lcl = nodes[0]->getLedgerManager().getLastClosedLedgerNum();
+    for (auto const& app : nodes)
+    {
+        REQUIRE(app->getMetrics()
+                    .NewTimer({"ledger", "close", "background"})
+                    .count() > 0);
+        auto const& nodeLcl =
+            app->getLedgerManager().getLastClosedLedgerHeader();
+        if (nodeLcl.header.ledgerSeq == lcl)
+        {
+            REQUIRE(nodeLcl.hash == nodes[0]
+                                        ->getLedgerManager()
+                                        .getLastClosedLedgerHeader()
+                                        .hash);
+        }
+    }
+
+    SECTION("transactions received during apply are checked after it")
+    {
+        auto app = nodes[0];
+        auto& lm = app->getLedgerManager();
+        auto& herder = app->getHerder();
+        sim->crankUntil([&]() { return !lm.isApplying(); },
+                        std::chrono::seconds(30), false);
+        auto root = TestAccount::createRoot(*app);
+        auto tx = root.tx({payment(root, 1)});
+
+        // Keep the next background apply from finishing until the held
+        // transaction has been looked at (and don't leave the ledger-close
+        // thread hanging if the test fails before then).
+        std::promise<void> unblock;
+        bool unblocked = false;
+        auto unblockOnExit = gsl::finally([&]() {
+            if (!unblocked)
+            {
+                unblock.set_value();
+            }
+        });
+        auto blocked = unblock.get_future().share();
+        app->postOnLedgerCloseThread([blocked]() { blocked.wait(); },
+                                     "test: block ledger close");
+        sim->crankUntil([&]() { return lm.isApplying(); },
+                        std::chrono::seconds(30), false);
+
+        // Nothing has checked the transaction yet, however many times it is
+        // submitted.
+        REQUIRE(herder.recvTransaction(tx) ==
+                TransactionQueue::AddResult::ADD_STATUS_TRY_AGAIN_LATER);
+        REQUIRE(herder.recvTransaction(tx) ==
+                TransactionQueue::AddResult::ADD_STATUS_TRY_AGAIN_LATER);
+
+        // Once the ledger closes it goes into the queue, and from there into
+        // a ledger.
+        unblocked = true;
+        unblock.set_value();
+        auto seq = tx->getSeqNum();
+        sim->crankUntil(
+            [&]() {
+                if (lm.isApplying())
+                {
+                    return false;
+                }
+                LedgerTxn ltx(app->getLedgerTxnRoot());
+                return stellar::loadAccount(ltx, root.getPublicKey())
+                           .current()
+                           .data.account()
+                           .seqNum >= seq;
+            },
+            std::chrono::seconds(60), false);
+    }
+}
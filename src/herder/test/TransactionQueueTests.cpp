@@ -18,10 +18,14 @@
 #include "util/Timer.h"
 #include "xdr/Stellar-transaction.h"
 
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+
 #include <chrono>
 #include <fmt/chrono.h>
 #include <lib/catch.hpp>
 #include <numeric>
+#include <optional>
 
 using namespace stellar;
 using namespace stellar::txtest;
@@ -60,6 +64,30 @@ feeBump(Application& app, TestAccount& feeSource, TransactionFrameBasePtr tx,
                                                          fb);
 }
 
+// Writes `n` funded accounts straight into the ledger, for benchmarks where
+// applying as many create-account transactions would dwarf what is being
+// measured. Returns their keys.
+std::vector<SecretKey>
+fundBenchmarkAccounts(Application& app, size_t n)
+{
+    std::vector<SecretKey> keys;
+    keys.reserve(n);
+    LedgerTxn ltx(app.getLedgerTxnRoot());
+    for (size_t i = 0; i < n; ++i)
+    {
+        keys.emplace_back(getAccount(fmt::format("bench{}", i)));
+        LedgerEntry le;
+        le.data.type(ACCOUNT);
+        auto& ae = le.data.account();
+        ae.accountID = keys.back().getPublicKey();
+        ae.balance = 1000000000000;
+        ae.thresholds[0] = 1;
+        ltx.create(le);
+    }
+    ltx.commit();
+    return keys;
+}
+
 TransactionFramePtr
 invalidTransaction(Application& app, TestAccount& account, int sequenceDelta)
 {
@@ -1448,6 +1476,181 @@ TEST_CASE("remove applied", "[herder][transactionqueue]")
     REQUIRE(tq.toTxSet({})->mTransactions.size() == 2);
 }
 
+TEST_CASE("transaction queue sharded admission", "[herder][transactionqueue]")
+{
+    VirtualClock clock;
+    auto cfg = getTestConfig();
+    cfg.TRANSACTION_QUEUE_ADMISSION_SHARDS = 2;
+    auto app = createTestApplication(clock, cfg);
+    auto const minBalance2 = app->getLedgerManager().getLastMinBalance(2);
+
+    // Admission reads accounts from the BucketList, so create them by closing
+    // a ledger rather than by applying transactions straight to the database.
+    auto root = TestAccount::createRoot(*app);
+    TestAccount account1(*app, getAccount("a1"));
+    TestAccount account2(*app, getAccount("a2"));
+    closeLedgerOn(*app, 2, 1, 1, 2020,
+                  {root.tx({createAccount(account1, minBalance2),
+                            createAccount(account2, minBalance2)})});
+
+    TransactionQueue tq(*app, 4, 2, 2);
+    using AddResult = TransactionQueue::AddResult;
+    std::vector<std::optional<AddResult>> results;
+    auto addAsync = [&](TransactionFrameBasePtr const& tx) {
+        size_t i = results.size();
+        results.emplace_back();
+        tq.tryAddAsync(tx, [&results, i](AddResult res) { results[i] = res; });
+    };
+    auto crankUntilDone = [&]() {
+        while (std::any_of(results.begin(), results.end(),
+                           [](auto const& r) { return !r; }))
+        {
+            clock.crank(true);
+        }
+    };
+    auto& rechecks = app->getMetrics().NewMeter(
+        {"herder", "pending-txs", "admission-recheck"}, "transaction");
+
+    SECTION("chain from one account is admitted in order")
+    {
+        std::vector<TransactionFrameBasePtr> txs;
+        for (int64_t i = 1; i <= 3; ++i)
+        {
+            txs.emplace_back(transaction(*app, account1, i, 1, 100));
+            addAsync(txs.back());
+        }
+        addAsync(transaction(*app, account2, 1, 1, 100));
+        crankUntilDone();
+
+        for (auto const& r : results)
+        {
+            REQUIRE(*r == AddResult::ADD_STATUS_PENDING);
+        }
+        REQUIRE(tq.getAccountTransactionQueueInfo(account1).mMaxSeq ==
+                txs.back()->getSeqNum());
+        REQUIRE(rechecks.count() == 0);
+    }
+
+    SECTION("invalid transactions are rejected")
+    {
+        addAsync(invalidTransaction(*app, account1, 1));
+        // Checked assuming the first one gets in, so it's checked again.
+        addAsync(transaction(*app, account1, 2, 1, 100));
+        addAsync(transaction(*app, account2, 2, 1, 100));
+        crankUntilDone();
+
+        REQUIRE(*results[0] == AddResult::ADD_STATUS_ERROR);
+        REQUIRE(*results[1] == AddResult::ADD_STATUS_ERROR);
+        REQUIRE(*results[2] == AddResult::ADD_STATUS_ERROR);
+        REQUIRE(rechecks.count() == 1);
+        REQUIRE(tq.getAccountTransactionQueueInfo(account1).mMaxSeq == 0);
+        REQUIRE(tq.getAccountTransactionQueueInfo(account2).mMaxSeq == 0);
+    }
+
+    SECTION("next transaction waits for the one being checked")
+    {
+        auto tx1 = transaction(*app, account1, 1, 1, 100);
+        auto tx2 = transaction(*app, account1, 2, 1, 100);
+        addAsync(tx1);
+        // Can't be checked off the main thread, but mustn't be checked
+        // before tx1 is in.
+        tq.mNoAdmissionSnapshotForTesting = true;
+        addAsync(tx2);
+        REQUIRE(!results[1]);
+        crankUntilDone();
+
+        REQUIRE(*results[0] == AddResult::ADD_STATUS_PENDING);
+        REQUIRE(*results[1] == AddResult::ADD_STATUS_PENDING);
+        REQUIRE(tq.getAccountTransactionQueueInfo(account1).mMaxSeq ==
+                tx2->getSeqNum());
+
+        // With nothing in flight, it's checked on the spot.
+        addAsync(transaction(*app, account2, 1, 1, 100));
+        REQUIRE(results[2]);
+        REQUIRE(*results[2] == AddResult::ADD_STATUS_PENDING);
+    }
+
+    SECTION("rejection reports the result of the worker's check")
+    {
+        auto tx = transaction(*app, account1, 5, 1, 100);
+        addAsync(tx);
+        crankUntilDone();
+
+        REQUIRE(*results[0] == AddResult::ADD_STATUS_ERROR);
+        REQUIRE(tx->getResult().result.code() == txBAD_SEQ);
+        REQUIRE(rechecks.count() == 0);
+    }
+}
+
+TEST_CASE("transaction queue surge priced tx set", "[herder][transactionqueue]")
+{
+    VirtualClock clock;
+    auto cfg = getTestConfig();
+    cfg.TESTING_UPGRADE_MAX_TX_SET_SIZE = 4;
+    auto app = createTestApplication(clock, cfg);
+    auto const minBalance2 = app->getLedgerManager().getLastMinBalance(2);
+
+    auto root = TestAccount::createRoot(*app);
+    auto a = root.create("a", minBalance2);
+    auto b = root.create("b", minBalance2);
+    auto c = root.create("c", minBalance2);
+    auto d = root.create("d", minBalance2);
+
+    TransactionQueue tq(*app, 4, 2, 3);
+    auto a1 = transaction(*app, a, 1, 1, 400);
+    auto a2 = transaction(*app, a, 2, 1, 100);
+    auto b1 = transaction(*app, b, 1, 1, 300);
+    auto b2 = transaction(*app, b, 2, 1, 250);
+    auto c1 = transaction(*app, c, 1, 1, 200);
+    auto d1 = transaction(*app, d, 1, 1, 1000, 2);
+    for (auto const& tx : {a1, a2, b1, b2, c1, d1})
+    {
+        REQUIRE(tq.tryAdd(tx) ==
+                TransactionQueue::AddResult::ADD_STATUS_PENDING);
+    }
+
+    auto const& lcl = app->getLedgerManager().getLastClosedLedgerHeader();
+    auto hashes = [](std::vector<TransactionFrameBasePtr> const& txs) {
+        UnorderedSet<Hash> res;
+        for (auto const& tx : txs)
+        {
+            res.emplace(tx->getFullHash());
+        }
+        return res;
+    };
+
+    SECTION("picks what surgePricingFilter keeps")
+    {
+        auto txSet = tq.toSurgePricedTxSet(lcl, 4);
+        REQUIRE(hashes(txSet->mTransactions) == hashes({d1, a1, b1}));
+
+        auto filtered = tq.toTxSet(lcl);
+        filtered->surgePricingFilter(*app);
+        REQUIRE(hashes(filtered->mTransactions) ==
+                hashes(txSet->mTransactions));
+    }
+
+    SECTION("skips accounts whose next transaction doesn't fit")
+    {
+        REQUIRE(hashes(tq.toSurgePricedTxSet(lcl, 1)->mTransactions) ==
+                hashes({a1}));
+    }
+
+    SECTION("follows removeApplied")
+    {
+        tq.removeApplied({d1, a1});
+        REQUIRE(hashes(tq.toSurgePricedTxSet(lcl, 3)->mTransactions) ==
+                hashes({b1, b2, c1}));
+    }
+
+    SECTION("follows ban")
+    {
+        tq.ban({b1});
+        REQUIRE(hashes(tq.toSurgePricedTxSet(lcl, 4)->mTransactions) ==
+                hashes({d1, a1, c1}));
+    }
+}
+
 static UnorderedSet<AssetPair, AssetPairHash>
 apVecToSet(std::vector<AssetPair> const& v)
 {
@@ -1667,4 +1870,120 @@ TEST_CASE("arbitrage tx identification benchmark",
     auto end = clock::now();
     LOG_INFO(DEFAULT_LOG, "executed 100 loop-checks of 600-op tx loop in {}",
              ch::duration_cast<ch::milliseconds>(end - start));
-}
\ No newline at end of file
+}
+
+TEST_CASE("transaction queue admission benchmark",
+          "[herder][transactionqueue][bench][!hide]")
+{
+    // This test admits one 4-payment transaction from each of 12000 accounts
+    // into a TransactionQueue and then re-evaluates the min fee and fee bid of
+    // every pending transaction 100 times, which is roughly what the limiter
+    // and the surge-pricing comparators do while the queue is under load.
+    size_t const numAccounts = 12000;
+    size_t const opsPerTx = 4;
+
+    VirtualClock clock;
+    auto cfg = getTestConfig();
+    cfg.TESTING_UPGRADE_MAX_TX_SET_SIZE =
+        static_cast<uint32>(numAccounts * opsPerTx);
+    auto app = createTestApplication(clock, cfg);
+    auto root = TestAccount::createRoot(*app);
+
+    std::vector<TransactionFrameBasePtr> txs;
+    for (auto const& key : fundBenchmarkAccounts(*app, numAccounts))
+    {
+        std::vector<Operation> ops(opsPerTx, payment(root, 1000000));
+        txs.emplace_back(transactionFromOperations(*app, key, 1, ops, 100000));
+    }
+
+    TransactionQueue queue(*app, 4, 2, 2);
+
+    namespace ch = std::chrono;
+    using benchClock = ch::high_resolution_clock;
+    auto start = benchClock::now();
+    size_t notPending = 0;
+    for (auto const& tx : txs)
+    {
+        if (queue.tryAdd(tx) != TransactionQueue::AddResult::ADD_STATUS_PENDING)
+        {
+            ++notPending;
+        }
+    }
+    auto end = benchClock::now();
+    REQUIRE(notPending == 0);
+    LOG_INFO(DEFAULT_LOG, "admitted {} txs into the queue in {}", txs.size(),
+             ch::duration_cast<ch::milliseconds>(end - start));
+
+    auto const& header =
+        app->getLedgerManager().getLastClosedLedgerHeader().header;
+    int64_t totalFees = 0;
+    start = benchClock::now();
+    for (size_t i = 0; i < 100; ++i)
+    {
+        for (auto const& tx : txs)
+        {
+            totalFees += tx->getMinFee(header) + tx->getFeeBid();
+        }
+    }
+    end = benchClock::now();
+    REQUIRE(totalFees > 0);
+    LOG_INFO(DEFAULT_LOG, "evaluated fees of {} pending txs 100 times in {}",
+             txs.size(), ch::duration_cast<ch::milliseconds>(end - start));
+}
+
+TEST_CASE("transaction queue surge priced tx set benchmark",
+          "[herder][transactionqueue][bench][!hide]")
+{
+    // This test queues one transaction from each of 100000 accounts, with
+    // fee bids all over the place, and then builds the 1000-operation tx set
+    // a validator would nominate 100 times, both by filtering a copy of the
+    // whole queue and by picking the best transactions off the queue.
+    size_t const numAccounts = 100000;
+    uint32 const maxTxSetSize = 1000;
+
+    VirtualClock clock;
+    auto cfg = getTestConfig();
+    cfg.TESTING_UPGRADE_MAX_TX_SET_SIZE = maxTxSetSize;
+    auto app = createTestApplication(clock, cfg);
+    auto root = TestAccount::createRoot(*app);
+
+    TransactionQueue queue(*app, 4, 2,
+                           static_cast<uint32>(numAccounts / maxTxSetSize));
+    auto keys = fundBenchmarkAccounts(*app, numAccounts);
+    for (size_t i = 0; i < numAccounts; ++i)
+    {
+        auto fee = static_cast<int>(100 + (i * 7919) % 100000);
+        auto tx = transactionFromOperations(*app, keys[i], 1,
+                                            {payment(root, 1000000)}, fee);
+        REQUIRE(queue.tryAdd(tx) ==
+                TransactionQueue::AddResult::ADD_STATUS_PENDING);
+    }
+
+    auto const& lcl = app->getLedgerManager().getLastClosedLedgerHeader();
+    namespace ch = std::chrono;
+    using benchClock = ch::high_resolution_clock;
+    auto start = benchClock::now();
+    for (size_t i = 0; i < 100; ++i)
+    {
+        auto txSet = queue.toTxSet(lcl);
+        txSet->surgePricingFilter(*app);
+        REQUIRE(txSet->sizeOp() == maxTxSetSize);
+    }
+    auto end = benchClock::now();
+    LOG_INFO(DEFAULT_LOG,
+             "built 100 tx sets from {} queued txs with toTxSet and "
+             "surgePricingFilter in {}",
+             numAccounts, ch::duration_cast<ch::milliseconds>(end - start));
+
+    start = benchClock::now();
+    for (size_t i = 0; i < 100; ++i)
+    {
+        auto txSet = queue.toSurgePricedTxSet(lcl, maxTxSetSize);
+        REQUIRE(txSet->sizeOp() == maxTxSetSize);
+    }
+    end = benchClock::now();
+    LOG_INFO(DEFAULT_LOG,
+             "built 100 tx sets from {} queued txs with toSurgePricedTxSet "
+             "in {}",
+             numAccounts, ch::duration_cast<ch::milliseconds>(end - start));
+}
@@ -25,6 +25,7 @@ class FileTransferInfo
     std::string mType;
     std::string mHexDigits;
     std::string mLocalPath;
+    std::string mCompressedBucketPath;
     std::string getLocalDir(TmpDir const& localRoot) const;
 
   public:
@@ -35,6 +36,16 @@ class FileTransferInfo
     {
     }
 
+    // A compressed bucket: it's published from a decompressed copy in
+    // `snapDir`, which has to be written before it's gzipped.
+    FileTransferInfo(TmpDir const& snapDir, Bucket const& bucket)
+        : mType(HISTORY_FILE_TYPE_BUCKET)
+        , mHexDigits(binToHex(bucket.getHash()))
+        , mLocalPath(getLocalDir(snapDir) + "/" + baseName_nogz())
+        , mCompressedBucketPath(bucket.getFilename())
+    {
+    }
+
     FileTransferInfo(TmpDir const& snapDir, std::string const& snapType,
                      uint32_t checkpointLedger)
         : mType(snapType)
@@ -62,6 +73,13 @@ class FileTransferInfo
     {
         return mLocalPath;
     }
+
+    // The compressed bucket file to decompress to localPath_nogz(), or empty.
+    std::string const&
+    compressedBucketPath() const
+    {
+        return mCompressedBucketPath;
+    }
     std::string
     localPath_gz() const
     {
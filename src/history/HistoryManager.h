@@ -9,6 +9,7 @@
 #include "util/GlobalChecks.h"
 #include <functional>
 #include <memory>
+#include <optional>
 
 /**
  * The history module is responsible for storing and retrieving "historical
@@ -319,6 +320,18 @@ class HistoryManager
     // (typically after commit) with a call to publishQueuedHistory.
     virtual void queueCurrentHistory() = 0;
 
+    // The two halves of maybeQueueHistoryCheckpoint(), for ledgers closed on
+    // the ledger-close thread. If `ledger` -- which need not be the LCL yet
+    // -- is a checkpoint and there is a writable archive, the first writes
+    // its publish-queue row, within the caller's SQL transaction and on the
+    // caller's thread, and returns the queued state. That state must then
+    // be passed to the second, on the main thread, before publishQueuedHistory
+    // or any bucket garbage collection.
+    virtual std::optional<HistoryArchiveState>
+    maybeWriteHistoryCheckpoint(uint32_t ledger) = 0;
+    virtual void
+    recordQueuedHistoryCheckpoint(HistoryArchiveState const& has) = 0;
+
     // Return the youngest ledger still in the outgoing publish queue;
     // returns 0 if the publish queue has nothing in it.
     virtual uint32_t getMinLedgerQueuedToPublish() = 0;
@@ -341,6 +354,12 @@ class HistoryManager
     // queue.
     virtual std::vector<std::string> getBucketsReferencedByPublishQueue() = 0;
 
+    // Return whether the bucket with the given hex hash is referenced by the
+    // persistent (DB) publish queue; cheaper than searching the result of
+    // getBucketsReferencedByPublishQueue for a single bucket.
+    virtual bool
+    isBucketReferencedByPublishQueue(std::string const& bucketHash) = 0;
+
     // Return the full set of HistoryArchiveStates in the persistent (DB)
     // publish queue.
     virtual std::vector<HistoryArchiveState> getPublishQueueStates() = 0;
@@ -198,32 +198,41 @@ bool
 HistoryManagerImpl::maybeQueueHistoryCheckpoint()
 {
     uint32_t lcl = mApp.getLedgerManager().getLastClosedLedgerNum();
-    if (!publishCheckpointOnLedgerClose(lcl))
+    auto has = maybeWriteHistoryCheckpoint(lcl);
+    if (!has)
     {
         return false;
     }
+    recordQueuedHistoryCheckpoint(*has);
+    return true;
+}
+
+std::optional<HistoryArchiveState>
+HistoryManagerImpl::maybeWriteHistoryCheckpoint(uint32_t ledger)
+{
+    if (!publishCheckpointOnLedgerClose(ledger))
+    {
+        return std::nullopt;
+    }
 
     if (!mApp.getHistoryArchiveManager().hasAnyWritableHistoryArchive())
     {
         CLOG_DEBUG(History,
                    "Skipping checkpoint, no writable history archives");
-        return false;
+        return std::nullopt;
     }
 
-    queueCurrentHistory();
-    return true;
+    return std::make_optional(writeHistoryCheckpoint(ledger));
 }
 
-void
-HistoryManagerImpl::queueCurrentHistory()
+HistoryArchiveState
+HistoryManagerImpl::writeHistoryCheckpoint(uint32_t ledger)
 {
     ZoneScoped;
-    auto ledger = mApp.getLedgerManager().getLastClosedLedgerNum();
     HistoryArchiveState has(ledger, mApp.getBucketManager().getBucketList(),
                             mApp.getConfig().NETWORK_PASSPHRASE);
 
     CLOG_DEBUG(History, "Queueing publish state for ledger {}", ledger);
-    mEnqueueTimes.emplace(ledger, std::chrono::steady_clock::now());
 
     auto state = has.toString();
     auto prep = mApp.getDatabase().getPreparedStatement(
@@ -236,7 +245,13 @@ HistoryManagerImpl::queueCurrentHistory()
         ZoneNamedN(insertPublishQueueZone, "insert publishqueue", true);
         st.execute(true);
     }
+    return has;
+}
 
+void
+HistoryManagerImpl::recordQueuedHistoryCheckpoint(
+    HistoryArchiveState const& has)
+{
     // We have now written the current HAS to the database, so
     // it's "safe" to crash (at least after the enclosing tx commits);
     // but that HAS might have merges running and if we throw it
@@ -244,11 +259,19 @@ HistoryManagerImpl::queueCurrentHistory()
     // them. So instead we're going to insert the HAS we have in hand
     // into the in-memory publish queue in order to preserve those
     // merges-in-progress, avoid restarting them.
-
+    mEnqueueTimes.emplace(has.currentLedger, std::chrono::steady_clock::now());
     mPublishQueued++;
     mPublishQueueBuckets.addBuckets(has.allBuckets());
 }
 
+void
+HistoryManagerImpl::queueCurrentHistory()
+{
+    ZoneScoped;
+    recordQueuedHistoryCheckpoint(writeHistoryCheckpoint(
+        mApp.getLedgerManager().getLastClosedLedgerNum()));
+}
+
 void
 HistoryManagerImpl::takeSnapshotAndPublish(HistoryArchiveState const& has)
 {
@@ -365,18 +388,23 @@ HistoryManagerImpl::loadBucketsReferencedByPublishQueue()
     return result;
 }
 
-std::vector<std::string>
-HistoryManagerImpl::getBucketsReferencedByPublishQueue()
+PublishQueueBuckets const&
+HistoryManagerImpl::getPublishQueueBuckets()
 {
-    ZoneScoped;
     if (!mPublishQueueBucketsFilled)
     {
         mPublishQueueBuckets.setBuckets(loadBucketsReferencedByPublishQueue());
         mPublishQueueBucketsFilled = true;
     }
+    return mPublishQueueBuckets;
+}
 
+std::vector<std::string>
+HistoryManagerImpl::getBucketsReferencedByPublishQueue()
+{
+    ZoneScoped;
     std::vector<std::string> buckets;
-    for (auto const& s : mPublishQueueBuckets.map())
+    for (auto const& s : getPublishQueueBuckets().map())
     {
         buckets.push_back(s.first);
     }
@@ -384,6 +412,15 @@ HistoryManagerImpl::getBucketsReferencedByPublishQueue()
     return buckets;
 }
 
+bool
+HistoryManagerImpl::isBucketReferencedByPublishQueue(
+    std::string const& bucketHash)
+{
+    ZoneScoped;
+    auto const& buckets = getPublishQueueBuckets().map();
+    return buckets.find(bucketHash) != buckets.end();
+}
+
 std::vector<std::string>
 HistoryManagerImpl::getMissingBucketsReferencedByPublishQueue()
 {
@@ -38,6 +38,8 @@ class HistoryManagerImpl : public HistoryManager
     UnorderedMap<uint32_t, std::chrono::steady_clock::time_point> mEnqueueTimes;
 
     PublishQueueBuckets::BucketCount loadBucketsReferencedByPublishQueue();
+    PublishQueueBuckets const& getPublishQueueBuckets();
+    HistoryArchiveState writeHistoryCheckpoint(uint32_t ledger);
 #ifdef BUILD_TESTS
     bool mPublicationEnabled{true};
 #endif
@@ -56,6 +58,11 @@ class HistoryManagerImpl : public HistoryManager
 
     void queueCurrentHistory() override;
 
+    std::optional<HistoryArchiveState>
+    maybeWriteHistoryCheckpoint(uint32_t ledger) override;
+
+    void recordQueuedHistoryCheckpoint(HistoryArchiveState const& has) override;
+
     void takeSnapshotAndPublish(HistoryArchiveState const& has);
 
     uint32_t getMinLedgerQueuedToPublish() override;
@@ -69,6 +76,9 @@ class HistoryManagerImpl : public HistoryManager
 
     std::vector<std::string> getBucketsReferencedByPublishQueue() override;
 
+    bool
+    isBucketReferencedByPublishQueue(std::string const& bucketHash) override;
+
     std::vector<HistoryArchiveState> getPublishQueueStates() override;
 
     void historyPublished(uint32_t ledgerSeq,
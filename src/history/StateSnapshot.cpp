@@ -149,7 +149,14 @@ StateSnapshot::differingHASFiles(HistoryArchiveState const& other)
     {
         auto b = mApp.getBucketManager().getBucketByHash(hexToBin256(hash));
         releaseAssert(b);
-        addIfExists(std::make_shared<FileTransferInfo>(*b));
+        if (b->isCompressed())
+        {
+            files.push_back(std::make_shared<FileTransferInfo>(mSnapDir, *b));
+        }
+        else
+        {
+            addIfExists(std::make_shared<FileTransferInfo>(*b));
+        }
     }
 
     return files;
@@ -2,6 +2,7 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "bucket/Bucket.h"
 #include "bucket/BucketManager.h"
 #include "bucket/BucketTests.h"
 #include "catchup/test/CatchupWorkTests.h"
@@ -447,6 +448,39 @@ TEST_CASE("History publish to multiple archives", "[history]")
     REQUIRE(catchupSimulation.catchupOffline(catchupApp, checkpointLedger));
 }
 
+#ifdef USE_ZSTD
+TEST_CASE("History publish with compressed buckets", "[history][publish]")
+{
+    // The publishing node compresses its buckets, the catching-up node
+    // doesn't; catchup verifies that what was published is the raw XDR.
+    CatchupSimulation catchupSimulation{
+        VirtualClock::VIRTUAL_TIME,
+        std::make_shared<CompressedBucketsTmpDirHistoryConfigurator>()};
+    auto checkpointLedger = catchupSimulation.getLastCheckpointLedger(3);
+    catchupSimulation.ensureOfflineCatchupPossible(checkpointLedger);
+
+    auto& bm = catchupSimulation.getApp().getBucketManager();
+    auto has = catchupSimulation.getApp()
+                   .getLedgerManager()
+                   .getLastClosedLedgerHAS();
+    bool sawCompressed = false;
+    for (auto const& h : has.allBuckets())
+    {
+        auto b = bm.getBucketByHash(hexToBin256(h));
+        if (b && !b->getFilename().empty())
+        {
+            sawCompressed = sawCompressed || b->isCompressed();
+        }
+    }
+    REQUIRE(sawCompressed);
+
+    auto app = catchupSimulation.createCatchupApplication(
+        std::numeric_limits<uint32_t>::max(), Config::TESTDB_ON_DISK_SQLITE,
+        "app");
+    REQUIRE(catchupSimulation.catchupOffline(app, checkpointLedger));
+}
+#endif
+
 TEST_CASE("History catchup with extra validation", "[history][publish]")
 {
     CatchupSimulation catchupSimulation{};
@@ -123,6 +123,18 @@ RealGenesisTmpDirHistoryConfigurator::configure(Config& mCfg,
     return mCfg;
 }
 
+Config&
+CompressedBucketsTmpDirHistoryConfigurator::configure(Config& mCfg,
+                                                      bool writable) const
+{
+    TmpDirHistoryConfigurator::configure(mCfg, writable);
+    if (writable)
+    {
+        mCfg.BUCKET_COMPRESSION_LEVEL = 3;
+    }
+    return mCfg;
+}
+
 BucketOutputIteratorForTesting::BucketOutputIteratorForTesting(
     std::string const& tmpDir, uint32_t protocolVersion, MergeCounters& mc,
     asio::io_context& ctx)
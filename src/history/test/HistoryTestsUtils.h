@@ -98,6 +98,13 @@ class RealGenesisTmpDirHistoryConfigurator : public TmpDirHistoryConfigurator
     Config& configure(Config& cfg, bool writable) const override;
 };
 
+class CompressedBucketsTmpDirHistoryConfigurator
+    : public TmpDirHistoryConfigurator
+{
+  public:
+    Config& configure(Config& cfg, bool writable) const override;
+};
+
 class BucketOutputIteratorForTesting : public BucketOutputIterator
 {
     const size_t NUM_ITEMS_PER_BUCKET = 5;
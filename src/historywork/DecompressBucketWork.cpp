@@ -0,0 +1,127 @@
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "historywork/DecompressBucketWork.h"
+#include "main/Application.h"
+#include "util/Logging.h"
+#include "util/ZstdSeekable.h"
+#include <fmt/format.h>
+
+#include <Tracy.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+namespace stellar
+{
+
+DecompressBucketWork::DecompressBucketWork(Application& app,
+                                           std::string const& bucketFile,
+                                           std::string const& outFile)
+    : BasicWork(app, "decompress-bucket-" + bucketFile,
+                BasicWork::RETRY_A_FEW)
+    , mBucketFile(bucketFile)
+    , mOutFile(outFile)
+{
+}
+
+BasicWork::State
+DecompressBucketWork::onRun()
+{
+    ZoneScoped;
+    if (mDone)
+    {
+        if (mEc)
+        {
+            return State::WORK_FAILURE;
+        }
+        return State::WORK_SUCCESS;
+    }
+
+    spawnDecompressor();
+    return State::WORK_WAITING;
+}
+
+void
+DecompressBucketWork::onReset()
+{
+    mDone = false;
+    mEc.clear();
+    std::remove(mOutFile.c_str());
+}
+
+void
+DecompressBucketWork::spawnDecompressor()
+{
+    std::string bucketFile = mBucketFile;
+    std::string outFile = mOutFile;
+    Application& app = this->mApp;
+    std::weak_ptr<DecompressBucketWork> weak(
+        std::static_pointer_cast<DecompressBucketWork>(shared_from_this()));
+    app.postOnBackgroundThread(
+        [&app, bucketFile, outFile, weak]() {
+            std::error_code ec;
+
+            auto self = weak.lock();
+            if (!self || self->isAborting())
+            {
+                return;
+            }
+
+            try
+            {
+                ZoneNamedN(decompressZone, "bucket decompress", true);
+                CLOG_DEBUG(History, "Decompressing bucket {} to {}",
+                           bucketFile, outFile);
+
+                std::ifstream in(bucketFile, std::ifstream::binary);
+                if (!in)
+                {
+                    throw std::runtime_error(fmt::format(
+                        FMT_STRING("Error opening file {}"), bucketFile));
+                }
+                in.exceptions(std::ios::badbit);
+                ZstdSeekableReader zin(in);
+
+                std::ofstream out(outFile, std::ofstream::binary |
+                                               std::ofstream::trunc);
+                if (!out)
+                {
+                    throw std::runtime_error(fmt::format(
+                        FMT_STRING("Error opening file {}"), outFile));
+                }
+                out.exceptions(std::ios::failbit | std::ios::badbit);
+                std::vector<char> buf(1024 * 1024);
+                size_t n;
+                while ((n = zin.read(buf.data(), buf.size())) > 0)
+                {
+                    out.write(buf.data(), n);
+                }
+                out.close();
+            }
+            catch (std::exception const& e)
+            {
+                CLOG_WARNING(History, "Failed to decompress bucket {}: {}",
+                             bucketFile, e.what());
+                ec = std::make_error_code(std::errc::io_error);
+            }
+
+            // As in VerifyBucketWork: BasicWork's state is only touched on
+            // the main thread.
+            app.postOnMainThread(
+                [weak, ec]() {
+                    auto self = weak.lock();
+                    if (self)
+                    {
+                        self->mEc = ec;
+                        self->mDone = true;
+                        self->wakeUp();
+                    }
+                },
+                "DecompressBucket: finish");
+        },
+        "DecompressBucket: start in background");
+}
+}
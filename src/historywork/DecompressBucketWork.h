@@ -0,0 +1,37 @@
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#pragma once
+
+#include "work/Work.h"
+
+namespace stellar
+{
+
+// Writes the raw XDR of a zstd-compressed local bucket file to another file,
+// on a background thread, so that it can be published.
+class DecompressBucketWork : public BasicWork
+{
+    std::string const mBucketFile;
+    std::string const mOutFile;
+    bool mDone{false};
+    std::error_code mEc;
+
+    void spawnDecompressor();
+
+  public:
+    DecompressBucketWork(Application& app, std::string const& bucketFile,
+                         std::string const& outFile);
+    ~DecompressBucketWork() = default;
+
+  protected:
+    BasicWork::State onRun() override;
+    void onReset() override;
+    bool
+    onAbort() override
+    {
+        return true;
+    };
+};
+}
@@ -6,6 +6,7 @@
 #include "bucket/BucketManager.h"
 #include "history/HistoryArchiveManager.h"
 #include "history/StateSnapshot.h"
+#include "historywork/DecompressBucketWork.h"
 #include "historywork/GetHistoryArchiveStateWork.h"
 #include "historywork/GzipFileWork.h"
 #include "historywork/PutFilesWork.h"
@@ -72,10 +73,25 @@ PutSnapshotFilesWork::doWork()
         auto status = WorkUtils::getWorkStatus(works);
         if (status == State::WORK_SUCCESS)
         {
-            // Step 2: Gzip all unique files
+            // Step 2: Gzip all unique files, decompressing compressed
+            // buckets first
             for (auto const& f : getFilesToZip())
             {
-                mGzipFilesWorks.emplace_back(addWork<GzipFileWork>(f, true));
+                if (f.second.empty())
+                {
+                    mGzipFilesWorks.emplace_back(
+                        addWork<GzipFileWork>(f.first, true));
+                }
+                else
+                {
+                    std::vector<std::shared_ptr<BasicWork>> seq{
+                        std::make_shared<DecompressBucketWork>(mApp, f.second,
+                                                               f.first),
+                        std::make_shared<GzipFileWork>(mApp, f.first, true)};
+                    mGzipFilesWorks.emplace_back(addWork<WorkSequence>(
+                        "decompress-and-zip-bucket", seq,
+                        BasicWork::RETRY_NEVER));
+                }
             }
             return State::WORK_RUNNING;
         }
@@ -104,7 +120,7 @@ PutSnapshotFilesWork::doReset()
     mUploadSeqs.clear();
 }
 
-UnorderedSet<std::string>
+UnorderedMap<std::string, std::string>
 PutSnapshotFilesWork::getFilesToZip()
 {
     // Sanity check: there are states for all archives
@@ -114,13 +130,14 @@ PutSnapshotFilesWork::getFilesToZip()
         throw std::runtime_error("Corrupted GetHistoryArchiveStateWork");
     }
 
-    UnorderedSet<std::string> filesToZip{};
+    UnorderedMap<std::string, std::string> filesToZip{};
     for (auto const& getState : mGetStateWorks)
     {
         for (auto const& f :
              mSnapshot->differingHASFiles(getState->getHistoryArchiveState()))
         {
-            filesToZip.insert(f->localPath_nogz());
+            filesToZip.emplace(f->localPath_nogz(),
+                               f->compressedBucketPath());
         }
     }
 
@@ -6,7 +6,7 @@
 
 #include "history/FileTransferInfo.h"
 #include "history/HistoryArchive.h"
-#include "util/UnorderedSet.h"
+#include "util/UnorderedMap.h"
 #include "work/Work.h"
 
 namespace stellar
@@ -24,7 +24,9 @@ class PutSnapshotFilesWork : public Work
     std::list<std::shared_ptr<BasicWork>> mGzipFilesWorks;
     std::list<std::shared_ptr<BasicWork>> mUploadSeqs;
 
-    UnorderedSet<std::string> getFilesToZip();
+    // Local paths of the files to zip, each mapped to the compressed bucket
+    // file it must first be decompressed from (or to an empty string).
+    UnorderedMap<std::string, std::string> getFilesToZip();
 
   public:
     PutSnapshotFilesWork(Application& app,
@@ -9,6 +9,8 @@
 #include "main/ErrorMessages.h"
 #include "util/Fs.h"
 #include "util/Logging.h"
+#include "util/MappedFile.h"
+#include "util/ZstdSeekable.h"
 #include <fmt/format.h>
 
 #include <Tracy.hpp>
@@ -83,10 +85,31 @@ VerifyBucketWork::spawnVerifier()
                 }
                 in.exceptions(std::ios::badbit);
                 char buf[4096];
-                while (in)
+                if (ZstdSeekableReader::hasMagic(in))
                 {
-                    in.read(buf, sizeof(buf));
-                    hasher.add(ByteSlice(buf, in.gcount()));
+                    // A compressed local bucket; its hash is that of the
+                    // XDR it decompresses to.
+                    ZstdSeekableReader zin(in);
+                    size_t n;
+                    while ((n = zin.read(buf, sizeof(buf))) > 0)
+                    {
+                        hasher.add(ByteSlice(buf, n));
+                    }
+                }
+                else if (MappedFile::isSupported())
+                {
+                    in.close();
+                    MappedFile mapped(filename);
+                    mapped.adviseSequential();
+                    hasher.add(ByteSlice(mapped.data(), mapped.size()));
+                }
+                else
+                {
+                    while (in)
+                    {
+                        in.read(buf, sizeof(buf));
+                        hasher.add(ByteSlice(buf, in.gcount()));
+                    }
                 }
                 uint256 vHash = hasher.finish();
                 if (vHash == hash)
@@ -119,6 +119,21 @@ InMemoryLedgerTxnRoot::dropAccounts()
 {
 }
 
+void
+InMemoryLedgerTxnRoot::loadInflationVotes()
+{
+}
+
+void
+InMemoryLedgerTxnRoot::loadOrderBook()
+{
+}
+
+void
+InMemoryLedgerTxnRoot::clearCaches()
+{
+}
+
 void
 InMemoryLedgerTxnRoot::dropData()
 {
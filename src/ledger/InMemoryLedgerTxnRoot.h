@@ -71,6 +71,9 @@ class InMemoryLedgerTxnRoot : public AbstractLedgerTxnParent
     void deleteObjectsModifiedOnOrAfterLedger(uint32_t ledger) const override;
 
     void dropAccounts() override;
+    void loadInflationVotes() override;
+    void loadOrderBook() override;
+    void clearCaches() override;
     void dropData() override;
     void dropOffers() override;
     void dropTrustLines() override;
@@ -0,0 +1,108 @@
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/InMemoryOrderBook.h"
+#include "util/GlobalChecks.h"
+
+namespace stellar
+{
+
+void
+InMemoryOrderBook::markUnloaded()
+{
+    mLoaded = false;
+    mBooks.clear();
+    mOffers.clear();
+}
+
+void
+InMemoryOrderBook::reset()
+{
+    markUnloaded();
+    mLoaded = true;
+}
+
+void
+InMemoryOrderBook::update(int64_t offerID, LedgerEntry const* offer)
+{
+    if (!mLoaded)
+    {
+        return;
+    }
+
+    auto it = mOffers.find(offerID);
+    if (it != mOffers.end())
+    {
+        auto bookIt = mBooks.find(it->second.mAssets);
+        releaseAssert(bookIt != mBooks.end());
+        auto erased = bookIt->second.erase(it->second.mDescriptor);
+        releaseAssert(erased == 1);
+        if (bookIt->second.empty())
+        {
+            mBooks.erase(bookIt);
+        }
+        mOffers.erase(it);
+    }
+
+    if (offer)
+    {
+        auto const& oe = offer->data.offer();
+        releaseAssert(oe.offerID == offerID);
+        Location loc{AssetPair{oe.buying, oe.selling},
+                     OfferDescriptor{oe.price, oe.offerID}};
+        auto res = mBooks[loc.mAssets].emplace(
+            loc.mDescriptor, std::make_shared<LedgerEntry const>(*offer));
+        releaseAssert(res.second);
+        mOffers.emplace(offerID, std::move(loc));
+    }
+}
+
+InMemoryOrderBook::Offers const*
+InMemoryOrderBook::findOffers(Asset const& buying, Asset const& selling) const
+{
+    releaseAssert(mLoaded);
+    auto it = mBooks.find(AssetPair{buying, selling});
+    return it == mBooks.end() ? nullptr : &it->second;
+}
+
+InMemoryOrderBook::Offers::const_iterator
+InMemoryOrderBook::findBestOffer(Offers const& offers,
+                                 OfferDescriptor const* worseThan) const
+{
+    // Offers are sorted best first, so the first offer that `worseThan` is
+    // better than is the upper bound of `worseThan`.
+    return worseThan ? offers.upper_bound(*worseThan) : offers.begin();
+}
+
+std::shared_ptr<LedgerEntry const>
+InMemoryOrderBook::getBestOffer(Asset const& buying, Asset const& selling,
+                                OfferDescriptor const* worseThan) const
+{
+    auto offers = findOffers(buying, selling);
+    if (!offers)
+    {
+        return nullptr;
+    }
+    auto it = findBestOffer(*offers, worseThan);
+    return it == offers->end() ? nullptr : it->second;
+}
+
+void
+InMemoryOrderBook::forEachBestOffer(
+    Asset const& buying, Asset const& selling,
+    OfferDescriptor const* worseThan, size_t maxOffers,
+    std::function<void(LedgerEntry const&)> f) const
+{
+    auto offers = findOffers(buying, selling);
+    if (!offers)
+    {
+        return;
+    }
+    for (auto it = findBestOffer(*offers, worseThan);
+         it != offers->end() && maxOffers > 0; ++it, --maxOffers)
+    {
+        f(*it->second);
+    }
+}
+}
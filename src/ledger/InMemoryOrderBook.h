@@ -0,0 +1,83 @@
+#pragma once
+
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerTxn.h"
+#include "util/UnorderedMap.h"
+#include "xdr/Stellar-ledger-entries.h"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+
+namespace stellar
+{
+
+// InMemoryOrderBook is an in-memory image of the offers table: for every
+// asset pair, its offers sorted best first in the order induced by
+// isBetterOffer (price, then offerID), which is also the order of the SQL
+// queries in loadBestOffers. LedgerTxnRoot keeps it up to date with every
+// offer it commits, so that best offers can be found without going to the
+// database at all.
+class InMemoryOrderBook
+{
+  public:
+    // Until the order book is loaded, updates are ignored and offers can't be
+    // queried.
+    bool
+    isLoaded() const
+    {
+        return mLoaded;
+    }
+    void markUnloaded();
+
+    // Empty the order book and mark it loaded, for an empty offers table.
+    // Offers are then added one by one with update().
+    void reset();
+
+    // Record the current state of offer `offerID`; `offer` is null if the
+    // offer was deleted.
+    void update(int64_t offerID, LedgerEntry const* offer);
+
+    // The best offer selling `selling` for `buying` that is worse than
+    // `worseThan` (or the best offer if `worseThan` is null), or null if there
+    // is no such offer.
+    std::shared_ptr<LedgerEntry const>
+    getBestOffer(Asset const& buying, Asset const& selling,
+                 OfferDescriptor const* worseThan) const;
+
+    // Call `f` on the best offer as getBestOffer() would find it, and then on
+    // the offers following it, up to `maxOffers` offers in total.
+    void forEachBestOffer(Asset const& buying, Asset const& selling,
+                          OfferDescriptor const* worseThan, size_t maxOffers,
+                          std::function<void(LedgerEntry const&)> f) const;
+
+    size_t
+    size() const
+    {
+        return mOffers.size();
+    }
+
+  private:
+    typedef std::map<OfferDescriptor, std::shared_ptr<LedgerEntry const>,
+                     IsBetterOfferComparator>
+        Offers;
+
+    struct Location
+    {
+        AssetPair mAssets;
+        OfferDescriptor mDescriptor;
+    };
+
+    Offers::const_iterator findBestOffer(Offers const& offers,
+                                         OfferDescriptor const* worseThan) const;
+    Offers const* findOffers(Asset const& buying, Asset const& selling) const;
+
+    bool mLoaded{false};
+    UnorderedMap<AssetPair, Offers, AssetPairHash> mBooks;
+    UnorderedMap<int64_t, Location> mOffers;
+};
+}
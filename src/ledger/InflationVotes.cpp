@@ -0,0 +1,98 @@
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/InflationVotes.h"
+#include "crypto/KeyUtils.h"
+#include "util/GlobalChecks.h"
+
+namespace stellar
+{
+
+int64_t const InflationVotes::MIN_VOTER_BALANCE = 1000000000;
+
+void
+InflationVotes::markUnloaded()
+{
+    mLoaded = false;
+    mVoters.clear();
+    mTallies.clear();
+    mRanking.clear();
+}
+
+void
+InflationVotes::reset()
+{
+    markUnloaded();
+    mLoaded = true;
+}
+
+void
+InflationVotes::addVotes(AccountID const& dest, int64_t votes)
+{
+    auto it = mTallies.find(dest);
+    if (it == mTallies.end())
+    {
+        releaseAssert(votes > 0);
+        Tally tally{votes, KeyUtils::toStrKey(dest)};
+        mRanking.emplace(tally.mVotes, tally.mDestStrKey);
+        mTallies.emplace(dest, std::move(tally));
+        return;
+    }
+
+    auto& tally = it->second;
+    auto node = mRanking.extract(RankKey{tally.mVotes, tally.mDestStrKey});
+    releaseAssert(!node.empty());
+    tally.mVotes += votes;
+    releaseAssert(tally.mVotes >= 0);
+    if (tally.mVotes == 0)
+    {
+        mTallies.erase(it);
+    }
+    else
+    {
+        node.value().first = tally.mVotes;
+        mRanking.insert(std::move(node));
+    }
+}
+
+void
+InflationVotes::update(AccountID const& id, AccountEntry const* account)
+{
+    if (!mLoaded)
+    {
+        return;
+    }
+
+    auto it = mVoters.find(id);
+    if (it != mVoters.end())
+    {
+        addVotes(it->second.mDest, -it->second.mBalance);
+        mVoters.erase(it);
+    }
+
+    if (account && account->inflationDest &&
+        account->balance >= MIN_VOTER_BALANCE)
+    {
+        mVoters.emplace(id, Vote{*account->inflationDest, account->balance});
+        addVotes(*account->inflationDest, account->balance);
+    }
+}
+
+std::vector<InflationWinner>
+InflationVotes::getWinners(size_t maxWinners, int64_t minVotes) const
+{
+    releaseAssert(mLoaded);
+    std::vector<InflationWinner> winners;
+    for (auto const& rank : mRanking)
+    {
+        if (winners.size() >= maxWinners || rank.first < minVotes)
+        {
+            break;
+        }
+        winners.push_back(
+            {KeyUtils::fromStrKey<PublicKey>(rank.second), rank.first});
+    }
+    return winners;
+}
+}
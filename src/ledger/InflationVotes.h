@@ -0,0 +1,85 @@
+#pragma once
+
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerTxn.h"
+#include "util/UnorderedMap.h"
+#include "xdr/Stellar-ledger-entries.h"
+
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace stellar
+{
+
+// InflationVotes is an in-memory image of the inflation vote tally of the
+// accounts table: for every inflation destination, the sum of the balances of
+// the accounts voting for it, counting only accounts holding at least
+// MIN_VOTER_BALANCE. LedgerTxnRoot keeps it up to date with every account it
+// commits, so that the top winners can be enumerated without the full-table
+// aggregate query.
+//
+// Ordering matches the SQL query this replaces: votes descending, then strkey
+// of the destination descending.
+class InflationVotes
+{
+  public:
+    static int64_t const MIN_VOTER_BALANCE;
+
+    // Until the tally is loaded, updates are ignored and winners can't be
+    // queried.
+    bool
+    isLoaded() const
+    {
+        return mLoaded;
+    }
+    void markUnloaded();
+
+    // Empty the tally and mark it loaded, for an empty accounts table. Voters
+    // are then added one by one with update().
+    void reset();
+
+    // Record the current state of account `id`; `account` is null if the
+    // account was deleted.
+    void update(AccountID const& id, AccountEntry const* account);
+
+    // Destinations with at least `minVotes` votes, at most `maxWinners` of
+    // them, best first.
+    std::vector<InflationWinner> getWinners(size_t maxWinners,
+                                            int64_t minVotes) const;
+
+    size_t
+    numVoters() const
+    {
+        return mVoters.size();
+    }
+
+  private:
+    struct Vote
+    {
+        AccountID mDest;
+        int64_t mBalance;
+    };
+
+    struct Tally
+    {
+        int64_t mVotes;
+        std::string mDestStrKey;
+    };
+
+    typedef std::pair<int64_t, std::string> RankKey;
+
+    void addVotes(AccountID const& dest, int64_t votes);
+
+    bool mLoaded{false};
+    UnorderedMap<AccountID, Vote> mVoters;
+    UnorderedMap<AccountID, Tally> mTallies;
+    std::set<RankKey, std::greater<RankKey>> mRanking;
+};
+}
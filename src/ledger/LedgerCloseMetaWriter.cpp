@@ -0,0 +1,294 @@
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerCloseMetaWriter.h"
+#include "util/GlobalChecks.h"
+#include "util/Logging.h"
+#include "util/XDRStream.h"
+
+#include "medida/counter.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+#include <Tracy.hpp>
+#include <fmt/format.h>
+
+#include <cstdio>
+#include <stdexcept>
+
+namespace stellar
+{
+
+LedgerCloseMetaWriter::FullQueuePolicy
+LedgerCloseMetaWriter::parseFullQueuePolicy(std::string const& s)
+{
+    if (s == "BLOCK")
+    {
+        return FullQueuePolicy::BLOCK;
+    }
+    if (s == "SPILL")
+    {
+        return FullQueuePolicy::SPILL;
+    }
+    throw std::invalid_argument(
+        fmt::format("unknown metadata output queue policy '{}', expected "
+                    "BLOCK or SPILL",
+                    s));
+}
+
+LedgerCloseMetaWriter::LedgerCloseMetaWriter(
+    std::unique_ptr<XDROutputFileStream> stream, size_t maxQueued,
+    FullQueuePolicy policy, std::string const& spillPath,
+    medida::MetricsRegistry& metrics)
+    : mStream(std::move(stream))
+    , mMaxQueued(maxQueued)
+    , mPolicy(policy)
+    , mSpillPath(spillPath)
+    , mQueueDepth(metrics.NewCounter({"ledger", "metastream", "queue-depth"}))
+    , mWriteTime(metrics.NewTimer({"ledger", "metastream", "async-write"}))
+    , mEnqueueBlocked(
+          metrics.NewTimer({"ledger", "metastream", "enqueue-blocked"}))
+    , mSpilled(metrics.NewMeter({"ledger", "metastream", "spilled"}, "ledger"))
+{
+    releaseAssert(mStream);
+    releaseAssert(mMaxQueued > 0);
+    mThread = std::thread{[this]() { run(); }};
+}
+
+LedgerCloseMetaWriter::~LedgerCloseMetaWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mQueueChanged.notify_all();
+    mThread.join();
+
+    if (mError)
+    {
+        try
+        {
+            std::rethrow_exception(mError);
+        }
+        catch (std::exception const& e)
+        {
+            CLOG_ERROR(Ledger, "Metadata stream writer failed: {}", e.what());
+        }
+    }
+    if (mSpillOut.is_open())
+    {
+        mSpillOut.close();
+        std::remove(mSpillPath.c_str());
+    }
+}
+
+void
+LedgerCloseMetaWriter::rethrowIfFailed()
+{
+    if (mError)
+    {
+        std::rethrow_exception(mError);
+    }
+}
+
+void
+LedgerCloseMetaWriter::spill(Record& record, bool restart)
+{
+    ZoneScoped;
+    // The spill file is only ever appended to here, and only truncated
+    // (`restart`) once the writer has consumed everything spilled so far.
+    // Called without mMutex: the writer never touches the spill file while
+    // no spilled record is outstanding.
+    if (!mSpillOut.is_open() || (restart && mSpillEnd != 0))
+    {
+        if (mSpillOut.is_open())
+        {
+            mSpillOut.close();
+        }
+        mSpillOut.open(mSpillPath, std::ios::binary | std::ios::trunc);
+        mSpillEnd = 0;
+    }
+
+    auto const& bytes = record.mBytes;
+    mSpillOut.write(bytes.data(), bytes.size());
+    mSpillOut.flush();
+    if (!mSpillOut)
+    {
+        throw std::runtime_error(
+            fmt::format("failed to spill metadata to {}", mSpillPath));
+    }
+    record.mSpillOffset = mSpillEnd;
+    record.mSpillSize = bytes.size();
+    mSpillEnd += static_cast<std::streamoff>(bytes.size());
+    record.mBytes.clear();
+    record.mBytes.shrink_to_fit();
+}
+
+void
+LedgerCloseMetaWriter::enqueue(LedgerCloseMeta const& meta)
+{
+    ZoneScoped;
+    Record record;
+    record.mBytes.resize(
+        XDROutputFileStream::serializeRecord(meta, record.mBytes));
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    rethrowIfFailed();
+    if (mInMemory >= mMaxQueued)
+    {
+        if (mPolicy == FullQueuePolicy::BLOCK)
+        {
+            auto blocked = mEnqueueBlocked.TimeScope();
+            mQueueChanged.wait(
+                lock, [&]() { return mInMemory < mMaxQueued || mError; });
+            rethrowIfFailed();
+        }
+        else
+        {
+            // Count the record as outstanding before letting go of the lock,
+            // so nothing decides the spill file is unused while it is written.
+            bool const restart = mSpilledOutstanding == 0;
+            ++mSpilledOutstanding;
+            lock.unlock();
+            try
+            {
+                spill(record, restart);
+            }
+            catch (...)
+            {
+                lock.lock();
+                if (!mError)
+                {
+                    --mSpilledOutstanding;
+                }
+                throw;
+            }
+            lock.lock();
+            rethrowIfFailed();
+            mSpilled.Mark();
+        }
+    }
+
+    if (!record.mBytes.empty())
+    {
+        ++mInMemory;
+    }
+    mQueue.emplace_back(std::move(record));
+    mQueueDepth.set_count(mQueue.size());
+    lock.unlock();
+    mQueueChanged.notify_all();
+}
+
+void
+LedgerCloseMetaWriter::drain()
+{
+    ZoneScoped;
+    std::unique_lock<std::mutex> lock(mMutex);
+    mQueueChanged.wait(lock,
+                       [&]() { return (mQueue.empty() && !mWriting) || mError; });
+    rethrowIfFailed();
+}
+
+size_t
+LedgerCloseMetaWriter::getQueueDepth()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mQueue.size() + (mWriting ? 1 : 0);
+}
+
+#ifdef BUILD_TESTS
+void
+LedgerCloseMetaWriter::setPausedForTesting(bool paused)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPaused = paused;
+    }
+    mQueueChanged.notify_all();
+}
+#endif
+
+void
+LedgerCloseMetaWriter::writeRecord(Record const& record)
+{
+    ZoneScoped;
+    auto timer = mWriteTime.TimeScope();
+    if (!record.mBytes.empty())
+    {
+        mStream->writeRecords(record.mBytes.data(), record.mBytes.size());
+    }
+    else
+    {
+        std::vector<char> bytes(record.mSpillSize);
+        std::ifstream in(mSpillPath, std::ios::binary);
+        in.seekg(record.mSpillOffset);
+        in.read(bytes.data(), bytes.size());
+        if (!in)
+        {
+            throw std::runtime_error(fmt::format(
+                "failed to read spilled metadata from {}", mSpillPath));
+        }
+        mStream->writeRecords(bytes.data(), bytes.size());
+    }
+    mStream->flush();
+}
+
+void
+LedgerCloseMetaWriter::run()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true)
+    {
+        mQueueChanged.wait(lock, [&]() {
+            return mStopping || (!mQueue.empty() && !mPaused);
+        });
+        if (mQueue.empty())
+        {
+            // stopping, and everything has been written
+            break;
+        }
+
+        Record record = std::move(mQueue.front());
+        mQueue.pop_front();
+        bool const spilled = record.mBytes.empty();
+        if (!spilled)
+        {
+            --mInMemory;
+        }
+        mWriting = true;
+        lock.unlock();
+        mQueueChanged.notify_all();
+
+        std::exception_ptr error;
+        try
+        {
+            writeRecord(record);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        lock.lock();
+        mWriting = false;
+        if (spilled)
+        {
+            --mSpilledOutstanding;
+        }
+        if (error)
+        {
+            mError = error;
+            mQueue.clear();
+            mInMemory = 0;
+            mSpilledOutstanding = 0;
+        }
+        mQueueDepth.set_count(mQueue.size());
+        mQueueChanged.notify_all();
+        if (mError)
+        {
+            break;
+        }
+    }
+}
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+#include "xdr/Stellar-ledger.h"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace medida
+{
+class Counter;
+class Meter;
+class MetricsRegistry;
+class Timer;
+}
+
+namespace stellar
+{
+
+class XDROutputFileStream;
+
+// LedgerCloseMetaWriter moves writes of LedgerCloseMeta to the
+// METADATA_OUTPUT_STREAM off the ledger-close path. Meta is serialized on the
+// calling (main) thread and handed to a dedicated writer thread that writes
+// and flushes it, in order, to the stream it owns.
+//
+// At most `maxQueued` serialized records are held in memory. When that many
+// are already waiting, enqueue() either blocks until the writer catches up
+// (FullQueuePolicy::BLOCK) or appends the record to a local spill file that
+// the writer reads back in order (FullQueuePolicy::SPILL), so that a slow
+// consumer costs disk rather than ledger-close latency.
+//
+// A write error on the writer thread is rethrown on the main thread by the
+// next call to enqueue() or drain(), just as a failing synchronous write
+// would have thrown from closeLedger.
+//
+// enqueue() returns before the record is written, so a caller that commits
+// the ledger next gets at-most-once delivery: a crash between the commit and
+// the write loses the record.
+class LedgerCloseMetaWriter : public NonMovableOrCopyable
+{
+  public:
+    enum class FullQueuePolicy
+    {
+        BLOCK,
+        SPILL
+    };
+
+    static FullQueuePolicy parseFullQueuePolicy(std::string const& s);
+
+    LedgerCloseMetaWriter(std::unique_ptr<XDROutputFileStream> stream,
+                          size_t maxQueued, FullQueuePolicy policy,
+                          std::string const& spillPath,
+                          medida::MetricsRegistry& metrics);
+
+    // Writes everything still queued before returning.
+    ~LedgerCloseMetaWriter();
+
+    void enqueue(LedgerCloseMeta const& meta);
+
+    // Wait until every record enqueued so far has been written and flushed.
+    void drain();
+
+    size_t getQueueDepth();
+
+#ifdef BUILD_TESTS
+    // While paused, the writer thread leaves the queue alone (unless the
+    // writer is being destroyed), so tests can fill it deterministically.
+    void setPausedForTesting(bool paused);
+#endif
+
+  private:
+    struct Record
+    {
+        // Either the serialized record, or empty if the record was spilled to
+        // `mSpillPath` at `mSpillOffset`.
+        std::vector<char> mBytes;
+        std::streamoff mSpillOffset{0};
+        size_t mSpillSize{0};
+    };
+
+    std::unique_ptr<XDROutputFileStream> mStream;
+    size_t const mMaxQueued;
+    FullQueuePolicy const mPolicy;
+    std::string const mSpillPath;
+
+    std::mutex mMutex;
+    std::condition_variable mQueueChanged;
+    std::deque<Record> mQueue;
+    size_t mInMemory{0};
+    size_t mSpilledOutstanding{0};
+    bool mWriting{false};
+    bool mStopping{false};
+    bool mPaused{false};
+    std::exception_ptr mError;
+
+    // Only touched by the thread calling enqueue().
+    std::ofstream mSpillOut;
+    std::streamoff mSpillEnd{0};
+
+    medida::Counter& mQueueDepth;
+    medida::Timer& mWriteTime;
+    medida::Timer& mEnqueueBlocked;
+    medida::Meter& mSpilled;
+
+    std::thread mThread;
+
+    void run();
+    void writeRecord(Record const& record);
+    void spill(Record& record, bool restart);
+    void rethrowIfFailed();
+};
+}
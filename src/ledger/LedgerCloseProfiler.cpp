@@ -0,0 +1,158 @@
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerCloseProfiler.h"
+#include "lib/json/json.h"
+
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+#include <xdrpp/types.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace stellar
+{
+
+size_t const LedgerCloseProfiler::MAX_PROFILES = 100;
+
+namespace
+{
+double
+toMilliseconds(std::chrono::nanoseconds d)
+{
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+}
+
+LedgerCloseProfiler::LedgerCloseProfiler(medida::MetricsRegistry& metrics)
+{
+    for (size_t i = 0; i < mTimers.size(); ++i)
+    {
+        mTimers[i] = &metrics.NewTimer(
+            {"ledger", "close-phase", getPhaseName(static_cast<Phase>(i))});
+    }
+}
+
+char const*
+LedgerCloseProfiler::getPhaseName(Phase phase)
+{
+    switch (phase)
+    {
+    case Phase::FEES:
+        return "fees";
+    case Phase::SIGNATURES:
+        return "signatures";
+    case Phase::APPLY:
+        return "apply";
+    case Phase::INVARIANTS:
+        return "invariants";
+    case Phase::UPGRADES:
+        return "upgrades";
+    case Phase::BUCKETS:
+        return "buckets";
+    case Phase::COMMIT:
+        return "commit";
+    case Phase::META:
+        return "meta";
+    default:
+        throw std::runtime_error("unknown ledger close phase");
+    }
+}
+
+void
+LedgerCloseProfiler::beginClose(uint32_t ledgerSeq)
+{
+    // Discards whatever was recorded for a close that threw.
+    mCurrent = Profile();
+    mCurrent.mLedgerSeq = ledgerSeq;
+    mProfiling = true;
+}
+
+void
+LedgerCloseProfiler::endClose(size_t numTxs, size_t numOps,
+                              std::chrono::nanoseconds total)
+{
+    if (!mProfiling)
+    {
+        return;
+    }
+    mProfiling = false;
+    mCurrent.mNumTxs = numTxs;
+    mCurrent.mNumOps = numOps;
+    mCurrent.mTotal = total;
+
+    // Invariants are checked (and timed) within the apply phase.
+    auto& apply = mCurrent.mPhases[static_cast<size_t>(Phase::APPLY)];
+    auto invariants = mCurrent.mPhases[static_cast<size_t>(Phase::INVARIANTS)];
+    apply = apply > invariants ? apply - invariants
+                               : std::chrono::nanoseconds::zero();
+
+    for (size_t i = 0; i < mTimers.size(); ++i)
+    {
+        mTimers[i]->Update(mCurrent.mPhases[i]);
+    }
+
+    std::lock_guard<std::mutex> guard(mProfilesMutex);
+    mProfiles.emplace_front(std::move(mCurrent));
+    if (mProfiles.size() > MAX_PROFILES)
+    {
+        mProfiles.pop_back();
+    }
+}
+
+void
+LedgerCloseProfiler::addPhaseTime(Phase phase, std::chrono::nanoseconds time)
+{
+    if (mProfiling)
+    {
+        mCurrent.mPhases[static_cast<size_t>(phase)] += time;
+    }
+}
+
+void
+LedgerCloseProfiler::addOperationTime(OperationType type,
+                                      std::chrono::nanoseconds time)
+{
+    if (mProfiling)
+    {
+        auto& times = mCurrent.mOperations[type];
+        ++times.mCount;
+        times.mTime += time;
+    }
+}
+
+Json::Value
+LedgerCloseProfiler::getJsonInfo(size_t count) const
+{
+    Json::Value res;
+    res["closes"] = Json::arrayValue;
+
+    std::lock_guard<std::mutex> guard(mProfilesMutex);
+    for (size_t i = 0; i < std::min(count, mProfiles.size()); ++i)
+    {
+        auto const& p = mProfiles[i];
+        Json::Value close;
+        close["ledger"] = p.mLedgerSeq;
+        close["txs"] = static_cast<Json::UInt64>(p.mNumTxs);
+        close["ops"] = static_cast<Json::UInt64>(p.mNumOps);
+        close["total_ms"] = toMilliseconds(p.mTotal);
+        for (size_t j = 0; j < p.mPhases.size(); ++j)
+        {
+            close["phases_ms"][getPhaseName(static_cast<Phase>(j))] =
+                toMilliseconds(p.mPhases[j]);
+        }
+        close["operations"] = Json::objectValue;
+        for (auto const& op : p.mOperations)
+        {
+            auto& o = close["operations"]
+                           [xdr::xdr_traits<OperationType>::enum_name(op.first)];
+            o["count"] = static_cast<Json::UInt64>(op.second.mCount);
+            o["ms"] = toMilliseconds(op.second.mTime);
+        }
+        res["closes"].append(close);
+    }
+    return res;
+}
+}
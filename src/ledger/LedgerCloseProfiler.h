@@ -0,0 +1,127 @@
+#pragma once
+
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+#include "xdr/Stellar-transaction.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+
+namespace Json
+{
+class Value;
+}
+
+namespace medida
+{
+class MetricsRegistry;
+class Timer;
+}
+
+namespace stellar
+{
+
+// LedgerCloseProfiler breaks the time spent applying each ledger down by
+// phase (and the time spent applying operations down by operation type), and
+// keeps the breakdown of the last MAX_PROFILES closes for the `closeprofile`
+// HTTP command. Each phase is also reported to a ledger.close-phase.* timer.
+//
+// Phases are timed with PhaseTimer, operations with addOperationTime; both
+// are only recorded between beginClose() and endClose(), and must be called
+// from the thread applying the ledger. getJsonInfo may be called from any
+// thread.
+class LedgerCloseProfiler : public NonMovableOrCopyable
+{
+  public:
+    enum class Phase
+    {
+        // Fee and sequence number processing.
+        FEES,
+        // Waiting for signature pre-verification to finish.
+        SIGNATURES,
+        // Applying transactions, except for invariant checks.
+        APPLY,
+        // Checking invariants after each operation.
+        INVARIANTS,
+        UPGRADES,
+        // Adding the ledger's changes to the bucket list.
+        BUCKETS,
+        // Committing the ledger's changes to the database.
+        COMMIT,
+        // Writing LedgerCloseMeta.
+        META,
+        COUNT
+    };
+
+    static size_t const MAX_PROFILES;
+
+    explicit LedgerCloseProfiler(medida::MetricsRegistry& metrics);
+
+    void beginClose(uint32_t ledgerSeq);
+    void endClose(size_t numTxs, size_t numOps,
+                  std::chrono::nanoseconds total);
+
+    void addPhaseTime(Phase phase, std::chrono::nanoseconds time);
+    void addOperationTime(OperationType type, std::chrono::nanoseconds time);
+
+    // Adds the time it is alive for to `phase`.
+    class PhaseTimer : public NonMovableOrCopyable
+    {
+        LedgerCloseProfiler& mProfiler;
+        Phase const mPhase;
+        std::chrono::steady_clock::time_point const mStart;
+
+      public:
+        PhaseTimer(LedgerCloseProfiler& profiler, Phase phase)
+            : mProfiler(profiler)
+            , mPhase(phase)
+            , mStart(std::chrono::steady_clock::now())
+        {
+        }
+
+        ~PhaseTimer()
+        {
+            mProfiler.addPhaseTime(mPhase,
+                                   std::chrono::steady_clock::now() - mStart);
+        }
+    };
+
+    // The last `count` closes, newest first.
+    Json::Value getJsonInfo(size_t count) const;
+
+    static char const* getPhaseName(Phase phase);
+
+  private:
+    struct OperationTimes
+    {
+        uint64_t mCount{0};
+        std::chrono::nanoseconds mTime{0};
+    };
+
+    struct Profile
+    {
+        uint32_t mLedgerSeq{0};
+        size_t mNumTxs{0};
+        size_t mNumOps{0};
+        std::chrono::nanoseconds mTotal{0};
+        std::array<std::chrono::nanoseconds, static_cast<size_t>(Phase::COUNT)>
+            mPhases{};
+        std::map<OperationType, OperationTimes> mOperations;
+    };
+
+    std::array<medida::Timer*, static_cast<size_t>(Phase::COUNT)> mTimers;
+
+    bool mProfiling{false};
+    Profile mCurrent;
+
+    mutable std::mutex mProfilesMutex;
+    std::deque<Profile> mProfiles;
+};
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerHashUtils.h"
+#include "util/NonCopyable.h"
+#include "util/RandomEvictionCache.h"
+#include "util/SegmentedLRUCache.h"
+#include "xdr/Stellar-ledger-entries.h"
+
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+
+#include <algorithm>
+#include <cctype>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace stellar
+{
+
+enum class LedgerEntryCachePolicy
+{
+    RANDOM_EVICTION,
+    SEGMENTED_LRU
+};
+
+inline LedgerEntryCachePolicy
+parseLedgerEntryCachePolicy(std::string const& s)
+{
+    if (s == "RANDOM_EVICTION")
+    {
+        return LedgerEntryCachePolicy::RANDOM_EVICTION;
+    }
+    if (s == "SEGMENTED_LRU")
+    {
+        return LedgerEntryCachePolicy::SEGMENTED_LRU;
+    }
+    throw std::invalid_argument("unknown entry cache policy '" + s +
+                                "', expected RANDOM_EVICTION or SEGMENTED_LRU");
+}
+
+// The entry cache of LedgerTxnRoot. With the SEGMENTED_LRU policy, offers
+// are admitted to a segmented LRU of their own, sized OFFER_PERCENT of the
+// cache, so that order book sweeps (or the prefetches of a catchup
+// checkpoint) cycle through that partition instead of evicting the accounts
+// and trustlines every transaction touches. RANDOM_EVICTION is the single
+// RandomEvictionCache this replaces, kept for comparison.
+//
+// Hits, misses and evictions are exported per LedgerEntryType as
+// ledger.entry-cache-{hit,miss,evict}.<type>.
+template <typename V> class LedgerEntryCache : public NonMovableOrCopyable
+{
+  public:
+    static size_t const OFFER_PERCENT = 25;
+
+  private:
+    using RandomCache = RandomEvictionCache<LedgerKey, V>;
+    using SegmentedCache = SegmentedLRUCache<LedgerKey, V>;
+
+    struct TypeMeters
+    {
+        medida::Meter& mHit;
+        medida::Meter& mMiss;
+        medida::Meter& mEvict;
+    };
+
+    LedgerEntryCachePolicy const mPolicy;
+    std::unique_ptr<RandomCache> mRandom;
+    std::unique_ptr<SegmentedCache> mOffers;
+    std::unique_ptr<SegmentedCache> mOthers;
+    std::vector<TypeMeters> mMeters;
+
+    TypeMeters&
+    meters(LedgerKey const& k)
+    {
+        return mMeters.at(static_cast<size_t>(k.type()));
+    }
+
+    template <typename F>
+    auto
+    withCache(LedgerKey const& k, F f)
+    {
+        if (mPolicy == LedgerEntryCachePolicy::RANDOM_EVICTION)
+        {
+            return f(*mRandom);
+        }
+        return f(k.type() == OFFER ? *mOffers : *mOthers);
+    }
+
+  public:
+    LedgerEntryCache(size_t maxSize, LedgerEntryCachePolicy policy,
+                     medida::MetricsRegistry& metrics)
+        : mPolicy(policy)
+    {
+        for (auto t : xdr::xdr_traits<LedgerEntryType>::enum_values())
+        {
+            std::string name = xdr::xdr_traits<LedgerEntryType>::enum_name(
+                static_cast<LedgerEntryType>(t));
+            std::transform(name.begin(), name.end(), name.begin(),
+                           [](unsigned char c) { return std::tolower(c); });
+            // LedgerEntryType values are dense from 0
+            if (mMeters.size() != static_cast<size_t>(t))
+            {
+                throw std::logic_error("unexpected LedgerEntryType values");
+            }
+            mMeters.push_back(TypeMeters{
+                metrics.NewMeter({"ledger", "entry-cache-hit", name}, "entry"),
+                metrics.NewMeter({"ledger", "entry-cache-miss", name},
+                                 "entry"),
+                metrics.NewMeter({"ledger", "entry-cache-evict", name},
+                                 "entry")});
+        }
+
+        auto onEvict = [this](LedgerKey const& k, V const&) {
+            meters(k).mEvict.Mark();
+        };
+        if (mPolicy == LedgerEntryCachePolicy::RANDOM_EVICTION)
+        {
+            mRandom = std::make_unique<RandomCache>(maxSize);
+            mRandom->setEvictionCallback(onEvict);
+        }
+        else
+        {
+            size_t offers = maxSize * OFFER_PERCENT / 100;
+            mOffers = std::make_unique<SegmentedCache>(offers);
+            mOthers = std::make_unique<SegmentedCache>(maxSize - offers);
+            mOffers->setEvictionCallback(onEvict);
+            mOthers->setEvictionCallback(onEvict);
+        }
+    }
+
+    size_t
+    size() const
+    {
+        return mRandom ? mRandom->size() : mOffers->size() + mOthers->size();
+    }
+
+    void
+    put(LedgerKey const& k, V const& v)
+    {
+        withCache(k, [&](auto& c) { c.put(k, v); });
+    }
+
+    // Counts a miss unless `countMisses` is false; hits are counted by get().
+    bool
+    exists(LedgerKey const& k, bool countMisses = true)
+    {
+        bool found = withCache(k, [&](auto& c) { return c.exists(k, false); });
+        if (!found && countMisses)
+        {
+            meters(k).mMiss.Mark();
+        }
+        return found;
+    }
+
+    V&
+    get(LedgerKey const& k)
+    {
+        V* v = withCache(k, [&](auto& c) { return c.maybeGet(k); });
+        if (v == nullptr)
+        {
+            meters(k).mMiss.Mark();
+            throw std::range_error("There is no such key in cache");
+        }
+        meters(k).mHit.Mark();
+        return *v;
+    }
+
+    void
+    clear()
+    {
+        if (mRandom)
+        {
+            mRandom->clear();
+        }
+        else
+        {
+            mOffers->clear();
+            mOthers->clear();
+        }
+    }
+};
+}
@@ -12,6 +12,7 @@ namespace stellar
 {
 
 class LedgerCloseData;
+class LedgerCloseProfiler;
 class Database;
 
 /**
@@ -91,6 +92,13 @@ class LedgerManager
     // `ledgerData`.
     virtual void valueExternalized(LedgerCloseData const& ledgerData) = 0;
 
+    // Return true while an externalized ledger is being applied on the
+    // ledger-close thread (see Config::PARALLEL_LEDGER_APPLY). Until it
+    // returns false again the LCL is not advanced, and the main thread must
+    // not touch ledger state: the ledger txn root, the bucket list or the
+    // ledger tables.
+    virtual bool isApplying() const = 0;
+
     // Return the LCL header and (complete, immutable) hash.
     virtual LedgerHeaderHistoryEntry const&
     getLastClosedLedgerHeader() const = 0;
@@ -130,6 +138,9 @@ class LedgerManager
 
     virtual Database& getDatabase() = 0;
 
+    // Per-phase timings of recent ledger closes.
+    virtual LedgerCloseProfiler& getCloseProfiler() = 0;
+
     // Called by application lifecycle events, system startup.
     virtual void startNewLedger() = 0;
 
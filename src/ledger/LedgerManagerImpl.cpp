@@ -17,6 +17,7 @@
 #include "herder/Upgrades.h"
 #include "history/HistoryManager.h"
 #include "ledger/FlushAndRotateMetaDebugWork.h"
+#include "ledger/LedgerCloseMetaWriter.h"
 #include "ledger/LedgerHeaderUtils.h"
 #include "ledger/LedgerRange.h"
 #include "ledger/LedgerTxn.h"
@@ -27,6 +28,7 @@
 #include "main/ErrorMessages.h"
 #include "overlay/OverlayManager.h"
 #include "transactions/OperationFrame.h"
+#include "transactions/SignaturePreVerifier.h"
 #include "transactions/TransactionSQL.h"
 #include "transactions/TransactionUtils.h"
 #include "util/Fs.h"
@@ -34,6 +36,7 @@
 #include "util/LogSlowExecution.h"
 #include "util/Logging.h"
 #include "util/ProtocolVersion.h"
+#include "util/TmpDir.h"
 #include "util/XDRCereal.h"
 #include "util/XDROperators.h"
 #include "util/XDRStream.h"
@@ -132,21 +135,40 @@ LedgerManagerImpl::LedgerManagerImpl(Application& app)
     , mPrefetchHitRate(
           app.getMetrics().NewHistogram({"ledger", "prefetch", "hit-rate"}))
     , mLedgerClose(app.getMetrics().NewTimer({"ledger", "ledger", "close"}))
+    , mLedgerCloseMainThreadTime(
+          app.getMetrics().NewTimer({"ledger", "close", "main-thread"}))
+    , mLedgerCloseBackgroundTime(
+          app.getMetrics().NewTimer({"ledger", "close", "background"}))
     , mLedgerAgeClosed(app.getMetrics().NewBuckets(
           {"ledger", "age", "closed"}, {5000.0, 7000.0, 10000.0, 20000.0}))
     , mLedgerAge(
           app.getMetrics().NewCounter({"ledger", "age", "current-seconds"}))
     , mMetaStreamWriteTime(
           app.getMetrics().NewTimer({"ledger", "metastream", "write"}))
+    , mSigPreVerifyTime(
+          app.getMetrics().NewTimer({"ledger", "signature", "preverify"}))
+    , mSigPreVerifyWait(app.getMetrics().NewTimer(
+          {"ledger", "signature", "preverify-wait"}))
+    , mApplySigCacheHit(app.getMetrics().NewMeter(
+          {"ledger", "signature", "apply-cache-hit"}, "signature"))
+    , mApplySigCacheMiss(app.getMetrics().NewMeter(
+          {"ledger", "signature", "apply-cache-miss"}, "signature"))
     , mLastClose(mApp.getClock().now())
     , mCatchupDuration(
           app.getMetrics().NewTimer({"ledger", "catchup", "duration"}))
+    , mCloseProfiler(app.getMetrics())
     , mState(LM_BOOTING_STATE)
 
 {
     setupLedgerCloseMetaStream();
 }
 
+// Out of line so that unique_ptr members of forward-declared types can be
+// destroyed; the meta writer finishes writing anything still queued here.
+LedgerManagerImpl::~LedgerManagerImpl()
+{
+}
+
 void
 LedgerManagerImpl::moveToSynced()
 {
@@ -321,6 +343,12 @@ LedgerManagerImpl::loadLastKnownLedger(function<void()> handler)
                 CLOG_INFO(Ledger, "Loaded LCL header from database: {}",
                           ledgerAbbrev(*currentLedger));
                 setLedgerTxnHeader(*currentLedger, mApp);
+
+                // Inflation winners (and, if enabled, best offers) are
+                // answered from memory; build them now rather than on first
+                // use.
+                mApp.getLedgerTxnRoot().loadInflationVotes();
+                mApp.getLedgerTxnRoot().loadOrderBook();
             }
         }
         else
@@ -391,6 +419,7 @@ LedgerManagerImpl::setupInMemoryStateRebuild()
         ps.setState(PersistentState::kLastClosedLedger,
                     binToHex(xdrSha256(lh)));
         ps.setState(PersistentState::kHistoryArchiveState, has.toString());
+        mApp.getBucketManager().noteLastClosedLedgerHAS(has);
         ps.setState(PersistentState::kLastSCPData, "");
         ps.setState(PersistentState::kLedgerUpgrades, "");
         mRebuildInMemoryState = true;
@@ -403,6 +432,12 @@ LedgerManagerImpl::getDatabase()
     return mApp.getDatabase();
 }
 
+LedgerCloseProfiler&
+LedgerManagerImpl::getCloseProfiler()
+{
+    return mCloseProfiler;
+}
+
 uint32_t
 LedgerManagerImpl::getLastMaxTxSetSize() const
 {
@@ -500,8 +535,35 @@ LedgerManagerImpl::valueExternalized(LedgerCloseData const& ledgerData)
         releaseAssert(false);
     }
 
+    if (mApplyingInBackground)
+    {
+        // Handled, in order, once the ledger being applied is closed.
+        CLOG_INFO(Ledger, "Ledger {} is being applied, deferring ledger {}",
+                  lcl + 1, ledgerData.getLedgerSeq());
+        mExternalizedDuringApply.emplace_back(ledgerData);
+        return;
+    }
+
     closeLedgerIf(ledgerData);
+    if (!mApplyingInBackground)
+    {
+        ledgerCloseProcessed(ledgerData, lcl);
+    }
+
+    FrameMark;
+}
 
+bool
+LedgerManagerImpl::isApplying() const
+{
+    return mApplyingInBackground;
+}
+
+void
+LedgerManagerImpl::ledgerCloseProcessed(LedgerCloseData const& ledgerData,
+                                        uint32_t lcl)
+{
+    ZoneScoped;
     auto& cm = mApp.getCatchupManager();
 
     cm.processLedger(ledgerData);
@@ -520,8 +582,6 @@ LedgerManagerImpl::valueExternalized(LedgerCloseData const& ledgerData)
             mApp.getHerder().lastClosedLedgerIncreased();
         }
     }
-
-    FrameMark;
 }
 
 void
@@ -542,6 +602,13 @@ LedgerManagerImpl::closeLedgerIf(LedgerCloseData const& ledgerData)
             return;
         }
 
+        if (mApp.getConfig().PARALLEL_LEDGER_APPLY &&
+            !mApp.getConfig().MANUAL_CLOSE && mState == LM_SYNCED_STATE)
+        {
+            closeLedgerInBackground(ledgerData);
+            return;
+        }
+
         closeLedger(ledgerData);
         CLOG_INFO(Ledger, "Closed ledger: {}", ledgerAbbrev(mLastClosedLedger));
     }
@@ -595,8 +662,9 @@ LedgerManagerImpl::syncMetrics()
 void
 LedgerManagerImpl::emitNextMeta()
 {
+    ZoneScoped;
     releaseAssert(mNextMetaToEmit);
-    releaseAssert(mMetaStream || mMetaDebugStream);
+    releaseAssert(isStreamingMeta());
     auto timer = LogSlowExecution("MetaStream write",
                                   LogSlowExecution::Mode::AUTOMATIC_RAII,
                                   "took", std::chrono::milliseconds(100));
@@ -606,6 +674,14 @@ LedgerManagerImpl::emitNextMeta()
         mMetaStream->writeOne(*mNextMetaToEmit);
         mMetaStream->flush();
     }
+    if (mMetaWriter)
+    {
+        // Only serialization happens here; the write and flush happen on the
+        // writer thread, in the order ledgers are enqueued. The ledger may be
+        // committed before that, so a crash can lose this meta; the operator
+        // opted into that with METADATA_OUTPUT_AT_MOST_ONCE.
+        mMetaWriter->enqueue(*mNextMetaToEmit);
+    }
     if (mMetaDebugStream)
     {
         mMetaDebugStream->writeOne(*mNextMetaToEmit);
@@ -621,6 +697,124 @@ during replays.
 */
 void
 LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
+{
+    ZoneScoped;
+    auto mainThreadTime = mLedgerCloseMainThreadTime.TimeScope();
+    startClosingLedger();
+    finishClosingLedger(applyLedger(ledgerData));
+}
+
+void
+LedgerManagerImpl::closeLedgerInBackground(LedgerCloseData const& ledgerData)
+{
+    ZoneScoped;
+    auto mainThreadTime = mLedgerCloseMainThreadTime.TimeScope();
+    startClosingLedger();
+
+    // From here until backgroundCloseFinished runs, the ledger-close thread
+    // owns the ledger state; see isApplying().
+    mApplyingInBackground = true;
+    CLOG_DEBUG(Ledger, "Applying ledger {} on the ledger close thread",
+               ledgerData.getLedgerSeq());
+    auto startTime = std::chrono::steady_clock::now();
+    mApp.postOnLedgerCloseThread(
+        [this, ledgerData, startTime]() {
+            std::optional<AppliedLedger> applied;
+            std::exception_ptr error;
+            try
+            {
+                applied = std::make_optional(applyLedger(ledgerData));
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            mApp.postOnMainThread(
+                [this, ledgerData, applied, error, startTime]() {
+                    mLedgerCloseBackgroundTime.Update(
+                        std::chrono::steady_clock::now() - startTime);
+                    backgroundCloseFinished(ledgerData, applied, error);
+                },
+                "LedgerManager: ledger applied");
+        },
+        "LedgerManager: apply ledger");
+}
+
+void
+LedgerManagerImpl::backgroundCloseFinished(
+    LedgerCloseData const& ledgerData,
+    std::optional<AppliedLedger> const& applied, std::exception_ptr error)
+{
+    ZoneScoped;
+    releaseAssert(mApplyingInBackground);
+    mApplyingInBackground = false;
+    if (error)
+    {
+        // Same outcome as a throw from a synchronous closeLedger.
+        std::rethrow_exception(error);
+    }
+    if (mApp.isStopping())
+    {
+        return;
+    }
+
+    auto lcl = getLastClosedLedgerNum();
+    {
+        auto mainThreadTime = mLedgerCloseMainThreadTime.TimeScope();
+        releaseAssert(applied);
+        finishClosingLedger(*applied);
+    }
+    CLOG_INFO(Ledger, "Closed ledger: {}", ledgerAbbrev(mLastClosedLedger));
+
+    mApp.getHerder().ledgerClosedInBackground();
+    ledgerCloseProcessed(ledgerData, lcl);
+
+    // Anything externalized in the meantime is processed as if it had
+    // arrived now, which may start the next background close.
+    while (!mExternalizedDuringApply.empty() && !mApplyingInBackground)
+    {
+        auto next = std::move(mExternalizedDuringApply.front());
+        mExternalizedDuringApply.pop_front();
+        valueExternalized(next);
+    }
+}
+
+void
+LedgerManagerImpl::startClosingLedger()
+{
+    maybeResetLedgerCloseMetaDebugStream(mLastClosedLedger.header.ledgerSeq +
+                                         1);
+
+    auto now = mApp.getClock().now();
+    mLedgerAgeClosed.Update(now - mLastClose);
+    mLastClose = now;
+    mLedgerAge.set_count(0);
+}
+
+void
+LedgerManagerImpl::finishClosingLedger(AppliedLedger const& applied)
+{
+    ZoneScoped;
+    advanceLedgerPointers(applied.mLedger.header);
+
+    // Steps 3 and 4 of the sequence described in applyLedger, which must run
+    // on the main thread.
+    auto& hm = mApp.getHistoryManager();
+    if (applied.mCheckpoint)
+    {
+        hm.recordQueuedHistoryCheckpoint(*applied.mCheckpoint);
+    }
+
+    // step 3
+    hm.publishQueuedHistory();
+    hm.logAndUpdatePublishStatus();
+
+    // step 4
+    mApp.getBucketManager().forgetUnreferencedBuckets();
+}
+
+LedgerManagerImpl::AppliedLedger
+LedgerManagerImpl::applyLedger(LedgerCloseData const& ledgerData)
 {
     ZoneScoped;
     auto ledgerTime = mLedgerClose.TimeScope();
@@ -636,11 +830,8 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
                header.current().ledgerSeq);
 
     ZoneValue(static_cast<int64_t>(header.current().ledgerSeq));
-
-    auto now = mApp.getClock().now();
-    mLedgerAgeClosed.Update(now - mLastClose);
-    mLastClose = now;
-    mLedgerAge.set_count(0);
+    mCloseProfiler.beginClose(header.current().ledgerSeq);
+    using Phase = LedgerCloseProfiler::Phase;
 
     std::shared_ptr<AbstractTxSetFrameForApply> txSet = ledgerData.getTxSet();
 
@@ -684,19 +875,19 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
     auto const& sv = ledgerData.getValue();
     header.current().scpValue = sv;
 
-    maybeResetLedgerCloseMetaDebugStream(header.current().ledgerSeq);
-
     // In addition to the _canonical_ LedgerResultSet hashed into the
     // LedgerHeader, we optionally collect an even-more-fine-grained record of
     // the ledger entries modified by each tx during tx processing in a
     // LedgerCloseMeta, for streaming to attached clients (typically: horizon).
     std::unique_ptr<LedgerCloseMeta> ledgerCloseMeta;
-    if (mMetaStream || mMetaDebugStream)
+    if (isStreamingMeta())
     {
         if (mNextMetaToEmit)
         {
             releaseAssert(mNextMetaToEmit->v0().ledgerHeader.hash ==
                           getLastClosedLedgerHeader().hash);
+            LedgerCloseProfiler::PhaseTimer metaTime(mCloseProfiler,
+                                                     Phase::META);
             emitNextMeta();
         }
         releaseAssert(!mNextMetaToEmit);
@@ -714,86 +905,111 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
     vector<TransactionFrameBasePtr> txs = ledgerData.getTxSet()->sortForApply();
 
     // first, prefetch source accounts for txset, then charge fees
-    prefetchTxSourceIds(txs);
     auto curBaseFee = txSet->getBaseFee(header.current());
-    processFeesSeqNums(txs, ltx, curBaseFee, ledgerCloseMeta);
+    std::chrono::steady_clock::time_point sigVerifyStart;
+    std::shared_ptr<SignaturePreVerifier> sigVerifier;
+    {
+        LedgerCloseProfiler::PhaseTimer feesTime(mCloseProfiler, Phase::FEES);
+        prefetchTxSourceIds(txs);
+
+        // verify signatures on the worker threads while fees are being
+        // charged
+        sigVerifyStart = std::chrono::steady_clock::now();
+        sigVerifier = startSignaturePreVerify(txs, ltx);
+        processFeesSeqNums(txs, ltx, curBaseFee, ledgerCloseMeta);
+    }
+    {
+        LedgerCloseProfiler::PhaseTimer sigTime(mCloseProfiler,
+                                                Phase::SIGNATURES);
+        finishSignaturePreVerify(sigVerifier, sigVerifyStart);
+    }
 
     TransactionResultSet txResultSet;
     txResultSet.results.reserve(txs.size());
-    applyTransactions(txs, ltx, txResultSet, ledgerCloseMeta, curBaseFee);
+    {
+        LedgerCloseProfiler::PhaseTimer applyTime(mCloseProfiler,
+                                                  Phase::APPLY);
+        applyTransactions(txs, ltx, txResultSet, ledgerCloseMeta, curBaseFee);
+    }
 
     ltx.loadHeader().current().txSetResultHash = xdrSha256(txResultSet);
 
     // apply any upgrades that were decided during consensus
     // this must be done after applying transactions as the txset
     // was validated before upgrades
-    for (size_t i = 0; i < sv.upgrades.size(); i++)
     {
-        LedgerUpgrade lupgrade;
-        auto valid = Upgrades::isValidForApply(
-            sv.upgrades[i], lupgrade, ltx.loadHeader().current(),
-            mApp.getConfig().LEDGER_PROTOCOL_VERSION);
-        switch (valid)
+        ZoneNamedN(upgradesZone, "applyUpgrades", true);
+        LedgerCloseProfiler::PhaseTimer upgradesTime(mCloseProfiler,
+                                                     Phase::UPGRADES);
+        for (size_t i = 0; i < sv.upgrades.size(); i++)
         {
-        case Upgrades::UpgradeValidity::VALID:
-            break;
-        case Upgrades::UpgradeValidity::XDR_INVALID:
-            throw std::runtime_error(
-                fmt::format(FMT_STRING("Unknown upgrade at index {:d}"), i));
-        case Upgrades::UpgradeValidity::INVALID:
-            throw std::runtime_error(
-                fmt::format(FMT_STRING("Invalid upgrade at index {:d}: {}"), i,
-                            xdr_to_string(lupgrade, "LedgerUpgrade")));
-        }
+            LedgerUpgrade lupgrade;
+            auto valid = Upgrades::isValidForApply(
+                sv.upgrades[i], lupgrade, ltx.loadHeader().current(),
+                mApp.getConfig().LEDGER_PROTOCOL_VERSION);
+            switch (valid)
+            {
+            case Upgrades::UpgradeValidity::VALID:
+                break;
+            case Upgrades::UpgradeValidity::XDR_INVALID:
+                throw std::runtime_error(fmt::format(
+                    FMT_STRING("Unknown upgrade at index {:d}"), i));
+            case Upgrades::UpgradeValidity::INVALID:
+                throw std::runtime_error(fmt::format(
+                    FMT_STRING("Invalid upgrade at index {:d}: {}"), i,
+                    xdr_to_string(lupgrade, "LedgerUpgrade")));
+            }
 
-        try
-        {
-            LedgerTxn ltxUpgrade(ltx);
-            Upgrades::applyTo(lupgrade, ltxUpgrade);
+            try
+            {
+                LedgerTxn ltxUpgrade(ltx);
+                Upgrades::applyTo(lupgrade, ltxUpgrade);
 
-            auto ledgerSeq = ltxUpgrade.loadHeader().current().ledgerSeq;
-            LedgerEntryChanges changes = ltxUpgrade.getChanges();
-            if (ledgerCloseMeta)
+                auto ledgerSeq = ltxUpgrade.loadHeader().current().ledgerSeq;
+                LedgerEntryChanges changes = ltxUpgrade.getChanges();
+                if (ledgerCloseMeta)
+                {
+                    auto& up = ledgerCloseMeta->v0().upgradesProcessing;
+                    up.emplace_back();
+                    UpgradeEntryMeta& uem = up.back();
+                    uem.upgrade = lupgrade;
+                    uem.changes = changes;
+                }
+                // Note: Index from 1 rather than 0 to match the behavior of
+                // storeTransaction and storeTransactionFee.
+                if (mApp.getConfig().MODE_STORES_HISTORY_MISC)
+                {
+                    Upgrades::storeUpgradeHistory(getDatabase(), ledgerSeq,
+                                                  lupgrade, changes,
+                                                  static_cast<int>(i + 1));
+                }
+                ltxUpgrade.commit();
+            }
+            catch (std::runtime_error& e)
             {
-                auto& up = ledgerCloseMeta->v0().upgradesProcessing;
-                up.emplace_back();
-                UpgradeEntryMeta& uem = up.back();
-                uem.upgrade = lupgrade;
-                uem.changes = changes;
+                CLOG_ERROR(Ledger, "Exception during upgrade: {}", e.what());
             }
-            // Note: Index from 1 rather than 0 to match the behavior of
-            // storeTransaction and storeTransactionFee.
-            if (mApp.getConfig().MODE_STORES_HISTORY_MISC)
+            catch (...)
             {
-                Upgrades::storeUpgradeHistory(getDatabase(), ledgerSeq,
-                                              lupgrade, changes,
-                                              static_cast<int>(i + 1));
+                CLOG_ERROR(Ledger, "Unknown exception during upgrade");
             }
-            ltxUpgrade.commit();
-        }
-        catch (std::runtime_error& e)
-        {
-            CLOG_ERROR(Ledger, "Exception during upgrade: {}", e.what());
-        }
-        catch (...)
-        {
-            CLOG_ERROR(Ledger, "Unknown exception during upgrade");
         }
     }
 
-    ledgerClosed(ltx);
+    AppliedLedger applied;
+    applied.mLedger = ledgerClosed(ltx);
 
     if (ledgerData.getExpectedHash() &&
-        *ledgerData.getExpectedHash() != mLastClosedLedger.hash)
+        *ledgerData.getExpectedHash() != applied.mLedger.hash)
     {
-        CLOG_TRACE(Ledger, "Expected Ledger Hash: {} vs Actual Ledger Hash: {}", *ledgerData.getExpectedHash(), mLastClosedLedger.hash);
+        CLOG_TRACE(Ledger, "Expected Ledger Hash: {} vs Actual Ledger Hash: {}", *ledgerData.getExpectedHash(), applied.mLedger.hash);
         throw std::runtime_error("Local node's ledger corrupted during close");
     }
 
-    if (mMetaStream || mMetaDebugStream)
+    if (isStreamingMeta())
     {
         releaseAssert(ledgerCloseMeta);
-        ledgerCloseMeta->v0().ledgerHeader = mLastClosedLedger;
+        ledgerCloseMeta->v0().ledgerHeader = applied.mLedger;
 
         // At this point we've got a complete meta and we can store it to the
         // member variable: if we throw while committing below, we will at worst
@@ -805,6 +1021,8 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
         if (!mApp.getConfig().EXPERIMENTAL_PRECAUTION_DELAY_META ||
             ledgerData.getExpectedHash())
         {
+            LedgerCloseProfiler::PhaseTimer metaTime(mCloseProfiler,
+                                                     Phase::META);
             emitNextMeta();
         }
     }
@@ -825,20 +1043,22 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
     //    bucket refcounts are incremented for the duration of the publish).
     //
     // 4. GC unreferenced buckets. Only do this once publishes are in progress.
+    //
+    // Steps 3 and 4 happen in finishClosingLedger, on the main thread, along
+    // with recording the checkpoint queued in step 1 and advancing the LCL.
 
     // step 1
-    auto& hm = mApp.getHistoryManager();
-    hm.maybeQueueHistoryCheckpoint();
+    applied.mCheckpoint =
+        mApp.getHistoryManager().maybeWriteHistoryCheckpoint(
+            applied.mLedger.header.ledgerSeq);
 
     // step 2
-    ltx.commit();
-
-    // step 3
-    hm.publishQueuedHistory();
-    hm.logAndUpdatePublishStatus();
-
-    // step 4
-    mApp.getBucketManager().forgetUnreferencedBuckets();
+    {
+        ZoneNamedN(commitZone, "commitLedger", true);
+        LedgerCloseProfiler::PhaseTimer commitTime(mCloseProfiler,
+                                                   Phase::COMMIT);
+        ltx.commit();
+    }
 
     if (!mApp.getConfig().OP_APPLY_SLEEP_TIME_WEIGHT_FOR_TESTING.empty())
     {
@@ -868,6 +1088,10 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
 
     std::chrono::duration<double> ledgerTimeSeconds = ledgerTime.Stop();
     CLOG_DEBUG(Perf, "Applied ledger in {} seconds", ledgerTimeSeconds.count());
+    mCloseProfiler.endClose(
+        txs.size(), txSet->sizeOp(),
+        std::chrono::duration_cast<std::chrono::nanoseconds>(ledgerTimeSeconds));
+    return applied;
 }
 
 void
@@ -934,7 +1158,7 @@ LedgerManagerImpl::manuallyAdvanceLedgerHeader(LedgerHeader const& header)
 void
 LedgerManagerImpl::setupLedgerCloseMetaStream()
 {
-    if (mMetaStream)
+    if (mMetaStream || mMetaWriter)
     {
         throw std::runtime_error("LedgerManagerImpl already streaming");
     }
@@ -960,6 +1184,22 @@ LedgerManagerImpl::setupLedgerCloseMetaStream()
                       cfg.METADATA_OUTPUT_STREAM);
             mMetaStream->open(cfg.METADATA_OUTPUT_STREAM);
         }
+
+        if (cfg.METADATA_OUTPUT_QUEUE_SIZE != 0)
+        {
+            auto policy = LedgerCloseMetaWriter::parseFullQueuePolicy(
+                cfg.METADATA_OUTPUT_QUEUE_FULL_POLICY);
+            mMetaSpillDir = std::make_unique<TmpDir>(
+                mApp.getTmpDirManager().tmpDir("meta-spill"));
+            CLOG_INFO(Ledger,
+                      "Writing metadata asynchronously, queue size {}, "
+                      "policy {}",
+                      cfg.METADATA_OUTPUT_QUEUE_SIZE,
+                      cfg.METADATA_OUTPUT_QUEUE_FULL_POLICY);
+            mMetaWriter = std::make_unique<LedgerCloseMetaWriter>(
+                std::move(mMetaStream), cfg.METADATA_OUTPUT_QUEUE_SIZE, policy,
+                mMetaSpillDir->getName() + "/meta.xdr", mApp.getMetrics());
+        }
     }
 }
 void
@@ -1140,6 +1380,45 @@ LedgerManagerImpl::prefetchTransactionData(
     }
 }
 
+std::shared_ptr<SignaturePreVerifier>
+LedgerManagerImpl::startSignaturePreVerify(
+    std::vector<TransactionFrameBasePtr> const& txs, AbstractLedgerTxn& ltx)
+{
+    ZoneScoped;
+    auto const& cfg = mApp.getConfig();
+    if (!cfg.PARALLEL_SIGNATURE_PREVERIFY || txs.empty())
+    {
+        return nullptr;
+    }
+
+    auto verifier = std::make_shared<SignaturePreVerifier>();
+    verifier->addTransactions(ltx, txs);
+    verifier->start(mApp, static_cast<size_t>(cfg.WORKER_THREADS));
+    return verifier;
+}
+
+void
+LedgerManagerImpl::finishSignaturePreVerify(
+    std::shared_ptr<SignaturePreVerifier> const& verifier,
+    std::chrono::steady_clock::time_point startTime)
+{
+    ZoneScoped;
+    if (!verifier)
+    {
+        return;
+    }
+
+    auto waitStart = std::chrono::steady_clock::now();
+    verifier->finish();
+    auto now = std::chrono::steady_clock::now();
+    mSigPreVerifyWait.Update(now - waitStart);
+    mSigPreVerifyTime.Update(now - startTime);
+    CLOG_DEBUG(Ledger, "pre-verified {} signatures in {} ms", verifier->size(),
+               std::chrono::duration_cast<std::chrono::milliseconds>(
+                   now - startTime)
+                   .count());
+}
+
 void
 LedgerManagerImpl::applyTransactions(
     std::vector<TransactionFrameBasePtr>& txs, AbstractLedgerTxn& ltx,
@@ -1170,6 +1449,11 @@ LedgerManagerImpl::applyTransactions(
 
     prefetchTransactionData(txs);
 
+    // Only the main thread flushes the verify cache counts, so the
+    // difference across this loop is what apply itself hit or missed.
+    uint64_t sigHitsBefore = 0, sigMissesBefore = 0;
+    PubKeyUtils::seeVerifySigCacheCounts(sigHitsBefore, sigMissesBefore);
+
     for (auto tx : txs)
     {
         ZoneNamedN(txZone, "applyTransaction", true);
@@ -1217,6 +1501,14 @@ LedgerManagerImpl::applyTransactions(
         }
     }
 
+    uint64_t sigHitsAfter = 0, sigMissesAfter = 0;
+    PubKeyUtils::seeVerifySigCacheCounts(sigHitsAfter, sigMissesAfter);
+    if (sigHitsAfter >= sigHitsBefore && sigMissesAfter >= sigMissesBefore)
+    {
+        mApplySigCacheHit.Mark(sigHitsAfter - sigHitsBefore);
+        mApplySigCacheMiss.Mark(sigMissesAfter - sigMissesBefore);
+    }
+
     logTxApplyMetrics(ltx, numTxs, numOps);
 }
 
@@ -1258,6 +1550,7 @@ LedgerManagerImpl::storeCurrentLedger(LedgerHeader const& header,
 
     mApp.getPersistentState().setState(PersistentState::kHistoryArchiveState,
                                        has.toString());
+    mApp.getBucketManager().noteLastClosedLedgerHAS(has);
 
     if (mApp.getConfig().MODE_STORES_HISTORY_LEDGERHEADERS && storeHeader)
     {
@@ -1282,7 +1575,7 @@ LedgerManagerImpl::transferLedgerEntriesToBucketList(AbstractLedgerTxn& ltx,
     }
 }
 
-void
+LedgerHeaderHistoryEntry
 LedgerManagerImpl::ledgerClosed(AbstractLedgerTxn& ltx)
 {
     ZoneScoped;
@@ -1292,12 +1585,19 @@ LedgerManagerImpl::ledgerClosed(AbstractLedgerTxn& ltx)
                "sealing ledger {} with version {}, sending to bucket list",
                ledgerSeq, ledgerVers);
 
-    transferLedgerEntriesToBucketList(ltx, ledgerSeq, ledgerVers);
+    {
+        LedgerCloseProfiler::PhaseTimer bucketsTime(
+            mCloseProfiler, LedgerCloseProfiler::Phase::BUCKETS);
+        transferLedgerEntriesToBucketList(ltx, ledgerSeq, ledgerVers);
+    }
 
-    ltx.unsealHeader([this](LedgerHeader& lh) {
+    LedgerHeaderHistoryEntry closed;
+    ltx.unsealHeader([this, &closed](LedgerHeader& lh) {
         mApp.getBucketManager().snapshotLedger(lh);
         storeCurrentLedger(lh, /* storeHeader */ true);
-        advanceLedgerPointers(lh);
+        closed.header = lh;
+        closed.hash = xdrSha256(lh);
     });
+    return closed;
 }
 }
@@ -5,13 +5,20 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 #include "util/asio.h"
 
+#include "herder/LedgerCloseData.h"
+#include "history/HistoryArchive.h"
 #include "history/HistoryManager.h"
+#include "ledger/LedgerCloseProfiler.h"
 #include "ledger/LedgerManager.h"
 #include "main/PersistentState.h"
 #include "transactions/TransactionFrame.h"
 #include "util/XDRStream.h"
 #include "xdr/Stellar-ledger.h"
+#include <chrono>
+#include <deque>
+#include <exception>
 #include <filesystem>
+#include <optional>
 #include <string>
 
 /*
@@ -23,6 +30,7 @@ Hands the old ledger off to the history
 namespace medida
 {
 class Timer;
+class Meter;
 class Counter;
 class Histogram;
 class Buckets;
@@ -35,6 +43,9 @@ class Application;
 class Database;
 class LedgerTxnHeader;
 class BasicWork;
+class SignaturePreVerifier;
+class LedgerCloseMetaWriter;
+class TmpDir;
 
 class LedgerManagerImpl : public LedgerManager
 {
@@ -43,6 +54,10 @@ class LedgerManagerImpl : public LedgerManager
   protected:
     Application& mApp;
     std::unique_ptr<XDROutputFileStream> mMetaStream;
+    // Owns the metadata stream instead of mMetaStream when
+    // METADATA_OUTPUT_QUEUE_SIZE is non-zero.
+    std::unique_ptr<TmpDir> mMetaSpillDir;
+    std::unique_ptr<LedgerCloseMetaWriter> mMetaWriter;
     std::unique_ptr<XDROutputFileStream> mMetaDebugStream;
     std::weak_ptr<BasicWork> mFlushAndRotateMetaDebugWork;
     std::filesystem::path mMetaDebugPath;
@@ -53,17 +68,38 @@ class LedgerManagerImpl : public LedgerManager
     medida::Histogram& mOperationCount;
     medida::Histogram& mPrefetchHitRate;
     medida::Timer& mLedgerClose;
+    medida::Timer& mLedgerCloseMainThreadTime;
+    medida::Timer& mLedgerCloseBackgroundTime;
     medida::Buckets& mLedgerAgeClosed;
     medida::Counter& mLedgerAge;
     medida::Timer& mMetaStreamWriteTime;
+    medida::Timer& mSigPreVerifyTime;
+    medida::Timer& mSigPreVerifyWait;
+    medida::Meter& mApplySigCacheHit;
+    medida::Meter& mApplySigCacheMiss;
     VirtualClock::time_point mLastClose;
     bool mRebuildInMemoryState{false};
 
     std::unique_ptr<VirtualClock::time_point> mStartCatchup;
     medida::Timer& mCatchupDuration;
 
+    LedgerCloseProfiler mCloseProfiler;
+
     std::unique_ptr<LedgerCloseMeta> mNextMetaToEmit;
 
+    // Set on the main thread while a ledger is being applied on the ledger
+    // close thread (PARALLEL_LEDGER_APPLY); ledgers externalized in the
+    // meantime are queued and closed, in order, once it is done.
+    bool mApplyingInBackground{false};
+    std::deque<LedgerCloseData> mExternalizedDuringApply;
+
+    // What applyLedger hands back to the main thread.
+    struct AppliedLedger
+    {
+        LedgerHeaderHistoryEntry mLedger;
+        std::optional<HistoryArchiveState> mCheckpoint;
+    };
+
     void
     processFeesSeqNums(std::vector<TransactionFrameBasePtr>& txs,
                        AbstractLedgerTxn& ltxOuter, int64_t baseFee,
@@ -75,17 +111,41 @@ class LedgerManagerImpl : public LedgerManager
                       std::unique_ptr<LedgerCloseMeta> const& ledgerCloseMeta,
                       int64 curBaseFee);
 
-    void ledgerClosed(AbstractLedgerTxn& ltx);
+    LedgerHeaderHistoryEntry ledgerClosed(AbstractLedgerTxn& ltx);
+
+    // closeLedger is split in three: startClosingLedger and
+    // finishClosingLedger run on the main thread, applyLedger may run on the
+    // ledger close thread and must not touch main-thread-only state.
+    void startClosingLedger();
+    AppliedLedger applyLedger(LedgerCloseData const& ledgerData);
+    void finishClosingLedger(AppliedLedger const& applied);
+
+    void closeLedgerInBackground(LedgerCloseData const& ledgerData);
+    void backgroundCloseFinished(LedgerCloseData const& ledgerData,
+                                 std::optional<AppliedLedger> const& applied,
+                                 std::exception_ptr error);
+    void ledgerCloseProcessed(LedgerCloseData const& ledgerData, uint32_t lcl);
 
     void storeCurrentLedger(LedgerHeader const& header, bool storeHeader);
     void prefetchTransactionData(std::vector<TransactionFrameBasePtr>& txs);
     void prefetchTxSourceIds(std::vector<TransactionFrameBasePtr>& txs);
+    std::shared_ptr<SignaturePreVerifier>
+    startSignaturePreVerify(std::vector<TransactionFrameBasePtr> const& txs,
+                            AbstractLedgerTxn& ltx);
+    void finishSignaturePreVerify(
+        std::shared_ptr<SignaturePreVerifier> const& verifier,
+        std::chrono::steady_clock::time_point startTime);
     void closeLedgerIf(LedgerCloseData const& ledgerData);
 
     State mState;
     void setState(State s);
 
     void emitNextMeta();
+    bool
+    isStreamingMeta() const
+    {
+        return mMetaStream || mMetaWriter || mMetaDebugStream;
+    }
 
   protected:
     virtual void transferLedgerEntriesToBucketList(AbstractLedgerTxn& ltx,
@@ -99,12 +159,14 @@ class LedgerManagerImpl : public LedgerManager
 
   public:
     LedgerManagerImpl(Application& app);
+    ~LedgerManagerImpl() override;
 
     void moveToSynced() override;
     State getState() const override;
     std::string getStateHuman() const override;
 
     void valueExternalized(LedgerCloseData const& ledgerData) override;
+    bool isApplying() const override;
 
     uint32_t getLastMaxTxSetSize() const override;
     uint32_t getLastMaxTxSetSizeOps() const override;
@@ -128,6 +190,7 @@ class LedgerManagerImpl : public LedgerManager
     HistoryArchiveState getLastClosedLedgerHAS() override;
 
     Database& getDatabase() override;
+    LedgerCloseProfiler& getCloseProfiler() override;
 
     void
     startCatchup(CatchupConfiguration configuration,
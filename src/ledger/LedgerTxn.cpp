@@ -3,6 +3,7 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "ledger/LedgerTxn.h"
+#include "bucket/BucketList.h"
 #include "crypto/Hex.h"
 #include "crypto/KeyUtils.h"
 #include "crypto/SecretKey.h"
@@ -1934,6 +1935,25 @@ LedgerTxn::dropAccounts()
     throw std::runtime_error("called dropAccounts on non-root LedgerTxn");
 }
 
+void
+LedgerTxn::loadInflationVotes()
+{
+    throw std::runtime_error(
+        "called loadInflationVotes on non-root LedgerTxn");
+}
+
+void
+LedgerTxn::loadOrderBook()
+{
+    throw std::runtime_error("called loadOrderBook on non-root LedgerTxn");
+}
+
+void
+LedgerTxn::clearCaches()
+{
+    throw std::runtime_error("called clearCaches on non-root LedgerTxn");
+}
+
 void
 LedgerTxn::dropData()
 {
@@ -2360,14 +2380,19 @@ LedgerTxn::Impl::EntryIteratorImpl::clone() const
 // Implementation of LedgerTxnRoot ------------------------------------------
 size_t const LedgerTxnRoot::Impl::MIN_BEST_OFFERS_BATCH_SIZE = 5;
 
-LedgerTxnRoot::LedgerTxnRoot(Database& db, size_t entryCacheSize,
-                             size_t prefetchBatchSize
+LedgerTxnRoot::LedgerTxnRoot(Database& db, medida::MetricsRegistry& metrics,
+                             size_t entryCacheSize,
+                             LedgerEntryCachePolicy entryCachePolicy,
+                             size_t prefetchBatchSize, bool inMemoryOrderBook,
+                             BucketList const* bucketList
 #ifdef BEST_OFFER_DEBUGGING
                              ,
                              bool bestOfferDebuggingEnabled
 #endif
                              )
-    : mImpl(std::make_unique<Impl>(db, entryCacheSize, prefetchBatchSize
+    : mImpl(std::make_unique<Impl>(db, metrics, entryCacheSize,
+                                   entryCachePolicy, prefetchBatchSize,
+                                   inMemoryOrderBook, bucketList
 #ifdef BEST_OFFER_DEBUGGING
                                    ,
                                    bestOfferDebuggingEnabled
@@ -2376,8 +2401,11 @@ LedgerTxnRoot::LedgerTxnRoot(Database& db, size_t entryCacheSize,
 {
 }
 
-LedgerTxnRoot::Impl::Impl(Database& db, size_t entryCacheSize,
-                          size_t prefetchBatchSize
+LedgerTxnRoot::Impl::Impl(Database& db, medida::MetricsRegistry& metrics,
+                          size_t entryCacheSize,
+                          LedgerEntryCachePolicy entryCachePolicy,
+                          size_t prefetchBatchSize, bool inMemoryOrderBook,
+                          BucketList const* bucketList
 #ifdef BEST_OFFER_DEBUGGING
                           ,
                           bool bestOfferDebuggingEnabled
@@ -2388,7 +2416,9 @@ LedgerTxnRoot::Impl::Impl(Database& db, size_t entryCacheSize,
                    getMaxOffersToCross()))
     , mDatabase(db)
     , mHeader(std::make_unique<LedgerHeader>())
-    , mEntryCache(entryCacheSize)
+    , mEntryCache(entryCacheSize, entryCachePolicy, metrics)
+    , mInMemoryOrderBook(inMemoryOrderBook)
+    , mBucketList(bucketList)
     , mBulkLoadBatchSize(prefetchBatchSize)
     , mChild(nullptr)
 #ifdef BEST_OFFER_DEBUGGING
@@ -2415,6 +2445,8 @@ LedgerTxnRoot::Impl::resetForFuzzer()
 {
     mBestOffers.clear();
     mEntryCache.clear();
+    mInflationVotes.markUnloaded();
+    mOrderBook.markUnloaded();
 }
 
 void
@@ -2617,6 +2649,24 @@ LedgerTxnRoot::Impl::commitChild(EntryIterator iter,
     {
         while ((bool)iter)
         {
+            auto const& key = iter.key();
+            if (key.type() == InternalLedgerEntryType::LEDGER_ENTRY &&
+                key.ledgerKey().type() == ACCOUNT)
+            {
+                mInflationVotes.update(
+                    key.ledgerKey().account().accountID,
+                    iter.entryExists()
+                        ? &iter.entry().ledgerEntry().data.account()
+                        : nullptr);
+            }
+            else if (key.type() == InternalLedgerEntryType::LEDGER_ENTRY &&
+                     key.ledgerKey().type() == OFFER)
+            {
+                mOrderBook.update(key.ledgerKey().offer().offerID,
+                                  iter.entryExists()
+                                      ? &iter.entry().ledgerEntry()
+                                      : nullptr);
+            }
             bleca.accumulate(iter);
             ++iter;
             ++counter;
@@ -2740,6 +2790,8 @@ LedgerTxnRoot::Impl::deleteObjectsModifiedOnOrAfterLedger(uint32_t ledger) const
     throwIfChild();
     mEntryCache.clear();
     mBestOffers.clear();
+    mInflationVotes.markUnloaded();
+    mOrderBook.markUnloaded();
 
     for (auto let : xdr::xdr_traits<LedgerEntryType>::enum_values())
     {
@@ -2756,6 +2808,34 @@ LedgerTxnRoot::dropAccounts()
     mImpl->dropAccounts();
 }
 
+void
+LedgerTxnRoot::loadInflationVotes()
+{
+    mImpl->loadInflationVotes();
+}
+
+void
+LedgerTxnRoot::loadOrderBook()
+{
+    mImpl->loadOrderBook();
+}
+
+void
+LedgerTxnRoot::clearCaches()
+{
+    mImpl->clearCaches();
+}
+
+void
+LedgerTxnRoot::Impl::clearCaches()
+{
+    throwIfChild();
+    mEntryCache.clear();
+    mBestOffers.clear();
+    mInflationVotes.markUnloaded();
+    mOrderBook.markUnloaded();
+}
+
 void
 LedgerTxnRoot::dropData()
 {
@@ -3106,6 +3186,21 @@ LedgerTxnRoot::Impl::loadNextBestOffersIntoCache(BestOffersEntryPtr cached,
     return iter;
 }
 
+static void
+insertOfferPrefetchKeys(UnorderedSet<LedgerKey>& toPrefetch,
+                        OfferEntry const& oe)
+{
+    toPrefetch.emplace(accountKey(oe.sellerID));
+    if (oe.buying.type() != ASSET_TYPE_NATIVE)
+    {
+        toPrefetch.emplace(trustlineKey(oe.sellerID, oe.buying));
+    }
+    if (oe.selling.type() != ASSET_TYPE_NATIVE)
+    {
+        toPrefetch.emplace(trustlineKey(oe.sellerID, oe.selling));
+    }
+}
+
 void
 LedgerTxnRoot::Impl::populateEntryCacheFromBestOffers(
     std::deque<LedgerEntry>::const_iterator iter,
@@ -3114,16 +3209,7 @@ LedgerTxnRoot::Impl::populateEntryCacheFromBestOffers(
     UnorderedSet<LedgerKey> toPrefetch;
     for (; iter != end; ++iter)
     {
-        auto const& oe = iter->data.offer();
-        toPrefetch.emplace(accountKey(oe.sellerID));
-        if (oe.buying.type() != ASSET_TYPE_NATIVE)
-        {
-            toPrefetch.emplace(trustlineKey(oe.sellerID, oe.buying));
-        }
-        if (oe.selling.type() != ASSET_TYPE_NATIVE)
-        {
-            toPrefetch.emplace(trustlineKey(oe.sellerID, oe.selling));
-        }
+        insertOfferPrefetchKeys(toPrefetch, iter->data.offer());
     }
     prefetch(toPrefetch);
 }
@@ -3131,20 +3217,23 @@ LedgerTxnRoot::Impl::populateEntryCacheFromBestOffers(
 bool
 LedgerTxnRoot::Impl::areEntriesMissingInCacheForOffer(OfferEntry const& oe)
 {
-    if (!mEntryCache.exists(accountKey(oe.sellerID)))
+    // Only decides whether to prefetch; a load that follows counts its own
+    // hit or miss.
+    if (!mEntryCache.exists(accountKey(oe.sellerID), false))
     {
         return true;
     }
     if (oe.buying.type() != ASSET_TYPE_NATIVE)
     {
-        if (!mEntryCache.exists(trustlineKey(oe.sellerID, oe.buying)))
+        if (!mEntryCache.exists(trustlineKey(oe.sellerID, oe.buying), false))
         {
             return true;
         }
     }
     if (oe.selling.type() != ASSET_TYPE_NATIVE)
     {
-        if (!mEntryCache.exists(trustlineKey(oe.sellerID, oe.selling)))
+        if (!mEntryCache.exists(trustlineKey(oe.sellerID, oe.selling),
+                                false))
         {
             return true;
         }
@@ -3153,12 +3242,66 @@ LedgerTxnRoot::Impl::areEntriesMissingInCacheForOffer(OfferEntry const& oe)
     return false;
 }
 
+std::shared_ptr<LedgerEntry const>
+LedgerTxnRoot::Impl::getBestOfferFromOrderBook(Asset const& buying,
+                                               Asset const& selling,
+                                               OfferDescriptor const* worseThan)
+{
+    if (!mOrderBook.isLoaded())
+    {
+        try
+        {
+            loadOrderBook();
+        }
+        catch (std::exception& e)
+        {
+            printErrorAndAbort(
+                "fatal error when loading order book in LedgerTxnRoot: ",
+                e.what());
+        }
+        catch (...)
+        {
+            printErrorAndAbort("unknown fatal error when loading order book "
+                               "in LedgerTxnRoot");
+        }
+    }
+
+    auto le = mOrderBook.getBestOffer(buying, selling, worseThan);
+    if (!le)
+    {
+        return nullptr;
+    }
+
+    // The offers come for free, but crossing them still loads the accounts
+    // and trust lines of their sellers. Batch load those for this offer and
+    // the next 999, as the database-backed path does.
+    if (areEntriesMissingInCacheForOffer(le->data.offer()))
+    {
+        UnorderedSet<LedgerKey> toPrefetch;
+        mOrderBook.forEachBestOffer(buying, selling, worseThan,
+                                    mMaxBestOffersBatchSize,
+                                    [&](LedgerEntry const& offer) {
+                                        insertOfferPrefetchKeys(
+                                            toPrefetch, offer.data.offer());
+                                    });
+        prefetch(toPrefetch);
+    }
+
+    putInEntryCache(LedgerEntryKey(*le), le, LoadType::IMMEDIATE);
+    return le;
+}
+
 std::shared_ptr<LedgerEntry const>
 LedgerTxnRoot::Impl::getBestOffer(Asset const& buying, Asset const& selling,
                                   OfferDescriptor const* worseThan)
 {
     ZoneScoped;
 
+    if (mInMemoryOrderBook)
+    {
+        return getBestOfferFromOrderBook(buying, selling, worseThan);
+    }
+
     // Note: Elements of mBestOffers are properly sorted lists of the best
     // offers for a certain asset pair. This function maintaints the invariant
     // that the lists of best offers remain properly sorted. The sort order is
@@ -3339,7 +3482,11 @@ LedgerTxnRoot::Impl::getInflationWinners(size_t maxWinners, int64_t minVotes)
 {
     try
     {
-        return loadInflationWinners(maxWinners, minVotes);
+        if (!mInflationVotes.isLoaded())
+        {
+            loadInflationVotes();
+        }
+        return mInflationVotes.getWinners(maxWinners, minVotes);
     }
     catch (std::exception& e)
     {
@@ -3390,7 +3537,8 @@ LedgerTxnRoot::Impl::getNewestVersion(InternalLedgerKey const& gkey) const
         switch (key.type())
         {
         case ACCOUNT:
-            entry = loadAccount(key);
+            entry = mBucketList ? mBucketList->getLedgerEntry(key)
+                                : loadAccount(key);
             break;
         case DATA:
             entry = loadData(key);
@@ -3399,7 +3547,8 @@ LedgerTxnRoot::Impl::getNewestVersion(InternalLedgerKey const& gkey) const
             entry = loadOffer(key);
             break;
         case TRUSTLINE:
-            entry = loadTrustLine(key);
+            entry = mBucketList ? mBucketList->getLedgerEntry(key)
+                                : loadTrustLine(key);
             break;
         case CLAIMABLE_BALANCE:
             entry = loadClaimableBalance(key);
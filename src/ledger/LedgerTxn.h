@@ -172,9 +172,16 @@
 //    accesses to a parent's entries when a child is open.
 //
 
+namespace medida
+{
+class MetricsRegistry;
+}
+
 namespace stellar
 {
 
+enum class LedgerEntryCachePolicy;
+
 /* LedgerEntryPtr holds a shared_ptr to a InternalLedgerEntry along with
   information about the state of the entry (or lack thereof)
 
@@ -267,6 +274,7 @@ enum class TransactionMode
     READ_WRITE_WITH_SQL_TXN
 };
 
+class BucketList;
 class Database;
 struct InflationVotes;
 struct LedgerEntry;
@@ -453,6 +461,22 @@ class AbstractLedgerTxnParent
     // on anything other than a (real or stub) root LedgerTxn.
     virtual void dropAccounts() = 0;
 
+    // (Re)build the in-memory inflation vote tally that answers
+    // getInflationWinners from the accounts in the database. Will throw when
+    // called on anything other than a (real or stub) root LedgerTxn.
+    virtual void loadInflationVotes() = 0;
+
+    // (Re)build the in-memory order book that answers getBestOffer from the
+    // offers in the database, if the root keeps one. Will throw when called
+    // on anything other than a (real or stub) root LedgerTxn.
+    virtual void loadOrderBook() = 0;
+
+    // Forget every ledger entry and best offer cached from the database, and
+    // the in-memory inflation vote tally and order book, after the database
+    // was written to through other connections. Will throw when called on
+    // anything other than a (real or stub) root LedgerTxn.
+    virtual void clearCaches() = 0;
+
     // Delete all account-data ledger entries. Will throw when called on
     // anything other than a (real or stub) root LedgerTxn.
     virtual void dropData() = 0;
@@ -765,6 +789,9 @@ class LedgerTxn : public AbstractLedgerTxn
                           LedgerRange const& ledgers) const override;
     void deleteObjectsModifiedOnOrAfterLedger(uint32_t ledger) const override;
     void dropAccounts() override;
+    void loadInflationVotes() override;
+    void loadOrderBook() override;
+    void clearCaches() override;
     void dropData() override;
     void dropOffers() override;
     void dropTrustLines() override;
@@ -801,8 +828,15 @@ class LedgerTxnRoot : public AbstractLedgerTxnParent
     std::unique_ptr<Impl> const mImpl;
 
   public:
-    explicit LedgerTxnRoot(Database& db, size_t entryCacheSize,
-                           size_t prefetchBatchSize
+    // If `bucketList` is set, point loads of accounts and trustlines are
+    // answered from its bucket indexes rather than from SQL (see
+    // EXPERIMENTAL_BUCKET_POINT_LOADS); it has to be kept in step with the
+    // database, so only the ledger close path may write through this root.
+    explicit LedgerTxnRoot(Database& db, medida::MetricsRegistry& metrics,
+                           size_t entryCacheSize,
+                           LedgerEntryCachePolicy entryCachePolicy,
+                           size_t prefetchBatchSize, bool inMemoryOrderBook,
+                           BucketList const* bucketList
 #ifdef BEST_OFFER_DEBUGGING
                            ,
                            bool bestOfferDebuggingEnabled
@@ -823,6 +857,9 @@ class LedgerTxnRoot : public AbstractLedgerTxnParent
     void deleteObjectsModifiedOnOrAfterLedger(uint32_t ledger) const override;
 
     void dropAccounts() override;
+    void loadInflationVotes() override;
+    void loadOrderBook() override;
+    void clearCaches() override;
     void dropData() override;
     void dropOffers() override;
     void dropTrustLines() override;
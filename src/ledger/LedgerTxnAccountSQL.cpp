@@ -5,6 +5,7 @@
 #include "crypto/KeyUtils.h"
 #include "crypto/SecretKey.h"
 #include "crypto/SignerKey.h"
+#include "database/BulkUpsert.h"
 #include "database/Database.h"
 #include "database/DatabaseTypeSpecificOperation.h"
 #include "ledger/LedgerTxnImpl.h"
@@ -96,37 +97,46 @@ LedgerTxnRoot::Impl::loadAccount(LedgerKey const& key) const
     return std::make_shared<LedgerEntry const>(std::move(le));
 }
 
-std::vector<InflationWinner>
-LedgerTxnRoot::Impl::loadInflationWinners(size_t maxWinners,
-                                          int64_t minBalance) const
+void
+LedgerTxnRoot::Impl::loadInflationVotes()
 {
-    InflationWinner w;
-    std::string inflationDest;
+    ZoneScoped;
+    CLOG_INFO(Ledger, "Loading inflation votes");
 
-    auto prep = mDatabase.getPreparedStatement(
-        "SELECT sum(balance) AS votes, inflationdest"
-        " FROM accounts WHERE inflationdest IS NOT NULL"
-        " AND balance >= 1000000000 GROUP BY inflationdest"
-        " ORDER BY votes DESC, inflationdest DESC LIMIT :lim");
-    auto& st = prep.statement();
-    st.exchange(soci::into(w.votes));
-    st.exchange(soci::into(inflationDest));
-    st.exchange(soci::use(maxWinners));
-    st.define_and_bind();
-    st.execute(true);
+    std::string accountID, inflationDest;
+    AccountEntry account;
 
-    std::vector<InflationWinner> winners;
-    while (st.got_data())
+    // reset() leaves the tally loaded-but-empty; make sure a failure part way
+    // through doesn't leave it half loaded.
+    mInflationVotes.reset();
+    try
     {
-        w.accountID = KeyUtils::fromStrKey<PublicKey>(inflationDest);
-        if (w.votes < minBalance)
+        auto prep = mDatabase.getPreparedStatement(
+            "SELECT accountid, balance, inflationdest FROM accounts"
+            " WHERE inflationdest IS NOT NULL AND balance >= :min");
+        auto& st = prep.statement();
+        st.exchange(soci::into(accountID));
+        st.exchange(soci::into(account.balance));
+        st.exchange(soci::into(inflationDest));
+        st.exchange(soci::use(InflationVotes::MIN_VOTER_BALANCE));
+        st.define_and_bind();
+        st.execute(true);
+        while (st.got_data())
         {
-            break;
+            account.inflationDest.activate() =
+                KeyUtils::fromStrKey<PublicKey>(inflationDest);
+            mInflationVotes.update(KeyUtils::fromStrKey<PublicKey>(accountID),
+                                   &account);
+            st.fetch();
         }
-        winners.push_back(w);
-        st.fetch();
     }
-    return winners;
+    catch (...)
+    {
+        mInflationVotes.markUnloaded();
+        throw;
+    }
+    CLOG_INFO(Ledger, "Loaded inflation votes of {} accounts",
+              mInflationVotes.numVoters());
 }
 
 class BulkUpsertAccountsOperation : public DatabaseTypeSpecificOperation<void>
@@ -274,9 +284,36 @@ class BulkUpsertAccountsOperation : public DatabaseTypeSpecificOperation<void>
         }
     }
 
+    BulkUpsert
+    makeBulkUpsert()
+    {
+        BulkUpsert bu(mDB, "accounts", {"accountid"});
+        bu.addColumn("accountid", "TEXT", mAccountIDs);
+        bu.addColumn("balance", "BIGINT", mBalances);
+        bu.addColumn("seqnum", "BIGINT", mSeqNums);
+        bu.addColumn("numsubentries", "INT", mSubEntryNums);
+        bu.addColumn("inflationdest", "TEXT", mInflationDests,
+                     &mInflationDestInds);
+        bu.addColumn("homedomain", "TEXT", mHomeDomains);
+        bu.addColumn("thresholds", "TEXT", mThresholds);
+        bu.addColumn("signers", "TEXT", mSigners, &mSignerInds);
+        bu.addColumn("flags", "INT", mFlags);
+        bu.addColumn("lastmodified", "INT", mLastModifieds);
+        bu.addColumn("extension", "TEXT", mExtensions, &mExtensionInds);
+        bu.addColumn("ledgerext", "TEXT", mLedgerExtensions);
+        return bu;
+    }
+
     void
     doSqliteSpecificOperation(soci::sqlite3_session_backend* sq) override
     {
+        if (mDB.useFastBulkUpsert())
+        {
+            auto bu = makeBulkUpsert();
+            auto timer = mDB.getUpsertTimer("account");
+            bu.executeSqlite();
+            return;
+        }
         doSociGenericOperation();
     }
 
@@ -284,6 +321,14 @@ class BulkUpsertAccountsOperation : public DatabaseTypeSpecificOperation<void>
     void
     doPostgresSpecificOperation(soci::postgresql_session_backend* pg) override
     {
+        if (mDB.useFastBulkUpsert())
+        {
+            auto bu = makeBulkUpsert();
+            auto timer = mDB.getUpsertTimer("account");
+            bu.executePostgres(pg->conn_);
+            return;
+        }
+
         std::string strAccountIDs, strBalances, strSeqNums, strSubEntryNums,
             strInflationDests, strFlags, strHomeDomains, strThresholds,
             strSigners, strLastModifieds, strExtensions, strLedgerExtensions;
@@ -463,6 +508,7 @@ LedgerTxnRoot::Impl::dropAccounts()
     throwIfChild();
     mEntryCache.clear();
     mBestOffers.clear();
+    mInflationVotes.reset();
 
     mDatabase.getSession() << "DROP TABLE IF EXISTS accounts;";
     mDatabase.getSession() << "DROP TABLE IF EXISTS signers;";
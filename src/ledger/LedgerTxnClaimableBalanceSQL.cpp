@@ -2,6 +2,7 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "database/BulkUpsert.h"
 #include "ledger/LedgerTxnImpl.h"
 #include "util/GlobalChecks.h"
 #include "util/types.h"
@@ -294,9 +295,26 @@ class BulkUpsertClaimableBalanceOperation
         }
     }
 
+    BulkUpsert
+    makeBulkUpsert()
+    {
+        BulkUpsert bu(mDb, "claimablebalance", {"balanceid"});
+        bu.addColumn("balanceid", "TEXT", mBalanceIDs);
+        bu.addColumn("ledgerentry", "TEXT", mClaimableBalanceEntrys);
+        bu.addColumn("lastmodified", "INT", mLastModifieds);
+        return bu;
+    }
+
     void
     doSqliteSpecificOperation(soci::sqlite3_session_backend* sq) override
     {
+        if (mDb.useFastBulkUpsert())
+        {
+            auto bu = makeBulkUpsert();
+            auto timer = mDb.getUpsertTimer("claimablebalance");
+            bu.executeSqlite();
+            return;
+        }
         doSociGenericOperation();
     }
 
@@ -304,6 +322,14 @@ class BulkUpsertClaimableBalanceOperation
     void
     doPostgresSpecificOperation(soci::postgresql_session_backend* pg) override
     {
+        if (mDb.useFastBulkUpsert())
+        {
+            auto bu = makeBulkUpsert();
+            auto timer = mDb.getUpsertTimer("claimablebalance");
+            bu.executePostgres(pg->conn_);
+            return;
+        }
+
         std::string strBalanceIDs, strClaimableBalanceEntry, strLastModifieds;
 
         PGconn* conn = pg->conn_;
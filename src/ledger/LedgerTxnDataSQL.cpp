@@ -4,6 +4,7 @@
 
 #include "crypto/KeyUtils.h"
 #include "crypto/SecretKey.h"
+#include "database/BulkUpsert.h"
 #include "database/Database.h"
 #include "database/DatabaseTypeSpecificOperation.h"
 #include "ledger/LedgerTxnImpl.h"
@@ -152,15 +153,43 @@ class BulkUpsertDataOperation : public DatabaseTypeSpecificOperation<void>
         }
     }
 
+    BulkUpsert
+    makeBulkUpsert()
+    {
+        BulkUpsert bu(mDB, "accountdata", {"accountid", "dataname"});
+        bu.addColumn("accountid", "TEXT", mAccountIDs);
+        bu.addColumn("dataname", "TEXT", mDataNames);
+        bu.addColumn("datavalue", "TEXT", mDataValues);
+        bu.addColumn("lastmodified", "INT", mLastModifieds);
+        bu.addColumn("extension", "TEXT", mExtensions);
+        bu.addColumn("ledgerext", "TEXT", mLedgerExtensions);
+        return bu;
+    }
+
     void
     doSqliteSpecificOperation(soci::sqlite3_session_backend* sq) override
     {
+        if (mDB.useFastBulkUpsert())
+        {
+            auto bu = makeBulkUpsert();
+            auto timer = mDB.getUpsertTimer("data");
+            bu.executeSqlite();
+            return;
+        }
         doSociGenericOperation();
     }
 #ifdef USE_POSTGRES
     void
     doPostgresSpecificOperation(soci::postgresql_session_backend* pg) override
     {
+        if (mDB.useFastBulkUpsert())
+        {
+            auto bu = makeBulkUpsert();
+            auto timer = mDB.getUpsertTimer("data");
+            bu.executePostgres(pg->conn_);
+            return;
+        }
+
         std::string strAccountIDs, strDataNames, strDataValues,
             strLastModifieds, strExtensions, strLedgerExtensions;
 
@@ -5,6 +5,9 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "database/Database.h"
+#include "ledger/InMemoryOrderBook.h"
+#include "ledger/InflationVotes.h"
+#include "ledger/LedgerEntryCache.h"
 #include "ledger/LedgerTxn.h"
 #include "util/RandomEvictionCache.h"
 #include <list>
@@ -662,7 +665,7 @@ class LedgerTxnRoot::Impl
         LoadType type;
     };
 
-    typedef RandomEvictionCache<LedgerKey, CacheEntry> EntryCache;
+    typedef LedgerEntryCache<CacheEntry> EntryCache;
 
     typedef AssetPair BestOffersKey;
 
@@ -683,6 +686,18 @@ class LedgerTxnRoot::Impl
     std::unique_ptr<LedgerHeader> mHeader;
     mutable EntryCache mEntryCache;
     mutable BestOffers mBestOffers;
+    // Updated on commitChild, so it is always an exact image of the accounts
+    // table once loaded; dropped whenever the table is changed behind its
+    // back.
+    mutable InflationVotes mInflationVotes;
+    // When enabled, getBestOffer is answered from mOrderBook rather than from
+    // mBestOffers. Like mInflationVotes, it is updated on commitChild and
+    // dropped whenever the offers table is changed behind its back.
+    bool const mInMemoryOrderBook;
+    mutable InMemoryOrderBook mOrderBook;
+    // Not owned; when set, getNewestVersion loads accounts and trustlines
+    // from it instead of from SQL.
+    BucketList const* const mBucketList;
     mutable uint64_t mPrefetchHits{0};
     mutable uint64_t mPrefetchMisses{0};
 
@@ -713,8 +728,6 @@ class LedgerTxnRoot::Impl
     loadOffersByAccountAndAsset(AccountID const& accountID,
                                 Asset const& asset) const;
     std::vector<LedgerEntry> loadOffers(StatementContext& prep) const;
-    std::vector<InflationWinner> loadInflationWinners(size_t maxWinners,
-                                                      int64_t minBalance) const;
     std::shared_ptr<LedgerEntry const>
     loadTrustLine(LedgerKey const& key) const;
     std::vector<LedgerEntry>
@@ -792,9 +805,16 @@ class LedgerTxnRoot::Impl
 
     bool areEntriesMissingInCacheForOffer(OfferEntry const& oe);
 
+    std::shared_ptr<LedgerEntry const>
+    getBestOfferFromOrderBook(Asset const& buying, Asset const& selling,
+                              OfferDescriptor const* worseThan);
+
   public:
     // Constructor has the strong exception safety guarantee
-    Impl(Database& db, size_t entryCacheSize, size_t prefetchBatchSize
+    Impl(Database& db, medida::MetricsRegistry& metrics,
+         size_t entryCacheSize, LedgerEntryCachePolicy entryCachePolicy,
+         size_t prefetchBatchSize, bool inMemoryOrderBook,
+         BucketList const* bucketList
 #ifdef BEST_OFFER_DEBUGGING
          ,
          bool bestOfferDebuggingEnabled
@@ -820,11 +840,28 @@ class LedgerTxnRoot::Impl
     // safety guarantees.
     void dropAccounts();
     void dropData();
+
+    // loadInflationVotes has the basic exception safety guarantee. If it
+    // throws an exception, then
+    // - the prepared statement cache may be, but is not guaranteed to be,
+    //   modified
+    // - the inflation vote tally is left unloaded
+    void loadInflationVotes();
     void dropOffers();
+
+    // loadOrderBook has the basic exception safety guarantee. If it throws an
+    // exception, then
+    // - the prepared statement cache may be, but is not guaranteed to be,
+    //   modified
+    // - the order book is left unloaded
+    void loadOrderBook();
     void dropTrustLines();
     void dropClaimableBalances();
     void dropLiquidityPools();
 
+    // clearCaches has the strong exception safety guarantee.
+    void clearCaches();
+
 #ifdef BUILD_TESTS
     void resetForFuzzer();
 #endif // BUILD_TESTS
@@ -2,6 +2,7 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "database/BulkUpsert.h"
 #include "ledger/LedgerTxnImpl.h"
 #include "ledger/NonSociRelatedException.h"
 #include "util/GlobalChecks.h"
@@ -323,9 +324,28 @@ class BulkUpsertLiquidityPoolOperation
         }
     }
 
+    BulkUpsert
+    makeBulkUpsert()
+    {
+        BulkUpsert bu(mDb, "liquiditypool", {"poolasset"});
+        bu.addColumn("poolasset", "TEXT", mPoolAssets);
+        bu.addColumn("asseta", "TEXT", mAssetAs);
+        bu.addColumn("assetb", "TEXT", mAssetBs);
+        bu.addColumn("ledgerentry", "TEXT", mLiquidityPoolEntries);
+        bu.addColumn("lastmodified", "INT", mLastModifieds);
+        return bu;
+    }
+
     void
     doSqliteSpecificOperation(soci::sqlite3_session_backend* sq) override
     {
+        if (mDb.useFastBulkUpsert())
+        {
+            auto bu = makeBulkUpsert();
+            auto timer = mDb.getUpsertTimer("liquiditypool");
+            bu.executeSqlite();
+            return;
+        }
         doSociGenericOperation();
     }
 
@@ -333,6 +353,14 @@ class BulkUpsertLiquidityPoolOperation
     void
     doPostgresSpecificOperation(soci::postgresql_session_backend* pg) override
     {
+        if (mDb.useFastBulkUpsert())
+        {
+            auto bu = makeBulkUpsert();
+            auto timer = mDb.getUpsertTimer("liquiditypool");
+            bu.executePostgres(pg->conn_);
+            return;
+        }
+
         std::string strPoolAssets, strAssetAs, strAssetBs,
             strLiquidityPoolEntry, strLastModifieds;
 
@@ -4,6 +4,7 @@
 
 #include "crypto/KeyUtils.h"
 #include "crypto/SecretKey.h"
+#include "database/BulkUpsert.h"
 #include "database/Database.h"
 #include "database/DatabaseTypeSpecificOperation.h"
 #include "ledger/LedgerTxnImpl.h"
@@ -69,6 +70,34 @@ LedgerTxnRoot::Impl::loadAllOffers() const
     return offers;
 }
 
+void
+LedgerTxnRoot::Impl::loadOrderBook()
+{
+    ZoneScoped;
+    if (!mInMemoryOrderBook)
+    {
+        return;
+    }
+    CLOG_INFO(Ledger, "Loading order book");
+
+    // reset() leaves the order book loaded-but-empty; make sure a failure part
+    // way through doesn't leave it half loaded.
+    mOrderBook.reset();
+    try
+    {
+        for (auto const& le : loadAllOffers())
+        {
+            mOrderBook.update(le.data.offer().offerID, &le);
+        }
+    }
+    catch (...)
+    {
+        mOrderBook.markUnloaded();
+        throw;
+    }
+    CLOG_INFO(Ledger, "Loaded {} offers into order book", mOrderBook.size());
+}
+
 std::deque<LedgerEntry>::const_iterator
 LedgerTxnRoot::Impl::loadBestOffers(std::deque<LedgerEntry>& offers,
                                     Asset const& buying, Asset const& selling,
@@ -464,9 +493,35 @@ class BulkUpsertOffersOperation : public DatabaseTypeSpecificOperation<void>
         }
     }
 
+    BulkUpsert
+    makeBulkUpsert()
+    {
+        BulkUpsert bu(mDB, "offers", {"offerid"});
+        bu.addColumn("sellerid", "TEXT", mSellerIDs);
+        bu.addColumn("offerid", "BIGINT", mOfferIDs);
+        bu.addColumn("sellingasset", "TEXT", mSellingAssets);
+        bu.addColumn("buyingasset", "TEXT", mBuyingAssets);
+        bu.addColumn("amount", "BIGINT", mAmounts);
+        bu.addColumn("pricen", "INT", mPriceNs);
+        bu.addColumn("priced", "INT", mPriceDs);
+        bu.addColumn("price", "DOUBLE PRECISION", mPrices);
+        bu.addColumn("flags", "INT", mFlags);
+        bu.addColumn("lastmodified", "INT", mLastModifieds);
+        bu.addColumn("extension", "TEXT", mExtensions);
+        bu.addColumn("ledgerext", "TEXT", mLedgerExtensions);
+        return bu;
+    }
+
     void
     doSqliteSpecificOperation(soci::sqlite3_session_backend* sq) override
     {
+        if (mDB.useFastBulkUpsert())
+        {
+            auto bu = makeBulkUpsert();
+            auto timer = mDB.getUpsertTimer("offer");
+            bu.executeSqlite();
+            return;
+        }
         doSociGenericOperation();
     }
 
@@ -474,6 +529,13 @@ class BulkUpsertOffersOperation : public DatabaseTypeSpecificOperation<void>
     void
     doPostgresSpecificOperation(soci::postgresql_session_backend* pg) override
     {
+        if (mDB.useFastBulkUpsert())
+        {
+            auto bu = makeBulkUpsert();
+            auto timer = mDB.getUpsertTimer("offer");
+            bu.executePostgres(pg->conn_);
+            return;
+        }
 
         std::string strSellerIDs, strOfferIDs, strSellingAssets,
             strBuyingAssets, strAmounts, strPriceNs, strPriceDs, strPrices,
@@ -655,6 +717,10 @@ LedgerTxnRoot::Impl::dropOffers()
     throwIfChild();
     mEntryCache.clear();
     mBestOffers.clear();
+    if (mInMemoryOrderBook)
+    {
+        mOrderBook.reset();
+    }
 
     std::string coll = mDatabase.getSimpleCollationClause();
 
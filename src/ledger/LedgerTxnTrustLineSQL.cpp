@@ -4,6 +4,7 @@
 
 #include "crypto/KeyUtils.h"
 #include "crypto/SecretKey.h"
+#include "database/BulkUpsert.h"
 #include "database/Database.h"
 #include "database/DatabaseTypeSpecificOperation.h"
 #include "ledger/LedgerTxnImpl.h"
@@ -185,9 +186,27 @@ class BulkUpsertTrustLinesOperation : public DatabaseTypeSpecificOperation<void>
         }
     }
 
+    BulkUpsert
+    makeBulkUpsert()
+    {
+        BulkUpsert bu(mDB, "trustlines", {"accountid", "asset"});
+        bu.addColumn("accountid", "TEXT", mAccountIDs);
+        bu.addColumn("asset", "TEXT", mAssets);
+        bu.addColumn("ledgerentry", "TEXT", mTrustLineEntries);
+        bu.addColumn("lastmodified", "INT", mLastModifieds);
+        return bu;
+    }
+
     void
     doSqliteSpecificOperation(soci::sqlite3_session_backend* sq) override
     {
+        if (mDB.useFastBulkUpsert())
+        {
+            auto bu = makeBulkUpsert();
+            auto timer = mDB.getUpsertTimer("trustline");
+            bu.executeSqlite();
+            return;
+        }
         doSociGenericOperation();
     }
 
@@ -195,6 +214,14 @@ class BulkUpsertTrustLinesOperation : public DatabaseTypeSpecificOperation<void>
     void
     doPostgresSpecificOperation(soci::postgresql_session_backend* pg) override
     {
+        if (mDB.useFastBulkUpsert())
+        {
+            auto bu = makeBulkUpsert();
+            auto timer = mDB.getUpsertTimer("trustline");
+            bu.executePostgres(pg->conn_);
+            return;
+        }
+
         PGconn* conn = pg->conn_;
 
         std::string strAccountIDs, strAssets, strTrustLineEntries,
@@ -0,0 +1,106 @@
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/SnapshotLedgerTxnRoot.h"
+#include "bucket/BucketListSnapshot.h"
+#include "util/GlobalChecks.h"
+#include <Tracy.hpp>
+#include <stdexcept>
+
+namespace stellar
+{
+
+namespace
+{
+[[noreturn]] void
+throwUnsupported(char const* query)
+{
+    throw std::runtime_error(
+        std::string("SnapshotLedgerTxnRoot does not support ") + query);
+}
+}
+
+SnapshotLedgerTxnRoot::SnapshotLedgerTxnRoot(
+    std::shared_ptr<BucketListSnapshot const> snapshot,
+    LedgerHeader const& header
+#ifdef BEST_OFFER_DEBUGGING
+    ,
+    bool bestOfferDebuggingEnabled
+#endif
+    )
+    : InMemoryLedgerTxnRoot(
+#ifdef BEST_OFFER_DEBUGGING
+          bestOfferDebuggingEnabled
+#endif
+          )
+    , mSnapshot(std::move(snapshot))
+    , mHeader(header)
+{
+    releaseAssert(mSnapshot);
+    releaseAssert(mSnapshot->getLedgerSeq() == mHeader.ledgerSeq);
+}
+
+UnorderedMap<LedgerKey, LedgerEntry>
+SnapshotLedgerTxnRoot::getAllOffers()
+{
+    throwUnsupported("getAllOffers");
+}
+
+std::shared_ptr<LedgerEntry const>
+SnapshotLedgerTxnRoot::getBestOffer(Asset const& buying, Asset const& selling)
+{
+    throwUnsupported("getBestOffer");
+}
+
+std::shared_ptr<LedgerEntry const>
+SnapshotLedgerTxnRoot::getBestOffer(Asset const& buying, Asset const& selling,
+                                    OfferDescriptor const& worseThan)
+{
+    throwUnsupported("getBestOffer");
+}
+
+UnorderedMap<LedgerKey, LedgerEntry>
+SnapshotLedgerTxnRoot::getOffersByAccountAndAsset(AccountID const& account,
+                                                  Asset const& asset)
+{
+    throwUnsupported("getOffersByAccountAndAsset");
+}
+
+UnorderedMap<LedgerKey, LedgerEntry>
+SnapshotLedgerTxnRoot::getPoolShareTrustLinesByAccountAndAsset(
+    AccountID const& account, Asset const& asset)
+{
+    throwUnsupported("getPoolShareTrustLinesByAccountAndAsset");
+}
+
+LedgerHeader const&
+SnapshotLedgerTxnRoot::getHeader() const
+{
+    return mHeader;
+}
+
+std::vector<InflationWinner>
+SnapshotLedgerTxnRoot::getInflationWinners(size_t maxWinners,
+                                           int64_t minBalance)
+{
+    throwUnsupported("getInflationWinners");
+}
+
+std::shared_ptr<InternalLedgerEntry const>
+SnapshotLedgerTxnRoot::getNewestVersion(InternalLedgerKey const& key) const
+{
+    ZoneScoped;
+    // Sponsorship entries only ever live in LedgerTxns, never in buckets.
+    if (key.type() != InternalLedgerEntryType::LEDGER_ENTRY)
+    {
+        return nullptr;
+    }
+    auto le = mSnapshot->getLedgerEntry(key.ledgerKey());
+    if (!le)
+    {
+        return nullptr;
+    }
+    return std::make_shared<InternalLedgerEntry const>(*le);
+}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/InMemoryLedgerTxnRoot.h"
+#include "xdr/Stellar-ledger.h"
+#include <memory>
+
+// A read-only root AbstractLedgerTxnParent that answers point loads from a
+// BucketListSnapshot, and reports the header of the ledger the snapshot was
+// taken at. It keeps no state of its own, so any number of LedgerTxns, on any
+// threads, can be open on it at once; this is what lets transactions be
+// checked off the main thread, where LedgerTxnRoot can't be used.
+//
+// Queries that need a whole table (offers, inflation winners, ...) can't be
+// answered from buckets and throw; committing to it aborts, as it does for
+// InMemoryLedgerTxnRoot.
+
+namespace stellar
+{
+
+class BucketListSnapshot;
+
+class SnapshotLedgerTxnRoot : public InMemoryLedgerTxnRoot
+{
+    std::shared_ptr<BucketListSnapshot const> const mSnapshot;
+    LedgerHeader const mHeader;
+
+  public:
+    SnapshotLedgerTxnRoot(std::shared_ptr<BucketListSnapshot const> snapshot,
+                          LedgerHeader const& header
+#ifdef BEST_OFFER_DEBUGGING
+                          ,
+                          bool bestOfferDebuggingEnabled
+#endif
+    );
+
+    UnorderedMap<LedgerKey, LedgerEntry> getAllOffers() override;
+    std::shared_ptr<LedgerEntry const>
+    getBestOffer(Asset const& buying, Asset const& selling) override;
+    std::shared_ptr<LedgerEntry const>
+    getBestOffer(Asset const& buying, Asset const& selling,
+                 OfferDescriptor const& worseThan) override;
+    UnorderedMap<LedgerKey, LedgerEntry>
+    getOffersByAccountAndAsset(AccountID const& account,
+                               Asset const& asset) override;
+
+    UnorderedMap<LedgerKey, LedgerEntry>
+    getPoolShareTrustLinesByAccountAndAsset(AccountID const& account,
+                                            Asset const& asset) override;
+
+    LedgerHeader const& getHeader() const override;
+
+    std::vector<InflationWinner>
+    getInflationWinners(size_t maxWinners, int64_t minBalance) override;
+
+    std::shared_ptr<InternalLedgerEntry const>
+    getNewestVersion(InternalLedgerKey const& key) const override;
+};
+}
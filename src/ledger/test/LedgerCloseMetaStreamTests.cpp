@@ -7,6 +7,7 @@
 #include "history/HistoryArchiveManager.h"
 #include "history/test/HistoryTestsUtils.h"
 #include "ledger/FlushAndRotateMetaDebugWork.h"
+#include "ledger/LedgerCloseMetaWriter.h"
 #include "ledger/LedgerTxn.h"
 #include "ledger/test/LedgerTestUtils.h"
 #include "lib/catch.hpp"
@@ -15,9 +16,13 @@
 #include "simulation/Simulation.h"
 #include "test/TestUtils.h"
 #include "test/test.h"
+#include "util/Fs.h"
 #include "util/Logging.h"
+#include "util/XDRStream.h"
 #include "work/WorkScheduler.h"
 #include "xdr/Stellar-ledger.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
 #include <fmt/format.h>
 #include <fstream>
 
@@ -385,4 +390,109 @@ TEST_CASE("METADATA_DEBUG_LEDGERS works", "[metadebug]")
         clock.crank(false);
     }
     REQUIRE(gotToExpectedSize);
-}
\ No newline at end of file
+}
+
+TEST_CASE("LedgerCloseMetaWriter preserves ledger order",
+          "[ledgerclosemetastreamasync]")
+{
+    auto policy = GENERATE(LedgerCloseMetaWriter::FullQueuePolicy::BLOCK,
+                           LedgerCloseMetaWriter::FullQueuePolicy::SPILL);
+
+    TmpDirManager tdm(std::string("streamtmp-") + binToHex(randomBytes(8)));
+    TmpDir td = tdm.tmpDir("streams");
+    std::string path = td.getName() + "/stream.xdr";
+    std::string spillPath = td.getName() + "/spill.xdr";
+
+    VirtualClock clock;
+    medida::MetricsRegistry metrics;
+    auto& spilled =
+        metrics.NewMeter({"ledger", "metastream", "spilled"}, "ledger");
+    uint32_t const nLedgers = 64;
+    uint32_t const half = nLedgers / 2;
+    bool const spill = policy == LedgerCloseMetaWriter::FullQueuePolicy::SPILL;
+    {
+        auto out = std::make_unique<XDROutputFileStream>(
+            clock.getIOContext(), /*fsyncOnClose=*/false);
+        out->open(path);
+        LedgerCloseMetaWriter writer(std::move(out), 1, policy, spillPath,
+                                     metrics);
+        // Each half is enqueued in one go. With SPILL the writer is paused
+        // meanwhile, so the first record of each half fills the queue and
+        // all the others are spilled; the second half reuses the spill file
+        // the first one left behind.
+        for (uint32_t h = 0; h < 2; ++h)
+        {
+            writer.setPausedForTesting(spill);
+            for (uint32_t i = h * half + 1; i <= (h + 1) * half; ++i)
+            {
+                LedgerCloseMeta lcm;
+                lcm.v0().ledgerHeader.header.ledgerSeq = i;
+                writer.enqueue(lcm);
+            }
+            if (spill)
+            {
+                REQUIRE(writer.getQueueDepth() == half);
+                REQUIRE(spilled.count() == (h + 1) * (half - 1));
+            }
+            writer.setPausedForTesting(false);
+            writer.drain();
+            REQUIRE(writer.getQueueDepth() == 0);
+        }
+    }
+    if (!spill)
+    {
+        REQUIRE(spilled.count() == 0);
+    }
+
+    XDRInputFileStream in;
+    in.open(path);
+    LedgerCloseMeta lcm;
+    uint32_t expected = 1;
+    while (in && in.readOne(lcm))
+    {
+        REQUIRE(lcm.v0().ledgerHeader.header.ledgerSeq == expected);
+        ++expected;
+    }
+    REQUIRE(expected == nLedgers + 1);
+    REQUIRE(!fs::exists(spillPath));
+}
+
+TEST_CASE("METADATA_OUTPUT_QUEUE_FULL_POLICY is validated",
+          "[ledgerclosemetastreamasync]")
+{
+    REQUIRE(LedgerCloseMetaWriter::parseFullQueuePolicy("BLOCK") ==
+            LedgerCloseMetaWriter::FullQueuePolicy::BLOCK);
+    REQUIRE(LedgerCloseMetaWriter::parseFullQueuePolicy("SPILL") ==
+            LedgerCloseMetaWriter::FullQueuePolicy::SPILL);
+    REQUIRE_THROWS_AS(LedgerCloseMetaWriter::parseFullQueuePolicy("DROP"),
+                      std::invalid_argument);
+}
+
+TEST_CASE("METADATA_OUTPUT_QUEUE_SIZE requires METADATA_OUTPUT_AT_MOST_ONCE",
+          "[ledgerclosemetastreamasync]")
+{
+    TmpDirManager tdm(std::string("streamtmp-") + binToHex(randomBytes(8)));
+    TmpDir td = tdm.tmpDir("streams");
+
+    VirtualClock clock;
+    Config cfg = getTestConfig();
+    cfg.METADATA_OUTPUT_STREAM = td.getName() + "/stream.xdr";
+    cfg.METADATA_OUTPUT_QUEUE_SIZE = 4;
+    SECTION("without the opt-in")
+    {
+        REQUIRE_THROWS_AS(createTestApplication(clock, cfg),
+                          std::invalid_argument);
+    }
+    SECTION("with the opt-in")
+    {
+        cfg.METADATA_OUTPUT_AT_MOST_ONCE = true;
+        REQUIRE_NOTHROW(createTestApplication(clock, cfg));
+    }
+    SECTION("with an unknown queue policy")
+    {
+        cfg.METADATA_OUTPUT_AT_MOST_ONCE = true;
+        cfg.METADATA_OUTPUT_QUEUE_FULL_POLICY = "DROP";
+        REQUIRE_THROWS_AS(createTestApplication(clock, cfg),
+                          std::invalid_argument);
+    }
+}
@@ -2,15 +2,25 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "crypto/SecretKey.h"
 #include "herder/Herder.h"
+#include "herder/TxSetFrame.h"
 #include "ledger/LedgerManager.h"
 #include "ledger/LedgerTxn.h"
 #include "main/Application.h"
+#include "test/TestAccount.h"
+#include "test/TestUtils.h"
+#include "test/TxTests.h"
 #include "test/test.h"
 
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+#include <fmt/format.h>
 #include <lib/catch.hpp>
 
 using namespace stellar;
+using namespace stellar::txtest;
 
 TEST_CASE("cannot close ledger with unsupported ledger version", "[ledger]")
 {
@@ -46,3 +56,77 @@ TEST_CASE("cannot close ledger with unsupported ledger version", "[ledger]")
     }
     REQUIRE_THROWS_AS(applyEmptyLedger(), std::runtime_error);
 }
+
+TEST_CASE("signatures are pre-verified before transactions are applied",
+          "[ledger]")
+{
+    auto closeWithPayments = [](bool preVerify) {
+        VirtualClock clock;
+        auto cfg = getTestConfig(0);
+        cfg.PARALLEL_SIGNATURE_PREVERIFY = preVerify;
+        auto app = createTestApplication(clock, cfg);
+
+        auto root = TestAccount::createRoot(*app);
+        auto const minBalance = app->getLedgerManager().getLastMinBalance(0);
+        std::vector<TransactionFrameBasePtr> txs;
+        for (int i = 0; i < 5; ++i)
+        {
+            auto account = root.create(fmt::format("A{}", i), minBalance * 10);
+            txs.emplace_back(account.tx({payment(root, 10)}));
+        }
+
+        auto const& lcl = app->getLedgerManager().getLastClosedLedgerHeader();
+        auto ledgerSeq = lcl.header.ledgerSeq + 1;
+        auto closeTime = lcl.header.scpValue.closeTime + 1;
+        auto txSet = std::make_shared<TxSetFrame>(lcl.hash);
+        for (auto const& tx : txs)
+        {
+            txSet->add(tx);
+        }
+        txSet->sortForHash();
+
+        // start from a cold cache so that apply has to verify everything
+        // that was not pre-verified
+        PubKeyUtils::clearVerifySigCache();
+        auto& metrics = app->getMetrics();
+        auto& preVerifyTime =
+            metrics.NewTimer({"ledger", "signature", "preverify"});
+        auto& applyMisses = metrics.NewMeter(
+            {"ledger", "signature", "apply-cache-miss"}, "signature");
+        auto& applyHits = metrics.NewMeter(
+            {"ledger", "signature", "apply-cache-hit"}, "signature");
+        auto missesBefore = applyMisses.count();
+        auto hitsBefore = applyHits.count();
+
+        app->getHerder().externalizeValue(txSet, ledgerSeq, closeTime,
+                                          emptyUpgradeSteps);
+        REQUIRE(app->getLedgerManager().getLastClosedLedgerNum() == ledgerSeq);
+        for (auto const& tx : txs)
+        {
+            REQUIRE(tx->getResultCode() == txSUCCESS);
+        }
+
+        auto misses = applyMisses.count() - missesBefore;
+        auto hits = applyHits.count() - hitsBefore;
+        if (preVerify)
+        {
+            REQUIRE(preVerifyTime.count() == 1);
+            REQUIRE(misses == 0);
+            REQUIRE(hits >= txs.size());
+        }
+        else
+        {
+            REQUIRE(preVerifyTime.count() == 0);
+            REQUIRE(misses == txs.size());
+        }
+    };
+
+    SECTION("with pre-verification")
+    {
+        closeWithPayments(true);
+    }
+    SECTION("without pre-verification")
+    {
+        closeWithPayments(false);
+    }
+}
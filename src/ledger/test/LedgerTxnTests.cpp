@@ -2,6 +2,8 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "bucket/BucketManager.h"
+#include "ledger/LedgerEntryCache.h"
 #include "ledger/LedgerTxn.h"
 #include "ledger/LedgerTxnEntry.h"
 #include "ledger/LedgerTxnHeader.h"
@@ -18,6 +20,7 @@
 #include "util/Math.h"
 #include "util/XDROperators.h"
 #include <algorithm>
+#include <chrono>
 #include <fmt/format.h>
 #include <functional>
 #include <map>
@@ -1208,6 +1211,47 @@ TEST_CASE("LedgerTxn queryInflationWinners", "[ledgertxn]")
             }
         }
     }
+
+    SECTION("votes committed to root match votes loaded from database")
+    {
+        VirtualClock clock;
+        auto app = createTestApplication(clock, getTestConfig());
+        auto& root = app->getLedgerTxnRoot();
+
+        std::vector<std::map<AccountID, std::pair<AccountID, int64_t>>>
+            updates{{{a1, {a3, QUERY_VOTE_MINIMUM + 3}},
+                     {a2, {a3, QUERY_VOTE_MINIMUM + 7}}},
+                    // a1 switches to a4, a2 drops below the voter minimum
+                    {{a1, {a4, QUERY_VOTE_MINIMUM + 5}},
+                     {a2, {a3, QUERY_VOTE_MINIMUM - 1}},
+                     {a3, {a4, QUERY_VOTE_MINIMUM}}},
+                    // a1 is deleted
+                    {{a1, {a4, 0}}, {a2, {a4, QUERY_VOTE_MINIMUM + 1}}}};
+
+        auto getWinners = [&]() {
+            LedgerTxn ltx(root);
+            std::vector<std::tuple<AccountID, int64_t>> res;
+            for (auto const& w : ltx.queryInflationWinners(4, 0))
+            {
+                res.emplace_back(w.accountID, w.votes);
+            }
+            return res;
+        };
+
+        for (auto const& update : updates)
+        {
+            {
+                LedgerTxn ltx(root);
+                applyLedgerTxnUpdates(ltx, update);
+                ltx.commit();
+            }
+            auto committed = getWinners();
+            root.loadInflationVotes();
+            REQUIRE(committed == getWinners());
+        }
+        REQUIRE(getWinners() ==
+                inflationSort({{a4, 2 * QUERY_VOTE_MINIMUM + 1}}));
+    }
 }
 
 TEST_CASE("LedgerTxn loadHeader", "[ledgertxn]")
@@ -1877,6 +1921,17 @@ testBestOffer(
         testAtRoot(*app);
     }
 
+    // first changes are in LedgerTxnRoot with in-memory order book
+    if (updates.size() > 1)
+    {
+        VirtualClock clock;
+        auto cfg = getTestConfig(0, mode);
+        cfg.IN_MEMORY_ORDER_BOOK = true;
+        auto app = createTestApplication(clock, cfg);
+
+        testAtRoot(*app);
+    }
+
     // first changes are in child of LedgerTxnRoot
     {
         VirtualClock clock;
@@ -2179,6 +2234,115 @@ TEST_CASE("LedgerTxn loadBestOffer", "[ledgertxn]")
 #endif
 }
 
+TEST_CASE("LedgerTxnRoot in-memory order book", "[ledgertxn]")
+{
+    Asset buying = LedgerTestUtils::generateValidOfferEntry().buying;
+    Asset selling = LedgerTestUtils::generateValidOfferEntry().selling;
+    REQUIRE(!(buying == selling));
+
+    VirtualClock clock;
+    auto app = createTestApplication(clock, getTestConfig());
+    auto cfg = getTestConfig(1);
+    cfg.IN_MEMORY_ORDER_BOOK = true;
+    auto appInMemory = createTestApplication(clock, cfg);
+
+    std::uniform_int_distribution<int32_t> priceDist(1, 5);
+    std::vector<LedgerEntry> offers;
+    for (int64_t offerID = 1; offerID <= 100; ++offerID)
+    {
+        LedgerEntry le;
+        le.data.type(OFFER);
+        auto& oe = le.data.offer();
+        oe = LedgerTestUtils::generateValidOfferEntry();
+        oe.offerID = offerID;
+        // Mostly one asset pair, with a few offers on the opposite side
+        oe.buying = offerID % 10 == 0 ? selling : buying;
+        oe.selling = offerID % 10 == 0 ? buying : selling;
+        oe.price = Price{priceDist(gRandomEngine), priceDist(gRandomEngine)};
+        offers.emplace_back(le);
+    }
+
+    auto applyToBoth = [&](std::function<void(AbstractLedgerTxn&)> f) {
+        for (auto a : {app.get(), appInMemory.get()})
+        {
+            LedgerTxn ltx(a->getLedgerTxnRoot());
+            f(ltx);
+            ltx.commit();
+        }
+    };
+
+    // Sweep the whole book from the root, best offer first
+    auto sweep = [&](Application& a, Asset const& b, Asset const& s) {
+        std::vector<LedgerEntry> res;
+        auto& root = a.getLedgerTxnRoot();
+        auto le = root.getBestOffer(b, s);
+        while (le)
+        {
+            res.emplace_back(*le);
+            auto const& oe = le->data.offer();
+            le = root.getBestOffer(b, s, {oe.price, oe.offerID});
+        }
+        return res;
+    };
+
+    auto check = [&]() {
+        for (auto const& assets : {std::make_pair(buying, selling),
+                                   std::make_pair(selling, buying)})
+        {
+            auto expected = sweep(*app, assets.first, assets.second);
+            REQUIRE(!expected.empty());
+            REQUIRE(sweep(*appInMemory, assets.first, assets.second) ==
+                    expected);
+        }
+    };
+
+    applyToBoth([&](AbstractLedgerTxn& ltx) {
+        for (auto const& le : offers)
+        {
+            ltx.create(le);
+        }
+    });
+    check();
+
+    applyToBoth([&](AbstractLedgerTxn& ltx) {
+        for (auto const& le : offers)
+        {
+            auto const& oe = le.data.offer();
+            if (oe.offerID % 7 == 0)
+            {
+                ltx.erase(LedgerEntryKey(le));
+            }
+            else if (oe.offerID % 3 == 0)
+            {
+                auto lte = ltx.load(LedgerEntryKey(le));
+                lte.current().data.offer().price.n += 1;
+            }
+        }
+    });
+    check();
+
+    SECTION("rebuilt from the database")
+    {
+        appInMemory->getLedgerTxnRoot().loadOrderBook();
+        check();
+    }
+
+    SECTION("rolled back changes are not seen")
+    {
+        {
+            LedgerTxn ltx(appInMemory->getLedgerTxnRoot());
+            for (auto const& le : offers)
+            {
+                if (le.data.offer().offerID % 7 != 0)
+                {
+                    ltx.erase(LedgerEntryKey(le));
+                }
+            }
+        }
+        check();
+    }
+}
+
 static void
 testOffersByAccountAndAsset(
     AbstractLedgerTxnParent& ltxParent, AccountID const& accountID,
@@ -2634,6 +2798,140 @@ TEST_CASE("Create performance benchmark", "[!hide][createbench]")
 #endif
 }
 
+TEST_CASE("LedgerTxnRoot fast bulk upsert", "[ledgertxn]")
+{
+    auto runTest = [&](Config::TestDbMode mode) {
+        // Two applications, one writing through BulkUpsert and the other
+        // through the array-bound statements, must end up with the same rows.
+        VirtualClock clock;
+        std::vector<Application::pointer> apps;
+        for (bool fast : {true, false})
+        {
+            Config cfg(getTestConfig(fast ? 0 : 1, mode));
+            cfg.ENTRY_CACHE_SIZE = 0;
+            cfg.FAST_BULK_UPSERT = fast;
+            apps.emplace_back(createTestApplication(clock, cfg));
+        }
+
+        // More entries than fit in one multi-row INSERT on SQLite.
+        std::vector<LedgerEntry> entries;
+        UnorderedSet<LedgerKey> keys;
+        for (auto const& le : LedgerTestUtils::generateValidLedgerEntries(2000))
+        {
+            if (keys.emplace(LedgerEntryKey(le)).second)
+            {
+                entries.emplace_back(le);
+            }
+        }
+
+        for (auto& app : apps)
+        {
+            {
+                LedgerTxn ltx(app->getLedgerTxnRoot());
+                for (auto const& le : entries)
+                {
+                    ltx.createWithoutLoading(le);
+                }
+                ltx.commit();
+            }
+            // Update every entry again, so that every row conflicts.
+            LedgerTxn ltx(app->getLedgerTxnRoot());
+            for (auto le : entries)
+            {
+                if (le.data.type() == ACCOUNT)
+                {
+                    le.data.account().balance /= 2;
+                }
+                ltx.updateWithoutLoading(le);
+            }
+            ltx.commit();
+        }
+
+        LedgerTxn ltxFast(apps[0]->getLedgerTxnRoot());
+        LedgerTxn ltxSlow(apps[1]->getLedgerTxnRoot());
+        for (auto const& key : keys)
+        {
+            auto fast = ltxFast.load(key);
+            auto slow = ltxSlow.load(key);
+            REQUIRE(fast);
+            REQUIRE(slow);
+            REQUIRE(fast.current() == slow.current());
+        }
+    };
+
+    SECTION("sqlite")
+    {
+        runTest(Config::TESTDB_IN_MEMORY_SQLITE);
+    }
+
+#ifdef USE_POSTGRES
+    SECTION("postgresql")
+    {
+        runTest(Config::TESTDB_POSTGRESQL);
+    }
+#endif
+}
+
+TEST_CASE("Bulk upsert performance benchmark", "[!hide][bulkupsertbench]")
+{
+    auto runTest = [&](Config::TestDbMode mode, bool fast) {
+        VirtualClock clock;
+        Config cfg(getTestConfig(0, mode));
+        cfg.FAST_BULK_UPSERT = fast;
+        Application::pointer app = createTestApplication(clock, cfg);
+
+        size_t n = 100000;
+        auto entries = LedgerTestUtils::generateValidLedgerEntries(n);
+        UnorderedSet<LedgerKey> keys;
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [&](LedgerEntry const& le) {
+                                         return !keys.emplace(LedgerEntryKey(le))
+                                                     .second;
+                                     }),
+                      entries.end());
+
+        // One commit that inserts every entry, then one that updates them
+        // all.
+        for (bool update : {false, true})
+        {
+            LedgerTxn ltx(app->getLedgerTxnRoot());
+            for (auto const& le : entries)
+            {
+                if (update)
+                {
+                    ltx.updateWithoutLoading(le);
+                }
+                else
+                {
+                    ltx.createWithoutLoading(le);
+                }
+            }
+            auto start = std::chrono::steady_clock::now();
+            ltx.commit();
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start);
+            CLOG_INFO(Ledger, "benchmark {} of {} entries: {} ms {}",
+                      (update ? "update" : "insert"), entries.size(),
+                      elapsed.count(),
+                      (fast ? "(bulk upsert)" : "(array-bound)"));
+        }
+    };
+
+    SECTION("sqlite")
+    {
+        runTest(Config::TESTDB_ON_DISK_SQLITE, true);
+        runTest(Config::TESTDB_ON_DISK_SQLITE, false);
+    }
+
+#ifdef USE_POSTGRES
+    SECTION("postgresql")
+    {
+        runTest(Config::TESTDB_POSTGRESQL, true);
+        runTest(Config::TESTDB_POSTGRESQL, false);
+    }
+#endif
+}
+
 TEST_CASE("Erase performance benchmark", "[!hide][erasebench]")
 {
     auto runTest = [&](Config::TestDbMode mode, bool loading) {
@@ -4198,3 +4496,74 @@ TEST_CASE("InMemoryLedgerTxn getPoolShareTrustLinesByAccountAndAsset",
         REQUIRE(kv.first.trustLine().accountID == a1.getPublicKey());
     }
 }
+
+TEST_CASE("LedgerTxnRoot point loads from buckets match SQL",
+          "[ledgertxn][bucketindex]")
+{
+    VirtualClock clock;
+    auto cfg = getTestConfig();
+    cfg.EXPERIMENTAL_BUCKET_POINT_LOADS = true;
+    auto app = createTestApplication(clock, cfg);
+    auto& lm = app->getLedgerManager();
+
+    // Everything has to go through ledger close, as that's what keeps the
+    // bucket list in step with the database.
+    auto root = TestAccount::createRoot(*app);
+    auto a1 = SecretKey::pseudoRandomForTesting();
+    auto a2 = SecretKey::pseudoRandomForTesting();
+    auto gone = SecretKey::pseudoRandomForTesting();
+    auto const minBalance = lm.getLastMinBalance(5);
+    std::vector<Operation> creates;
+    for (auto const& sk : {a1, a2, gone})
+    {
+        creates.emplace_back(
+            txtest::createAccount(sk.getPublicKey(), minBalance));
+    }
+    closeLedgerOn(*app, lm.getLastClosedLedgerNum() + 1, 1, 1, 2016,
+                  {root.tx(creates)});
+
+    auto usd = txtest::makeAsset(a1, "USD");
+    TestAccount acc2(*app, a2);
+    TestAccount accGone(*app, gone);
+    auto trust = acc2.tx({txtest::changeTrust(usd, 1000)});
+    auto merge = accGone.tx({txtest::accountMerge(root.getPublicKey())});
+    closeLedgerOn(*app, lm.getLastClosedLedgerNum() + 1, 2, 1, 2016,
+                  {trust, merge});
+
+    auto policy = parseLedgerEntryCachePolicy(cfg.ENTRY_CACHE_POLICY);
+    LedgerTxnRoot sqlRoot(app->getDatabase(), app->getMetrics(), 100, policy,
+                          0, false, nullptr
+#ifdef BEST_OFFER_DEBUGGING
+                          ,
+                          false
+#endif
+    );
+    LedgerTxnRoot bucketRoot(app->getDatabase(), app->getMetrics(), 100,
+                             policy, 0, false,
+                             &app->getBucketManager().getBucketList()
+#ifdef BEST_OFFER_DEBUGGING
+                                 ,
+                             false
+#endif
+    );
+
+    std::vector<LedgerKey> keys = {accountKey(root.getPublicKey()),
+                                   accountKey(a1.getPublicKey()),
+                                   accountKey(a2.getPublicKey()),
+                                   accountKey(gone.getPublicKey()),
+                                   trustlineKey(a2.getPublicKey(), usd),
+                                   trustlineKey(root.getPublicKey(), usd)};
+    for (auto const& k : keys)
+    {
+        auto fromSql = sqlRoot.getNewestVersion(k);
+        auto fromBuckets = bucketRoot.getNewestVersion(k);
+        REQUIRE(static_cast<bool>(fromSql) == static_cast<bool>(fromBuckets));
+        if (fromSql)
+        {
+            REQUIRE(*fromSql == *fromBuckets);
+        }
+    }
+    REQUIRE(sqlRoot.getNewestVersion(accountKey(a1.getPublicKey())));
+    REQUIRE(sqlRoot.getNewestVersion(trustlineKey(a2.getPublicKey(), usd)));
+    REQUIRE(!sqlRoot.getNewestVersion(accountKey(gone.getPublicKey())));
+}
@@ -232,6 +232,15 @@ class Application
     virtual void postOnBackgroundThread(std::function<void()>&& f,
                                         std::string jobName) = 0;
 
+    // Post `f` to the dedicated ledger-close thread, which only exists when
+    // Config::PARALLEL_LEDGER_APPLY is set. Work posted there runs one item
+    // at a time, in parallel with the main thread.
+    virtual void postOnLedgerCloseThread(std::function<void()>&& f,
+                                         std::string jobName) = 0;
+
+    // Return true if called from the ledger-close thread.
+    virtual bool threadIsLedgerClose() const = 0;
+
     // Perform actions necessary to transition from BOOTING_STATE to other
     // states. In particular: either reload or reinitialize the database, and
     // either restart or begin reacquiring SCP consensus (as instructed by
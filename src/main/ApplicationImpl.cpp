@@ -33,6 +33,7 @@
 #include "invariant/SponsorshipCountIsValid.h"
 #include "ledger/InMemoryLedgerTxn.h"
 #include "ledger/InMemoryLedgerTxnRoot.h"
+#include "ledger/LedgerEntryCache.h"
 #include "ledger/LedgerHeaderUtils.h"
 #include "ledger/LedgerManager.h"
 #include "ledger/LedgerTxn.h"
@@ -81,6 +82,7 @@ ApplicationImpl::ApplicationImpl(VirtualClock& clock, Config const& cfg)
     , mConfig(cfg)
     , mWorkerIOContext(mConfig.WORKER_THREADS)
     , mWork(std::make_unique<asio::io_context::work>(mWorkerIOContext))
+    , mLedgerCloseIOContext(1)
     , mWorkerThreads()
     , mStopSignals(clock.getIOContext(), SIGINT)
     , mStarted(false)
@@ -141,6 +143,13 @@ ApplicationImpl::ApplicationImpl(VirtualClock& clock, Config const& cfg)
         }};
         mWorkerThreads.emplace_back(std::move(thread));
     }
+
+    if (mConfig.PARALLEL_LEDGER_APPLY)
+    {
+        mLedgerCloseWork =
+            std::make_unique<asio::io_context::work>(mLedgerCloseIOContext);
+        mLedgerCloseThread.emplace([this]() { mLedgerCloseIOContext.run(); });
+    }
 }
 
 static void
@@ -270,7 +279,12 @@ ApplicationImpl::initialize(bool createNewDB, bool forceRebuild)
                         mConfig.ENTRY_CACHE_SIZE);
         }
         mLedgerTxnRoot = std::make_unique<LedgerTxnRoot>(
-            *mDatabase, mConfig.ENTRY_CACHE_SIZE, mConfig.PREFETCH_BATCH_SIZE
+            *mDatabase, getMetrics(), mConfig.ENTRY_CACHE_SIZE,
+            parseLedgerEntryCachePolicy(mConfig.ENTRY_CACHE_POLICY),
+            mConfig.PREFETCH_BATCH_SIZE, mConfig.IN_MEMORY_ORDER_BOOK,
+            mConfig.EXPERIMENTAL_BUCKET_POINT_LOADS
+                ? &mBucketManager->getBucketList()
+                : nullptr
 #ifdef BEST_OFFER_DEBUGGING
             ,
             mConfig.BEST_OFFER_DEBUGGING_ENABLED
@@ -646,6 +660,34 @@ ApplicationImpl::validateAndLogConfig()
             "requires --in-memory");
     }
 
+    // The writer thread may not have written a ledger's metadata by the time
+    // that ledger is committed; operators have to accept losing it on a crash.
+    if (mConfig.METADATA_OUTPUT_STREAM != "" &&
+        mConfig.METADATA_OUTPUT_QUEUE_SIZE != 0 &&
+        !mConfig.METADATA_OUTPUT_AT_MOST_ONCE)
+    {
+        throw std::invalid_argument(
+            "METADATA_OUTPUT_QUEUE_SIZE is set but "
+            "METADATA_OUTPUT_AT_MOST_ONCE is not");
+    }
+
+    // Point loads are answered from the bucket list, so there has to be one.
+    if (mConfig.EXPERIMENTAL_BUCKET_POINT_LOADS &&
+        !mConfig.MODE_ENABLES_BUCKETLIST)
+    {
+        throw std::invalid_argument(
+            "EXPERIMENTAL_BUCKET_POINT_LOADS requires MODE_ENABLES_BUCKETLIST");
+    }
+
+    if (mConfig.PARALLEL_LEDGER_APPLY &&
+        (mConfig.isInMemoryMode() ||
+         mConfig.DATABASE.value == "sqlite3://:memory:"))
+    {
+        throw std::invalid_argument(
+            "PARALLEL_LEDGER_APPLY requires a DATABASE that supports more "
+            "than one connection and is not compatible with in-memory mode");
+    }
+
     if (isNetworkedValidator && mConfig.isInMemoryMode())
     {
         throw std::invalid_argument(
@@ -742,6 +784,9 @@ ApplicationImpl::gracefulStop()
     {
         mProcessManager->shutdown();
     }
+    // Let a ledger that is being applied in the background finish before
+    // anything below looks at (or garbage-collects) bucket or ledger state.
+    joinLedgerCloseThread();
     if (mBucketManager)
     {
         // This call happens in shutdown -- before destruction -- so that we can
@@ -778,9 +823,25 @@ ApplicationImpl::shutdownWorkScheduler()
     }
 }
 
+void
+ApplicationImpl::joinLedgerCloseThread()
+{
+    if (mLedgerCloseWork)
+    {
+        mLedgerCloseWork.reset();
+    }
+    if (mLedgerCloseThread && mLedgerCloseThread->joinable())
+    {
+        LOG_DEBUG(DEFAULT_LOG, "Joining ledger close thread");
+        mLedgerCloseThread->join();
+    }
+}
+
 void
 ApplicationImpl::joinAllThreads()
 {
+    joinLedgerCloseThread();
+
     // We never strictly stop the worker IO service, just release the work-lock
     // that keeps the worker threads alive. This gives them the chance to finish
     // any work that the main thread queued.
@@ -1290,6 +1351,26 @@ ApplicationImpl::postOnBackgroundThread(std::function<void()>&& f,
     });
 }
 
+void
+ApplicationImpl::postOnLedgerCloseThread(std::function<void()>&& f,
+                                         std::string jobName)
+{
+    releaseAssert(mLedgerCloseThread);
+    LogSlowExecution isSlow{std::move(jobName), LogSlowExecution::Mode::MANUAL,
+                            "executed after"};
+    asio::post(mLedgerCloseIOContext, [f = std::move(f), isSlow]() {
+        isSlow.checkElapsedTime();
+        f();
+    });
+}
+
+bool
+ApplicationImpl::threadIsLedgerClose() const
+{
+    return mLedgerCloseThread &&
+           mLedgerCloseThread->get_id() == std::this_thread::get_id();
+}
+
 void
 ApplicationImpl::enableInvariantsFromConfig()
 {
@@ -1332,7 +1413,10 @@ ApplicationImpl::createDatabase()
 AbstractLedgerTxnParent&
 ApplicationImpl::getLedgerTxnRoot()
 {
-    assertThreadIsMain();
+    // While a ledger is applied on the ledger-close thread, LedgerManager
+    // keeps the main thread away from ledger state; see
+    // LedgerManager::isApplying().
+    releaseAssert(threadIsMain() || threadIsLedgerClose());
     return mConfig.MODE_USES_IN_MEMORY_LEDGER ? *mNeverCommittingLedgerTxn
                                               : *mLedgerTxnRoot;
 }
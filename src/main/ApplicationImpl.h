@@ -82,6 +82,9 @@ class ApplicationImpl : public Application
                                   Scheduler::ActionType type) override;
     virtual void postOnBackgroundThread(std::function<void()>&& f,
                                         std::string jobName) override;
+    virtual void postOnLedgerCloseThread(std::function<void()>&& f,
+                                         std::string jobName) override;
+    virtual bool threadIsLedgerClose() const override;
 
     virtual void start() override;
 
@@ -151,6 +154,8 @@ class ApplicationImpl : public Application
 
     asio::io_context mWorkerIOContext;
     std::unique_ptr<asio::io_context::work> mWork;
+    asio::io_context mLedgerCloseIOContext;
+    std::unique_ptr<asio::io_context::work> mLedgerCloseWork;
 
     std::unique_ptr<BucketManager> mBucketManager;
     std::unique_ptr<Database> mDatabase;
@@ -189,6 +194,7 @@ class ApplicationImpl : public Application
 #endif
 
     std::vector<std::thread> mWorkerThreads;
+    std::optional<std::thread> mLedgerCloseThread;
 
     asio::signal_set mStopSignals;
 
@@ -213,6 +219,7 @@ class ApplicationImpl : public Application
 
     void shutdownMainIOContext();
     void shutdownWorkScheduler();
+    void joinLedgerCloseThread();
 
     void enableInvariantsFromConfig();
 
@@ -7,6 +7,7 @@
 #include "crypto/KeyUtils.h"
 #include "herder/Herder.h"
 #include "history/HistoryArchiveManager.h"
+#include "ledger/LedgerCloseProfiler.h"
 #include "ledger/LedgerManager.h"
 #include "ledger/LedgerTxn.h"
 #include "ledger/LedgerTxnEntry.h"
@@ -18,6 +19,7 @@
 #include "overlay/BanManager.h"
 #include "overlay/OverlayManager.h"
 #include "overlay/SurveyManager.h"
+#include "transactions/SignaturePreVerifier.h"
 #include "transactions/TransactionBridge.h"
 #include "transactions/TransactionUtils.h"
 #include "util/Logging.h"
@@ -47,6 +49,8 @@ using std::placeholders::_2;
 
 namespace stellar
 {
+size_t const CommandHandler::MAX_TX_BATCH_SIZE = 1000;
+
 CommandHandler::CommandHandler(Application& app) : mApp(app)
 {
     if (mApp.getConfig().HTTP_PORT)
@@ -102,12 +106,14 @@ CommandHandler::CommandHandler(Application& app) : mApp(app)
     }
 
     addRoute("clearmetrics", &CommandHandler::clearMetrics);
+    addRoute("closeprofile", &CommandHandler::closeProfile);
     addRoute("info", &CommandHandler::info);
     addRoute("ll", &CommandHandler::ll);
     addRoute("logrotate", &CommandHandler::logRotate);
     addRoute("manualclose", &CommandHandler::manualClose);
     addRoute("metrics", &CommandHandler::metrics);
     addRoute("tx", &CommandHandler::tx);
+    addRoute("txbatch", &CommandHandler::txbatch);
     addRoute("upgrades", &CommandHandler::upgrades);
     addRoute("self-check", &CommandHandler::selfCheck);
 
@@ -659,6 +665,39 @@ CommandHandler::ll(std::string const& params, std::string& retStr)
     retStr = root.toStyledString();
 }
 
+// Decodes a base64 XDR TransactionEnvelope, as submitted through the tx and
+// txbatch commands. Throws if `blob` isn't one.
+static TransactionFrameBasePtr
+parseTxBlob(Application& app, std::string const& blob)
+{
+    TransactionEnvelope envelope;
+    std::vector<uint8_t> binBlob;
+    decoder::decode_b64(blob, binBlob);
+    xdr::xdr_from_opaque(binBlob, envelope);
+
+    {
+        auto lhhe = app.getLedgerManager().getLastClosedLedgerHeader();
+        if (protocolVersionStartsFrom(lhhe.header.ledgerVersion,
+                                      ProtocolVersion::V_13))
+        {
+            envelope = txbridge::convertForV13(envelope);
+        }
+    }
+
+    return TransactionFrameBase::makeTransactionFromWire(app.getNetworkID(),
+                                                         envelope);
+}
+
+static std::string
+txResultToBase64(TransactionFrameBasePtr const& tx)
+{
+    std::string resultBase64;
+    auto resultBin = xdr::xdr_to_opaque(tx->getResult());
+    resultBase64.reserve(decoder::encoded_size64(resultBin.size()) + 1);
+    resultBase64 = decoder::encode_b64(resultBin);
+    return resultBase64;
+}
+
 void
 CommandHandler::tx(std::string const& params, std::string& retStr)
 {
@@ -668,23 +707,7 @@ CommandHandler::tx(std::string const& params, std::string& retStr)
     const std::string prefix("?blob=");
     if (params.compare(0, prefix.size(), prefix) == 0)
     {
-        TransactionEnvelope envelope;
-        std::string blob = params.substr(prefix.size());
-        std::vector<uint8_t> binBlob;
-        decoder::decode_b64(blob, binBlob);
-        xdr::xdr_from_opaque(binBlob, envelope);
-
-        {
-            auto lhhe = mApp.getLedgerManager().getLastClosedLedgerHeader();
-            if (protocolVersionStartsFrom(lhhe.header.ledgerVersion,
-                                          ProtocolVersion::V_13))
-            {
-                envelope = txbridge::convertForV13(envelope);
-            }
-        }
-
-        auto transaction = TransactionFrameBase::makeTransactionFromWire(
-            mApp.getNetworkID(), envelope);
+        auto transaction = parseTxBlob(mApp, params.substr(prefix.size()));
         if (transaction)
         {
             // add it to our current set
@@ -698,13 +721,8 @@ CommandHandler::tx(std::string const& params, std::string& retStr)
                    << "\"";
             if (status == TransactionQueue::AddResult::ADD_STATUS_ERROR)
             {
-                std::string resultBase64;
-                auto resultBin = xdr::xdr_to_opaque(transaction->getResult());
-                resultBase64.reserve(decoder::encoded_size64(resultBin.size()) +
-                                     1);
-                resultBase64 = decoder::encode_b64(resultBin);
-
-                output << " , \"error\": \"" << resultBase64 << "\"";
+                output << " , \"error\": \"" << txResultToBase64(transaction)
+                       << "\"";
             }
             output << "}";
         }
@@ -718,6 +736,103 @@ CommandHandler::tx(std::string const& params, std::string& retStr)
     retStr = output.str();
 }
 
+void
+CommandHandler::txbatch(std::string const& params, std::string& retStr)
+{
+    ZoneScoped;
+    std::map<std::string, std::string> retMap;
+    http::server::server::parseParams(params, retMap);
+    auto blobsIter = retMap.find("blobs");
+    if (blobsIter == retMap.end())
+    {
+        throw std::invalid_argument(
+            "Must specify tx blobs: txbatch?blobs=<tx in xdr format>,<tx in "
+            "xdr format>,...");
+    }
+
+    std::vector<std::string> blobs;
+    std::istringstream blobStream(blobsIter->second);
+    for (std::string blob; std::getline(blobStream, blob, ',');)
+    {
+        blobs.emplace_back(std::move(blob));
+    }
+    if (blobs.size() > MAX_TX_BATCH_SIZE)
+    {
+        throw std::invalid_argument(fmt::format(
+            FMT_STRING("Too many transactions in batch: {} > {}"),
+            blobs.size(), MAX_TX_BATCH_SIZE));
+    }
+
+    // Envelopes that don't decode get an exception in the response, and
+    // don't stop the rest of the batch from being submitted.
+    std::vector<TransactionFrameBasePtr> txs(blobs.size());
+    std::vector<std::string> parseErrors(blobs.size());
+    std::vector<TransactionFrameBasePtr> parsed;
+    parsed.reserve(blobs.size());
+    for (size_t i = 0; i < blobs.size(); ++i)
+    {
+        try
+        {
+            txs[i] = parseTxBlob(mApp, blobs[i]);
+            parsed.emplace_back(txs[i]);
+        }
+        catch (std::exception const& e)
+        {
+            parseErrors[i] = e.what();
+        }
+    }
+
+    // Verify the signatures of the whole batch on the worker threads up
+    // front, so that the checks recvTransaction runs below, one transaction
+    // at a time on the main thread, find them in the verify cache. While a
+    // ledger is applied on the ledger-close thread, the LedgerTxnRoot isn't
+    // ours to read from, and recvTransaction holds the batch unchecked
+    // anyway.
+    auto const& cfg = mApp.getConfig();
+    if (cfg.PARALLEL_SIGNATURE_PREVERIFY && parsed.size() > 1 &&
+        !mApp.getLedgerManager().isApplying())
+    {
+        auto verifier = std::make_shared<SignaturePreVerifier>();
+        {
+            LedgerTxn ltx(mApp.getLedgerTxnRoot());
+            verifier->addTransactions(ltx, parsed);
+        }
+        verifier->start(mApp, static_cast<size_t>(cfg.WORKER_THREADS));
+        verifier->finish();
+    }
+
+    // Transactions are submitted in the order they're in the batch, so a
+    // chain of transactions from one account can be sent in one batch.
+    Json::Value root(Json::arrayValue);
+    for (size_t i = 0; i < txs.size(); ++i)
+    {
+        Json::Value res;
+        auto const& tx = txs[i];
+        if (!tx)
+        {
+            res["exception"] = parseErrors[i].empty()
+                                   ? std::string("Invalid transaction")
+                                   : parseErrors[i];
+            root.append(res);
+            continue;
+        }
+
+        auto status = mApp.getHerder().recvTransaction(tx);
+        res["hash"] = binToHex(tx->getFullHash());
+        res["status"] = TX_STATUS_STRING[static_cast<int>(status)];
+        res["fee_bid"] = static_cast<Json::Int64>(tx->getFeeBid());
+        if (status == TransactionQueue::AddResult::ADD_STATUS_ERROR)
+        {
+            res["fee_charged"] =
+                static_cast<Json::Int64>(tx->getResult().feeCharged);
+            res["error"] = txResultToBase64(tx);
+        }
+        root.append(res);
+    }
+
+    retStr = root.toStyledString();
+}
+
 void
 CommandHandler::dropcursor(std::string const& params, std::string& retStr)
 {
@@ -824,6 +939,22 @@ CommandHandler::clearMetrics(std::string const& params, std::string& retStr)
     retStr = fmt::format(FMT_STRING("Cleared {} metrics!"), domain);
 }
 
+void
+CommandHandler::closeProfile(std::string const& params, std::string& retStr)
+{
+    ZoneScoped;
+    std::map<std::string, std::string> map;
+    http::server::server::parseParams(params, map);
+
+    size_t count = parseOptionalParamOrDefault<size_t>(
+        map, "count", LedgerCloseProfiler::MAX_PROFILES);
+
+    retStr = mApp.getLedgerManager()
+                 .getCloseProfiler()
+                 .getJsonInfo(count)
+                 .toStyledString();
+}
+
 void
 CommandHandler::surveyTopology(std::string const& params, std::string& retStr)
 {
@@ -940,6 +1071,12 @@ CommandHandler::testAcc(std::string const& params, std::string& retStr)
         root["status"] = "error";
         root["detail"] = "Bad HTTP GET: try something like: testacc?name=bob";
     }
+    else if (mApp.getLedgerManager().isApplying())
+    {
+        // The ledger-close thread owns the ledger state for now.
+        root["status"] = "error";
+        root["detail"] = "A ledger is being applied, try again later";
+    }
     else
     {
         SecretKey key;
@@ -982,7 +1119,15 @@ CommandHandler::testTx(std::string const& params, std::string& retStr)
 
     Json::Value root;
 
-    if (to != retMap.end() && from != retMap.end() && amount != retMap.end())
+    if (mApp.getLedgerManager().isApplying())
+    {
+        // Building the transaction loads the source account's sequence
+        // number, and the ledger-close thread owns the ledger state for now.
+        root["status"] = "error";
+        root["detail"] = "A ledger is being applied, try again later";
+    }
+    else if (to != retMap.end() && from != retMap.end() &&
+             amount != retMap.end())
     {
         Hash const& networkID = mApp.getNetworkID();
 
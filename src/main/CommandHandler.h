@@ -29,6 +29,9 @@ class CommandHandler
                     std::string& retStr);
 
   public:
+    // Most transactions the txbatch command accepts in one request.
+    static size_t const MAX_TX_BATCH_SIZE;
+
     CommandHandler(Application& app);
 
     std::string manualCmd(std::string const& cmd);
@@ -47,6 +50,7 @@ class CommandHandler
     void manualClose(std::string const& params, std::string& retStr);
     void metrics(std::string const& params, std::string& retStr);
     void clearMetrics(std::string const& params, std::string& retStr);
+    void closeProfile(std::string const& params, std::string& retStr);
     void peers(std::string const& params, std::string& retStr);
     void selfCheck(std::string const&, std::string& retStr);
     void quorum(std::string const& params, std::string& retStr);
@@ -54,6 +58,7 @@ class CommandHandler
     void getcursor(std::string const& params, std::string& retStr);
     void scpInfo(std::string const& params, std::string& retStr);
     void tx(std::string const& params, std::string& retStr);
+    void txbatch(std::string const& params, std::string& retStr);
     void unban(std::string const& params, std::string& retStr);
     void upgrades(std::string const& params, std::string& retStr);
     void surveyTopology(std::string const&, std::string& retStr);
@@ -28,12 +28,15 @@
 #include "work/WorkScheduler.h"
 
 #ifdef BUILD_TESTS
+#include "bucket/test/BucketListBenchmark.h"
+#include "lib/json/json.h"
 #include "test/Fuzzer.h"
 #include "test/fuzz.h"
 #include "test/test.h"
 #endif
 
 #include <fmt/format.h>
+#include <fstream>
 #include <iostream>
 #include <lib/clara.hpp>
 #include <optional>
@@ -1537,6 +1540,84 @@ runSimulateBuckets(CommandLineArgs const& args)
         });
 }
 
+int
+runBenchBucketList(CommandLineArgs const& args)
+{
+    LogLevel logLevel{LogLevel::LVL_INFO};
+    std::string outputFile;
+    std::string mix;
+    BucketListBenchmarkConfig cfg;
+    bool noFsync = false;
+
+    auto validate = [&] {
+        if (cfg.mLedgers == 0)
+        {
+            return std::string{"ledgers must be non-zero"};
+        }
+        if (cfg.mUpdatePercent + cfg.mDeletePercent > 100)
+        {
+            return std::string{
+                "update and delete percentages must add up to at most 100"};
+        }
+        if (!mix.empty())
+        {
+            try
+            {
+                cfg.mEntryMix = parseEntryMix(mix);
+            }
+            catch (std::invalid_argument const& e)
+            {
+                return std::string{"bad entry mix: "} + e.what();
+            }
+        }
+        return std::string{};
+    };
+    ParserWithValidation ledgersParser{
+        clara::Opt{cfg.mLedgers, "N"}["--ledgers"]("ledgers to time"),
+        validate};
+
+    return runWithHelp(
+        args,
+        {logLevelParser(logLevel), outputFileParser(outputFile), ledgersParser,
+         clara::Opt{cfg.mInitialEntries, "N"}["--initial-entries"](
+             "entries in the BucketList before the timed ledgers"),
+         clara::Opt{cfg.mEntriesPerLedger, "N"}["--entries-per-ledger"](
+             "entries added, updated or deleted per ledger"),
+         clara::Opt{cfg.mUpdatePercent, "PCT"}["--update-percent"](
+             "percentage of each ledger's entries that update existing ones"),
+         clara::Opt{cfg.mDeletePercent, "PCT"}["--delete-percent"](
+             "percentage of each ledger's entries that delete existing ones"),
+         clara::Opt{mix, "TYPE=WEIGHT,..."}["--entry-mix"](
+             "relative weights of ledger entry types, defaults to "
+             "ACCOUNT=40,TRUSTLINE=40,OFFER=15,DATA=5"),
+         clara::Opt{cfg.mFirstLedger, "LEDGER"}["--first-ledger"](
+             "first timed ledger, defaults to straddling a ledger at which "
+             "every level spills"),
+         clara::Opt{cfg.mSeed, "SEED"}["--seed"]("random seed"),
+         clara::Opt{cfg.mMergeThreads, "N"}["--merge-threads"](
+             "bucket merge threads, overriding BUCKET_MERGE_THREADS"),
+         clara::Opt{noFsync}["--no-fsync"]("don't fsync bucket files"),
+         clara::Opt{cfg.mBucketDir, "DIR-NAME"}["--bucket-dir"](
+             "write buckets to DIR-NAME, which must not exist and is deleted "
+             "afterwards")},
+        [&] {
+            Logging::setLogLevel(logLevel, nullptr);
+            cfg.mFsync = !noFsync;
+            auto res = runBucketListBenchmark(cfg);
+            if (outputFile.empty())
+            {
+                std::cout << res.toStyledString();
+            }
+            else
+            {
+                std::ofstream out(outputFile);
+                out.exceptions(std::ios::failbit | std::ios::badbit);
+                out << res.toStyledString();
+            }
+            return 0;
+        });
+}
+
 ParserWithValidation
 fuzzerModeParser(std::string& fuzzerModeArg, FuzzerMode& fuzzerMode)
 {
@@ -1681,6 +1762,9 @@ handleCommandLine(int argc, char* const* argv)
           "caught up)",
           runSimulateTxs},
          {"simulate-bucketlist", "simulate bucketlist", runSimulateBuckets},
+         {"bench-bucketlist",
+          "time bucket merges over a synthetic bucket list, reporting JSON",
+          runBenchBucketList},
          {"test", "execute test suite", runTest},
 #endif
          {"version", "print version information", runVersion}}};
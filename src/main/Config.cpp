@@ -170,10 +170,16 @@ Config::Config() : NODE_SEED(SecretKey::random())
     DISABLE_XDR_FSYNC = false;
     MAX_SLOTS_TO_REMEMBER = 12;
     METADATA_OUTPUT_STREAM = "";
+    METADATA_OUTPUT_QUEUE_SIZE = 0;
+    METADATA_OUTPUT_QUEUE_FULL_POLICY = "BLOCK";
+    METADATA_OUTPUT_AT_MOST_ONCE = false;
     METADATA_DEBUG_LEDGERS = 0;
 
     LOG_FILE_PATH = "stellar-core-{datetime:%Y-%m-%d_%H-%M-%S}.log";
     BUCKET_DIR_PATH = "buckets";
+    BUCKET_COMPRESSION_LEVEL = 0;
+    BUCKET_MERGE_CHECKPOINT_BYTES = 0;
+    EXPERIMENTAL_BUCKET_POINT_LOADS = false;
 
     LOG_COLOR = false;
 
@@ -222,14 +228,34 @@ Config::Config() : NODE_SEED(SecretKey::random())
     // for it.
     //
     // Worst case = 10 concurrent merges + 1 quorum intersection calculation.
+    //
+    // Bucket merges have since moved to threads of their own, scheduled by
+    // deadline (see BucketMergeExecutor); the worker thread default is kept
+    // for the other background work (bucket verification, history) that
+    // relied on it.
     WORKER_THREADS = 11;
+    // Deadline order alone doesn't stop the inversion: a merge into a level
+    // that has hours to run still holds its thread for those hours. Each of
+    // the 11 levels has at most one merge in flight, so one thread per level
+    // (and no cap on the 7 levels from LONG_MERGE_LEVEL down) means no merge
+    // ever waits for another; the OS time-slices if there are fewer cores.
+    BUCKET_MERGE_THREADS = 11;
+    BUCKET_MERGE_MAX_LONG_MERGES = 7;
     MAX_CONCURRENT_SUBPROCESSES = 16;
     NODE_IS_VALIDATOR = false;
     QUORUM_INTERSECTION_CHECKER = true;
     DATABASE = SecretValue{"sqlite3://:memory:"};
 
+    FAST_BULK_UPSERT = true;
     ENTRY_CACHE_SIZE = 100000;
+    ENTRY_CACHE_POLICY = "RANDOM_EVICTION";
+    IN_MEMORY_ORDER_BOOK = false;
     PREFETCH_BATCH_SIZE = 1000;
+    PARALLEL_SIGNATURE_PREVERIFY = true;
+    PARALLEL_LEDGER_APPLY = false;
+    PARALLEL_BUCKET_APPLY = false;
+    TRANSACTION_QUEUE_ADMISSION_SHARDS = 0;
+    PARALLEL_TXSET_VALIDATION = false;
 
     HISTOGRAM_WINDOW_SIZE = std::chrono::seconds(30);
 
@@ -974,6 +1000,18 @@ Config::processConfig(std::shared_ptr<cpptoml::table> t)
             {
                 METADATA_OUTPUT_STREAM = readString(item);
             }
+            else if (item.first == "METADATA_OUTPUT_QUEUE_SIZE")
+            {
+                METADATA_OUTPUT_QUEUE_SIZE = readInt<uint32_t>(item);
+            }
+            else if (item.first == "METADATA_OUTPUT_QUEUE_FULL_POLICY")
+            {
+                METADATA_OUTPUT_QUEUE_FULL_POLICY = readString(item);
+            }
+            else if (item.first == "METADATA_OUTPUT_AT_MOST_ONCE")
+            {
+                METADATA_OUTPUT_AT_MOST_ONCE = readBool(item);
+            }
             else if (item.first == "EXPERIMENTAL_PRECAUTION_DELAY_META")
             {
                 EXPERIMENTAL_PRECAUTION_DELAY_META = readBool(item);
@@ -1069,6 +1107,26 @@ Config::processConfig(std::shared_ptr<cpptoml::table> t)
             {
                 BUCKET_DIR_PATH = readString(item);
             }
+            else if (item.first == "BUCKET_COMPRESSION_LEVEL")
+            {
+                BUCKET_COMPRESSION_LEVEL = readInt<int>(item, 0, 19);
+#ifndef USE_ZSTD
+                if (BUCKET_COMPRESSION_LEVEL != 0)
+                {
+                    throw std::invalid_argument(
+                        "BUCKET_COMPRESSION_LEVEL needs stellar-core built "
+                        "with zstd");
+                }
+#endif
+            }
+            else if (item.first == "BUCKET_MERGE_CHECKPOINT_BYTES")
+            {
+                BUCKET_MERGE_CHECKPOINT_BYTES = readInt<size_t>(item, 0);
+            }
+            else if (item.first == "EXPERIMENTAL_BUCKET_POINT_LOADS")
+            {
+                EXPERIMENTAL_BUCKET_POINT_LOADS = readBool(item);
+            }
             else if (item.first == "NODE_NAMES")
             {
                 auto names = readArray<std::string>(item);
@@ -1185,6 +1243,14 @@ Config::processConfig(std::shared_ptr<cpptoml::table> t)
             {
                 WORKER_THREADS = readInt<int>(item, 1, 1000);
             }
+            else if (item.first == "BUCKET_MERGE_THREADS")
+            {
+                BUCKET_MERGE_THREADS = readInt<int>(item, 1, 1000);
+            }
+            else if (item.first == "BUCKET_MERGE_MAX_LONG_MERGES")
+            {
+                BUCKET_MERGE_MAX_LONG_MERGES = readInt<int>(item, 1, 1000);
+            }
             else if (item.first == "MAX_CONCURRENT_SUBPROCESSES")
             {
                 MAX_CONCURRENT_SUBPROCESSES = readInt<size_t>(item, 1);
@@ -1257,10 +1323,50 @@ Config::processConfig(std::shared_ptr<cpptoml::table> t)
             {
                 ENTRY_CACHE_SIZE = readInt<uint32_t>(item);
             }
+            else if (item.first == "ENTRY_CACHE_POLICY")
+            {
+                ENTRY_CACHE_POLICY = readString(item);
+                if (ENTRY_CACHE_POLICY != "SEGMENTED_LRU" &&
+                    ENTRY_CACHE_POLICY != "RANDOM_EVICTION")
+                {
+                    throw std::invalid_argument(
+                        "ENTRY_CACHE_POLICY must be one of SEGMENTED_LRU, "
+                        "RANDOM_EVICTION");
+                }
+            }
+            else if (item.first == "FAST_BULK_UPSERT")
+            {
+                FAST_BULK_UPSERT = readBool(item);
+            }
+            else if (item.first == "IN_MEMORY_ORDER_BOOK")
+            {
+                IN_MEMORY_ORDER_BOOK = readBool(item);
+            }
             else if (item.first == "PREFETCH_BATCH_SIZE")
             {
                 PREFETCH_BATCH_SIZE = readInt<uint32_t>(item);
             }
+            else if (item.first == "PARALLEL_SIGNATURE_PREVERIFY")
+            {
+                PARALLEL_SIGNATURE_PREVERIFY = readBool(item);
+            }
+            else if (item.first == "PARALLEL_LEDGER_APPLY")
+            {
+                PARALLEL_LEDGER_APPLY = readBool(item);
+            }
+            else if (item.first == "PARALLEL_BUCKET_APPLY")
+            {
+                PARALLEL_BUCKET_APPLY = readBool(item);
+            }
+            else if (item.first == "TRANSACTION_QUEUE_ADMISSION_SHARDS")
+            {
+                TRANSACTION_QUEUE_ADMISSION_SHARDS =
+                    readInt<uint32_t>(item, 0, 256);
+            }
+            else if (item.first == "PARALLEL_TXSET_VALIDATION")
+            {
+                PARALLEL_TXSET_VALIDATION = readBool(item);
+            }
             else if (item.first == "MAXIMUM_LEDGER_CLOSETIME_DRIFT")
             {
                 MAXIMUM_LEDGER_CLOSETIME_DRIFT = readInt<int64_t>(item, 0);
@@ -342,6 +342,23 @@ class Config : public std::enable_shared_from_this<Config>
     // in consensus, only a passive "watcher" node.
     std::string METADATA_OUTPUT_STREAM;
 
+    // Number of ledgers worth of serialized metadata that may be waiting to be
+    // written to METADATA_OUTPUT_STREAM. When zero (the default) metadata is
+    // written synchronously during ledger close; otherwise it is handed to a
+    // dedicated writer thread. Requires METADATA_OUTPUT_AT_MOST_ONCE.
+    uint32_t METADATA_OUTPUT_QUEUE_SIZE;
+
+    // What to do when METADATA_OUTPUT_QUEUE_SIZE ledgers are already waiting:
+    // "BLOCK" ledger close until the writer catches up, or "SPILL" further
+    // metadata to a temporary file that the writer drains in order.
+    std::string METADATA_OUTPUT_QUEUE_FULL_POLICY;
+
+    // Acknowledges that with METADATA_OUTPUT_QUEUE_SIZE set, a ledger can be
+    // committed before its metadata has been written, so a crash right after
+    // the commit loses that metadata for good: on restart the node resumes
+    // after the committed ledger and never emits it again.
+    bool METADATA_OUTPUT_AT_MOST_ONCE;
+
     // Number of ledgers worth of transaction metadata to preserve on disk for
     // debugging purposes. These records are automatically maintained and
     // rotated during processing, and are helpful for recovery in case of a
@@ -372,6 +389,18 @@ class Config : public std::enable_shared_from_this<Config>
     std::string LOG_FILE_PATH;
     bool LOG_COLOR;
     std::string BUCKET_DIR_PATH;
+    // zstd compression level for bucket files written by this node; 0 writes
+    // them as raw XDR.
+    int BUCKET_COMPRESSION_LEVEL;
+    // When nonzero, bucket merges save a checkpoint each time they write this
+    // many bytes of output, and finished merges are recorded in the bucket
+    // dir, so that a restart resumes or reuses them rather than starting
+    // over. Only applies to uncompressed buckets.
+    size_t BUCKET_MERGE_CHECKPOINT_BYTES;
+    // When set, bucket indexes are built as buckets are written and saved
+    // next to them, and LedgerTxnRoot answers point loads of accounts and
+    // trustlines from the bucket list instead of from SQL.
+    bool EXPERIMENTAL_BUCKET_POINT_LOADS;
     // Ledger protocol version for testing purposes. Defaulted to
     // LEDGER_PROTOCOL_VERSION. Used in the following scenarios: 1. to specify
     // the genesis ledger version (only when USE_CONFIG_FOR_GENESIS is true) 2.
@@ -422,6 +451,11 @@ class Config : public std::enable_shared_from_this<Config>
 
     // thread-management config
     int WORKER_THREADS;
+    // Bucket merges run on BUCKET_MERGE_THREADS threads of their own, at most
+    // BUCKET_MERGE_MAX_LONG_MERGES of them merging into deep levels at a time.
+    // The defaults give every level of the bucket list a thread.
+    int BUCKET_MERGE_THREADS;
+    int BUCKET_MERGE_MAX_LONG_MERGES;
 
     // process-management config
     size_t MAX_CONCURRENT_SUBPROCESSES;
@@ -446,6 +480,10 @@ class Config : public std::enable_shared_from_this<Config>
 
     // Database config
     SecretValue DATABASE;
+    // - FAST_BULK_UPSERT writes the entries changed by a ledger with COPY into
+    //   a temporary table (postgres) or multi-row INSERTs (SQLite) rather than
+    //   with one array-bound statement per entry type
+    bool FAST_BULK_UPSERT;
 
     std::vector<std::string> COMMANDS;
     std::vector<std::string> REPORT_METRICS;
@@ -454,6 +492,14 @@ class Config : public std::enable_shared_from_this<Config>
     // - ENTRY_CACHE_SIZE controls the maximum number of LedgerEntry objects
     //   that will be stored in the cache
     size_t ENTRY_CACHE_SIZE;
+    // - ENTRY_CACHE_POLICY is RANDOM_EVICTION (the default) or SEGMENTED_LRU
+    //   (offers are cached apart from other entries, and entries must be hit
+    //   twice to be protected from eviction)
+    std::string ENTRY_CACHE_POLICY;
+    // - IN_MEMORY_ORDER_BOOK keeps every offer in memory, sorted by price
+    //   per asset pair, and finds best offers there instead of in the
+    //   database
+    bool IN_MEMORY_ORDER_BOOK;
 
     // Data layer prefetcher configuration
     // - PREFETCH_BATCH_SIZE determines how many records we'll prefetch per
@@ -461,6 +507,42 @@ class Config : public std::enable_shared_from_this<Config>
     // the entry cache
     size_t PREFETCH_BATCH_SIZE;
 
+    // If set to true (the default), signatures of the externalized
+    // transaction set are verified on the worker threads while fees and
+    // sequence numbers are processed, so that applying transactions mostly
+    // hits the signature-verification cache.
+    bool PARALLEL_SIGNATURE_PREVERIFY;
+
+    // If set to true, ledgers externalized while in sync are applied on a
+    // dedicated ledger-close thread with its own database connection, so the
+    // main thread keeps serving overlay, SCP and transaction flooding during
+    // apply. Requires a DATABASE that accepts more than one connection (not
+    // in-memory SQLite). Ledgers closed during catchup, and all ledgers when
+    // MANUAL_CLOSE is set, are still applied synchronously.
+    bool PARALLEL_LEDGER_APPLY;
+
+    // If set to true, catchup applies buckets one partition per ledger entry
+    // type, concurrently, each on the worker threads with its own database
+    // connection, keeping the newest version of each entry across levels.
+    // Only used on postgres, and not when the
+    // BucketListIsConsistentWithDatabase invariant is enabled; otherwise
+    // buckets are applied level by level.
+    bool PARALLEL_BUCKET_APPLY;
+
+    // If nonzero, transactions flooded by peers are checked against a
+    // snapshot of the last closed ledger on the worker threads, spread over
+    // this many shards by source account, and only inserted into the
+    // TransactionQueue on the main thread. If 0 (the default), they're
+    // checked and inserted on the main thread.
+    uint32_t TRANSACTION_QUEUE_ADMISSION_SHARDS;
+
+    // If set to true, the transactions of a transaction set are checked
+    // against a snapshot of the last closed ledger on the worker threads, one
+    // source account at a time, when validating or trimming the set; the
+    // outcome is the same as checking them on the main thread, which is what
+    // happens when this is false (the default) or no snapshot is available.
+    bool PARALLEL_TXSET_VALIDATION;
+
     // If set to true, the application will halt when an internal error is
     // encountered during applying a transaction. Otherwise, the
     // txINTERNAL_ERROR transaction is created but not applied.
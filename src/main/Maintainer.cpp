@@ -3,6 +3,8 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "main/Maintainer.h"
+#include "ledger/LedgerManager.h"
+#include "main/Application.h"
 #include "main/Config.h"
 #include "main/ExternalQueue.h"
 #include "util/GlobalChecks.h"
@@ -58,7 +60,12 @@ void
 Maintainer::tick()
 {
     ZoneScoped;
-    performMaintenance(mApp.getConfig().AUTOMATIC_MAINTENANCE_COUNT);
+    // Don't compete with a ledger being applied on the ledger close thread
+    // for the database; the next tick picks up whatever is skipped here.
+    if (!mApp.getLedgerManager().isApplying())
+    {
+        performMaintenance(mApp.getConfig().AUTOMATIC_MAINTENANCE_COUNT);
+    }
     scheduleMaintenance();
 }
 
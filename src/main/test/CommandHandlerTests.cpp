@@ -2,11 +2,17 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "crypto/Hex.h"
+#include "crypto/SHA.h"
+#include "ledger/LedgerManager.h"
 #include "ledger/LedgerTxn.h"
 #include "ledger/test/LedgerTestUtils.h"
 #include "lib/catch.hpp"
+#include "lib/json/json.h"
 #include "main/Application.h"
 #include "main/CommandHandler.h"
+#include "simulation/Simulation.h"
+#include "simulation/Topologies.h"
 #include "test/TestAccount.h"
 #include "test/TestUtils.h"
 #include "test/TxTests.h"
@@ -15,11 +21,16 @@
 #include "transactions/TransactionBridge.h"
 #include "transactions/TransactionUtils.h"
 #include "util/Decoder.h"
+#include "util/Logging.h"
 #include "util/Math.h"
+#include "util/finally.h"
 #include "xdr/Stellar-ledger-entries.h"
 #include "xdr/Stellar-transaction.h"
 #include "xdrpp/marshal.h"
+#include <chrono>
+#include <fmt/chrono.h>
 #include <fmt/format.h>
+#include <future>
 #include <optional>
 #include <stdexcept>
 
@@ -541,3 +552,260 @@ TEST_CASE("manualclose", "[commandhandler]")
         }
     }
 }
+
+TEST_CASE("closeprofile", "[commandhandler]")
+{
+    VirtualClock clock;
+    auto app = createTestApplication(clock, getTestConfig());
+    auto& commandHandler = app->getCommandHandler();
+
+    auto root = TestAccount::createRoot(*app);
+    auto a1 = getAccount("a1");
+    auto lcl = app->getLedgerManager().getLastClosedLedgerNum();
+    closeLedgerOn(*app, lcl + 1, 1, 1, 2022,
+                  {root.tx({createAccount(a1.getPublicKey(), 1000000000),
+                            payment(a1.getPublicKey(), 100)})});
+    closeLedgerOn(*app, lcl + 2, 2, 1, 2022);
+
+    std::string retStr;
+    commandHandler.closeProfile("", retStr);
+    Json::Value res;
+    REQUIRE(Json::Reader().parse(retStr, res));
+    auto const& closes = res["closes"];
+    REQUIRE(closes.size() >= 2);
+
+    // Newest first.
+    REQUIRE(closes[0]["ledger"].asUInt() == lcl + 2);
+    REQUIRE(closes[0]["txs"].asUInt() == 0);
+    REQUIRE(closes[0]["operations"].empty());
+
+    auto const& withTx = closes[1];
+    REQUIRE(withTx["ledger"].asUInt() == lcl + 1);
+    REQUIRE(withTx["txs"].asUInt() == 1);
+    REQUIRE(withTx["ops"].asUInt() == 2);
+    for (auto const& phase : {"fees", "signatures", "apply", "invariants",
+                              "upgrades", "buckets", "commit", "meta"})
+    {
+        REQUIRE(withTx["phases_ms"].isMember(phase));
+        REQUIRE(withTx["phases_ms"][phase].asDouble() >= 0);
+    }
+    REQUIRE(withTx["operations"]["CREATE_ACCOUNT"]["count"].asUInt() == 1);
+    REQUIRE(withTx["operations"]["PAYMENT"]["count"].asUInt() == 1);
+
+    commandHandler.closeProfile("count=1", retStr);
+    REQUIRE(Json::Reader().parse(retStr, res));
+    REQUIRE(res["closes"].size() == 1);
+}
+
+TEST_CASE("txbatch", "[commandhandler]")
+{
+    VirtualClock clock;
+    auto app = createTestApplication(clock, getTestConfig());
+    auto& ch = app->getCommandHandler();
+    auto root = TestAccount::createRoot(*app);
+    auto a1 = root.create("a1", app->getLedgerManager().getLastMinBalance(0));
+
+    auto toBlob = [](TransactionFrameBasePtr const& tx) {
+        return decoder::encode_b64(xdr::xdr_to_opaque(tx->getEnvelope()));
+    };
+    auto submit = [&](std::vector<std::string> const& blobs) {
+        std::string params = "?blobs=";
+        for (size_t i = 0; i < blobs.size(); ++i)
+        {
+            params += (i == 0 ? "" : ",") + blobs[i];
+        }
+        std::string retStr;
+        ch.txbatch(params, retStr);
+        Json::Value res;
+        REQUIRE(Json::Reader().parse(retStr, res));
+        REQUIRE(res.isArray());
+        REQUIRE(res.size() == blobs.size());
+        return res;
+    };
+
+    SECTION("transactions are submitted in order")
+    {
+        // The second transaction from root follows the first, and the one
+        // from a1 can't pay for itself.
+        auto tx1 = root.tx({payment(a1, 1)});
+        auto tx2 = root.tx({payment(a1, 2)});
+        auto tx3 = a1.tx({payment(root, 1)});
+        auto res = submit({toBlob(tx1), toBlob(tx2), "garbage", toBlob(tx3),
+                           toBlob(tx1)});
+
+        REQUIRE(res[0]["status"].asString() == "PENDING");
+        REQUIRE(res[0]["hash"].asString() == binToHex(tx1->getFullHash()));
+        REQUIRE(res[0]["fee_bid"].asInt64() == tx1->getFeeBid());
+        REQUIRE(!res[0].isMember("error"));
+        REQUIRE(res[1]["status"].asString() == "PENDING");
+        REQUIRE(res[1]["hash"].asString() == binToHex(tx2->getFullHash()));
+        REQUIRE(res[2].isMember("exception"));
+        REQUIRE(!res[2].isMember("status"));
+        REQUIRE(res[3]["status"].asString() == "ERROR");
+        REQUIRE(res[3].isMember("error"));
+        REQUIRE(res[3].isMember("fee_charged"));
+        REQUIRE(res[4]["status"].asString() == "DUPLICATE");
+    }
+
+    SECTION("batch size is limited")
+    {
+        std::vector<std::string> blobs(CommandHandler::MAX_TX_BATCH_SIZE + 1,
+                                       toBlob(root.tx({payment(a1, 1)})));
+        std::string params = "?blobs=" + blobs[0];
+        for (size_t i = 1; i < blobs.size(); ++i)
+        {
+            params += "," + blobs[i];
+        }
+        std::string retStr;
+        REQUIRE_THROWS_AS(ch.txbatch(params, retStr), std::invalid_argument);
+    }
+}
+
+TEST_CASE("commands during background apply", "[commandhandler]")
+{
+    auto networkID = sha256(getTestConfig().NETWORK_PASSPHRASE);
+    auto sim = Topologies::core(4, 0.75, Simulation::OVER_LOOPBACK, networkID,
+                                [](int i) {
+                                    auto cfg = getTestConfig(
+                                        i, Config::TESTDB_ON_DISK_SQLITE);
+                                    cfg.PARALLEL_LEDGER_APPLY = true;
+                                    return cfg;
+                                });
+    sim->startAllNodes();
+    sim->crankUntil([&]() { return sim->haveAllExternalized(3, 1); },
+                    std::chrono::seconds(30), false);
+
+    auto app = sim->getNodes()[0];
+    auto& lm = app->getLedgerManager();
+    sim->crankUntil([&]() { return !lm.isApplying(); },
+                    std::chrono::seconds(30), false);
+    auto root = TestAccount::createRoot(*app);
+    std::vector<TransactionFrameBasePtr> txs{root.tx({payment(root, 1)}),
+                                             root.tx({payment(root, 2)})};
+
+    // Hold the next background apply until the batch has been submitted.
+    std::promise<void> unblock;
+    auto unblockOnExit = gsl::finally([&]() { unblock.set_value(); });
+    auto blocked = unblock.get_future().share();
+    app->postOnLedgerCloseThread([blocked]() { blocked.wait(); },
+                                 "test: block ledger close");
+    sim->crankUntil([&]() { return lm.isApplying(); },
+                    std::chrono::seconds(30), false);
+
+    std::string params = "?blobs=";
+    for (size_t i = 0; i < txs.size(); ++i)
+    {
+        auto env = xdr::xdr_to_opaque(txs[i]->getEnvelope());
+        params += (i == 0 ? "" : ",") + decoder::encode_b64(env);
+    }
+    // The LedgerTxnRoot belongs to the ledger-close thread: the batch must
+    // neither touch it nor report anything it hasn't checked as pending.
+    std::string retStr;
+    app->getCommandHandler().txbatch(params, retStr);
+    Json::Value res;
+    REQUIRE(Json::Reader().parse(retStr, res));
+    REQUIRE(res.size() == txs.size());
+    for (auto const& r : res)
+    {
+        REQUIRE(r["status"].asString() == "TRY_AGAIN_LATER");
+    }
+
+    // testacc and testtx load accounts, so they turn the request down.
+    retStr.clear();
+    app->getCommandHandler().testAcc("?name=root", retStr);
+    REQUIRE(Json::Reader().parse(retStr, res));
+    REQUIRE(res["status"].asString() == "error");
+
+    retStr.clear();
+    app->getCommandHandler().testTx("?from=root&to=root&amount=1", retStr);
+    REQUIRE(Json::Reader().parse(retStr, res));
+    REQUIRE(res["status"].asString() == "error");
+}
+
+TEST_CASE("txbatch benchmark", "[commandhandler][bench][!hide]")
+{
+    // Submits one transaction from each of 10000 accounts, half through one
+    // `tx` request per transaction and half through full `txbatch` requests,
+    // and compares the throughput.
+    size_t const numAccounts = 10000;
+
+    VirtualClock clock;
+    auto cfg = getTestConfig();
+    cfg.TESTING_UPGRADE_MAX_TX_SET_SIZE = static_cast<uint32>(numAccounts);
+    auto app = createTestApplication(clock, cfg);
+    auto& ch = app->getCommandHandler();
+    auto root = TestAccount::createRoot(*app);
+
+    // Write the accounts straight into the ledger: applying 10000
+    // create-account transactions would take longer than what's measured.
+    std::vector<SecretKey> keys;
+    {
+        LedgerTxn ltx(app->getLedgerTxnRoot());
+        for (size_t i = 0; i < numAccounts; ++i)
+        {
+            keys.emplace_back(getAccount(fmt::format("bench{}", i)));
+            LedgerEntry le;
+            le.data.type(ACCOUNT);
+            auto& ae = le.data.account();
+            ae.accountID = keys.back().getPublicKey();
+            ae.balance = 1000000000000;
+            ae.thresholds[0] = 1;
+            ltx.create(le);
+        }
+        ltx.commit();
+    }
+
+    std::vector<std::string> blobs;
+    for (auto const& key : keys)
+    {
+        auto tx =
+            transactionFromOperations(*app, key, 1, {payment(root, 1000000)});
+        blobs.emplace_back(
+            decoder::encode_b64(xdr::xdr_to_opaque(tx->getEnvelope())));
+    }
+
+    namespace chr = std::chrono;
+    using benchClock = chr::steady_clock;
+    size_t const half = numAccounts / 2;
+    std::string retStr;
+
+    auto start = benchClock::now();
+    for (size_t i = 0; i < half; ++i)
+    {
+        ch.tx("?blob=" + blobs[i], retStr);
+        REQUIRE(retStr == "{\"status\": \"PENDING\"}");
+    }
+    auto singleTime = benchClock::now() - start;
+
+    start = benchClock::now();
+    for (size_t i = half; i < numAccounts;
+         i += CommandHandler::MAX_TX_BATCH_SIZE)
+    {
+        auto end = std::min(numAccounts, i + CommandHandler::MAX_TX_BATCH_SIZE);
+        std::string params = "?blobs=" + blobs[i];
+        for (size_t j = i + 1; j < end; ++j)
+        {
+            params += "," + blobs[j];
+        }
+        ch.txbatch(params, retStr);
+        Json::Value res;
+        REQUIRE(Json::Reader().parse(retStr, res));
+        for (auto const& r : res)
+        {
+            REQUIRE(r["status"].asString() == "PENDING");
+        }
+    }
+    auto batchTime = benchClock::now() - start;
+
+    auto perSecond = [](size_t n, benchClock::duration d) {
+        return static_cast<double>(n) / chr::duration<double>(d).count();
+    };
+    LOG_INFO(DEFAULT_LOG,
+             "submitted {} txs one per request in {} ({:.0f} tx/s), and {} "
+             "in batches of up to {} in {} ({:.0f} tx/s)",
+             half, chr::duration_cast<chr::milliseconds>(singleTime),
+             perSecond(half, singleTime), numAccounts - half,
+             CommandHandler::MAX_TX_BATCH_SIZE,
+             chr::duration_cast<chr::milliseconds>(batchTime),
+             perSecond(numAccounts - half, batchTime));
+}
@@ -1259,13 +1259,17 @@ Peer::recvTransaction(StellarMessage const& msg)
 
         // add it to our current set
         // and make sure it is valid
-        auto recvRes = mApp.getHerder().recvTransaction(transaction);
-
-        if (!(recvRes == TransactionQueue::AddResult::ADD_STATUS_PENDING ||
-              recvRes == TransactionQueue::AddResult::ADD_STATUS_DUPLICATE))
-        {
-            mApp.getOverlayManager().forgetFloodedMsg(msgID);
-        }
+        auto& om = mApp.getOverlayManager();
+        mApp.getHerder().recvTransactionAsync(
+            transaction, [&om, msgID](TransactionQueue::AddResult recvRes) {
+                if (!(recvRes ==
+                          TransactionQueue::AddResult::ADD_STATUS_PENDING ||
+                      recvRes ==
+                          TransactionQueue::AddResult::ADD_STATUS_DUPLICATE))
+                {
+                    om.forgetFloodedMsg(msgID);
+                }
+            });
     }
 }
 
@@ -6,6 +6,7 @@
 #include "crypto/Random.h"
 #include "database/Database.h"
 #include "lib/util/stdrandom.h"
+#include "ledger/LedgerManager.h"
 #include "main/Application.h"
 #include "overlay/RandomPeerSource.h"
 #include "overlay/StellarXDR.h"
@@ -97,6 +98,7 @@ PeerManager::loadRandomPeers(PeerQuery const& query, size_t size)
     ZoneScoped;
     // BATCH_SIZE should always be bigger, so it should win anyway
     size = std::max(size, BATCH_SIZE);
+    storeDeferred();
 
     // if we ever start removing peers from db, we may need to enable this
     // soci::transaction sqltx(mApp.getDatabase().getSession());
@@ -172,6 +174,12 @@ PeerManager::removePeersWithManyFailures(size_t minNumFailures,
                                          PeerBareAddress const* address)
 {
     ZoneScoped;
+    // Peers are purged again on the next call.
+    if (mApp.getLedgerManager().isApplying())
+    {
+        return;
+    }
+    storeDeferred();
     try
     {
         auto& db = mApp.getDatabase();
@@ -232,6 +240,13 @@ std::pair<PeerRecord, bool>
 PeerManager::load(PeerBareAddress const& address)
 {
     ZoneScoped;
+    storeDeferred();
+    auto deferred = mDeferredStores.find(address);
+    if (deferred != mDeferredStores.end())
+    {
+        return deferred->second;
+    }
+
     auto result = PeerRecord{};
     auto inDatabase = false;
 
@@ -276,6 +291,18 @@ PeerManager::store(PeerBareAddress const& address, PeerRecord const& peerRecord,
                    bool inDatabase)
 {
     ZoneScoped;
+    if (mApp.getLedgerManager().isApplying())
+    {
+        auto res = mDeferredStores.emplace(
+            address, std::make_pair(peerRecord, inDatabase));
+        if (!res.second)
+        {
+            res.first->second.first = peerRecord;
+        }
+        return;
+    }
+    storeDeferred();
+
     std::string query;
 
     if (inDatabase)
@@ -323,6 +350,21 @@ PeerManager::store(PeerBareAddress const& address, PeerRecord const& peerRecord,
     }
 }
 
+void
+PeerManager::storeDeferred()
+{
+    if (mDeferredStores.empty() || mApp.getLedgerManager().isApplying())
+    {
+        return;
+    }
+    auto deferred = std::move(mDeferredStores);
+    mDeferredStores.clear();
+    for (auto const& kv : deferred)
+    {
+        store(kv.first, kv.second.first, kv.second.second);
+    }
+}
+
 void
 PeerManager::update(PeerRecord& peer, TypeUpdate type)
 {
@@ -580,6 +622,7 @@ std::vector<std::pair<PeerBareAddress, PeerRecord>>
 PeerManager::loadAllPeers()
 {
     ZoneScoped;
+    storeDeferred();
     std::vector<std::pair<PeerBareAddress, PeerRecord>> result;
     std::string sql =
         "SELECT ip, port, nextattempt, numfailures, type FROM peers";
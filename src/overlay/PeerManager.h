@@ -8,6 +8,7 @@
 #include "util/Timer.h"
 
 #include <functional>
+#include <map>
 
 namespace soci
 {
@@ -115,7 +116,9 @@ class PeerManager
 
     /**
      * Store PeerRecord data into database. If inDatabase is true, uses UPDATE
-     * query, uses INSERT otherwise.
+     * query, uses INSERT otherwise. While a ledger is applied on the
+     * ledger-close thread the write is held back (and seen by load()) until
+     * the next call made after the apply.
      */
     void store(PeerBareAddress const& address, PeerRecord const& PeerRecord,
                bool inDatabase);
@@ -128,7 +131,8 @@ class PeerManager
 
     /**
      * Remove peers that have at least minNumFailures. Can only remove peer with
-     * given address.
+     * given address. Does nothing while a ledger is being applied on the
+     * ledger-close thread.
      */
     void removePeersWithManyFailures(size_t minNumFailures,
                                      PeerBareAddress const* address = nullptr);
@@ -156,6 +160,14 @@ class PeerManager
     std::unique_ptr<RandomPeerSource> mOutboundPeersToSend;
     std::unique_ptr<RandomPeerSource> mInboundPeersToSend;
 
+    // Stores held back while the ledger-close thread applies a ledger: on
+    // SQLite its write transaction would block the main thread until the
+    // apply commits. Keyed by address, with the inDatabase flag of the first
+    // held store.
+    std::map<PeerBareAddress, std::pair<PeerRecord, bool>> mDeferredStores;
+
+    void storeDeferred();
+
     size_t countPeers(std::string const& where,
                       std::function<void(soci::statement&)> const& bind);
     std::vector<PeerBareAddress>
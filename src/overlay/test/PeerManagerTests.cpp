@@ -2,7 +2,9 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "crypto/SHA.h"
 #include "database/Database.h"
+#include "ledger/LedgerManager.h"
 #include "lib/catch.hpp"
 #include "main/Application.h"
 #include "main/Config.h"
@@ -10,8 +12,13 @@
 #include "overlay/PeerManager.h"
 #include "overlay/RandomPeerSource.h"
 #include "overlay/StellarXDR.h"
+#include "simulation/Simulation.h"
+#include "simulation/Topologies.h"
 #include "test/TestUtils.h"
 #include "test/test.h"
+#include "util/finally.h"
+
+#include <future>
 
 namespace stellar
 {
@@ -537,4 +544,49 @@ TEST_CASE("purge peer table", "[overlay][PeerManager]")
     peerManager.removePeersWithManyFailures(2, &localhost2);
     REQUIRE(!peerManager.load(localhost(2)).second);
 }
+
+TEST_CASE("peer writes during background apply", "[overlay][PeerManager]")
+{
+    auto networkID = sha256(getTestConfig().NETWORK_PASSPHRASE);
+    auto sim = Topologies::core(4, 0.75, Simulation::OVER_LOOPBACK, networkID,
+                                [](int i) {
+                                    auto cfg = getTestConfig(
+                                        i, Config::TESTDB_ON_DISK_SQLITE);
+                                    cfg.PARALLEL_LEDGER_APPLY = true;
+                                    return cfg;
+                                });
+    sim->startAllNodes();
+    sim->crankUntil([&]() { return sim->haveAllExternalized(3, 1); },
+                    std::chrono::seconds(30), false);
+
+    auto app = sim->getNodes()[0];
+    auto& lm = app->getLedgerManager();
+    auto& peerManager = app->getOverlayManager().getPeerManager();
+    auto address = PeerBareAddress{"10.0.0.1", 11625};
+    auto record = PeerRecord{{}, 2, static_cast<int>(PeerType::INBOUND)};
+
+    {
+        // Hold the next background apply until the peer has been stored.
+        std::promise<void> unblock;
+        auto unblockOnExit = gsl::finally([&]() { unblock.set_value(); });
+        auto blocked = unblock.get_future().share();
+        app->postOnLedgerCloseThread([blocked]() { blocked.wait(); },
+                                     "test: block ledger close");
+        sim->crankUntil([&]() { return lm.isApplying(); },
+                        std::chrono::seconds(30), false);
+
+        // The write is held back, but load() already sees it.
+        peerManager.store(address, record, false);
+        peerManager.removePeersWithManyFailures(1, &address);
+        auto loaded = peerManager.load(address);
+        REQUIRE(!loaded.second);
+        REQUIRE(loaded.first.mNumFailures == 2);
+    }
+
+    sim->crankUntil([&]() { return !lm.isApplying(); },
+                    std::chrono::seconds(30), false);
+    auto loaded = peerManager.load(address);
+    REQUIRE(loaded.second);
+    REQUIRE(loaded.first.mNumFailures == 2);
+}
 }
@@ -233,6 +233,15 @@ LoadGenerator::generateLoad(LoadGenMode mode, uint32_t nAccounts,
             std::make_unique<VirtualClock::time_point>(mApp.getClock().now());
     }
 
+    // The ledger-close thread owns the ledger state while it applies a
+    // ledger, so nothing can be loaded or submitted; skip this step.
+    if (mApp.getLedgerManager().isApplying())
+    {
+        scheduleLoadGeneration(mode, nAccounts, offset, nTxs, txRate,
+                               batchSize, spikeInterval, spikeSize);
+        return;
+    }
+
     createRootAccount();
 
     // Finish if no more txs need to be created.
@@ -649,6 +658,18 @@ LoadGenerator::waitTillComplete(bool isCreate)
     {
         mLoadTimer = std::make_unique<VirtualTimer>(mApp.getClock());
     }
+
+    // Accounts can't be loaded while a ledger is applied on the ledger-close
+    // thread; check again shortly, without counting it against the timeout.
+    if (mApp.getLedgerManager().isApplying())
+    {
+        mLoadTimer->expires_from_now(std::chrono::milliseconds(STEP_MSECS));
+        mLoadTimer->async_wait(
+            [this, isCreate]() { this->waitTillComplete(isCreate); },
+            &VirtualTimer::onFailureNoop);
+        return;
+    }
+
     vector<TestAccountPtr> inconsistencies;
     inconsistencies = checkAccountSynced(mApp, isCreate);
 
@@ -12,6 +12,7 @@
 #include "ledger/LedgerTxnHeader.h"
 #include "main/Application.h"
 #include "transactions/SignatureChecker.h"
+#include "transactions/SignaturePreVerifier.h"
 #include "transactions/SignatureUtils.h"
 #include "transactions/SponsorshipUtils.h"
 #include "transactions/TransactionUtils.h"
@@ -389,6 +390,15 @@ FeeBumpTransactionFrame::insertKeysForTxApply(
     mInnerTx->insertKeysForTxApply(keys);
 }
 
+void
+FeeBumpTransactionFrame::insertSignaturesForPreVerify(
+    AbstractLedgerTxn& ltx, SignaturePreVerifier& verifier) const
+{
+    verifier.addAccountSignatures(ltx, getFeeSourceID(), getContentsHash(),
+                                  mEnvelope.feeBump().signatures);
+    mInnerTx->insertSignaturesForPreVerify(ltx, verifier);
+}
+
 void
 FeeBumpTransactionFrame::processFeeSeqNum(AbstractLedgerTxn& ltx,
                                           int64_t baseFee)
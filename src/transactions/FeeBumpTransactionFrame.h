@@ -87,6 +87,9 @@ class FeeBumpTransactionFrame : public TransactionFrameBase
     void
     insertKeysForFeeProcessing(UnorderedSet<LedgerKey>& keys) const override;
     void insertKeysForTxApply(UnorderedSet<LedgerKey>& keys) const override;
+    void
+    insertSignaturesForPreVerify(AbstractLedgerTxn& ltx,
+                                 SignaturePreVerifier& verifier) const override;
 
     void processFeeSeqNum(AbstractLedgerTxn& ltx, int64_t baseFee) override;
 
@@ -0,0 +1,128 @@
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "transactions/SignaturePreVerifier.h"
+#include "crypto/KeyUtils.h"
+#include "crypto/SecretKey.h"
+#include "crypto/SignerKey.h"
+#include "ledger/LedgerTxn.h"
+#include "ledger/LedgerTxnEntry.h"
+#include "main/Application.h"
+#include "transactions/SignatureUtils.h"
+#include "transactions/TransactionUtils.h"
+#include "util/GlobalChecks.h"
+#include <Tracy.hpp>
+
+#include <algorithm>
+
+namespace stellar
+{
+
+void
+SignaturePreVerifier::addTransactions(
+    AbstractLedgerTxn& ltx, std::vector<TransactionFrameBasePtr> const& txs)
+{
+    ZoneScoped;
+    releaseAssert(!mStarted);
+    for (auto const& tx : txs)
+    {
+        tx->insertSignaturesForPreVerify(ltx, *this);
+    }
+}
+
+void
+SignaturePreVerifier::addAccountSignatures(
+    AbstractLedgerTxn& ltx, AccountID const& accountID,
+    Hash const& contentsHash,
+    xdr::xvector<DecoratedSignature, 20> const& signatures)
+{
+    releaseAssert(!mStarted);
+    if (signatures.empty())
+    {
+        return;
+    }
+
+    // The master key is a candidate even if the account does not exist, as
+    // operations with a missing source account still check it.
+    std::vector<PublicKey> keys{accountID};
+    {
+        auto account = loadAccountWithoutRecord(ltx, accountID);
+        if (account)
+        {
+            for (auto const& signer : account.current().data.account().signers)
+            {
+                if (signer.key.type() == SIGNER_KEY_TYPE_ED25519)
+                {
+                    keys.emplace_back(
+                        KeyUtils::convertKey<PublicKey>(signer.key));
+                }
+            }
+        }
+    }
+
+    for (auto const& sig : signatures)
+    {
+        if (sig.signature.size() != 64)
+        {
+            continue;
+        }
+        for (auto const& key : keys)
+        {
+            if (SignatureUtils::doesHintMatch(key.ed25519(), sig.hint))
+            {
+                mChecks.emplace_back(Check{key, sig.signature, contentsHash});
+            }
+        }
+    }
+}
+
+void
+SignaturePreVerifier::drain()
+{
+    ZoneScoped;
+    size_t n = 0;
+    for (size_t i = mNextCheck++; i < mChecks.size(); i = mNextCheck++)
+    {
+        auto const& check = mChecks[i];
+        PubKeyUtils::verifySig(check.mKey, check.mSignature,
+                               check.mContentsHash);
+        ++n;
+    }
+
+    if (n != 0 && (mDoneChecks += n) == mChecks.size())
+    {
+        std::lock_guard<std::mutex> lock(mDoneMutex);
+        mDoneCV.notify_all();
+    }
+}
+
+void
+SignaturePreVerifier::start(Application& app, size_t maxTasks)
+{
+    ZoneScoped;
+    releaseAssert(!mStarted);
+    mStarted = true;
+
+    // Each task drains the shared queue, so posting more tasks than there
+    // are checks only produces no-op wakeups.
+    auto tasks = std::min(maxTasks, mChecks.size());
+    for (size_t i = 0; i < tasks; ++i)
+    {
+        app.postOnBackgroundThread(
+            [self = shared_from_this()]() { self->drain(); },
+            "SignaturePreVerifier: verify");
+    }
+}
+
+void
+SignaturePreVerifier::finish()
+{
+    ZoneScoped;
+    releaseAssert(mStarted);
+    drain();
+
+    std::unique_lock<std::mutex> lock(mDoneMutex);
+    mDoneCV.wait(lock, [&] { return mDoneChecks == mChecks.size(); });
+}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "transactions/TransactionFrameBase.h"
+#include "xdr/Stellar-ledger-entries.h"
+#include "xdr/Stellar-transaction.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace stellar
+{
+
+class AbstractLedgerTxn;
+class Application;
+
+// SignaturePreVerifier runs the ed25519 checks that applying a set of
+// transactions is going to perform ahead of time, on the worker threads, so
+// that the (pure, process-wide) verify cache in PubKeyUtils is already warm
+// once the transactions are applied on the main thread.
+//
+// Usage is: add every transaction while the ledger still reflects the
+// signers that apply will see, call start() to fan the checks out, do other
+// main-thread work, then call finish() before applying. finish() claims any
+// check no worker has picked up yet and runs it on the calling thread, so a
+// worker pool that is busy with long-running merges can delay but never
+// block ledger close.
+//
+// Results are only ever used as cache entries: a check that turns out to be
+// unnecessary (or is missing because signers changed during apply) costs
+// time, never correctness.
+class SignaturePreVerifier
+  : public std::enable_shared_from_this<SignaturePreVerifier>
+{
+    struct Check
+    {
+        PublicKey mKey;
+        Signature mSignature;
+        Hash mContentsHash;
+    };
+
+    std::vector<Check> mChecks;
+
+    std::atomic<size_t> mNextCheck{0};
+    std::atomic<size_t> mDoneChecks{0};
+    std::mutex mDoneMutex;
+    std::condition_variable mDoneCV;
+    bool mStarted{false};
+
+    // Claims and runs checks until none are left unclaimed.
+    void drain();
+
+  public:
+    // Queue checks for every transaction in `txs`, looking signers up in
+    // `ltx` (which is not modified).
+    void addTransactions(AbstractLedgerTxn& ltx,
+                         std::vector<TransactionFrameBasePtr> const& txs);
+
+    // Queue a check for every (signature, key) pair where `key` is the
+    // master key or an ed25519 signer of `accountID` and its hint matches.
+    void addAccountSignatures(
+        AbstractLedgerTxn& ltx, AccountID const& accountID,
+        Hash const& contentsHash,
+        xdr::xvector<DecoratedSignature, 20> const& signatures);
+
+    // Post the queued checks to at most `maxTasks` worker threads.
+    void start(Application& app, size_t maxTasks);
+
+    // Run whatever is left on the calling thread and wait for checks that
+    // are still in flight on worker threads.
+    void finish();
+
+    size_t
+    size() const
+    {
+        return mChecks.size();
+    }
+};
+}
@@ -14,12 +14,15 @@
 #include "herder/TxSetFrame.h"
 #include "invariant/InvariantDoesNotHold.h"
 #include "invariant/InvariantManager.h"
+#include "ledger/LedgerCloseProfiler.h"
 #include "ledger/LedgerHeaderUtils.h"
+#include "ledger/LedgerManager.h"
 #include "ledger/LedgerTxn.h"
 #include "ledger/LedgerTxnEntry.h"
 #include "ledger/LedgerTxnHeader.h"
 #include "main/Application.h"
 #include "transactions/SignatureChecker.h"
+#include "transactions/SignaturePreVerifier.h"
 #include "transactions/SignatureUtils.h"
 #include "transactions/SponsorshipUtils.h"
 #include "transactions/TransactionBridge.h"
@@ -41,6 +44,7 @@
 #include "medida/metrics_registry.h"
 
 #include <algorithm>
+#include <chrono>
 #include <numeric>
 
 namespace stellar
@@ -53,6 +57,9 @@ TransactionFrame::TransactionFrame(Hash const& networkID,
                                    TransactionEnvelope const& envelope)
     : mEnvelope(envelope), mNetworkID(networkID)
 {
+#ifdef _KINESIS
+    computePercentageFeeAmount();
+#endif
 }
 
 Hash const&
@@ -99,6 +106,10 @@ TransactionFrame::clearCached()
     Hash zero;
     mContentsHash = zero;
     mFullHash = zero;
+#ifdef _KINESIS
+    // the envelope may have been edited in place
+    computePercentageFeeAmount();
+#endif
 }
 
 TransactionEnvelope const&
@@ -157,56 +168,91 @@ TransactionFrame::getRawOperations() const
 int64_t
 TransactionFrame::getFeeBid() const
 {
-    auto feeBid = mEnvelope.type() == ENVELOPE_TYPE_TX_V0 ? mEnvelope.v0().tx.fee
+    return mEnvelope.type() == ENVELOPE_TYPE_TX_V0 ? mEnvelope.v0().tx.fee
                                                    : mEnvelope.v1().tx.fee;
-    CLOG_DEBUG(Tx, "**Kinesis** TransactionFrame::getFeeBid() - feeBid: {}", feeBid);
-    return feeBid;
 }
 
 
 #ifdef _KINESIS
 
 // kinesis implementation
-int64_t
-TransactionFrame::getMinFee(LedgerHeader const& header) const
+void
+TransactionFrame::computePercentageFeeAmount()
 {
-    auto baseFee =
-        ((int64_t)header.baseFee) * std::max<int64_t>(1, getNumOperations());
-
     // apply base percentage fee
     // affect: create_account and payment ops
-    int64_t accumulatedBasePercentageFee = 0;
-    double basePercentageFeeRate =
-        (double)header.basePercentageFee / (double)BASIS_POINTS_TO_PERCENT;
-
     int64_t totalAmount = 0;
-    for (auto& op : mOperations)
+    for (auto const& operation : getRawOperations())
     {
-        auto operation = op->getOperation();
         auto operationType = operation.body.type();
         if (operationType == CREATE_ACCOUNT)
         {
             totalAmount += operation.body.createAccountOp().startingBalance;
         }
-        else if (operationType == PAYMENT)
+        else if (operationType == PAYMENT &&
+                 operation.body.paymentOp().asset.type() == ASSET_TYPE_NATIVE)
         {
-            int8_t assetType =
-                operation.body.paymentOp().asset.type(); // 0 is native
-            if (assetType == 0)
-            {
-                totalAmount += operation.body.paymentOp().amount;
-            }
+            totalAmount += operation.body.paymentOp().amount;
         }
     }
+    mPercentageFeeAmount = totalAmount;
+}
+
+namespace
+{
+// getMinFee is a pure function of these inputs, and the same frame is
+// usually asked several times in a row for the same header (queue
+// admission, tx set building, apply). The last result is memoized per
+// thread, keyed on every input, so frames checked on worker threads share
+// nothing and a hit can never return a fee computed for other inputs.
+struct MinFeeMemo
+{
+    int64_t mAmount{0};
+    int64_t mNumOps{0};
+    uint32_t mBaseFee{0};
+    uint32_t mBasePercentageFee{0};
+    uint64_t mMaxFee{0};
+    int64_t mMinFee{-1};
+};
+thread_local MinFeeMemo gMinFeeMemo;
+}
+
+int64_t
+TransactionFrame::getMinFee(LedgerHeader const& header) const
+{
+    int64_t numOps = std::max<int64_t>(1, getNumOperations());
+    auto& memo = gMinFeeMemo;
+    if (memo.mMinFee >= 0 && memo.mAmount == mPercentageFeeAmount &&
+        memo.mNumOps == numOps && memo.mBaseFee == header.baseFee &&
+        memo.mBasePercentageFee == header.basePercentageFee &&
+        memo.mMaxFee == header.maxFee)
+    {
+        return memo.mMinFee;
+    }
+
+    auto baseFee = ((int64_t)header.baseFee) * numOps;
 
-    accumulatedBasePercentageFee +=
-        (int64_t)(totalAmount * basePercentageFeeRate);
+    // Note: the rate is applied in floating point, exactly as it always has
+    // been. The result feeds the min-fee check performed during apply, so
+    // switching to integer basis-point math changes which transactions are
+    // valid and needs a protocol upgrade.
+    double basePercentageFeeRate =
+        (double)header.basePercentageFee / (double)BASIS_POINTS_TO_PERCENT;
+    int64_t accumulatedBasePercentageFee =
+        (int64_t)(mPercentageFeeAmount * basePercentageFeeRate);
     int64_t totalFee = baseFee + accumulatedBasePercentageFee;
     CLOG_DEBUG(Tx, "**Kinesis** TransactionFrame::getMinFee() - header.baseFee: {}, baseFee: {}, amount: {}, totalFee: {}",
-       header.baseFee, baseFee, totalAmount, totalFee
+       header.baseFee, baseFee, mPercentageFeeAmount, totalFee
     );
     int64_t headerMaxFee=(int64_t)header.maxFee;
     totalFee=totalFee>headerMaxFee?headerMaxFee:totalFee;
+
+    memo.mAmount = mPercentageFeeAmount;
+    memo.mNumOps = numOps;
+    memo.mBaseFee = header.baseFee;
+    memo.mBasePercentageFee = header.basePercentageFee;
+    memo.mMaxFee = header.maxFee;
+    memo.mMinFee = totalFee;
     return totalFee;
 }
 #else
@@ -793,6 +839,31 @@ TransactionFrame::insertKeysForTxApply(UnorderedSet<LedgerKey>& keys) const
     }
 }
 
+void
+TransactionFrame::insertSignaturesForPreVerify(
+    AbstractLedgerTxn& ltx, SignaturePreVerifier& verifier) const
+{
+    // Use the raw operations: frames coming from a tx set have not
+    // necessarily had their OperationFrames built yet.
+    UnorderedSet<AccountID> accounts{getSourceID()};
+    for (auto const& op : getRawOperations())
+    {
+        if (op.sourceAccount)
+        {
+            accounts.emplace(toAccountID(*op.sourceAccount));
+        }
+    }
+
+    auto const& signatures = mEnvelope.type() == ENVELOPE_TYPE_TX_V0
+                                 ? mEnvelope.v0().signatures
+                                 : mEnvelope.v1().signatures;
+    for (auto const& accountID : accounts)
+    {
+        verifier.addAccountSignatures(ltx, accountID, getContentsHash(),
+                                      signatures);
+    }
+}
+
 void
 TransactionFrame::markResultFailed()
 {
@@ -836,11 +907,16 @@ TransactionFrame::applyOperations(SignatureChecker& signatureChecker,
             app.getConfig().LEDGER_PROTOCOL_MIN_VERSION_INTERNAL_ERROR_REPORT;
         auto& opTimer =
             app.getMetrics().NewTimer({"ledger", "operation", "apply"});
+        auto& profiler = app.getLedgerManager().getCloseProfiler();
         for (auto& op : mOperations)
         {
             auto time = opTimer.TimeScope();
             LedgerTxn ltxOp(ltxTx);
+            auto opStart = std::chrono::steady_clock::now();
             bool txRes = op->apply(app, signatureChecker, ltxOp);
+            profiler.addOperationTime(op->getOperation().body.type(),
+                                      std::chrono::steady_clock::now() -
+                                          opStart);
 
             if (!txRes)
             {
@@ -848,6 +924,8 @@ TransactionFrame::applyOperations(SignatureChecker& signatureChecker,
             }
             if (success)
             {
+                LedgerCloseProfiler::PhaseTimer invariantsTime(
+                    profiler, LedgerCloseProfiler::Phase::INVARIANTS);
                 app.getInvariantManager().checkOnOperationApply(
                     op->getOperation(), op->getResult(), ltxOp.getDelta());
 
@@ -56,6 +56,14 @@ class TransactionFrame : public TransactionFrameBase
 
     std::vector<std::shared_ptr<OperationFrame>> mOperations;
 
+#ifdef _KINESIS
+    // Native amount moved by the create-account and payment operations of
+    // the envelope, which is what the percentage fee is charged on.
+    int64_t mPercentageFeeAmount{0};
+
+    void computePercentageFeeAmount();
+#endif
+
     LedgerTxnEntry loadSourceAccount(AbstractLedgerTxn& ltx,
                                      LedgerTxnHeader const& header);
 
@@ -189,6 +197,9 @@ class TransactionFrame : public TransactionFrameBase
     void
     insertKeysForFeeProcessing(UnorderedSet<LedgerKey>& keys) const override;
     void insertKeysForTxApply(UnorderedSet<LedgerKey>& keys) const override;
+    void
+    insertSignaturesForPreVerify(AbstractLedgerTxn& ltx,
+                                 SignaturePreVerifier& verifier) const override;
 
     // collect fee, consume sequence number
     void processFeeSeqNum(AbstractLedgerTxn& ltx, int64_t baseFee) override;
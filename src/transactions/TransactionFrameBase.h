@@ -14,6 +14,7 @@ class AbstractLedgerTxn;
 class Application;
 class Database;
 class OperationFrame;
+class SignaturePreVerifier;
 
 class TransactionFrameBase;
 using TransactionFrameBasePtr = std::shared_ptr<TransactionFrameBase>;
@@ -56,6 +57,12 @@ class TransactionFrameBase
     insertKeysForFeeProcessing(UnorderedSet<LedgerKey>& keys) const = 0;
     virtual void insertKeysForTxApply(UnorderedSet<LedgerKey>& keys) const = 0;
 
+    // Queue, in `verifier`, the ed25519 checks apply is expected to perform
+    // given the signers currently recorded in `ltx`.
+    virtual void
+    insertSignaturesForPreVerify(AbstractLedgerTxn& ltx,
+                                 SignaturePreVerifier& verifier) const = 0;
+
     virtual void processFeeSeqNum(AbstractLedgerTxn& ltx, int64_t baseFee) = 0;
 
     virtual StellarMessage toStellarMessage() const = 0;
@@ -2112,3 +2112,47 @@ TEST_CASE("txenvelope", "[tx][envelope]")
         for_versions_from(13, *app, [&] { doChecks(txSUCCESS); });
     }
 }
+
+#ifdef _KINESIS
+TEST_CASE("kinesis min fee follows header fee parameters", "[tx][envelope]")
+{
+    VirtualClock clock;
+    auto app = createTestApplication(clock, getTestConfig());
+    auto root = TestAccount::createRoot(*app);
+    auto a1 = getAccount("a1").getPublicKey();
+
+    auto tx = root.tx({payment(a1, 1000000), createAccount(a1, 2000000),
+                       payment(a1, makeAsset(root, "USD"), 5000000)});
+
+    // The percentage is applied in floating point (which, for instance,
+    // charges 13499 rather than 13500 on 3000000 at 45bp); this is
+    // consensus-relevant and must not change silently.
+    auto percentageFee = [](int64_t amount, uint32_t bps) {
+        return (int64_t)(amount * ((double)bps / 10000.0));
+    };
+
+    LedgerHeader header =
+        app->getLedgerManager().getLastClosedLedgerHeader().header;
+    header.baseFee = 100;
+    header.basePercentageFee = 45;
+    header.maxFee = 1000000;
+    // only the native payment and the create-account amounts are charged
+    REQUIRE(tx->getMinFee(header) == 3 * 100 + 13499);
+    REQUIRE(tx->getMinFee(header) == 3 * 100 + percentageFee(3000000, 45));
+
+    header.basePercentageFee = 10;
+    REQUIRE(tx->getMinFee(header) == 3 * 100 + percentageFee(3000000, 10));
+
+    header.baseFee = 200;
+    REQUIRE(tx->getMinFee(header) == 3 * 200 + percentageFee(3000000, 10));
+
+    header.maxFee = 1000;
+    REQUIRE(tx->getMinFee(header) == 1000);
+
+    // editing the envelope in place and clearing cached state is honored
+    getOperations(tx->getEnvelope())[0].body.paymentOp().amount = 4000000;
+    tx->clearCached();
+    header.maxFee = 1000000;
+    REQUIRE(tx->getMinFee(header) == 3 * 200 + percentageFee(6000000, 10));
+}
+#endif
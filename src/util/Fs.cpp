@@ -104,6 +104,27 @@ flushFileChanges(native_handle_t fh)
     }
 }
 
+void
+flushPathChanges(std::string const& path)
+{
+    ZoneScoped;
+    if (std::filesystem::is_directory(path))
+    {
+        return;
+    }
+    HANDLE h = ::CreateFile(path.c_str(), GENERIC_WRITE,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE)
+    {
+        FileSystemException::failWithGetLastError(
+            std::string("fs::flushPathChanges() failed on CreateFile(\"") +
+            path + std::string("\"): "));
+    }
+    flushFileChanges(h);
+    ::CloseHandle(h);
+}
+
 native_handle_t
 openFileToWrite(std::string const& path)
 {
@@ -233,6 +254,34 @@ flushFileChanges(native_handle_t fd)
     }
 }
 
+void
+flushPathChanges(std::string const& path)
+{
+    ZoneScoped;
+    int fd;
+    while ((fd = ::open(path.c_str(), O_RDONLY)) == -1)
+    {
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        FileSystemException::failWithErrno(
+            std::string("fs::flushPathChanges() failed to open ") + path +
+            ": ");
+    }
+    flushFileChanges(fd);
+    while (close(fd) == -1)
+    {
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        FileSystemException::failWithErrno(
+            std::string("fs::flushPathChanges() failed to close ") + path +
+            ": ");
+    }
+}
+
 native_handle_t
 openFileToWrite(std::string const& path)
 {
@@ -47,6 +47,12 @@ void unlockFile(std::string const& path);
 // Call fsync() on POSIX or FlushFileBuffers() on Win32.
 void flushFileChanges(native_handle_t h);
 
+// Flush the already-written contents of the file at `path` to disk, as
+// flushFileChanges() would through a handle it was written with. On POSIX
+// `path` may also be a directory, making renames into it durable; on Win32,
+// where durableRename() writes through instead, directories are skipped.
+void flushPathChanges(std::string const& path);
+
 // Open a native handle (fd or HANDLE) for writing.
 native_handle_t openFileToWrite(std::string const& path);
 
@@ -0,0 +1,109 @@
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/MappedFile.h"
+#include "util/FileSystemException.h"
+#include <Tracy.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace stellar
+{
+
+bool
+MappedFile::isSupported()
+{
+#ifdef _WIN32
+    return false;
+#else
+    return true;
+#endif
+}
+
+MappedFile::MappedFile(std::string const& filename)
+{
+    ZoneScoped;
+#ifdef _WIN32
+    FileSystemException::failWith("MappedFile is not supported on windows");
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        FileSystemException::failWithErrno("MappedFile failed to open " +
+                                           filename + ": ");
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        std::string err = std::strerror(errno);
+        ::close(fd);
+        FileSystemException::failWith("MappedFile failed to stat " +
+                                      filename + ": " + err);
+    }
+    mSize = static_cast<size_t>(st.st_size);
+    // Empty files can't be mapped, and need no mapping.
+    if (mSize != 0)
+    {
+        void* p = ::mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            std::string err = std::strerror(errno);
+            ::close(fd);
+            FileSystemException::failWith("MappedFile failed to map " +
+                                          filename + ": " + err);
+        }
+        mData = static_cast<char const*>(p);
+    }
+    // The mapping holds its own reference to the file.
+    ::close(fd);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+    if (mData)
+    {
+        ::munmap(const_cast<char*>(mData), mSize);
+    }
+#endif
+}
+
+void
+MappedFile::adviseSequential()
+{
+#ifndef _WIN32
+    if (mData)
+    {
+        // Only a hint: failure is harmless.
+        ::madvise(const_cast<char*>(mData), mSize, MADV_SEQUENTIAL);
+    }
+#endif
+}
+
+void
+MappedFile::adviseWillNeed(size_t offset, size_t length)
+{
+#ifndef _WIN32
+    if (!mData || offset >= mSize)
+    {
+        return;
+    }
+    // madvise wants a page-aligned start.
+    static size_t const pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t start = offset - offset % pageSize;
+    size_t end = std::min(mSize, offset + length);
+    ::madvise(const_cast<char*>(mData) + start, end - start, MADV_WILLNEED);
+#endif
+}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+
+#include <cstddef>
+#include <string>
+
+namespace stellar
+{
+
+/**
+ * A read-only memory mapping of a whole file, for reading files that don't
+ * change while they're mapped (such as bucket files) without a syscall and a
+ * copy per read. Only supported on POSIX systems; see isSupported().
+ */
+class MappedFile : public NonMovableOrCopyable
+{
+    char const* mData{nullptr};
+    size_t mSize{0};
+
+  public:
+    static bool isSupported();
+
+    // Throws FileSystemException if the file can't be opened or mapped.
+    explicit MappedFile(std::string const& filename);
+    ~MappedFile();
+
+    char const*
+    data() const
+    {
+        return mData;
+    }
+
+    size_t
+    size() const
+    {
+        return mSize;
+    }
+
+    // Hint that the mapping will be read front to back, so the kernel reads
+    // ahead aggressively and drops pages behind the reader early.
+    void adviseSequential();
+
+    // Hint that [offset, offset + length) will be read soon, so the kernel
+    // starts reading it in now.
+    void adviseWillNeed(size_t offset, size_t length);
+};
+}
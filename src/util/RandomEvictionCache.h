@@ -6,6 +6,7 @@
 #include "util/Math.h"
 #include "util/NonCopyable.h"
 
+#include <functional>
 #include <random>
 #include <unordered_map>
 
@@ -56,6 +57,9 @@ class RandomEvictionCache : public NonMovableOrCopyable
     // Each cache keeps some counters just to monitor its performance.
     Counters mCounters;
 
+    // Optionally told about every entry evicted to make room.
+    std::function<void(K const&, V const&)> mOnEvict;
+
     // Randomly pick two elements and evict the less-recently-used one.
     void
     evictOne()
@@ -69,6 +73,10 @@ class RandomEvictionCache : public NonMovableOrCopyable
         MapValueType*& vp2 = mValuePtrs.at(rand_uniform<size_t>(0, sz - 1));
         MapValueType*& victim =
             (vp1->second.mLastAccess < vp2->second.mLastAccess ? vp1 : vp2);
+        if (mOnEvict)
+        {
+            mOnEvict(victim->first, victim->second.mValue);
+        }
         mValueMap.erase(victim->first);
         std::swap(victim, mValuePtrs.back());
         mValuePtrs.pop_back();
@@ -100,6 +108,12 @@ class RandomEvictionCache : public NonMovableOrCopyable
         return mCounters;
     }
 
+    void
+    setEvictionCallback(std::function<void(K const&, V const&)> onEvict)
+    {
+        mOnEvict = std::move(onEvict);
+    }
+
     // `put` does not offer exception safety. If it throws an exception,
     // cache may be in an inconsistent state. It is, therefore,
     // client's responsibility to handle failures correctly.
@@ -0,0 +1,230 @@
+#pragma once
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace stellar
+{
+
+// Implements a fixed-size segmented LRU cache. New entries are admitted to a
+// probationary segment and only move to the protected segment when they are
+// hit again; entries falling off the end of the protected segment get
+// another chance at the head of the probationary one. A scan of entries that
+// are touched once therefore only ever cycles through the probationary
+// segment, and can't flush out entries that are used repeatedly.
+//
+// The interface mirrors RandomEvictionCache so the two can be swapped.
+template <typename K, typename V, typename Hash = std::hash<K>>
+class SegmentedLRUCache : public NonMovableOrCopyable
+{
+  public:
+    struct Counters
+    {
+        uint64_t mHits{0};
+        uint64_t mMisses{0};
+        uint64_t mInserts{0};
+        uint64_t mUpdates{0};
+        uint64_t mEvicts{0};
+        uint64_t mPromotions{0};
+    };
+
+  private:
+    // Share of mMaxSize reserved for the protected segment, in percent.
+    static size_t const PROTECTED_PERCENT = 80;
+
+    size_t mMaxSize;
+    size_t mMaxProtected;
+
+    // Each segment is ordered most- to least-recently used.
+    using ListType = std::list<std::pair<K, V>>;
+    ListType mProbation;
+    ListType mProtected;
+
+    struct Location
+    {
+        bool mProtected;
+        typename ListType::iterator mIter;
+    };
+    std::unordered_map<K, Location, Hash> mLocations;
+
+    Counters mCounters;
+    std::function<void(K const&, V const&)> mOnEvict;
+
+    void
+    evictOne()
+    {
+        auto& victims = mProbation.empty() ? mProtected : mProbation;
+        if (victims.empty())
+        {
+            return;
+        }
+        auto const& victim = victims.back();
+        if (mOnEvict)
+        {
+            mOnEvict(victim.first, victim.second);
+        }
+        mLocations.erase(victim.first);
+        victims.pop_back();
+        ++mCounters.mEvicts;
+    }
+
+    // Move `loc` to the head of the protected segment, demoting the least
+    // recently used protected entry if that overflows it.
+    void
+    touch(Location& loc)
+    {
+        if (loc.mProtected)
+        {
+            mProtected.splice(mProtected.begin(), mProtected, loc.mIter);
+            return;
+        }
+
+        mProtected.splice(mProtected.begin(), mProbation, loc.mIter);
+        loc.mProtected = true;
+        ++mCounters.mPromotions;
+        if (mProtected.size() > mMaxProtected)
+        {
+            auto demoted = std::prev(mProtected.end());
+            mProbation.splice(mProbation.begin(), mProtected, demoted);
+            mLocations.at(demoted->first).mProtected = false;
+        }
+    }
+
+  public:
+    explicit SegmentedLRUCache(size_t maxSize)
+        : mMaxSize(maxSize), mMaxProtected(maxSize * PROTECTED_PERCENT / 100)
+    {
+        mLocations.reserve(maxSize + 1);
+    }
+
+    size_t
+    maxSize() const
+    {
+        return mMaxSize;
+    }
+
+    size_t
+    size() const
+    {
+        return mLocations.size();
+    }
+
+    Counters const&
+    getCounters() const
+    {
+        return mCounters;
+    }
+
+    void
+    setEvictionCallback(std::function<void(K const&, V const&)> onEvict)
+    {
+        mOnEvict = std::move(onEvict);
+    }
+
+    // `put` does not offer exception safety. If it throws an exception,
+    // cache may be in an inconsistent state. It is, therefore,
+    // client's responsibility to handle failures correctly.
+    void
+    put(K const& k, V const& v)
+    {
+        auto it = mLocations.find(k);
+        if (it != mLocations.end())
+        {
+            it->second.mIter->second = v;
+            touch(it->second);
+            ++mCounters.mUpdates;
+            return;
+        }
+
+        mProbation.emplace_front(k, v);
+        mLocations.emplace(k, Location{false, mProbation.begin()});
+        ++mCounters.mInserts;
+        if (mLocations.size() > mMaxSize)
+        {
+            evictOne();
+        }
+    }
+
+    // `exists` offers strong exception safety guarantee. Like
+    // RandomEvictionCache::exists it counts misses (unless told not to) but
+    // neither hits nor accesses.
+    bool
+    exists(K const& k, bool countMisses = true)
+    {
+        bool miss = (mLocations.find(k) == mLocations.end());
+        if (miss && countMisses)
+        {
+            ++mCounters.mMisses;
+        }
+        return !miss;
+    }
+
+    // `clear` does not throw
+    void
+    clear()
+    {
+        mLocations.clear();
+        mProbation.clear();
+        mProtected.clear();
+    }
+
+    // `erase_if` offers basic exception safety guarantee. If it throws an
+    // exception, then the cache may or may not be modified.
+    void
+    erase_if(std::function<bool(V const&)> const& f)
+    {
+        for (auto* segment : {&mProbation, &mProtected})
+        {
+            for (auto it = segment->begin(); it != segment->end();)
+            {
+                if (f(it->second))
+                {
+                    mLocations.erase(it->first);
+                    it = segment->erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    // `maybeGet` offers basic exception safety guarantee.
+    // Returns a pointer to the value if the key exists,
+    // and returns a nullptr otherwise.
+    V*
+    maybeGet(K const& k)
+    {
+        auto it = mLocations.find(k);
+        if (it == mLocations.end())
+        {
+            ++mCounters.mMisses;
+            return nullptr;
+        }
+        ++mCounters.mHits;
+        touch(it->second);
+        return &it->second.mIter->second;
+    }
+
+    // `get` offers basic exception safety guarantee.
+    V&
+    get(K const& k)
+    {
+        V* result = maybeGet(k);
+        if (result == nullptr)
+        {
+            throw std::range_error("There is no such key in cache");
+        }
+        return *result;
+    }
+};
+}
@@ -10,10 +10,13 @@
 #include "util/Fs.h"
 #include "util/GlobalChecks.h"
 #include "util/Logging.h"
+#include "util/MappedFile.h"
+#include "util/ZstdSeekable.h"
 #include "xdrpp/marshal.h"
 #include <Tracy.hpp>
 
 #include <fstream>
+#include <memory>
 #include <string>
 #include <vector>
 #ifdef _WIN32
@@ -26,15 +29,73 @@ namespace stellar
 /**
  * Helper for loading a sequence of XDR objects from a file one at a time,
  * rather than all at once.
+ *
+ * Files written by an XDROutputFileStream with compression enabled are
+ * recognized and decompressed transparently; size(), pos() and seek() are
+ * then in terms of the decompressed XDR.
+ *
+ * Files opened with openMapped() are decoded straight out of a memory
+ * mapping of the file, rather than copied out of it a record at a time.
  */
 class XDRInputFileStream
 {
     std::ifstream mIn;
+    std::unique_ptr<ZstdSeekableReader> mZstd;
+    std::unique_ptr<MappedFile> mMapped;
+    size_t mMappedPos{0};
+    // Offset at which to hint the kernel to read the next window ahead.
+    size_t mNextWillNeed{0};
+    // Whether a read ran out of data, in the zstd and mapped modes (which
+    // don't go through mIn).
+    bool mFailed{false};
     std::vector<char> mBuf;
     size_t mSizeLimit;
     size_t mSize;
 
+    // The next `size` bytes of the file, valid until the next read, or
+    // nullptr if there aren't that many.
+    char const*
+    readBytes(size_t size)
+    {
+        if (mMapped)
+        {
+            if (mMappedPos > mMapped->size() ||
+                mMapped->size() - mMappedPos < size)
+            {
+                mFailed = true;
+                return nullptr;
+            }
+            // xdr_get reads 32-bit words; records are a multiple of 4 bytes
+            // long, so every record in a (page-aligned) mapping is aligned.
+            char const* data = mMapped->data() + mMappedPos;
+            mMappedPos += size;
+            if (mMappedPos >= mNextWillNeed)
+            {
+                mMapped->adviseWillNeed(mMappedPos, MAPPED_READAHEAD);
+                mNextWillNeed = mMappedPos + MAPPED_READAHEAD / 2;
+            }
+            return data;
+        }
+        if (size > mBuf.size())
+        {
+            mBuf.resize(size);
+        }
+        if (mZstd)
+        {
+            if (mZstd->read(mBuf.data(), size) == size)
+            {
+                return mBuf.data();
+            }
+            mFailed = true;
+            return nullptr;
+        }
+        return mIn.read(mBuf.data(), size) ? mBuf.data() : nullptr;
+    }
+
   public:
+    // How far ahead of the reader of a mapped file to ask the kernel to read.
+    static constexpr size_t MAPPED_READAHEAD = 4 * 1024 * 1024;
+
     XDRInputFileStream(unsigned int sizeLimit = 0)
         : mSizeLimit{sizeLimit}, mSize{0}
     {
@@ -44,6 +105,8 @@ class XDRInputFileStream
     close()
     {
         ZoneScoped;
+        mZstd.reset();
+        mMapped.reset();
         mIn.close();
     }
 
@@ -62,12 +125,49 @@ class XDRInputFileStream
             throw FileSystemException(msg);
         }
         mIn.exceptions(std::ios::badbit);
-        mSize = fs::size(mIn);
+        mFailed = false;
+        if (ZstdSeekableReader::hasMagic(mIn))
+        {
+            mZstd = std::make_unique<ZstdSeekableReader>(mIn);
+            mSize = mZstd->size();
+        }
+        else
+        {
+            mSize = fs::size(mIn);
+        }
+    }
+
+    // Like open(), but where MappedFile is supported, read the file through
+    // a mapping that the kernel is told will be read sequentially. The file
+    // must not change while it's open. Compressed files are read as by
+    // open().
+    void
+    openMapped(std::string const& filename)
+    {
+        ZoneScoped;
+        open(filename);
+        if (mZstd || !MappedFile::isSupported())
+        {
+            return;
+        }
+        mMapped = std::make_unique<MappedFile>(filename);
+        mIn.close();
+        mFailed = false;
+        mMappedPos = 0;
+        mNextWillNeed = 0;
+        mSize = mMapped->size();
+        mMapped->adviseSequential();
     }
 
     operator bool() const
     {
-        return mIn.good();
+        return (mZstd || mMapped) ? !mFailed : mIn.good();
+    }
+
+    bool
+    isCompressed() const
+    {
+        return mZstd != nullptr;
     }
 
     size_t
@@ -79,18 +179,48 @@ class XDRInputFileStream
     size_t
     pos()
     {
+        if (mMapped)
+        {
+            releaseAssertOrThrow(!mFailed);
+            return mMappedPos;
+        }
+        if (mZstd)
+        {
+            releaseAssertOrThrow(!mFailed);
+            return mZstd->pos();
+        }
         releaseAssertOrThrow(!mIn.fail());
 
         return mIn.tellg();
     }
 
+    void
+    seek(size_t pos)
+    {
+        if (mMapped)
+        {
+            mFailed = false;
+            mMappedPos = pos;
+            mNextWillNeed = pos;
+            return;
+        }
+        if (mZstd)
+        {
+            mFailed = false;
+            mZstd->seek(pos);
+            return;
+        }
+        mIn.clear();
+        mIn.seekg(pos);
+    }
+
     template <typename T>
     bool
     readOne(T& out)
     {
         ZoneScoped;
-        char szBuf[4];
-        if (!mIn.read(szBuf, 4))
+        char const* szBuf = readBytes(4);
+        if (!szBuf)
         {
             return false;
         }
@@ -110,15 +240,12 @@ class XDRInputFileStream
         {
             return false;
         }
-        if (sz > mBuf.size())
-        {
-            mBuf.resize(sz);
-        }
-        if (!mIn.read(mBuf.data(), sz))
+        char const* body = readBytes(sz);
+        if (!body)
         {
             throw xdr::xdr_runtime_error("malformed XDR file");
         }
-        xdr::xdr_get g(mBuf.data(), mBuf.data() + sz);
+        xdr::xdr_get g(body, body + sz);
         xdr::xdr_argpack_archive(g, out);
         return true;
     }
@@ -129,7 +256,9 @@ class XDRInputFileStream
 class XDROutputFileStream
 {
     std::vector<char> mBuf;
-    const bool mFsyncOnClose;
+    bool mFsyncOnClose;
+    std::unique_ptr<ZstdSeekableWriter> mZstd;
+    std::vector<char> mCompressed;
 
 #ifdef WIN32
     // Windows implementation assumes calls can't get interrupted
@@ -140,11 +269,54 @@ class XDROutputFileStream
     asio::buffered_write_stream<stellar::fs::stream_t> mBufferedWriteStream;
 #endif
 
+    void
+    writeBytes(char const* data, size_t size)
+    {
+        size_t written = 0;
+        while (written < size)
+        {
+#ifdef WIN32
+            auto w = fwrite(data + written, 1, size - written, mOut);
+            if (w == 0)
+            {
+                FileSystemException::failWith(
+                    std::string("XDROutputFileStream::writeRecords() failed"));
+            }
+            written += w;
+#else
+            asio::error_code ec;
+            auto buf = asio::buffer(data + written, size - written);
+            written += asio::write(mBufferedWriteStream, buf, ec);
+            if (ec)
+            {
+                if (ec == asio::error::interrupted)
+                {
+                    continue;
+                }
+                else
+                {
+                    FileSystemException::failWith(
+                        std::string(
+                            "XDROutputFileStream::writeRecords() failed: ") +
+                        ec.message());
+                }
+            }
+#endif
+        }
+    }
+
   public:
-    XDROutputFileStream(asio::io_context& ctx, bool fsyncOnClose)
+    // Uncompressed bytes per zstd frame of a compressed stream; each frame
+    // is decompressed whole to seek into it.
+    static constexpr size_t COMPRESSION_FRAME_SIZE = 64 * 1024;
+
+    // `bufferSize` is the size of the write buffer, which is flushed to the
+    // file whenever it fills; it's ignored on Windows.
+    XDROutputFileStream(asio::io_context& ctx, bool fsyncOnClose,
+                        size_t bufferSize = stellar::fs::bufsz())
         : mFsyncOnClose(fsyncOnClose)
 #ifndef WIN32
-        , mBufferedWriteStream(ctx, stellar::fs::bufsz())
+        , mBufferedWriteStream(ctx, bufferSize)
 #endif
     {
     }
@@ -167,6 +339,14 @@ class XDROutputFileStream
 #endif
     }
 
+    // Change whether close() fsyncs the file, for writers that sync it some
+    // other way (see fs::flushPathChanges).
+    void
+    setFsyncOnClose(bool fsyncOnClose)
+    {
+        mFsyncOnClose = fsyncOnClose;
+    }
+
     fs::native_handle_t
     getHandle()
     {
@@ -186,6 +366,13 @@ class XDROutputFileStream
             FileSystemException::failWith(
                 "XDROutputFileStream::close() on non-open FILE*");
         }
+        if (mZstd)
+        {
+            mZstd->finish(mCompressed);
+            mZstd.reset();
+            writeBytes(mCompressed.data(), mCompressed.size());
+            mCompressed.clear();
+        }
         flush();
         if (mFsyncOnClose)
         {
@@ -277,73 +464,90 @@ class XDROutputFileStream
         return isOpen();
     }
 
-    template <typename T>
+    // Write everything from now on as seekable zstd frames at compression
+    // level `level` (see ZstdSeekable.h), which XDRInputFileStream reads
+    // back transparently. Must be called before anything is written.
     void
-    writeOne(T const& t, SHA256* hasher = nullptr, size_t* bytesPut = nullptr)
+    enableCompression(int level)
     {
-        ZoneScoped;
-        if (!isOpen())
-        {
-            FileSystemException::failWith(
-                "XDROutputFileStream::writeOne() on non-open stream");
-        }
+        releaseAssertOrThrow(!mZstd);
+        mZstd = std::make_unique<ZstdSeekableWriter>(level,
+                                                     COMPRESSION_FRAME_SIZE);
+    }
 
+    // Serialize `t` into `buf` as a single record: 4 bytes of size,
+    // big-endian, with the XDR 'continuation' bit set, followed by the XDR
+    // body. Returns the number of bytes of `buf` used.
+    template <typename T>
+    static size_t
+    serializeRecord(T const& t, std::vector<char>& buf)
+    {
         uint32_t sz = (uint32_t)xdr::xdr_size(t);
         releaseAssertOrThrow(sz < 0x80000000);
 
-        if (mBuf.size() < sz + 4)
+        if (buf.size() < sz + 4)
         {
-            mBuf.resize(sz + 4);
+            buf.resize(sz + 4);
         }
 
         // Write 4 bytes of size, big-endian, with XDR 'continuation' bit set on
         // high bit of high byte.
-        mBuf[0] = static_cast<char>((sz >> 24) & 0xFF) | '\x80';
-        mBuf[1] = static_cast<char>((sz >> 16) & 0xFF);
-        mBuf[2] = static_cast<char>((sz >> 8) & 0xFF);
-        mBuf[3] = static_cast<char>(sz & 0xFF);
-        xdr::xdr_put p(mBuf.data() + 4, mBuf.data() + 4 + sz);
+        buf[0] = static_cast<char>((sz >> 24) & 0xFF) | '\x80';
+        buf[1] = static_cast<char>((sz >> 16) & 0xFF);
+        buf[2] = static_cast<char>((sz >> 8) & 0xFF);
+        buf[3] = static_cast<char>(sz & 0xFF);
+        xdr::xdr_put p(buf.data() + 4, buf.data() + 4 + sz);
         xdr_argpack_archive(p, t);
+        return sz + 4;
+    }
 
-        size_t const to_write = sz + 4;
-        size_t written = 0;
-        while (written < to_write)
+    // Write `size` bytes holding one or more records produced by
+    // serializeRecord.
+    void
+    writeRecords(char const* data, size_t size)
+    {
+        ZoneScoped;
+        if (!isOpen())
         {
-#ifdef WIN32
-            auto w = fwrite(mBuf.data() + written, 1, to_write - written, mOut);
-            if (w == 0)
-            {
-                FileSystemException::failWith(
-                    std::string("XDROutputFileStream::writeOne() failed"));
-            }
-            written += w;
-#else
-            asio::error_code ec;
-            auto buf = asio::buffer(mBuf.data() + written, to_write - written);
-            written += asio::write(mBufferedWriteStream, buf, ec);
-            if (ec)
+            FileSystemException::failWith(
+                "XDROutputFileStream::writeRecords() on non-open stream");
+        }
+
+        if (mZstd)
+        {
+            mZstd->add(data, size, mCompressed);
+            if (!mCompressed.empty())
             {
-                if (ec == asio::error::interrupted)
-                {
-                    continue;
-                }
-                else
-                {
-                    FileSystemException::failWith(
-                        std::string(
-                            "XDROutputFileStream::writeOne() failed: ") +
-                        ec.message());
-                }
+                writeBytes(mCompressed.data(), mCompressed.size());
+                mCompressed.clear();
             }
-#endif
         }
+        else
+        {
+            writeBytes(data, size);
+        }
+    }
+
+    template <typename T>
+    void
+    writeOne(T const& t, SHA256* hasher = nullptr, size_t* bytesPut = nullptr)
+    {
+        ZoneScoped;
+        if (!isOpen())
+        {
+            FileSystemException::failWith(
+                "XDROutputFileStream::writeOne() on non-open stream");
+        }
+
+        size_t const to_write = serializeRecord(t, mBuf);
+        writeRecords(mBuf.data(), to_write);
         if (hasher)
         {
-            hasher->add(ByteSlice(mBuf.data(), sz + 4));
+            hasher->add(ByteSlice(mBuf.data(), to_write));
         }
         if (bytesPut)
         {
-            *bytesPut += (sz + 4);
+            *bytesPut += to_write;
         }
     }
 };
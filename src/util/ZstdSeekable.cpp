@@ -0,0 +1,334 @@
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/ZstdSeekable.h"
+#include "util/GlobalChecks.h"
+#include <Tracy.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace stellar
+{
+
+namespace
+{
+// Magic numbers and sizes of the zstd frame format and the seekable format,
+// all little-endian.
+uint32_t const ZSTD_FRAME_MAGIC = 0xFD2FB528;
+uint32_t const SEEK_TABLE_SKIPPABLE_MAGIC = 0x184D2A5E;
+uint32_t const SEEKABLE_MAGIC = 0x8F92EAB1;
+size_t const SKIPPABLE_HEADER_SIZE = 8;
+size_t const SEEK_TABLE_FOOTER_SIZE = 9;
+size_t const SEEK_TABLE_ENTRY_SIZE = 8;
+size_t const SEEK_TABLE_ENTRY_SIZE_WITH_CHECKSUM = 12;
+uint8_t const SEEK_TABLE_CHECKSUM_FLAG = 0x80;
+uint8_t const SEEK_TABLE_RESERVED_BITS = 0x7C;
+
+void
+putLE32(std::vector<char>& out, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+    }
+}
+
+uint32_t
+getLE32(char const* p)
+{
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; --i)
+    {
+        v = (v << 8) | static_cast<uint8_t>(p[i]);
+    }
+    return v;
+}
+
+[[noreturn]] void
+throwMalformed(char const* what)
+{
+    throw std::runtime_error(std::string("malformed zstd seekable file: ") +
+                             what);
+}
+
+#ifndef USE_ZSTD
+[[noreturn]] void
+throwNoZstd()
+{
+    throw std::runtime_error(
+        "zstd-compressed files need stellar-core built with zstd");
+}
+#endif
+}
+
+void
+ZstdSeekableWriter::CCtxDeleter::operator()(ZSTD_CCtx_s* ctx) const
+{
+#ifdef USE_ZSTD
+    ZSTD_freeCCtx(ctx);
+#endif
+}
+
+ZstdSeekableWriter::ZstdSeekableWriter(int level, size_t frameSize)
+    : mLevel(level), mFrameSize(frameSize)
+{
+#ifdef USE_ZSTD
+    mCtx.reset(ZSTD_createCCtx());
+    if (!mCtx)
+    {
+        throw std::runtime_error("failed to create zstd compression context");
+    }
+#else
+    throwNoZstd();
+#endif
+    mPending.reserve(mFrameSize);
+}
+
+ZstdSeekableWriter::~ZstdSeekableWriter()
+{
+}
+
+void
+ZstdSeekableWriter::add(char const* data, size_t size, std::vector<char>& out)
+{
+    mPending.insert(mPending.end(), data, data + size);
+    if (mPending.size() >= mFrameSize)
+    {
+        compressPending(out);
+    }
+}
+
+void
+ZstdSeekableWriter::compressPending(std::vector<char>& out)
+{
+    ZoneScoped;
+    if (mPending.empty())
+    {
+        return;
+    }
+    releaseAssertOrThrow(mPending.size() <=
+                         std::numeric_limits<uint32_t>::max());
+#ifdef USE_ZSTD
+    size_t start = out.size();
+    size_t bound = ZSTD_compressBound(mPending.size());
+    out.resize(start + bound);
+    size_t n = ZSTD_compressCCtx(mCtx.get(), out.data() + start, bound,
+                                 mPending.data(), mPending.size(), mLevel);
+    if (ZSTD_isError(n))
+    {
+        throw std::runtime_error(std::string("zstd compression failed: ") +
+                                 ZSTD_getErrorName(n));
+    }
+    out.resize(start + n);
+    mFrames.emplace_back(static_cast<uint32_t>(n),
+                         static_cast<uint32_t>(mPending.size()));
+    mPending.clear();
+#else
+    throwNoZstd();
+#endif
+}
+
+void
+ZstdSeekableWriter::finish(std::vector<char>& out)
+{
+    compressPending(out);
+    size_t tableSize = mFrames.size() * SEEK_TABLE_ENTRY_SIZE +
+                       SEEK_TABLE_FOOTER_SIZE;
+    putLE32(out, SEEK_TABLE_SKIPPABLE_MAGIC);
+    putLE32(out, static_cast<uint32_t>(tableSize));
+    for (auto const& f : mFrames)
+    {
+        putLE32(out, f.first);
+        putLE32(out, f.second);
+    }
+    putLE32(out, static_cast<uint32_t>(mFrames.size()));
+    // No checksums.
+    out.push_back(0);
+    putLE32(out, SEEKABLE_MAGIC);
+}
+
+void
+ZstdSeekableReader::DCtxDeleter::operator()(ZSTD_DCtx_s* ctx) const
+{
+#ifdef USE_ZSTD
+    ZSTD_freeDCtx(ctx);
+#endif
+}
+
+bool
+ZstdSeekableReader::hasMagic(std::ifstream& in)
+{
+    char buf[4];
+    in.clear();
+    in.seekg(0);
+    bool res = in.read(buf, sizeof(buf)) && getLE32(buf) == ZSTD_FRAME_MAGIC;
+    in.clear();
+    in.seekg(0);
+    return res;
+}
+
+ZstdSeekableReader::ZstdSeekableReader(std::ifstream& in) : mIn(in)
+{
+    ZoneScoped;
+#ifdef USE_ZSTD
+    mCtx.reset(ZSTD_createDCtx());
+    if (!mCtx)
+    {
+        throw std::runtime_error(
+            "failed to create zstd decompression context");
+    }
+#else
+    throwNoZstd();
+#endif
+
+    mIn.clear();
+    mIn.seekg(0, std::ios::end);
+    uint64_t fileSize = mIn.tellg();
+    if (fileSize < SKIPPABLE_HEADER_SIZE + SEEK_TABLE_FOOTER_SIZE)
+    {
+        throwMalformed("too short");
+    }
+
+    char footer[SEEK_TABLE_FOOTER_SIZE];
+    mIn.seekg(fileSize - SEEK_TABLE_FOOTER_SIZE);
+    if (!mIn.read(footer, sizeof(footer)) ||
+        getLE32(footer + 5) != SEEKABLE_MAGIC)
+    {
+        throwMalformed("no seek table");
+    }
+    uint64_t numFrames = getLE32(footer);
+    uint8_t descriptor = static_cast<uint8_t>(footer[4]);
+    if (descriptor & SEEK_TABLE_RESERVED_BITS)
+    {
+        throwMalformed("reserved seek table bits set");
+    }
+    size_t entrySize = (descriptor & SEEK_TABLE_CHECKSUM_FLAG)
+                           ? SEEK_TABLE_ENTRY_SIZE_WITH_CHECKSUM
+                           : SEEK_TABLE_ENTRY_SIZE;
+    uint64_t tableSize =
+        numFrames * entrySize + SEEK_TABLE_FOOTER_SIZE + SKIPPABLE_HEADER_SIZE;
+    if (tableSize > fileSize)
+    {
+        throwMalformed("seek table larger than file");
+    }
+
+    std::vector<char> table(tableSize);
+    mIn.seekg(fileSize - tableSize);
+    if (!mIn.read(table.data(), table.size()) ||
+        getLE32(table.data()) != SEEK_TABLE_SKIPPABLE_MAGIC ||
+        getLE32(table.data() + 4) != tableSize - SKIPPABLE_HEADER_SIZE)
+    {
+        throwMalformed("bad seek table header");
+    }
+
+    uint64_t compressed = 0;
+    uint64_t decompressed = 0;
+    mFrameStarts.reserve(numFrames + 1);
+    for (uint64_t i = 0; i < numFrames; ++i)
+    {
+        char const* entry = table.data() + SKIPPABLE_HEADER_SIZE + i * entrySize;
+        mFrameStarts.emplace_back(compressed, decompressed);
+        compressed += getLE32(entry);
+        decompressed += getLE32(entry + 4);
+    }
+    mFrameStarts.emplace_back(compressed, decompressed);
+    if (compressed != fileSize - tableSize)
+    {
+        throwMalformed("seek table does not match frames");
+    }
+}
+
+ZstdSeekableReader::~ZstdSeekableReader()
+{
+}
+
+size_t
+ZstdSeekableReader::size() const
+{
+    return mFrameStarts.back().second;
+}
+
+size_t
+ZstdSeekableReader::pos() const
+{
+    return mFrameStarts[mFrameIndex].second + mFramePos;
+}
+
+void
+ZstdSeekableReader::seek(size_t pos)
+{
+    if (pos > size())
+    {
+        throw std::out_of_range("seek past end of zstd seekable file");
+    }
+    // The last frame starting at or before `pos`.
+    auto it = std::upper_bound(
+        mFrameStarts.begin(), mFrameStarts.end(), pos,
+        [](size_t p, std::pair<uint64_t, uint64_t> const& start) {
+            return p < start.second;
+        });
+    mFrameIndex = std::distance(mFrameStarts.begin(), it) - 1;
+    mFramePos = pos - mFrameStarts[mFrameIndex].second;
+}
+
+size_t
+ZstdSeekableReader::read(char* data, size_t size)
+{
+    size_t numFrames = mFrameStarts.size() - 1;
+    size_t got = 0;
+    while (got < size && mFrameIndex < numFrames)
+    {
+        if (mLoadedFrame != mFrameIndex)
+        {
+            loadFrame(mFrameIndex);
+        }
+        size_t n = std::min(size - got, mFrame.size() - mFramePos);
+        if (n == 0)
+        {
+            ++mFrameIndex;
+            mFramePos = 0;
+            continue;
+        }
+        std::memcpy(data + got, mFrame.data() + mFramePos, n);
+        mFramePos += n;
+        got += n;
+    }
+    return got;
+}
+
+void
+ZstdSeekableReader::loadFrame(size_t index)
+{
+    ZoneScoped;
+    auto const& start = mFrameStarts[index];
+    auto const& end = mFrameStarts[index + 1];
+    mCompressed.resize(end.first - start.first);
+    mIn.clear();
+    mIn.seekg(start.first);
+    if (!mIn.read(mCompressed.data(), mCompressed.size()))
+    {
+        throwMalformed("truncated frame");
+    }
+    mFrame.resize(end.second - start.second);
+#ifdef USE_ZSTD
+    size_t n = ZSTD_decompressDCtx(mCtx.get(), mFrame.data(), mFrame.size(),
+                                   mCompressed.data(), mCompressed.size());
+    if (ZSTD_isError(n) || n != mFrame.size())
+    {
+        throwMalformed("bad frame");
+    }
+#else
+    throwNoZstd();
+#endif
+    mLoadedFrame = index;
+}
+}
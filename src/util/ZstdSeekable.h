@@ -0,0 +1,102 @@
+#pragma once
+
+// Copyright 2022 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+
+namespace stellar
+{
+
+/**
+ * Support for files in the zstd "seekable" format (see
+ * contrib/seekable_format in the zstd repository): a sequence of independent
+ * zstd frames, each holding a bounded amount of data, followed by a seek table
+ * in a skippable frame that lists the compressed and decompressed size of
+ * every frame. Plain `zstd -d` decompresses such files; readers that know the
+ * format can seek to any decompressed offset by decompressing a single frame.
+ *
+ * Actual (de)compression needs stellar-core to be built with zstd (USE_ZSTD);
+ * without it, recognizing a compressed file still works, but writing or
+ * reading one throws.
+ */
+class ZstdSeekableWriter : public NonMovableOrCopyable
+{
+  public:
+    ZstdSeekableWriter(int level, size_t frameSize);
+    ~ZstdSeekableWriter();
+
+    // Append `size` bytes; whenever a frame fills up, its compressed form is
+    // appended to `out`.
+    void add(char const* data, size_t size, std::vector<char>& out);
+
+    // Append the last (partial) frame and the seek table to `out`.
+    void finish(std::vector<char>& out);
+
+  private:
+    int const mLevel;
+    size_t const mFrameSize;
+    std::vector<char> mPending;
+    // Compressed and decompressed size of each frame written so far.
+    std::vector<std::pair<uint32_t, uint32_t>> mFrames;
+    struct CCtxDeleter
+    {
+        void operator()(ZSTD_CCtx_s* ctx) const;
+    };
+    std::unique_ptr<ZSTD_CCtx_s, CCtxDeleter> mCtx;
+
+    void compressPending(std::vector<char>& out);
+};
+
+class ZstdSeekableReader : public NonMovableOrCopyable
+{
+  public:
+    // Whether `in` starts with a zstd frame. Leaves `in` at its start.
+    static bool hasMagic(std::ifstream& in);
+
+    // Reads the seek table of the file open in `in`, which must outlive the
+    // reader. Throws if the seek table is malformed.
+    explicit ZstdSeekableReader(std::ifstream& in);
+    ~ZstdSeekableReader();
+
+    // Total decompressed size.
+    size_t size() const;
+
+    // Decompressed offset of the next byte read().
+    size_t pos() const;
+
+    void seek(size_t pos);
+
+    // Read up to `size` bytes; returns the number read, which is less than
+    // `size` only at the end of the data.
+    size_t read(char* data, size_t size);
+
+  private:
+    std::ifstream& mIn;
+    // Compressed and decompressed offset of the start of each frame, plus a
+    // final entry for the end of the data.
+    std::vector<std::pair<uint64_t, uint64_t>> mFrameStarts;
+    size_t mFrameIndex{0};
+    size_t mFramePos{0};
+    // Frame mLoadedFrame, decompressed.
+    size_t mLoadedFrame{SIZE_MAX};
+    std::vector<char> mFrame;
+    std::vector<char> mCompressed;
+    struct DCtxDeleter
+    {
+        void operator()(ZSTD_DCtx_s* ctx) const;
+    };
+    std::unique_ptr<ZSTD_DCtx_s, DCtxDeleter> mCtx;
+
+    void loadFrame(size_t index);
+};
+}
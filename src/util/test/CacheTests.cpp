@@ -4,6 +4,7 @@
 
 #include "lib/catch.hpp"
 #include "util/RandomEvictionCache.h"
+#include "util/SegmentedLRUCache.h"
 #include <ctime>
 #include <map>
 
@@ -152,8 +153,10 @@ TEST_CASE("RandomEvictionCache does not thrash",
 }
 
 using RandCache = RandomEvictionCache<int, int>;
+using SLRUCache = SegmentedLRUCache<int, int>;
 
-TEMPLATE_TEST_CASE("cache empty", "[cache][template]", RandCache)
+TEMPLATE_TEST_CASE("cache empty", "[cache][template]", RandCache,
+                   SLRUCache)
 {
     TestType c{5};
 
@@ -161,7 +164,7 @@ TEMPLATE_TEST_CASE("cache empty", "[cache][template]", RandCache)
 }
 
 TEMPLATE_TEST_CASE("cache keeps most added items", "[cache][template]",
-                   RandCache)
+                   RandCache, SLRUCache)
 {
     TestType c{5};
     c.put(0, 0);
@@ -189,7 +192,7 @@ TEMPLATE_TEST_CASE("cache keeps most added items", "[cache][template]",
 }
 
 TEMPLATE_TEST_CASE("cache keeps last read items", "[cache][template]",
-                   RandCache)
+                   RandCache, SLRUCache)
 {
     TestType c{5};
     c.put(0, 0);
@@ -213,7 +216,8 @@ TEMPLATE_TEST_CASE("cache keeps last read items", "[cache][template]",
 }
 
 TEMPLATE_TEST_CASE("cache keeps last read items with maybeGet",
-                   "[cache][template]", RandCache)
+                   "[cache][template]", RandCache,
+                   SLRUCache)
 {
     TestType c{5};
     c.put(0, 0);
@@ -236,7 +240,8 @@ TEMPLATE_TEST_CASE("cache keeps last read items with maybeGet",
     REQUIRE(existing == 5);
 }
 
-TEMPLATE_TEST_CASE("cache replace element", "[cache][template]", RandCache)
+TEMPLATE_TEST_CASE("cache replace element", "[cache][template]", RandCache,
+                   SLRUCache)
 {
     TestType c{5};
     c.put(0, 0);
@@ -264,7 +269,7 @@ TEMPLATE_TEST_CASE("cache replace element", "[cache][template]", RandCache)
 }
 
 TEMPLATE_TEST_CASE("cache erase_if removes some nodes", "[cache][template]",
-                   RandCache)
+                   RandCache, SLRUCache)
 {
     TestType c{5};
     c.put(0, 0);
@@ -283,7 +288,7 @@ TEMPLATE_TEST_CASE("cache erase_if removes some nodes", "[cache][template]",
 }
 
 TEMPLATE_TEST_CASE("cache erase_if removes no nodes", "[cache][template]",
-                   RandCache)
+                   RandCache, SLRUCache)
 {
     TestType c{5};
     c.put(0, 0);
@@ -302,7 +307,7 @@ TEMPLATE_TEST_CASE("cache erase_if removes no nodes", "[cache][template]",
 }
 
 TEMPLATE_TEST_CASE("cache erase_if removes all nodes", "[cache][template]",
-                   RandCache)
+                   RandCache, SLRUCache)
 {
     TestType c{5};
     c.put(0, 0);
@@ -319,3 +324,61 @@ TEMPLATE_TEST_CASE("cache erase_if removes all nodes", "[cache][template]",
     REQUIRE(!c.exists(3));
     REQUIRE(!c.exists(4));
 }
+
+TEST_CASE("SegmentedLRUCache is scan resistant", "[cache][slru]")
+{
+    size_t sz = 100;
+    SegmentedLRUCache<size_t, size_t> cache(sz);
+    auto const& ctrs = cache.getCounters();
+
+    // A hot set, read twice so that it is promoted out of probation
+    size_t hot = sz / 2;
+    for (size_t i = 0; i < hot; ++i)
+    {
+        cache.put(i, i);
+    }
+    for (size_t i = 0; i < hot; ++i)
+    {
+        REQUIRE(cache.get(i) == i);
+    }
+    REQUIRE(ctrs.mPromotions == hot);
+
+    // A scan over many more entries than the cache holds, each touched once
+    size_t evicted = 0;
+    cache.setEvictionCallback([&](size_t const& k, size_t const&) {
+        REQUIRE(k >= hot);
+        ++evicted;
+    });
+    for (size_t i = hot; i < hot + 10 * sz; ++i)
+    {
+        cache.put(i, i);
+    }
+    REQUIRE(cache.size() == sz);
+    REQUIRE(evicted == 10 * sz - (sz - hot));
+    REQUIRE(ctrs.mEvicts == evicted);
+
+    // The hot set survived
+    for (size_t i = 0; i < hot; ++i)
+    {
+        REQUIRE(cache.exists(i));
+    }
+}
+
+TEST_CASE("SegmentedLRUCache demotes from protected segment", "[cache][slru]")
+{
+    // 80% of 5 entries: 4 may be protected
+    SegmentedLRUCache<int, int> c{5};
+    for (int i = 0; i < 5; ++i)
+    {
+        c.put(i, i);
+        c.get(i);
+    }
+    // 0 was demoted to probation when 4 got promoted, and is the first
+    // candidate for eviction
+    c.put(5, 5);
+    REQUIRE(!c.exists(0));
+    for (int i = 1; i <= 5; ++i)
+    {
+        REQUIRE(c.exists(i));
+    }
+}
@@ -3,10 +3,13 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "bucket/Bucket.h"
+#include "crypto/Hex.h"
+#include "crypto/Random.h"
 #include "ledger/test/LedgerTestUtils.h"
 #include "lib/catch.hpp"
 #include "test/test.h"
 #include "util/Logging.h"
+#include "util/TmpDir.h"
 #include "util/XDRStream.h"
 #include <fmt/format.h>
 
@@ -44,6 +47,53 @@ TEST_CASE("XDROutputFileStream fail modes", "[xdrstream]")
     }
 }
 
+TEST_CASE("XDRInputFileStream mapped reads", "[xdrstream]")
+{
+    VirtualClock clock;
+    TmpDirManager tdm(std::string("xdrstream-") + binToHex(randomBytes(8)));
+    TmpDir td = tdm.tmpDir("mapped");
+    auto filename = td.getName() + "/entries.xdr";
+
+    auto ledgerEntries = LedgerTestUtils::generateValidLedgerEntries(1000);
+    auto bucketEntries =
+        Bucket::convertToBucketEntry(false, {}, ledgerEntries, {});
+    std::vector<size_t> offsets;
+    {
+        XDROutputFileStream out(clock.getIOContext(), /*doFsync=*/false);
+        out.open(filename);
+        size_t bytes = 0;
+        for (auto const& e : bucketEntries)
+        {
+            offsets.emplace_back(bytes);
+            out.writeOne(e, nullptr, &bytes);
+        }
+        out.close();
+    }
+
+    XDRInputFileStream streamed, mapped;
+    streamed.open(filename);
+    mapped.openMapped(filename);
+    REQUIRE(mapped.size() == streamed.size());
+
+    BucketEntry s, m;
+    for (size_t i = 0; i < bucketEntries.size(); ++i)
+    {
+        REQUIRE(mapped.pos() == offsets[i]);
+        REQUIRE(streamed.readOne(s));
+        REQUIRE(mapped.readOne(m));
+        REQUIRE(m == s);
+        REQUIRE(m == bucketEntries[i]);
+    }
+    REQUIRE(!streamed.readOne(s));
+    REQUIRE(!mapped.readOne(m));
+    REQUIRE(!mapped);
+
+    mapped.seek(offsets[500]);
+    REQUIRE(mapped);
+    REQUIRE(mapped.readOne(m));
+    REQUIRE(m == bucketEntries[500]);
+}
+
 TEST_CASE("XDROutputFileStream fsync bench", "[!hide][xdrstream][bench]")
 {
     VirtualClock clock;